@@ -0,0 +1,380 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <system_error>
+#include <algorithm>
+
+#include <sys/types.h>
+
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "msr.hpp"
+
+namespace {
+
+// below this # of register accesses a list is read serially, the threads cost more than the IPIs
+constexpr size_t nr_access_parallel = 64;
+
+int open_errno(int err)
+{
+    switch (err) {
+    case ENXIO:
+        return msr::MSR_ENOCPU;
+
+    case EIO:
+        return msr::MSR_ENOMSR;
+
+    default:
+        return msr::MSR_EACCES;
+    }
+}
+
+int is_cpu(const struct dirent *dirp)
+{
+    return std::isdigit(dirp->d_name[0]); /* /dev/cpu/<cpu> */
+}
+
+} /* namespace */
+
+namespace msr {
+
+const char *strerr(int err)
+{
+    switch (err) {
+    case MSR_OK:
+        return "succ";
+
+    case MSR_ENOCPU:
+        return "no such cpu";
+
+    case MSR_ENOMSR:
+        return "MSR not supported";
+
+    case MSR_EACCES:
+        return "failed to open the MSR device (root? msr module loaded?)";
+
+    case MSR_EIO:
+        return "no such register, or the access is refused";
+
+    default:
+        return "unknown error";
+    }
+}
+
+const std::string &dev_dir()
+{
+    static const std::string dir = [] {
+        const char *env = ::getenv("MSR_DEV_DIR");
+        return std::string(env && *env ? env : "/dev/cpu");
+    }();
+
+    return dir;
+}
+
+off_t reg_offset(uint32_t reg)
+{
+    static const bool fake = dev_dir() != "/dev/cpu";
+
+    return fake ? static_cast<off_t>(reg) * 8 : static_cast<off_t>(reg);
+}
+
+std::vector<int> parse_cpus(const std::string &list)
+{
+    std::vector<int> cpus;
+
+    for (const char *p = list.c_str(); *p; ) {
+        char *end;
+
+        long fr = std::strtol(p, &end, 10);
+        if (end == p || fr < 0) {
+            break;
+        }
+
+        long to = fr;
+        if (*end == '-') {
+            p  = end + 1;
+            to = std::strtol(p, &end, 10);
+            if (end == p || to < fr) {
+                break;
+            }
+        }
+
+        for (long c = fr; c <= to; ++c) {
+            cpus.push_back(c);
+        }
+
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',') {
+            break;
+        }
+    }
+
+    return cpus;
+}
+
+std::vector<int> online_cpus()
+{
+    std::vector<int> cpus;
+
+    // a fake tree has its own set of cpus
+    if (dev_dir() == "/dev/cpu") {
+        FILE *fp = ::fopen("/sys/devices/system/cpu/online", "r");
+        if (fp) {
+            char buf[4096];
+
+            if (::fgets(buf, sizeof(buf), fp)) {
+                cpus = parse_cpus(buf);
+            }
+
+            ::fclose(fp);
+        }
+    }
+
+    if (!cpus.empty()) {
+        return cpus;
+    }
+
+    // no sysfs, all the cpus with a MSR device
+    struct dirent **namelist;
+
+    int nr_dirent = ::scandir(dev_dir().c_str(), &namelist, is_cpu, 0);
+
+    for (int i = 0; i < nr_dirent; ++i) {
+        cpus.push_back(std::atoi(namelist[i]->d_name));
+        free(namelist[i]);
+    }
+
+    if (nr_dirent >= 0) {
+        free(namelist);
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+
+    return cpus;
+}
+
+unsigned int handle::default_threads()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+
+    return std::max(1U, std::min(n, 16U));
+}
+
+int handle::open(int cpu)
+{
+    if (cpu < 0) {
+        return MSR_ENOCPU;
+    }
+
+    if (static_cast<size_t>(cpu) >= _fd.size()) {
+        _fd.resize(cpu + 1, -1);
+    }
+
+    if (_fd[cpu] != -1) {
+        return MSR_OK;
+    }
+
+    std::string msr_path = dev_dir() + "/" + std::to_string(cpu) + "/msr";
+
+    int fd = ::open(msr_path.c_str(), _writable ? O_RDWR : O_RDONLY);
+    if (fd == -1) {
+        return open_errno(errno);
+    }
+
+    _fd[cpu] = fd;
+
+    return MSR_OK;
+}
+
+void handle::close()
+{
+    for (int fd : _fd) {
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+
+    _fd.clear();
+}
+
+int handle::read(int cpu, uint32_t reg, uint64_t *val)
+{
+    int err = open(cpu);
+    if (err != MSR_OK) {
+        return err;
+    }
+
+    return ::pread(_fd[cpu], val, sizeof(*val), reg_offset(reg)) == sizeof(*val) ? MSR_OK : MSR_EIO;
+}
+
+int handle::write(int cpu, uint32_t reg, uint64_t val)
+{
+    if (!_writable) {
+        return MSR_EACCES;
+    }
+
+    int err = open(cpu);
+    if (err != MSR_OK) {
+        return err;
+    }
+
+    return ::pwrite(_fd[cpu], &val, sizeof(val), reg_offset(reg)) == sizeof(val) ? MSR_OK : MSR_EIO;
+}
+
+int handle::read(int cpu, const std::vector<uint32_t> &regs, uint64_t *vals)
+{
+    for (size_t r = 0; r < regs.size(); ++r) {
+        int err = read(cpu, regs[r], &vals[r]);
+        if (err != MSR_OK) {
+            return err;
+        }
+    }
+
+    return MSR_OK;
+}
+
+int handle::write(int cpu, const std::vector<uint32_t> &regs, const uint64_t *vals)
+{
+    for (size_t r = 0; r < regs.size(); ++r) {
+        int err = write(cpu, regs[r], vals[r]);
+        if (err != MSR_OK) {
+            return err;
+        }
+    }
+
+    return MSR_OK;
+}
+
+template <typename Func>
+void handle::fan_out(size_t n, size_t nr_access, Func fn) const
+{
+    const size_t nr_thread = nr_access < nr_access_parallel ? 1 : std::min<size_t>(_nr_thread, n);
+
+    // the thread t takes the cpus t, t + nr_thread, ..., the caller is the thread 0
+    auto work = [&](size_t t) {
+        for (size_t i = t; i < n; i += nr_thread) {
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    size_t t = 1;
+    for (; t < nr_thread; ++t) {
+        try {
+            workers.emplace_back(work, t);
+        } catch (const std::system_error &) {
+            break;
+        }
+    }
+
+    // the strides which failed to get a thread are run here
+    for (work(0); t < nr_thread; ++t) {
+        work(t);
+    }
+
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+int handle::read(const std::vector<int> &cpus, const std::vector<uint32_t> &regs, std::vector<uint64_t> &vals,
+                 std::vector<int> *errs)
+{
+    std::vector<int> err(cpus.size(), MSR_OK);
+
+    vals.assign(cpus.size() * regs.size(), 0);
+
+    // the fds are opened here, the workers only pread
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        err[i] = open(cpus[i]);
+    }
+
+    fan_out(cpus.size(), cpus.size() * regs.size(), [&](size_t i) {
+        if (err[i] != MSR_OK) {
+            return;
+        }
+
+        int fd = _fd[cpus[i]];
+
+        for (size_t r = 0; r < regs.size(); ++r) {
+            if (::pread(fd, &vals[i * regs.size() + r], sizeof(uint64_t), reg_offset(regs[r])) != sizeof(uint64_t)) {
+                err[i] = MSR_EIO;
+                return;
+            }
+        }
+    });
+
+    int res = MSR_OK;
+    for (int e : err) {
+        if (e != MSR_OK) {
+            res = e;
+            break;
+        }
+    }
+
+    if (errs) {
+        errs->swap(err);
+    }
+
+    return res;
+}
+
+int handle::write(const std::vector<int> &cpus, const std::vector<uint32_t> &regs, const std::vector<uint64_t> &vals,
+                  std::vector<int> *errs)
+{
+    std::vector<int> err(cpus.size(), _writable ? MSR_OK : MSR_EACCES);
+
+    if (vals.size() < cpus.size() * regs.size()) {
+        std::fill(err.begin(), err.end(), MSR_EIO);
+    }
+
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        if (err[i] == MSR_OK) {
+            err[i] = open(cpus[i]);
+        }
+    }
+
+    fan_out(cpus.size(), cpus.size() * regs.size(), [&](size_t i) {
+        if (err[i] != MSR_OK) {
+            return;
+        }
+
+        int fd = _fd[cpus[i]];
+
+        for (size_t r = 0; r < regs.size(); ++r) {
+            if (::pwrite(fd, &vals[i * regs.size() + r], sizeof(uint64_t), reg_offset(regs[r])) != sizeof(uint64_t)) {
+                err[i] = MSR_EIO;
+                return;
+            }
+        }
+    });
+
+    int res = MSR_OK;
+    for (int e : err) {
+        if (e != MSR_OK) {
+            res = e;
+            break;
+        }
+    }
+
+    if (errs) {
+        errs->swap(err);
+    }
+
+    return res;
+}
+
+} /* namespace msr */
@@ -0,0 +1,205 @@
+/**
+ * msr.hpp - read/write model specific registers through /dev/cpu/<cpu>/msr
+ *
+ */
+#ifndef __MSR_HPP__
+#define __MSR_HPP__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace msr {
+
+enum {
+    MSR_OK = 0,
+    MSR_ENOCPU,   /* the cpu does not exist (ENXIO) */
+    MSR_ENOMSR,   /* the cpu does not support MSR, or the register does not exist (EIO) */
+    MSR_EACCES,   /* failed to open /dev/cpu/<cpu>/msr (not root, msr module not loaded, ...) */
+    MSR_EIO       /* pread/pwrite failed */
+};
+
+/* a short description of the MSR_* code @err */
+const char *strerr(int err);
+
+/**
+ * dev_dir - the directory of the per cpu MSR devices, "/dev/cpu" unless $MSR_DEV_DIR is set
+ *
+ * Description:
+ *     $MSR_DEV_DIR points the library to a fake tree of <dir>/<cpu>/msr regular files, the
+ *     register X being the 8 bytes at offset X * 8 (see reg_offset()), so the tools can be
+ *     tested without root
+ */
+const std::string &dev_dir();
+
+/**
+ * reg_offset - the file offset of register @reg in the msr file of dev_dir()
+ *
+ * Description:
+ *     /dev/cpu/<cpu>/msr takes the register id as the offset of an 8 bytes access. in a fake
+ *     tree the registers are 8 bytes apart instead, otherwise adjacent ones (0xc8f & 0xc90,
+ *     0xe7 & 0xe8) would overlap
+ */
+off_t reg_offset(uint32_t reg);
+
+/* the ids in the cpulist @list, e.g. "0,18-35", in the given order */
+std::vector<int> parse_cpus(const std::string &list);
+
+/* the online processors in ascending order, from /sys/devices/system/cpu/online (or dev_dir()) */
+std::vector<int> online_cpus();
+
+/**
+ * rdmsr - read the register @reg on processor @cpu
+ *
+ * @cpu  which processor
+ * @reg  the register id
+ * @val  where to store the value
+ *
+ * Return:
+ *     MSR_OK on succ, otherwise one of the MSR_E* above
+ */
+inline int rdmsr(int cpu, uint32_t reg, uint64_t *val)
+{
+    std::string msr_path = dev_dir() + "/" + std::to_string(cpu) + "/msr";
+
+    int fd = ::open(msr_path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        switch (errno) {
+        case ENXIO:
+            return MSR_ENOCPU;
+
+        case EIO:
+            return MSR_ENOMSR;
+
+        default:
+            return MSR_EACCES;
+        }
+    }
+
+    int err = ::pread(fd, val, sizeof(*val), reg_offset(reg)) == sizeof(*val) ? MSR_OK : MSR_EIO;
+
+    ::close(fd);
+
+    return err;
+}
+
+/**
+ * wrmsr - write @val to the register @reg on processor @cpu
+ *
+ * Return:
+ *     MSR_OK on succ, otherwise one of the MSR_E* above
+ */
+inline int wrmsr(int cpu, uint32_t reg, uint64_t val)
+{
+    std::string msr_path = dev_dir() + "/" + std::to_string(cpu) + "/msr";
+
+    int fd = ::open(msr_path.c_str(), O_WRONLY);
+    if (fd == -1) {
+        switch (errno) {
+        case ENXIO:
+            return MSR_ENOCPU;
+
+        case EIO:
+            return MSR_ENOMSR;
+
+        default:
+            return MSR_EACCES;
+        }
+    }
+
+    int err = ::pwrite(fd, &val, sizeof(val), reg_offset(reg)) == sizeof(val) ? MSR_OK : MSR_EIO;
+
+    ::close(fd);
+
+    return err;
+}
+
+//
+// rdmsr()/wrmsr() above open & close /dev/cpu/<cpu>/msr for each register, fine for a one-shot
+// access, but too slow to read a dozen MSRs on every cpu each interval. a handle keeps the fd of
+// each cpu open until it is destroyed, & accesses a list of registers (on a list of cpus) at a time:
+//
+//   msr::handle h;
+//   std::vector<uint64_t> vals;                   /* cpus.size() x regs.size(), row major */
+//   h.read(cpus, { 0xe7, 0xe8, 0x19c }, vals);   /* MPERF, APERF, THERM_STATUS of each cpu */
+//
+// each access is still one pread/pwrite (an IPI to the target cpu, a few us), the list forms fan
+// out across up to threads() worker threads by cpu, so the latency of N cpus is not N x IPIs.
+// a handle is not thread safe itself, use one per thread.
+//
+class handle {
+
+public:
+    explicit handle(bool writable = false) : _writable(writable) { }
+
+    ~handle() {
+        close();
+    }
+
+    handle(const handle &) = delete;
+    handle &operator=(const handle &) = delete;
+
+    /* open (& cache) /dev/cpu/<cpu>/msr, MSR_OK if it is already opened */
+    int open(int cpu);
+    void close();
+
+    /**
+     * read/write - access the register(s) @regs on processor @cpu
+     *
+     * Return:
+     *     MSR_OK on succ, otherwise one of the MSR_E* above for the first failed register
+     */
+    int read(int cpu, uint32_t reg, uint64_t *val);
+    int write(int cpu, uint32_t reg, uint64_t val);
+
+    int read(int cpu, const std::vector<uint32_t> &regs, uint64_t *vals);
+    int write(int cpu, const std::vector<uint32_t> &regs, const uint64_t *vals);
+
+    /**
+     * read/write - access the registers @regs on each processor of @cpus, in parallel
+     *
+     * @vals  cpus.size() x regs.size() values, vals[i * regs.size() + r] for register r of cpus[i]
+     * @errs  if not null, the result of each cpu
+     *
+     * Return:
+     *     MSR_OK if all succ, otherwise the error of the first failed cpu
+     */
+    int read(const std::vector<int> &cpus, const std::vector<uint32_t> &regs, std::vector<uint64_t> &vals,
+             std::vector<int> *errs = nullptr);
+    int write(const std::vector<int> &cpus, const std::vector<uint32_t> &regs, const std::vector<uint64_t> &vals,
+              std::vector<int> *errs = nullptr);
+
+    /* the max # of threads (including the caller) to fan out the list forms, 1 for serial */
+    void threads(unsigned int n) {
+        _nr_thread = n ? n : 1;
+    }
+
+    unsigned int threads() const {
+        return _nr_thread;
+    }
+
+private:
+    template <typename Func>
+    void fan_out(size_t n, size_t nr_access, Func fn) const;
+
+private:
+    bool _writable;
+    unsigned int _nr_thread = default_threads();
+
+    std::vector<int> _fd; /* subscript is the processor's id, -1 if not opened */
+
+    static unsigned int default_threads();
+};
+
+} /* namespace msr */
+
+#endif /* __MSR_HPP__ */
@@ -0,0 +1,808 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include "msr.hpp"
+#include "msr_version.hpp"
+
+#define program "msr_exp"
+
+#define msr_warn(fmt, ...) fprintf(stderr, program ": " fmt, ##__VA_ARGS__)
+
+//
+// msr_exp - run a command (or wait) under a list of uncore frequency / LLC allocation settings,
+// & restore the original MSR values afterwards, whatever happens to the run
+//
+// the registers (see README):
+//
+//   MSR_UNCORE_RATIO_LIMIT (0x620)  bits 7:0 max ratio, 15:8 min ratio, in 100MHz, per package
+//   IA32_PQR_ASSOC         (0xc8f)  bits 63:32 class of service (COS) of the thread
+//   IA32_L3_QOS_MASK_n     (0xc90+n) the LLC ways COS n may allocate in, contiguous bits
+//
+// a setting ("point") is either named in a config file, one per line:
+//
+//   # name      settings
+//   unc-12      uncore=12              min = max = 1.2GHz
+//   unc-12-24   uncore=12:24           min 1.2GHz, max 2.4GHz
+//   llc-5       ways=5                 all the cpus in COS 0, with 5 ways
+//   isolate     cat=0-3:0xff cat=4-7:0xff00
+//                                      cpus 0-3 in COS 1 with ways 0-7, 4-7 in COS 2 with 8-15
+//
+// or the product of --uncore & --ways. the original values of all the registers any point writes
+// are saved first, & written back before the next point, at exit, & on SIGINT/SIGTERM/SIGHUP/SIGQUIT
+//
+
+namespace msr {
+
+constexpr uint32_t MSR_UNCORE_RATIO_LIMIT = 0x620;
+constexpr uint32_t IA32_PQR_ASSOC         = 0xc8f;
+constexpr uint32_t IA32_L3_QOS_MASK_0     = 0xc90;
+
+const struct option long_options[] = {
+    {"help",      no_argument,       NULL, 'h'},
+    {"version",   no_argument,       NULL, 'v'},
+    {"config",    required_argument, NULL, 'c'},
+    {"name",      required_argument, NULL, 'n'},
+    {"uncore",    required_argument, NULL, 'u'},
+    {"ways",      required_argument, NULL, 'w'},
+    {"wait",      required_argument, NULL, 't'},
+    {"repeat",    required_argument, NULL, 'r'},
+    {"perfm",     required_argument, NULL, 'P'},
+    {"capture",   required_argument, NULL, 'C'},
+    {"output",    required_argument, NULL, 'o'},
+    {"dry-run",   no_argument,       NULL, 'N'},
+    {NULL,        no_argument,       NULL,  0 }
+};
+
+const char shot_options[] = "hvc:n:u:w:t:r:P:C:o:N";
+
+typedef struct {
+    std::string name;
+
+    int unc_min;   /* -1 to keep */
+    int unc_max;
+    int ways;      /* of COS 0, -1 to keep */
+
+    std::vector<std::pair<std::string, uint64_t>> cat; /* cpulist:mask, COS 1, 2, ... */
+} config_t;
+
+typedef struct {
+    std::string config_filp;
+    std::set<std::string> names;  /* of the config file to run, empty for all */
+
+    std::string uncore;           /* grid axes */
+    std::string ways;
+
+    double wait;                  /* seconds to wait without a command */
+    int repeat;                   /* runs per point */
+
+    std::string perfm;            /* perfm monitor arguments, capture if not empty */
+    std::string capture;          /* directory of the captures */
+
+    FILE *fp;
+    bool dry_run;
+
+    std::vector<char *> command;
+} options_t;
+
+options_t options;
+
+volatile sig_atomic_t should_quit = 0; /* the signal received */
+volatile pid_t child[2] = { -1, -1 };  /* the command & perfm */
+
+void usage()
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    %s [options] [-- <command> [args ...]]\n"
+            "Options:\n"
+            "    --help            -h  print this help\n"
+            "    --version         -v  print current version\n"
+            "    --config <file>   -c  the named configurations, one per line:\n"
+            "                          <name> [uncore=<min>[:<max>]] [ways=<n>] [cat=<cpus>:<mask> ...]\n"
+            "    --name <a,b,..>   -n  run only these configurations of the file\n"
+            "    --uncore <list>   -u  grid of uncore ratios (100MHz), e.g. 12,18,24 or 12:24,24\n"
+            "    --ways <list>     -w  grid of LLC ways of COS 0, e.g. 5,10,20\n"
+            "    --wait <sec>      -t  without a command, seconds to wait at each point (default 10)\n"
+            "    --repeat <n>      -r  runs per point (default 1)\n"
+            "    --perfm <args>    -P  capture `perfm monitor <args>` during each run\n"
+            "    --capture <dir>   -C  directory of the captures (default .)\n"
+            "    --output <file>   -o  the sensitivity table (default stdout)\n"
+            "    --dry-run         -N  print the points & the values to write, do not run\n"
+            "\n"
+            "    the original MSR values are always restored, also on SIGINT/SIGTERM/SIGHUP/SIGQUIT.\n"
+            "    $MSR_DEV_DIR points to a fake <dir>/<cpu>/msr tree instead of /dev/cpu, for testing\n",
+            program
+        );
+}
+
+inline void version()
+{
+    fprintf(stderr, "%s: version %s\n", program, MSR_VERSION_STRING);
+}
+
+void sig_handler(int signo)
+{
+    should_quit = signo;
+
+    for (int i = 0; i < 2; ++i) {
+        if (child[i] > 0) {
+            ::kill(child[i], signo == SIGQUIT ? SIGTERM : signo);
+        }
+    }
+}
+
+double monotonic_seconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+std::vector<std::string> split(const std::string &str, char del)
+{
+    std::vector<std::string> res;
+    std::stringstream ss(str);
+    std::string item;
+
+    while (std::getline(ss, item, del)) {
+        if (!item.empty()) {
+            res.push_back(item);
+        }
+    }
+
+    return res;
+}
+
+/* parse "<min>[:<max>]" */
+bool parse_uncore(const std::string &val, config_t &cfg)
+{
+    try {
+        size_t del = val.find(':');
+
+        cfg.unc_min = std::stoi(val);
+        cfg.unc_max = del == std::string::npos ? cfg.unc_min : std::stoi(val.substr(del + 1));
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    return cfg.unc_min > 0 && cfg.unc_min <= cfg.unc_max && cfg.unc_max < 0x80;
+}
+
+/* whether the bits set in @mask are contiguous */
+bool is_contiguous(uint64_t mask)
+{
+    return mask && ((mask >> __builtin_ctzll(mask)) & ((mask >> __builtin_ctzll(mask)) + 1)) == 0;
+}
+
+bool parse_setting(const std::string &item, config_t &cfg)
+{
+    size_t eq = item.find('=');
+    if (eq == std::string::npos) {
+        return false;
+    }
+
+    std::string key = item.substr(0, eq);
+    std::string val = item.substr(eq + 1);
+
+    if (key == "uncore") {
+        return parse_uncore(val, cfg);
+    }
+
+    if (key == "ways") {
+        try {
+            cfg.ways = std::stoi(val);
+        } catch (const std::exception &) {
+            return false;
+        }
+        return cfg.ways > 0 && cfg.ways < 32;
+    }
+
+    if (key == "cat") {
+        size_t del = val.rfind(':');
+        if (del == std::string::npos) {
+            return false;
+        }
+
+        uint64_t mask = 0;
+        try {
+            mask = std::stoull(val.substr(del + 1), 0, 16);
+        } catch (const std::exception &) {
+            return false;
+        }
+
+        if (!is_contiguous(mask) || parse_cpus(val.substr(0, del)).empty()) {
+            return false;
+        }
+
+        cfg.cat.push_back({val.substr(0, del), mask});
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * load_points - the points to run, of the config file (filtered by --name) & of the grid
+ *
+ * Return:
+ *     false on a syntax error
+ */
+bool load_points(std::vector<config_t> &points)
+{
+    if (!options.config_filp.empty()) {
+        std::ifstream fin(options.config_filp);
+        if (!fin.good()) {
+            msr_warn("failed to open %s\n", options.config_filp.c_str());
+            return false;
+        }
+
+        std::string line;
+        for (int nr = 1; std::getline(fin, line); ++nr) {
+            line = line.substr(0, line.find('#'));
+
+            std::vector<std::string> items;
+            std::stringstream ss(line);
+            for (std::string item; ss >> item; ) {
+                items.push_back(item);
+            }
+
+            if (items.empty()) {
+                continue;
+            }
+
+            config_t cfg = { items[0], -1, -1, -1, {} };
+
+            for (size_t i = 1; i < items.size(); ++i) {
+                if (!parse_setting(items[i], cfg)) {
+                    msr_warn("%s:%d: invalid setting %s\n", options.config_filp.c_str(), nr, items[i].c_str());
+                    return false;
+                }
+            }
+
+            if (options.names.empty() || options.names.count(cfg.name)) {
+                points.push_back(cfg);
+            }
+        }
+    }
+
+    // the grid, uncore x ways
+    std::vector<std::string> unc = split(options.uncore, ',');
+    std::vector<std::string> way = split(options.ways, ',');
+
+    if (unc.empty() && way.empty()) {
+        return true;
+    }
+
+    if (unc.empty()) {
+        unc.push_back("");
+    }
+
+    if (way.empty()) {
+        way.push_back("");
+    }
+
+    for (const auto &u : unc) {
+        for (const auto &w : way) {
+            config_t cfg = { "", -1, -1, -1, {} };
+
+            if (!u.empty()) {
+                if (!parse_uncore(u, cfg)) {
+                    msr_warn("invalid uncore ratio %s\n", u.c_str());
+                    return false;
+                }
+                cfg.name += "unc" + u;
+            }
+
+            if (!w.empty()) {
+                if (!parse_setting("ways=" + w, cfg)) {
+                    msr_warn("invalid ways %s\n", w.c_str());
+                    return false;
+                }
+                cfg.name += (cfg.name.empty() ? "" : "-") + std::string("ways") + w;
+            }
+
+            points.push_back(cfg);
+        }
+    }
+
+    return true;
+}
+
+//
+// the saved registers & the values of a point, cpus x regs, as msr::handle's list forms
+//
+class state {
+
+public:
+    state(const std::vector<int> &cpus, const std::vector<config_t> &points) : _cpus(cpus), _h(true) {
+        size_t nr_cos = 0;
+        bool unc = false;
+
+        for (const auto &p : points) {
+            unc = unc || p.unc_min > 0;
+
+            if (p.ways > 0 || !p.cat.empty()) {
+                nr_cos = std::max(nr_cos, p.cat.size() + 1);
+            }
+        }
+
+        if (unc) {
+            _regs.push_back(MSR_UNCORE_RATIO_LIMIT);
+        }
+
+        if (nr_cos) {
+            _regs.push_back(IA32_PQR_ASSOC);
+
+            for (size_t n = 0; n < nr_cos; ++n) {
+                _regs.push_back(IA32_L3_QOS_MASK_0 + n);
+            }
+        }
+
+        for (size_t r = 0; r < _cpus.size(); ++r) {
+            _row[_cpus[r]] = r;
+        }
+    }
+
+    bool empty() const {
+        return _regs.empty();
+    }
+
+    /* save the original values, before anything is written */
+    bool save() {
+        std::vector<int> errs;
+
+        if (_h.read(_cpus, _regs, _orig, &errs) == MSR_OK) {
+            _saved = true;
+            return true;
+        }
+
+        for (size_t i = 0; i < _cpus.size(); ++i) {
+            if (errs[i] != MSR_OK) {
+                msr_warn("failed to save the MSRs of cpu %d, %s\n", _cpus[i], strerr(errs[i]));
+            }
+        }
+
+        return false;
+    }
+
+    bool restore() {
+        return !_saved || write(_orig);
+    }
+
+    /* the values of point @p, on top of the original ones */
+    std::vector<uint64_t> values(const config_t &p) const {
+        std::vector<uint64_t> vals = _orig;
+        size_t nr_reg = _regs.size();
+
+        for (size_t r = 0; r < nr_reg; ++r) {
+            for (size_t i = 0; i < _cpus.size(); ++i) {
+                uint64_t &v = vals[i * nr_reg + r];
+
+                if (_regs[r] == MSR_UNCORE_RATIO_LIMIT && p.unc_min > 0) {
+                    v = (v & ~0xffffULL) | (static_cast<uint64_t>(p.unc_min) << 8) | p.unc_max;
+
+                } else if (_regs[r] == IA32_PQR_ASSOC && (p.ways > 0 || !p.cat.empty())) {
+                    v &= 0xffffffffULL; /* COS 0, the RMID kept */
+
+                } else if (_regs[r] == IA32_L3_QOS_MASK_0 && p.ways > 0) {
+                    v = (1ULL << p.ways) - 1;
+                }
+            }
+        }
+
+        // COS k for the k-th cat= item
+        for (size_t k = 1; k <= p.cat.size(); ++k) {
+            size_t r_mask = col(IA32_L3_QOS_MASK_0 + k);
+            size_t r_assoc = col(IA32_PQR_ASSOC);
+
+            for (size_t i = 0; i < _cpus.size(); ++i) {
+                vals[i * nr_reg + r_mask] = p.cat[k - 1].second;
+            }
+
+            for (int c : parse_cpus(p.cat[k - 1].first)) {
+                auto it = _row.find(c);
+                if (it == _row.end()) {
+                    msr_warn("point %s: cpu %d is not online, ignored\n", p.name.c_str(), c);
+                    continue;
+                }
+
+                uint64_t &v = vals[it->second * nr_reg + r_assoc];
+                v = (v & 0xffffffffULL) | (static_cast<uint64_t>(k) << 32);
+            }
+        }
+
+        return vals;
+    }
+
+    bool write(const std::vector<uint64_t> &vals) {
+        std::vector<int> errs;
+
+        if (_h.write(_cpus, _regs, vals, &errs) == MSR_OK) {
+            return true;
+        }
+
+        for (size_t i = 0; i < _cpus.size(); ++i) {
+            if (errs[i] != MSR_OK) {
+                msr_warn("failed to write the MSRs of cpu %d, %s\n", _cpus[i], strerr(errs[i]));
+            }
+        }
+
+        return false;
+    }
+
+    void print(FILE *fp, const std::vector<uint64_t> &vals) const {
+        for (size_t i = 0; i < _cpus.size(); ++i) {
+            fprintf(fp, "#   cpu %3d", _cpus[i]);
+            for (size_t r = 0; r < _regs.size(); ++r) {
+                fprintf(fp, "  0x%x=0x%" PRIx64, _regs[r], vals[i * _regs.size() + r]);
+            }
+            fprintf(fp, "\n");
+        }
+    }
+
+private:
+    size_t col(uint32_t reg) const {
+        for (size_t r = 0; r < _regs.size(); ++r) {
+            if (_regs[r] == reg) {
+                return r;
+            }
+        }
+
+        return _regs.size();
+    }
+
+private:
+    std::vector<int> _cpus;
+    std::vector<uint32_t> _regs;
+    std::vector<uint64_t> _orig;
+    std::map<int, size_t> _row; /* cpu id -> subscript in _cpus */
+
+    handle _h;
+    bool _saved = false;
+};
+
+pid_t spawn(const std::vector<char *> &argv)
+{
+    pid_t pid = ::fork();
+
+    if (pid == 0) {
+        ::execvp(argv[0], argv.data());
+        msr_warn("failed to exec %s, %s\n", argv[0], strerror(errno));
+        ::_exit(127);
+    }
+
+    if (pid == -1) {
+        msr_warn("failed to fork, %s\n", strerror(errno));
+    }
+
+    return pid;
+}
+
+int reap(pid_t pid)
+{
+    int status = 0;
+
+    while (::waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/**
+ * run - one run of a point, the command (or the wait) with perfm capturing alongside
+ *
+ * @capture  the capture file, empty if no perfm
+ * @elapsed  wall time of the command (s)
+ *
+ * Return:
+ *     the exit status of the command, 0 for a wait
+ */
+int run(const std::string &capture, double *elapsed)
+{
+    std::vector<std::string> args;
+    std::vector<char *> argv;
+
+    if (!capture.empty()) {
+        args = split(options.perfm, ' ');
+        args.insert(args.begin(), { "perfm", "monitor" });
+        args.push_back("-o");
+        args.push_back(capture);
+
+        for (auto &a : args) {
+            argv.push_back(&a[0]);
+        }
+        argv.push_back(nullptr);
+
+        child[1] = spawn(argv);
+    }
+
+    int status = 0;
+    double t0 = monotonic_seconds();
+
+    if (!options.command.empty()) {
+        child[0] = spawn(options.command);
+        status = child[0] > 0 ? reap(child[0]) : -1;
+        child[0] = -1;
+    } else {
+        // nanosleep returns early on a signal, should_quit is then set
+        struct timespec ts;
+        ts.tv_sec  = static_cast<time_t>(options.wait);
+        ts.tv_nsec = static_cast<long>((options.wait - ts.tv_sec) * 1e9);
+
+        while (!should_quit && ::nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+            ;
+        }
+    }
+
+    *elapsed = monotonic_seconds() - t0;
+
+    // the monitor writes the last interval & exits on SIGINT
+    if (child[1] > 0) {
+        ::kill(child[1], SIGINT);
+        reap(child[1]);
+        child[1] = -1;
+    }
+
+    return status;
+}
+
+std::string describe(const config_t &p)
+{
+    std::string res;
+
+    if (p.unc_min > 0) {
+        res += "uncore=" + std::to_string(p.unc_min) + ":" + std::to_string(p.unc_max);
+    }
+
+    if (p.ways > 0) {
+        res += (res.empty() ? "" : ",") + std::string("ways=") + std::to_string(p.ways);
+    }
+
+    for (const auto &c : p.cat) {
+        char mask[32];
+        snprintf(mask, sizeof(mask), "%" PRIx64, c.second);
+        res += (res.empty() ? "" : ",") + std::string("cat=") + c.first + ":0x" + mask;
+    }
+
+    return res.empty() ? "-" : res;
+}
+
+/**
+ * sweep - run each point & write a row of the sensitivity table for each run
+ *
+ * Return:
+ *     EXIT_SUCCESS, or the exit code after a signal/failed write
+ */
+int sweep(state &st, const std::vector<config_t> &points)
+{
+    FILE *fp = options.fp;
+
+    fprintf(fp, "# %-20s %-40s %4s %12s %12s %6s %s\n",
+            "point", "settings", "run", "seconds", "rel", "status", "capture");
+
+    double base = 0; /* mean seconds of the first point, the reference */
+
+    for (size_t i = 0; i < points.size() && !should_quit; ++i) {
+        const config_t &p = points[i];
+
+        if (!st.write(st.values(p))) {
+            msr_warn("point %s: failed to apply, skipped\n", p.name.c_str());
+            st.restore();
+            continue;
+        }
+
+        double sum = 0;
+
+        for (int r = 0; r < options.repeat && !should_quit; ++r) {
+            std::string capture;
+            if (!options.perfm.empty()) {
+                capture = options.capture + "/" + p.name + "." + std::to_string(r) + ".perfm";
+            }
+
+            double elapsed = 0;
+            int status = run(capture, &elapsed);
+
+            sum += elapsed;
+
+            fprintf(fp, "  %-20s %-40s %4d %12.3f %12.3f %6d %s\n",
+                    p.name.c_str(), describe(p).c_str(), r, elapsed, base > 0 ? elapsed / base : 1.0,
+                    status, capture.empty() ? "-" : capture.c_str());
+            fflush(fp);
+        }
+
+        if (i == 0 && options.repeat > 0) {
+            base = sum / options.repeat;
+        }
+
+        // back to the original values between the points, so a point never depends on the previous
+        if (!st.restore()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return should_quit ? 128 + should_quit : EXIT_SUCCESS;
+}
+
+} /* namespace msr */
+
+
+int main(int argc, char **argv)
+{
+    msr::options.wait   = 10;
+    msr::options.repeat = 1;
+    msr::options.fp     = stdout;
+    msr::options.capture = ".";
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, msr::shot_options, msr::long_options, NULL)) != -1) {
+        switch (ch) {
+        case 'h':
+            msr::usage();
+            exit(EXIT_SUCCESS);
+
+        case 'v':
+            msr::version();
+            exit(EXIT_SUCCESS);
+
+        case 'c':
+            msr::options.config_filp = optarg;
+            break;
+
+        case 'n':
+            for (const auto &n : msr::split(optarg, ',')) {
+                msr::options.names.insert(n);
+            }
+            break;
+
+        case 'u':
+            msr::options.uncore = optarg;
+            break;
+
+        case 'w':
+            msr::options.ways = optarg;
+            break;
+
+        case 't':
+            msr::options.wait = std::stod(optarg);
+            break;
+
+        case 'r':
+            msr::options.repeat = std::stoi(optarg);
+            break;
+
+        case 'P':
+            msr::options.perfm = optarg;
+            break;
+
+        case 'C':
+            msr::options.capture = optarg;
+            break;
+
+        case 'o':
+            msr::options.fp = fopen(optarg, "w");
+            if (!msr::options.fp) {
+                msr_warn("failed to open %s, %s\n", optarg, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'N':
+            msr::options.dry_run = true;
+            break;
+
+        default:
+            msr::usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        msr::options.command.push_back(argv[i]);
+    }
+
+    if (!msr::options.command.empty()) {
+        msr::options.command.push_back(nullptr);
+    }
+
+    std::vector<msr::config_t> points;
+    if (!msr::load_points(points)) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (points.empty()) {
+        msr_warn("nothing to run, see --config, --uncore & --ways\n");
+        msr::usage();
+        exit(EXIT_FAILURE);
+    }
+
+    if (geteuid() != 0 && msr::dev_dir() == "/dev/cpu") {
+        msr_warn("you need root privilege to run\n");
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<int> cpus = msr::online_cpus();
+    if (cpus.empty()) {
+        msr_warn("no online cpu\n");
+        exit(EXIT_FAILURE);
+    }
+
+    msr::state st(cpus, points);
+
+    if (st.empty()) {
+        msr_warn("the points write no MSR\n");
+    }
+
+    // nothing is written before all the registers are saved
+    if (!st.empty() && !st.save()) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (msr::options.dry_run) {
+        for (const auto &p : points) {
+            fprintf(msr::options.fp, "# %s: %s\n", p.name.c_str(), msr::describe(p).c_str());
+            st.print(msr::options.fp, st.values(p));
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (!msr::options.perfm.empty()) {
+        ::mkdir(msr::options.capture.c_str(), 0755);
+    }
+
+    struct sigaction sig;
+
+    memset(&sig, 0, sizeof(sig));
+    sigemptyset(&sig.sa_mask);
+    sig.sa_handler = msr::sig_handler;
+
+    for (int signo : { SIGINT, SIGTERM, SIGHUP, SIGQUIT }) {
+        if (sigaction(signo, &sig, NULL) != 0) {
+            msr_warn("failed to install handler for signal %d\n", signo);
+        }
+    }
+
+    int res = msr::sweep(st, points);
+
+    if (!st.restore()) {
+        msr_warn("FAILED TO RESTORE THE ORIGINAL MSR VALUES, see below\n");
+        st.print(stderr, st.values({ "", -1, -1, -1, {} }));
+        res = EXIT_FAILURE;
+    }
+
+    if (msr::options.fp != stdout) {
+        fclose(msr::options.fp);
+    }
+
+    return res;
+}
@@ -0,0 +1,93 @@
+#!/bin/bash
+#
+# msr_exp_test.sh - run msr_exp against a fake MSR tree ($MSR_DEV_DIR), no root needed
+#
+#   ./msr_exp_test.sh           after make
+#
+# checks that a dry run writes nothing, that each setting is applied while the command runs,
+# & that the original values are written back after the run and on SIGTERM.
+#
+
+set -u
+
+cd "$(dirname "$0")"
+
+TREE=$(mktemp -d)
+trap 'rm -rf $TREE' EXIT
+
+export MSR_DEV_DIR=$TREE/dev
+
+NR_FAIL=0
+
+check() {
+    # check <what> <expected> <actual>
+    if [ "$2" = "$3" ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: expected '$2', got '$3'"
+        NR_FAIL=$((NR_FAIL + 1))
+    fi
+}
+
+# the registers of every cpu, one line each
+regs() {
+    for r in 0x620 0xc8f 0xc90 0xc91 0xc92; do
+        ./msr_read -a $r | tr '\n' ' '
+        echo
+    done
+}
+
+# 4 cpus, a 64K sparse file each, register X at offset X * 8
+for c in 0 1 2 3; do
+    mkdir -p $MSR_DEV_DIR/$c
+    truncate -s 64K $MSR_DEV_DIR/$c/msr
+done
+
+./msr_write -a 0x620 0x1818 || exit 1
+./msr_write -a 0xc90 0xfffff || exit 1
+./msr_write -a 0xc91 0xfffff || exit 1
+./msr_write -a 0xc92 0xfffff || exit 1
+
+ORIG=$(regs)
+
+cat > $TREE/exp.cfg <<EOF
+base
+isolate     uncore=12:24 cat=0-1:0xff cat=2-3:0xff00
+EOF
+
+# 1. dry run, nothing is written
+./msr_exp -c $TREE/exp.cfg -N > $TREE/dry.txt 2>&1
+check "dry run exit code" 0 $?
+check "dry run writes nothing" "$ORIG" "$(regs)"
+check "dry run prints the values of isolate" 1 \
+      $(grep -c "cpu   2  0x620=0xc18  0xc8f=0x200000000  0xc90=0xfffff  0xc91=0xff  0xc92=0xff00" $TREE/dry.txt)
+
+# 2. apply, the command sees the setting, the originals are back after the run
+./msr_exp -c $TREE/exp.cfg -n isolate -o $TREE/out.txt -- \
+    sh -c "./msr_read -p 0 0x620 0xc8f 0xc91 0xc92 > $TREE/cpu0.txt; ./msr_read -p 3 0xc8f > $TREE/cpu3.txt" 2> $TREE/apply.err
+check "apply exit code" 0 $?
+check "applied on cpu 0" "c18 100000000 ff ff00" "$(tr '\n' ' ' < $TREE/cpu0.txt | sed 's/ $//')"
+check "applied on cpu 3" "200000000" "$(cat $TREE/cpu3.txt)"
+check "restored after the run" "$ORIG" "$(regs)"
+
+# 3. SIGTERM during the run, the originals are back
+./msr_exp -c $TREE/exp.cfg -n isolate -o $TREE/term.txt -- sleep 30 2> $TREE/term.err &
+PID=$!
+
+for i in $(seq 50); do
+    [ "$(./msr_read -p 2 0xc8f)" = "200000000" ] && break
+    sleep 0.1
+done
+check "applied before SIGTERM" "200000000" "$(./msr_read -p 2 0xc8f)"
+
+kill -TERM $PID
+wait $PID
+check "exit code on SIGTERM" 143 $?
+check "restored on SIGTERM" "$ORIG" "$(regs)"
+
+if [ $NR_FAIL -ne 0 ]; then
+    echo "$NR_FAIL check(s) failed"
+    exit 1
+fi
+
+echo "all passed"
@@ -9,9 +9,14 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <map>
 
 #include <inttypes.h>
 #include <sys/types.h>
+#include <signal.h>
+#include <time.h>
+#include <x86intrin.h>
 
 #include <unistd.h>
 #include <dirent.h>
@@ -21,6 +26,7 @@
 #include <errno.h>
 #include <fcntl.h>
 
+#include "msr.hpp"
 #include "msr_version.hpp"
 
 #define program "msr_read"
@@ -35,14 +41,25 @@ const struct option long_options[] = {
     {"all",       no_argument,       NULL, 'a'},
     {"processor", required_argument, NULL, 'p'},
     {"cpu",       required_argument, NULL, 'p'},
+    {"sample",    required_argument, NULL, 's'},
+    {"interval",  required_argument, NULL, 'i'},
+    {"loops",     required_argument, NULL, 'l'},
+    {"delta",     no_argument,       NULL, 'd'},
+    {"output",    required_argument, NULL, 'o'},
     {NULL,        no_argument,       NULL,  0 }
 };
 
-const char shot_options[] = "hvap:";
+const char shot_options[] = "hvap:s:i:l:do:";
 
 typedef struct {
     int cpu;
-    uint32_t reg;
+    std::vector<uint32_t> regs;
+
+    bool sample;      /* sample the registers at an interval, rather than read once */
+    double interval;  /* in seconds */
+    long loops;       /* # of intervals, -1 until SIGINT */
+    bool delta;       /* the register ids given are counters */
+    FILE *fp;
 } options_t;
 
 options_t options;
@@ -51,13 +68,27 @@ void usage()
 {
     fprintf(stderr,
             "Usage:\n"
-            "    %s [options] <register-id> <register-value> [...]\n"
+            "    %s [options] <register-id> [...]\n"
+            "    %s [options] --sample <set> [<register-id> ...]\n"
             "Options:\n"
             "    --help         -h  print this help\n"
             "    --version      -v  print current version\n"
             "    --all          -a  all processors\n"
-            "    --processor #  -p  select processor number (default 0)\n",
-            program
+            "    --processor #  -p  select processor number (default 0)\n"
+            "    --sample <set> -s  sample at an interval, <set> is a comma separated list of\n"
+            "                       freq (APERF/MPERF/TSC), cstate (core & package C-state\n"
+            "                       residency), thermal (thermal status & TjMax), or none\n"
+            "    --interval #   -i  sampling interval in seconds (default 1)\n"
+            "    --loops #      -l  # of intervals to sample (default until Ctrl-C)\n"
+            "    --delta        -d  the <register-id>s are counters, print their deltas\n"
+            "    --output <f>   -o  write the samples to <f> (default stdout)\n"
+            "\n"
+            "    the samples are written in the format of `perfm monitor`, one row per register:\n"
+            "        <name> <tsc-cycles> <cpu0> <cpu1> ...        (thread/core scope)\n"
+            "        <name> <tsc-cycles> <socket0> <socket1> ...  (package scope)\n"
+            "    counters as the delta over the interval, status registers as the decoded field,\n"
+            "    \"-\" for an offline/failed cpu\n",
+            program, program
         );
 }
 
@@ -66,127 +97,374 @@ inline void version()
     fprintf(stderr, "%s: version %s\n", program, MSR_VERSION_STRING);
 }
 
-int is_cpu(const struct dirent *dirp)
-{
-    return std::isdigit(dirp->d_name[0]); /* /dev/cpu/<cpu> */
-}
-
 bool is_onln(int cpu)
 {
     if (cpu < 0) {
         return false;
     }
 
-    // the boot cpu do *not* support hotplug (x86 platform, linux-2.6.x, linux-4.7.x)
-    if (cpu == 0) {
-        return true;
-    }
-
-    // if online, the cache directory exist, otherwise not (x86 platform, linux-2.6.x, linux-4.7.x)
-    std::string cpu_path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache"; 
-
-    if (::access(cpu_path.c_str(), F_OK) != 0) {
-        return false;
-    }
+    // the same set as -a, so a fake tree ($MSR_DEV_DIR) is checked against its own cpus
+    std::vector<int> cpus = msr::online_cpus();
 
-    return true;
+    return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
 }
 
 /**
- * msr_print - print value in the given format
+ * msr_print - print value(s) in the given format, one line per cpu
  *
- * @val  value to print
+ * @vals  values to print
+ * @n     # of values
  *
  * FIXME:
  *
  */
-void msr_print(uint64_t val)
+void msr_print(const uint64_t *vals, size_t n)
 {
     FILE *fp = stdout;
 
-    fprintf(fp, "%zx\n", val);
+    for (size_t i = 0; i < n; ++i) {
+        fprintf(fp, i ? " %" PRIx64 : "%" PRIx64, vals[i]);
+    }
+    fprintf(fp, "\n");
+}
+
+void msr_error(int cpu, int err)
+{
+    switch (err) {
+    // the file is a device special file and no corresponding device exists
+    case msr::MSR_ENOCPU:
+        msr_warn("cpu %2d does not exist\n", cpu);
+        break;
+
+    //
+    case msr::MSR_ENOMSR:
+        msr_warn("cpu %2d does not support MSR\n", cpu);
+        break;
+
+    default:
+        msr_warn("failed to read MSR for cpu %d, %s\n", cpu, msr::strerr(err));
+        break;
+    }
 }
 
 /** 
- * msr_read - read values from @cpu's msr register specified by @reg
+ * msr_read - read values from @cpu's msr registers specified by @regs
  *
  * @cpu   which processor
- * @reg   the register id
+ * @regs  the register ids
  *
  * Return:
  *     true  - read succ
  *     false - read fail
  */
-bool msr_read(int cpu, uint32_t reg)
+bool msr_read(int cpu, const std::vector<uint32_t> &regs)
 {
     if (!is_onln(cpu)) {
         msr_warn("cpu %2d does not online\n", cpu);
         return true;
     }
 
-    std::string msr_path = "/dev/cpu/" + std::to_string(cpu) + "/msr";
+    msr::handle h;
+    std::vector<uint64_t> vals(regs.size());
 
-    int fd = ::open(msr_path.c_str(), O_RDONLY);
-    if (fd == -1) {
-        switch(errno) {
+    int err = h.read(cpu, regs, vals.data());
+    if (err != msr::MSR_OK) {
+        msr_error(cpu, err);
+        return false;
+    }
 
-        // the file is a device special file and no corresponding device exists
-        case ENXIO:
-            msr_warn("cpu %2d does not exist\n", cpu);
-            return false;
+    msr_print(vals.data(), vals.size());
 
-        //
-        case EIO:
-            msr_warn("cpu %2d does not support MSR\n", cpu);
-            return false;
+    return true;
+}
 
-        default:
-            msr_warn("failed on open MSR file for cpu %d, %s\n", cpu, strerror_r(errno, NULL, 0));
-            return false;
+
+/** 
+ * msr_read - read values from all (online) cpus' msr registers specified by @regs
+ *
+ * @regs  the register ids
+ *
+ * Description:
+ *     the cpus are read in parallel through one handle, & printed in ascending order
+ *
+ * Return:
+ *     true  - read succ
+ *     false - read fail
+ */
+bool msr_read(const std::vector<uint32_t> &regs)
+{
+    std::vector<int> cpus = msr::online_cpus();
+    std::vector<uint64_t> vals;
+    std::vector<int> errs;
+
+    msr::handle h;
+
+    bool succ = h.read(cpus, regs, vals, &errs) == msr::MSR_OK;
+
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        if (errs[i] != msr::MSR_OK) {
+            msr_error(cpus[i], errs[i]);
+        } else {
+            msr_print(&vals[i * regs.size()], regs.size());
         }
     }
-    
-    uint64_t val = 0;
 
-    if (::pread(fd, &val, sizeof(val), reg) != sizeof(val)) {
-        msr_warn("failed to read MSR file for cpu %d, %s\n", cpu, strerror_r(errno, NULL, 0));
-        ::close(fd);
-        return false;
+    return succ;
+}
+
+//
+// continuous sampling
+//
+
+enum {
+    SCOPE_THREAD = 0, /* one column per cpu */
+    SCOPE_PACKAGE     /* one column per socket, read on its first online cpu */
+};
+
+typedef struct {
+    uint32_t reg;
+    const char *name;
+    int scope;
+    bool counter;     /* print the delta, otherwise the field below */
+    int shift;
+    int width;
+} msr_desc_t;
+
+// the core residency counters are per core, sampled on each thread (siblings show the same delta)
+const msr_desc_t sample_freq[] = {
+    { 0x010, "IA32_TIME_STAMP_COUNTER",   SCOPE_THREAD,  true,  0, 64 },
+    { 0x0e7, "IA32_MPERF",                SCOPE_THREAD,  true,  0, 64 },
+    { 0x0e8, "IA32_APERF",                SCOPE_THREAD,  true,  0, 64 },
+};
+
+const msr_desc_t sample_cstate[] = {
+    { 0x3fc, "MSR_CORE_C3_RESIDENCY",     SCOPE_THREAD,  true,  0, 64 },
+    { 0x3fd, "MSR_CORE_C6_RESIDENCY",     SCOPE_THREAD,  true,  0, 64 },
+    { 0x3fe, "MSR_CORE_C7_RESIDENCY",     SCOPE_THREAD,  true,  0, 64 },
+    { 0x60d, "MSR_PKG_C2_RESIDENCY",      SCOPE_PACKAGE, true,  0, 64 },
+    { 0x3f8, "MSR_PKG_C3_RESIDENCY",      SCOPE_PACKAGE, true,  0, 64 },
+    { 0x3f9, "MSR_PKG_C6_RESIDENCY",      SCOPE_PACKAGE, true,  0, 64 },
+    { 0x3fa, "MSR_PKG_C7_RESIDENCY",      SCOPE_PACKAGE, true,  0, 64 },
+};
+
+// the digital readouts are in degrees C below TjMax (MSR_TEMPERATURE_TARGET bits 23:16)
+const msr_desc_t sample_thermal[] = {
+    { 0x19c, "IA32_THERM_STATUS",         SCOPE_THREAD,  false, 16, 7 },
+    { 0x1b1, "IA32_PACKAGE_THERM_STATUS", SCOPE_PACKAGE, false, 16, 7 },
+    { 0x1a2, "MSR_TEMPERATURE_TARGET",    SCOPE_PACKAGE, false, 16, 8 },
+};
+
+#define nr_elem(a) (sizeof(a) / sizeof((a)[0]))
+
+volatile sig_atomic_t should_quit = 0; /* SIGINT */
+
+void sig_handler(int signo)
+{
+    if (signo == SIGINT) {
+        should_quit = 1;
     }
+}
 
-    ::close(fd);
+int cpu_package_id(int cpu)
+{
+    std::string filp = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/physical_package_id";
 
-    msr_print(val);
+    FILE *fp = ::fopen(filp.c_str(), "r");
+    if (!fp) {
+        return 0;
+    }
 
-    return true;
+    int id = 0;
+    if (::fscanf(fp, "%d", &id) != 1) {
+        id = 0;
+    }
+
+    ::fclose(fp);
+
+    return id;
 }
 
+/**
+ * sample_select - the registers to sample, from the --sample sets & the register ids given
+ *
+ * Return:
+ *     false if a set is unknown
+ */
+bool sample_select(const std::string &sets, std::vector<msr_desc_t> &descs, std::vector<std::string> &names)
+{
+    size_t fr = 0;
 
-/** 
- * msr_read - read values from all (online) cpus' msr register specified by @reg
+    while (fr <= sets.size()) {
+        size_t to = sets.find(',', fr);
+        if (to == std::string::npos) {
+            to = sets.size();
+        }
+
+        std::string set = sets.substr(fr, to - fr);
+        fr = to + 1;
+
+        const msr_desc_t *d = nullptr;
+        size_t n = 0;
+
+        if (set == "freq") {
+            d = sample_freq,    n = nr_elem(sample_freq);
+        } else if (set == "cstate") {
+            d = sample_cstate,  n = nr_elem(sample_cstate);
+        } else if (set == "thermal") {
+            d = sample_thermal, n = nr_elem(sample_thermal);
+        } else if (set == "none" || set.empty()) {
+            continue;
+        } else {
+            msr_warn("unknown sample set %s\n", set.c_str());
+            return false;
+        }
+
+        descs.insert(descs.end(), d, d + n);
+    }
+
+    // the raw register ids, per thread
+    for (uint32_t reg : options.regs) {
+        char name[32];
+        snprintf(name, sizeof(name), "MSR_0x%x", reg);
+
+        names.push_back(name);
+        descs.push_back({ reg, nullptr, SCOPE_THREAD, options.delta, 0, 64 });
+    }
+
+    for (size_t i = 0, r = 0; i < descs.size(); ++i) {
+        if (!descs[i].name) {
+            descs[i].name = names[r++].c_str();
+        }
+    }
+
+    return true;
+}
+
+/**
+ * msr_sample - sample the registers every options.interval seconds, until options.loops or SIGINT
  *
- * @reg   the register id
+ * Description:
+ *     the thread scope registers are read on each cpu, the package scope ones on the first online
+ *     cpu of each socket, one batch of the handle per register & interval. the first read is the
+ *     baseline, each interval after it prints a block of rows & a blank line, as `perfm monitor`
  *
  * Return:
- *     true  - read succ
- *     false - read fail
+ *     true  - sampled
+ *     false - nothing to sample
  */
-bool msr_read(uint32_t reg)
+bool msr_sample(const std::string &sets)
 {
-    struct dirent **namelist;
-    size_t nr_dirent = 0;
+    std::vector<msr_desc_t> descs;
+    std::vector<std::string> names;
 
-    nr_dirent = ::scandir("/dev/cpu", &namelist, is_cpu, 0);
+    if (!sample_select(sets, descs, names) || descs.empty()) {
+        return false;
+    }
 
-    for (size_t cpu = 0; cpu < nr_dirent; ++cpu) {
-        msr_read(std::stoi(namelist[cpu]->d_name), reg);
+    std::vector<int> cpus = options.cpu == -1 ? msr::online_cpus() : std::vector<int>(1, options.cpu);
+    if (cpus.empty()) {
+        msr_warn("no online cpu\n");
+        return false;
     }
 
-    for (size_t cpu = 0; cpu < nr_dirent; ++cpu) {
-        free(namelist[cpu]);
+    // the first online cpu of each socket, in the order of package id
+    std::map<int, int> skt2cpu;
+    for (int c : cpus) {
+        skt2cpu.insert({cpu_package_id(c), c});
     }
 
-    free(namelist);
+    std::vector<int> pkgs;
+    for (const auto &it : skt2cpu) {
+        pkgs.push_back(it.second);
+    }
+
+    const std::vector<int> *scope_cpus[2] = { &cpus, &pkgs };
+
+    // one batch per register, a register the part lacks (e.g. CORE_C7 residency) fails only its own row
+    std::vector<std::vector<uint64_t>> prev(descs.size()), curr(descs.size());
+    std::vector<std::vector<int>> errs(descs.size()), prev_errs(descs.size());
+
+    // the thread scope columns are cpu 0 .. the largest id selected, as `perfm monitor`
+    std::vector<int> column(cpus.back() + 1, -1); /* cpu id -> subscript in @cpus */
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        column[cpus[i]] = i;
+    }
+
+    struct sigaction sig;
+
+    memset(&sig, 0, sizeof(sig));
+    sigemptyset(&sig.sa_mask);
+    sig.sa_handler = sig_handler;
+
+    if (sigaction(SIGINT, &sig, NULL) != 0) {
+        msr_warn("failed to install handler for SIGINT\n");
+    }
+
+    struct timespec ts;
+    ts.tv_sec  = static_cast<time_t>(options.interval);
+    ts.tv_nsec = static_cast<long>((options.interval - ts.tv_sec) * 1e9);
+
+    msr::handle h;
+
+    uint64_t tsc_prev = 0;
+    uint64_t tsc_curr = 0;
+
+    for (long r = -1; !should_quit && (options.loops < 0 || r < options.loops); ++r) {
+        tsc_prev = tsc_curr;
+        tsc_curr = __rdtsc();
+
+        for (size_t i = 0; i < descs.size(); ++i) {
+            prev[i].swap(curr[i]);
+            prev_errs[i].swap(errs[i]);
+
+            h.read(*scope_cpus[descs[i].scope], { descs[i].reg }, curr[i], &errs[i]);
+        }
+
+        if (r >= 0) {
+            for (size_t i = 0; i < descs.size(); ++i) {
+                const msr_desc_t &d = descs[i];
+
+                const std::vector<int> &sc = *scope_cpus[d.scope];
+
+                fprintf(options.fp, "%s %" PRIu64, d.name, tsc_curr - tsc_prev);
+
+                size_t nr_col = d.scope == SCOPE_THREAD ? column.size() : sc.size();
+
+                for (size_t k = 0; k < nr_col; ++k) {
+                    int j = d.scope == SCOPE_THREAD ? column[k] : static_cast<int>(k);
+
+                    if (j < 0) {
+                        fprintf(options.fp, " 0"); /* not selected */
+                        continue;
+                    }
+
+                    if (errs[i][j] != msr::MSR_OK || (d.counter && prev_errs[i][j] != msr::MSR_OK)) {
+                        fprintf(options.fp, " -");
+                        continue;
+                    }
+
+                    uint64_t val = curr[i][j];
+
+                    if (d.counter) {
+                        val -= prev[i][j];
+                    } else {
+                        val = (val >> d.shift) & (d.width < 64 ? (1ULL << d.width) - 1 : ~0ULL);
+                    }
+
+                    fprintf(options.fp, " %" PRIu64, val);
+                }
+
+                fprintf(options.fp, "\n");
+            }
+
+            fprintf(options.fp, "\n");
+            fflush(options.fp);
+        }
+
+        if (options.loops < 0 || r + 1 < options.loops) {
+            nanosleep(&ts, NULL);
+        }
+    }
 
     return true;
 }
@@ -196,6 +474,12 @@ bool msr_read(uint32_t reg)
 
 int main(int argc, char **argv)
 {
+    std::string sets;
+
+    msr::options.interval = 1;
+    msr::options.loops    = -1;
+    msr::options.fp       = stdout;
+
     char ch;
     while ((ch = getopt_long(argc, argv, msr::shot_options, msr::long_options, NULL)) != -1) {
         switch (ch) {
@@ -214,6 +498,35 @@ int main(int argc, char **argv)
         case 'p':
             msr::options.cpu = std::stoi(optarg);
             break;
+
+        case 's':
+            msr::options.sample = true;
+            sets = optarg;
+            break;
+
+        case 'i':
+            msr::options.interval = std::stod(optarg);
+            if (msr::options.interval <= 0) {
+                msr_warn("invalid interval %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'l':
+            msr::options.loops = std::stol(optarg);
+            break;
+
+        case 'd':
+            msr::options.delta = true;
+            break;
+
+        case 'o':
+            msr::options.fp = fopen(optarg, "w");
+            if (!msr::options.fp) {
+                msr_warn("failed to open %s, %s\n", optarg, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            break;
             
         default:
             msr::usage();
@@ -221,7 +534,7 @@ int main(int argc, char **argv)
         }
     }
 
-    if (optind + 1 > argc) {
+    if (optind + 1 > argc && !msr::options.sample) {
         msr::usage();
         exit(EXIT_FAILURE);
     }
@@ -231,11 +544,17 @@ int main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
-    msr::options.reg = std::stoul(argv[optind++], 0, 16);
+    while (optind < argc) {
+        msr::options.regs.push_back(std::stoul(argv[optind++], 0, 16));
+    }
 
-    if (msr::options.cpu == -1) {
-        msr::msr_read(msr::options.reg);
+    if (msr::options.sample) {
+        if (!msr::msr_sample(sets)) {
+            exit(EXIT_FAILURE);
+        }
+    } else if (msr::options.cpu == -1) {
+        msr::msr_read(msr::options.regs);
     } else {
-        msr::msr_read(msr::options.cpu, msr::options.reg);
+        msr::msr_read(msr::options.cpu, msr::options.regs);
     }
 }
@@ -9,6 +9,7 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
 
 #include <inttypes.h>
 #include <sys/types.h>
@@ -21,6 +22,7 @@
 #include <errno.h>
 #include <fcntl.h>
 
+#include "msr.hpp"
 #include "msr_version.hpp"
 
 #define program "msr_write"
@@ -67,30 +69,35 @@ inline void version()
     fprintf(stderr, "%s: version %s\n", program, MSR_VERSION_STRING);
 }
 
-int is_cpu(const struct dirent *dirp)
-{
-    return std::isdigit(dirp->d_name[0]); /* /dev/cpu/<cpu> */
-}
-
 bool is_onln(int cpu)
 {
     if (cpu < 0) {
         return false;
     }
 
-    // the boot cpu do *not* support hotplug (x86 platform, linux-2.6.x, linux-4.7.x)
-    if (cpu == 0) {
-        return true;
-    }
+    // the same set as -a, so a fake tree ($MSR_DEV_DIR) is checked against its own cpus
+    std::vector<int> cpus = msr::online_cpus();
 
-    // if online, the cache directory exist, otherwise not (x86 platform, linux-2.6.x, linux-4.7.x)
-    std::string cpu_path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache"; 
+    return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+}
 
-    if (::access(cpu_path.c_str(), F_OK) != 0) {
-        return false;
+void msr_error(int cpu, int err)
+{
+    switch (err) {
+    // the file is a device special file and no corresponding device exists
+    case msr::MSR_ENOCPU:
+        msr_warn("cpu %2d does not exist\n", cpu);
+        break;
+
+    //
+    case msr::MSR_ENOMSR:
+        msr_warn("cpu %2d does not support MSR\n", cpu);
+        break;
+
+    default:
+        msr_warn("failed to write MSR for cpu %d, %s\n", cpu, msr::strerr(err));
+        break;
     }
-
-    return true;
 }
 
 /** 
@@ -111,40 +118,16 @@ bool msr_write(int cpu, uint32_t reg, const std::vector<uint64_t> &vals)
         return true;
     }
 
-    std::string msr_path = "/dev/cpu/" + std::to_string(cpu) + "/msr";
-
-    int fd = ::open(msr_path.c_str(), O_WRONLY);
-    if (fd == -1) {
-        switch(errno) {
-
-        // the file is a device special file and no corresponding device exists
-        case ENXIO:
-            msr_warn("cpu %2d does not exist\n", cpu);
-            return false; 
-
-        //
-        case EIO:
-            msr_warn("cpu %2d does not support MSR\n", cpu);
-            return false; 
-
-        default:
-            msr_warn("failed on open MSR file for cpu %d, %s\n", cpu, strerror_r(errno, NULL, 0));
-            return false; 
-        }
-    }
+    msr::handle h(true);
 
     for (size_t i = 0; i < vals.size(); ++i) {
-        uint64_t val = vals[i];
-
-        if (::pwrite(fd, &val, sizeof(val), reg) != sizeof(val)) {
-            msr_warn("failed to write MSR file for cpu %d, %s\n", cpu, strerror_r(errno, NULL, 0));
-            ::close(fd);
+        int err = h.write(cpu, reg, vals[i]);
+        if (err != msr::MSR_OK) {
+            msr_error(cpu, err);
             return false;
         }
     }
 
-    ::close(fd);
-
     return true;
 }
 
@@ -155,26 +138,33 @@ bool msr_write(int cpu, uint32_t reg, const std::vector<uint64_t> &vals)
  * @reg   the register id
  * @vals  values to write 
  *
+ * Description:
+ *     each value is written to all the cpus in parallel, before the next one
+ *
  * Return:
  *     true  - write succ
  *     false - write fail
  */
 bool msr_write(uint32_t reg, const std::vector<uint64_t> &vals)
 {
-    struct dirent **namelist;
-    size_t nr_dirent = 0;
+    std::vector<int> cpus = msr::online_cpus();
+    std::vector<int> errs;
 
-    nr_dirent = ::scandir("/dev/cpu", &namelist, is_cpu, 0);
+    msr::handle h(true);
 
-    for (size_t cpu = 0; cpu < nr_dirent; ++cpu) {
-        msr_write(std::stoi(namelist[cpu]->d_name), reg, vals);
-    }
+    for (size_t i = 0; i < vals.size(); ++i) {
+        if (h.write(cpus, { reg }, std::vector<uint64_t>(cpus.size(), vals[i]), &errs) == msr::MSR_OK) {
+            continue;
+        }
 
-    for (size_t cpu = 0; cpu < nr_dirent; ++cpu) {
-        free(namelist[cpu]);
-    }
+        for (size_t c = 0; c < cpus.size(); ++c) {
+            if (errs[c] != msr::MSR_OK) {
+                msr_error(cpus[c], errs[c]);
+            }
+        }
 
-    free(namelist);
+        return false;
+    }
 
     return true;
 }
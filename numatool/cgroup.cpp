@@ -26,7 +26,7 @@ std::string cgroup::is_supported()
      * the above one is used by default
      */
     while (std::getline(fp, fs)) {
-        size_t pos = fs.find_first_of("cgroup");
+        size_t pos = fs.find("cgroup");
 
         if (pos == std::string::npos) {
             continue;
@@ -43,52 +43,187 @@ std::string cgroup::is_installed(const std::string &subsys)
     std::fstream fp("/proc/mounts", std::ios_base::in); 
     std::string  fs;
 
-    // whether the cgroup filesystem itself had been mounted
-    if (subsys.empty()) {
-        fatal("not impled\n");
+    std::string v1_dir;   /* the first v1 hierarchy with @subsys */
+    std::string v2_dir;   /* the unified hierarchy */
+
+    while (std::getline(fp, fs)) {
+        std::vector<std::string> fs_mnt = util::str_split(fs, " ", 4);
+        if (fs_mnt.size() < 4) {
+            continue;
+        }
+
+        std::string fs_dev = fs_mnt[0];
+        std::string fs_dir = fs_mnt[1];
+        std::string fs_typ = fs_mnt[2];
+        std::string fs_opt = fs_mnt[3];
+
+        if (fs_typ == "cgroup2") {
+            if (v2_dir.empty()) {
+                v2_dir = fs_dir;
+            }
+            continue;
+        }
 
-    // whether the cgroup subsystem specified by @subsys had been mounted
-    } else {
-        while (std::getline(fp, fs)) {
-            std::vector<std::string> fs_mnt = util::str_split(fs, " ", 4);
+        if (fs_typ != "cgroup" || !v1_dir.empty()) {
+            continue;
+        }
 
-            std::string fs_dev = fs_mnt[0];
-            std::string fs_dir = fs_mnt[1];
-            std::string fs_typ = fs_mnt[2];
-            std::string fs_opt = fs_mnt[3];
+        if (subsys.empty()) {
+            v1_dir = fs_dir;
+            continue;
+        }
 
-            if (fs_typ == "cgroup" && fs_opt.find_first_of(subsys) != std::string::npos) {
-                return fs_dir;
+        // the mount options, e.g. "rw,nosuid,nodev,noexec,relatime,cpuset"
+        for (const auto &opt : util::str_split(fs_opt, ",")) {
+            if (opt == subsys) {
+                v1_dir = fs_dir;
+                break;
             }
         }
     }
 
+    // whether the cgroup filesystem itself had been mounted
+    if (subsys.empty()) {
+        return v2_dir.empty() ? v1_dir : v2_dir;
+    }
+
+    // a controller bound to a v1 hierarchy is not available in the unified one
+    if (!v1_dir.empty() || v2_dir.empty()) {
+        return v1_dir;
+    }
+
+    // the controllers of the unified hierarchy, e.g. "cpuset cpu io memory pids"
+    for (const auto &ctl : util::str_split(util::read_line(v2_dir + "/cgroup.controllers"), " ")) {
+        if (ctl == subsys) {
+            return v2_dir;
+        }
+    }
+
     return std::move(std::string(""));
 }
 
-bool cpuset::setcpus(const std::string &cpulist)
+bool cgroup::is_unified(const std::string &mnt)
+{
+    struct stat st;
+
+    // cgroup.controllers only exists in v2
+    return ::stat((mnt + "/cgroup.controllers").c_str(), &st) == 0;
+}
+
+cpuset::ptr_t cpuset::creat()
+{
+    std::string mnt = is_installed();
+    if (mnt.empty()) {
+        return ptr_t();
+    }
+
+    ptr_t cs(new cpuset);
+    cs->path = mnt + "/";
+    cs->v2   = cgroup::is_unified(mnt);
+
+    return cs;
+}
+
+cpuset::ptr_t cpuset::creat(const std::string &name) const
+{
+    // without +cpuset in the parent's subtree_control a v2 child has no cpuset.* files
+    if (v2 && !enable_subtree()) {
+        return ptr_t();
+    }
+
+    ptr_t cs(new cpuset);
+
+    cs->path = path + name + "/";
+    cs->v2   = v2;
+
+    if (::mkdir(cs->path.c_str(), 0755) != 0 && errno != EEXIST) {
+        warn("mkdir() %s %s\n", cs->path.c_str(), strerror(errno));
+        return ptr_t();
+    }
+
+    cs->parent = ptr_t(new cpuset(*this));
+
+    return cs;
+}
+
+bool cpuset::destroy()
 {
-    std::string file = "/cpuset.cpus"; /* FIXME */
+    if (!parent) {
+        warn("the root cpuset %s can not be removed\n", path.c_str());
+        return false;
+    }
 
-    char *buf = ::strdup(cpulist.c_str()); 
-    if (!buf) {
-        char buferr[BUFERR] = { '\0' };
-        strerror_r(errno, buferr, sizeof(buferr));
-        warn("strdup() %s %s\n", cpulist.c_str(), buferr);
+    if (::rmdir(path.c_str()) != 0) {
+        warn("rmdir() %s %s\n", path.c_str(), strerror(errno));
         return false;
     }
 
-    size_t sz = ::strlen(buf);
+    return true;
+}
+
+bool cpuset::set(const std::string &file, const std::string &val) const
+{
+    std::string filp = path + file;
+
+    std::vector<char> buf(val.begin(), val.end());
 
-    ssize_t nr = util::write_file(file.c_str(), buf, sz);
-    if (nr != sz) {
-        warn("write() %s %zd %zu\n", buf, nr, sz); 
-        free(buf);
+    ssize_t nr = util::write_file(filp.c_str(), buf.data(), buf.size());
+    if (nr != static_cast<ssize_t>(buf.size())) {
+        warn("write() %s to %s %zd %zu\n", val.c_str(), filp.c_str(), nr, buf.size()); 
         return false;
     }
 
-    free(buf);
     return true;
 }
 
+bool cpuset::enable_subtree() const
+{
+    for (const auto &ctl : util::str_split(util::read_line(path + "cgroup.subtree_control"), " ")) {
+        if (ctl == "cpuset") {
+            return true;
+        }
+    }
+
+    return set("cgroup.subtree_control", "+cpuset");
+}
+
+bool cpuset::setcpus(const std::string &cpulist)
+{
+    return set("cpuset.cpus", cpulist);
+}
+
+bool cpuset::setmems(const std::string &memlist)
+{
+    return set("cpuset.mems", memlist);
+}
+
+bool cpuset::settask(pid_t pid)
+{
+    // cgroup.procs moves all the threads of @pid, 'tasks' only the one thread
+    return set("cgroup.procs", std::to_string(pid));
+}
+
+std::string cpuset::getcpus() const
+{
+    return util::read_line(path + (v2 ? "cpuset.cpus.effective" : "cpuset.cpus"));
+}
+
+std::string cpuset::getmems() const
+{
+    return util::read_line(path + (v2 ? "cpuset.mems.effective" : "cpuset.mems"));
+}
+
+std::string cpuset::gettask() const
+{
+    std::fstream fp(path + "cgroup.procs", std::ios_base::in);
+    std::string  pid;
+    std::string  res;
+
+    while (std::getline(fp, pid)) {
+        res += (res.empty() ? "" : " ") + pid;
+    }
+
+    return res;
+}
+
 } /* namespace cgroup */
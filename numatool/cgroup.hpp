@@ -6,6 +6,8 @@
 #define __CGROUP_HPP_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <sys/types.h>
 
@@ -21,8 +23,23 @@ public:
     }
 
     static std::string is_supported();
+
+    /**
+     * is_installed - where the hierarchy of subsystem @subsys is mounted
+     *
+     * Description:
+     *     a v1 hierarchy ('cgroup' mount with @subsys in its options) is preferred, else the v2
+     *     unified hierarchy ('cgroup2' mount) if @subsys is listed in its cgroup.controllers. an
+     *     empty @subsys asks for any cgroup mount, the unified one first.
+     *
+     * Return:
+     *     the mount point, or "" if not mounted
+     */
     static std::string is_installed(const std::string &subsys = "");
 
+    /* whether @mnt is the mount point of a cgroup v2 (unified) hierarchy */
+    static bool is_unified(const std::string &mnt);
+
     ~cgroup() { }
 
 public:
@@ -53,9 +70,8 @@ class cpuset {
 public:
     using ptr_t = std::shared_ptr<cpuset>;
 
-    static ptr_t creat() {
-        return ptr_t(new cpuset);
-    }
+    /* the root cpuset of the mounted hierarchy, null if the cpuset subsystem is not mounted */
+    static ptr_t creat();
 
     static std::string is_installed() {
         return cgroup::is_installed("cpuset");
@@ -67,20 +83,51 @@ private:
     cpuset() = default;
 
 public:
+    /**
+     * creat - the child cpuset @name of this one, created if not existing
+     *
+     * Description:
+     *     a new v1 child has no cpus & no mems, both must be set before a task is attached. a new
+     *     v2 child inherits the effective cpus & mems of this one, the cpuset controller is first
+     *     enabled in cgroup.subtree_control of this one.
+     */
+    ptr_t creat(const std::string &name) const;
+
+    /* remove this (child) cpuset, it must have no task left */
+    bool destroy();
+
     bool setcpus(const std::string &cpulist);
     bool setmems(const std::string &memlist);
     bool settask(pid_t pid);
 
+    /* the cpus & mems in effect, cpuset.{cpus,mems}.effective on v2 */
     std::string getcpus() const;
     std::string getmems() const;
     std::string gettask() const;
 
+    std::string root() const {
+        return path;
+    }
+
+    bool unified() const {
+        return v2;
+    }
+
+private:
+    bool set(const std::string &file, const std::string &val) const;
+
+    /* enable the cpuset controller for the children, v2 only */
+    bool enable_subtree() const;
+
 private:
     cpuset::ptr_t parent;
 
-    std::string path = "cpuset/";  /* relative path to it's parent,
-                                    * default to '/sys/fs/cgroup/cpuset' (full path)
-                                    */
+    bool v2 = false;   /* in the unified hierarchy */
+
+    std::string path;  /* full path, e.g. '/sys/fs/cgroup/cpuset/' for the root,
+                        * '/sys/fs/cgroup/cpuset/<name>/' for a child, or
+                        * '/sys/fs/cgroup/<name>/' in the unified hierarchy
+                        */
 };
 
 } /* namespace cgroup */
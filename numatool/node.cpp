@@ -6,7 +6,9 @@
 #include <string>
 #include <memory>
 #include <fstream>
+#include <algorithm>
 #include <cstring>
+#include <cctype>
 
 #include <sys/types.h>
 #include <dirent.h>
@@ -33,6 +35,81 @@ std::string node::cpulist() const
     return std::move(std::string(""));
 }
 
+std::vector<int> node::cpus() const
+{
+    return util::parse_list(cpulist());
+}
+
+uint64_t node::meminfo(const std::string &key) const
+{
+    std::fstream fp(numacfg + "node" + std::to_string(nid()) + "/meminfo", std::ios_base::in);
+    std::string  line;
+
+    // "Node 0 MemTotal:        4423416 kB"
+    while (std::getline(fp, line)) {
+        std::vector<std::string> item = util::str_split(line, " ");
+
+        item.erase(std::remove(item.begin(), item.end(), std::string("")), item.end());
+
+        if (item.size() < 4 || item[2] != key + ":") {
+            continue;
+        }
+
+        uint64_t val = std::strtoull(item[3].c_str(), NULL, 10);
+
+        return item.size() > 4 && item[4] == "kB" ? val << 10 : val;
+    }
+
+    return 0;
+}
+
+uint64_t node::mem_total() const
+{
+    return meminfo("MemTotal");
+}
+
+uint64_t node::mem_free() const
+{
+    return meminfo("MemFree");
+}
+
+std::vector<node::hugepage_t> node::hugepages() const
+{
+    std::vector<hugepage_t> res;
+    std::string dir = numacfg + "node" + std::to_string(nid()) + "/hugepages/";
+
+    DIR *dirp = ::opendir(dir.c_str());
+    if (!dirp) {
+        return res; /* no hugetlb */
+    }
+
+    struct dirent *dp = NULL;
+
+    // hugepages-<size>kB
+    while ((dp = ::readdir(dirp)) != NULL) {
+        if (std::strncmp("hugepages-", dp->d_name, sizeof("hugepages-") - 1) != 0) {
+            continue;
+        }
+
+        std::string sub = dir + dp->d_name + "/";
+
+        hugepage_t hp;
+        hp.size = std::strtoull(dp->d_name + sizeof("hugepages-") - 1, NULL, 10) << 10;
+        hp.nr   = std::strtoull(util::read_line(sub + "nr_hugepages").c_str(), NULL, 10);
+        hp.free = std::strtoull(util::read_line(sub + "free_hugepages").c_str(), NULL, 10);
+
+        res.push_back(hp);
+    }
+
+    ::closedir(dirp);
+
+    std::sort(res.begin(), res.end(), [] (const hugepage_t &a, const hugepage_t &b) {
+        return a.size < b.size;
+    });
+
+    return res;
+}
+
 size_t nodelist::init()
 {
     size_t nr = 0;
@@ -55,11 +132,12 @@ size_t nodelist::init()
     errno = 0;
 
     while ((dp = ::readdir(dirp)) != NULL) {
-        if (std::strncmp("node", dp->d_name, sizeof("node")) == 0) {
+        // node<N>, not node's other attributes (e.g. "online", "has_cpu")
+        if (std::strncmp("node", dp->d_name, sizeof("node") - 1) == 0 && std::isdigit(dp->d_name[sizeof("node") - 1])) {
             node::ptr_t np = node::creat();
 
             try {
-                np->id = std::stoi(dp->d_name + sizeof("node"));             
+                np->id = std::stoi(dp->d_name + sizeof("node") - 1);
             } catch (const std::invalid_argument &e) {
                 warn("std::stoi() %s %s\n", dp->d_name, e.what()); 
                 continue;
@@ -68,6 +146,13 @@ size_t nodelist::init()
                 continue;
             }
 
+            // e.g. "10 21", one column per online node
+            for (const auto &d : util::str_split(util::read_line(numacfg + dp->d_name + "/distance"), " ")) {
+                if (!d.empty()) {
+                    np->dist.push_back(std::atoi(d.c_str()));
+                }
+            }
+
             nlist.push_back(np);
             ++nr;
         }
@@ -79,7 +164,63 @@ size_t nodelist::init()
         warn("readdir() %s %s", numacfg.c_str(), buferr);        
     }
 
+    ::closedir(dirp);
+
+    std::sort(nlist.begin(), nlist.end(), [] (const node::ptr_t &a, const node::ptr_t &b) {
+        return a->id < b->id;
+    });
+
     return nr;
 }
 
+node::ptr_t nodelist::find(int nid) const
+{
+    for (const auto &np : nlist) {
+        if (np->id == nid) {
+            return np;
+        }
+    }
+
+    return node::ptr_t();
+}
+
+int nodelist::distance(int from, int to) const
+{
+    node::ptr_t np = find(from);
+    if (!np) {
+        return -1;
+    }
+
+    // the columns are the online nodes, which are the listed ones, ascending
+    for (size_t i = 0; i < nlist.size() && i < np->dist.size(); ++i) {
+        if (nlist[i]->id == to) {
+            return np->dist[i];
+        }
+    }
+
+    return -1;
+}
+
+std::string nodelist::cpulist(const std::vector<int> &nids) const
+{
+    std::string cpulst;
+
+    for (int nid : nids) {
+        node::ptr_t np = find(nid);
+        if (!np) {
+            warn("node %d does not exist\n", nid);
+            return "";
+        }
+
+        std::string l = np->cpulist();
+        if (l.empty()) {
+            continue; /* memory only node */
+        }
+
+        cpulst += (cpulst.empty() ? "" : ",") + l;
+    }
+
+    return cpulst;
+}
+
 } /* namespace numa */
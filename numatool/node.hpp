@@ -6,8 +6,11 @@
 #define __NODE_HPP_
 
 #include <cstdio>
+#include <cstdint>
 #include <memory>
 #include <cstdlib>
+#include <string>
+#include <vector>
 
 namespace numa {
 
@@ -20,6 +23,12 @@ class node {
 public:
     using ptr_t = std::shared_ptr<node>;
 
+    struct hugepage_t {
+        uint64_t size;      /* page size in bytes */
+        uint64_t nr;        /* nr_hugepages */
+        uint64_t free;      /* free_hugepages */
+    };
+
     static ptr_t creat() {
         return ptr_t(new node);
     }
@@ -36,9 +45,26 @@ public:
 
     std::string cpulist() const;
 
+    /* the cpus of the node, empty for a memory only node */
+    std::vector<int> cpus() const;
+
+    /* MemTotal & MemFree in node<N>/meminfo, in bytes, 0 on error */
+    uint64_t mem_total() const;
+    uint64_t mem_free() const;
+
+    /* the hugepage pools of the node, ascending in page size */
+    std::vector<hugepage_t> hugepages() const;
+
+private:
+    uint64_t meminfo(const std::string &key) const;
+
 private:
     int id;
 
+    std::vector<int> dist;  /* node<N>/distance, i.e. the row N of the SLIT, in the order of
+                             * the online nodes
+                             */
+
 };
 
 class nodelist {
@@ -58,6 +84,28 @@ public:
         return nlist.size();
     }
 
+    /* the node @nid, null if it does not exist */
+    node::ptr_t find(int nid) const;
+
+    /**
+     * distance - the SLIT distance from node @from to node @to
+     *
+     * Return:
+     *     10 for the local node, > 10 for the remote ones, -1 if unknown
+     */
+    int distance(int from, int to) const;
+
+    /* the cpus of the nodes @nids, as a cpulist, e.g. "0-17,36-53" */
+    std::string cpulist(const std::vector<int> &nids) const;
+
+    std::vector<node::ptr_t>::const_iterator begin() const {
+        return nlist.begin();
+    }
+
+    std::vector<node::ptr_t>::const_iterator end() const {
+        return nlist.end();
+    }
+
 private:
     nodelist() = default;
 
@@ -0,0 +1,210 @@
+/**
+ * numainfo.cpp - the numa inventory of the machine, to decide the placement of the workloads
+ *
+ *   numainfo              cpus, memory & hugepages per node, the SLIT distances
+ *   numainfo -p           plus the measured bandwidth & latency of every cpu node -> memory node
+ *   numainfo -p lat -s 64 only the latency, over a 64MB buffer
+ */
+#include "utils.hpp"
+#include "node.hpp"
+#include "probe.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include <getopt.h>
+
+namespace {
+
+const struct option long_options[] = {
+    {"help",    no_argument,       NULL, 'h'},
+    {"probe",   optional_argument, NULL, 'p'},
+    {"size",    required_argument, NULL, 's'},
+    {"rounds",  required_argument, NULL, 'r'},
+    {NULL,      no_argument,       NULL,  0 }
+};
+
+const char short_options[] = "hp::s:r:";
+
+struct {
+    bool   bw     = false;
+    bool   lat    = false;
+    size_t size   = 256;   /* MB */
+    int    rounds = 3;
+} options;
+
+void usage()
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    numainfo [options]\n"
+            "Options:\n"
+            "    --probe[=bw|lat]   -p[bw|lat]  measure the bandwidth and/or latency between every node pair\n"
+            "    --size <MB>        -s          size of each probe array, default 256, far above the LLC\n"
+            "    --rounds <n>       -r          rounds per pair, the best is kept, default 3\n"
+            "    --help             -h          print this help\n");
+}
+
+std::string size_str(uint64_t bytes)
+{
+    char buf[32];
+
+    if (bytes >= (1ULL << 30)) {
+        snprintf(buf, sizeof(buf), "%.1fG", static_cast<double>(bytes) / (1ULL << 30));
+    } else if (bytes >= (1ULL << 20)) {
+        snprintf(buf, sizeof(buf), "%.1fM", static_cast<double>(bytes) / (1ULL << 20));
+    } else {
+        snprintf(buf, sizeof(buf), "%lluK", static_cast<unsigned long long>(bytes >> 10));
+    }
+
+    return buf;
+}
+
+void print_nodes(const numa::nodelist::ptr_t &nodes)
+{
+    info("%-6s %-10s %-10s %-24s %s\n", "node", "total", "free", "hugepages(nr/free)", "cpus");
+
+    for (const auto &np : *nodes) {
+        std::string hp;
+        for (const auto &h : np->hugepages()) {
+            hp += (hp.empty() ? "" : " ") + size_str(h.size) + ":" + std::to_string(h.nr) + "/" + std::to_string(h.free);
+        }
+
+        std::string cpus = np->cpulist();
+
+        info("%-6d %-10s %-10s %-24s %s\n", np->nid(), size_str(np->mem_total()).c_str(),
+             size_str(np->mem_free()).c_str(), hp.empty() ? "-" : hp.c_str(), cpus.empty() ? "-" : cpus.c_str());
+    }
+}
+
+void print_header(const numa::nodelist::ptr_t &nodes, const char *title)
+{
+    info("\n%s\n%-6s", title, "node");
+
+    for (const auto &np : *nodes) {
+        info(" %9d", np->nid());
+    }
+
+    info("\n");
+}
+
+void print_distance(const numa::nodelist::ptr_t &nodes)
+{
+    print_header(nodes, "distance (SLIT):");
+
+    for (const auto &from : *nodes) {
+        info("%-6d", from->nid());
+
+        for (const auto &to : *nodes) {
+            int d = nodes->distance(from->nid(), to->nid());
+            if (d < 0) {
+                info(" %9s", "-");
+            } else {
+                info(" %9d", d);
+            }
+        }
+
+        info("\n");
+    }
+}
+
+void print_probe(const numa::nodelist::ptr_t &nodes, const std::vector<numa::probe::result_t> &res)
+{
+    size_t n = nodes->size();
+
+    if (options.bw) {
+        print_header(nodes, "bandwidth (MB/s, triad, cpu node -> memory node):");
+
+        for (size_t i = 0; i < n; ++i) {
+            info("%-6d", res[i * n].cpu_node);
+            for (size_t j = 0; j < n; ++j) {
+                if (res[i * n + j].bandwidth > 0) {
+                    info(" %9.0f", res[i * n + j].bandwidth);
+                } else {
+                    info(" %9s", "-");
+                }
+            }
+            info("\n");
+        }
+    }
+
+    if (options.lat) {
+        print_header(nodes, "latency (ns, pointer chase, cpu node -> memory node):");
+
+        for (size_t i = 0; i < n; ++i) {
+            info("%-6d", res[i * n].cpu_node);
+            for (size_t j = 0; j < n; ++j) {
+                if (res[i * n + j].latency > 0) {
+                    info(" %9.1f", res[i * n + j].latency);
+                } else {
+                    info(" %9s", "-");
+                }
+            }
+            info("\n");
+        }
+    }
+}
+
+} /* namespace */
+
+int main(int argc, char **argv)
+{
+    int ch;
+    while ((ch = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+        switch (ch) {
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+
+        case 'p':
+            if (!optarg) {
+                options.bw  = true;
+                options.lat = true;
+            } else if (std::string(optarg) == "bw") {
+                options.bw  = true;
+            } else if (std::string(optarg) == "lat") {
+                options.lat = true;
+            } else {
+                fatal("unknown probe %s, bw or lat\n", optarg);
+            }
+            break;
+
+        case 's':
+            options.size = std::strtoul(optarg, NULL, 10);
+            if (options.size == 0) {
+                fatal("invalid size %s\n", optarg);
+            }
+            break;
+
+        case 'r':
+            options.rounds = std::atoi(optarg);
+            break;
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    numa::nodelist::ptr_t nodes = numa::nodelist::creat();
+    if (!nodes->init()) {
+        fatal("no numa node found in %s\n", numa::numacfg.c_str());
+    }
+
+    print_nodes(nodes);
+    print_distance(nodes);
+
+    if (options.bw || options.lat) {
+        numa::probe::ptr_t prb = numa::probe::creat(nodes);
+
+        prb->set_size(options.size << 20, options.size << 20);
+        prb->set_rounds(options.rounds);
+
+        fflush(stdout);
+
+        print_probe(nodes, prb->matrix(options.bw, options.lat));
+    }
+
+    return 0;
+}
@@ -0,0 +1,404 @@
+/**
+ * numarun.cpp - run a command on a set of cpus & memory nodes, in a transient cpuset cgroup
+ *
+ * a native replacement of scripts/run_on_numa, without a shell or any other tool in between:
+ *
+ *   numarun -N 0 -m 0 ./bench          cpus of node 0, memory of node 0
+ *   numarun -C 0-3,8 -m 1 -p interleave ./bench
+ *
+ * by default numarun creates the cpuset '<root>/numarun.<pid>', moves itself into it, forks the
+ * command, waits for it & removes the cpuset, so thousands of runs do not leave thousands of
+ * cgroups behind. --exec replaces numarun by the command instead (the cpuset is then left, with
+ * notify_on_release set for a release agent on v1). both a v1 cpuset hierarchy & the v2 unified
+ * one are supported. without the cpuset controller (or --no-cgroup) the cpus & nodes are bound
+ * by sched_setaffinity() & set_mempolicy(MPOL_BIND) instead.
+ */
+#include "utils.hpp"
+#include "cgroup.hpp"
+#include "node.hpp"
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+
+#include <sched.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+namespace {
+
+// <numaif.h> without libnuma
+enum {
+    MPOL_DEFAULT = 0,
+    MPOL_PREFERRED,
+    MPOL_BIND,
+    MPOL_INTERLEAVE,
+    MPOL_LOCAL
+};
+
+const struct option long_options[] = {
+    {"help",         no_argument,       NULL, 'h'},
+    {"cpunodebind",  required_argument, NULL, 'N'},
+    {"physcpubind",  required_argument, NULL, 'C'},
+    {"membind",      required_argument, NULL, 'm'},
+    {"policy",       required_argument, NULL, 'p'},
+    {"name",         required_argument, NULL, 'n'},
+    {"exec",         no_argument,       NULL, 'e'},
+    {"no-cgroup",    no_argument,       NULL, 'G'},
+    {"verbose",      no_argument,       NULL, 'v'},
+    {NULL,           no_argument,       NULL,  0 }
+};
+
+const char short_options[] = "+hN:C:m:p:n:eGv";
+
+struct {
+    std::string cpus;      /* cpulist */
+    std::string mems;      /* nodelist */
+    std::string name;      /* of the cpuset */
+    int  policy  = -1;     /* MPOL_*, -1 for none */
+    bool exec    = false;
+    bool cgroup  = true;
+    bool verbose = false;
+} options;
+
+volatile pid_t child = -1;
+
+const int forward_signals[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT };
+
+cgroup::cpuset::ptr_t transient;  /* the cpuset created by numarun, removed at exit */
+
+void usage()
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    numarun [options] <command> [args...]\n"
+            "Options:\n"
+            "    --cpunodebind <nodes>  -N  run on the cpus of the nodes, e.g. 0 or 0,1\n"
+            "    --physcpubind <cpus>   -C  run on the cpus, e.g. 0-3,8\n"
+            "    --membind <nodes>      -m  allocate memory on the nodes (default: the nodes of -N)\n"
+            "    --policy <policy>      -p  memory policy inside the nodes: bind, interleave, preferred, local\n"
+            "    --name <name>          -n  name of the cpuset (default numarun.<pid>)\n"
+            "    --exec                 -e  exec the command in place of numarun, the cpuset is left\n"
+            "    --no-cgroup            -G  bind by sched_setaffinity & set_mempolicy, no cpuset\n"
+            "    --verbose              -v  print the binding\n"
+            "    --help                 -h  print this help\n");
+}
+
+void sig_forward(int signo)
+{
+    if (child > 0) {
+        ::kill(child, signo);
+    }
+}
+
+/* atexit(), fatal() included: move back to the root & remove the transient cpuset */
+void release()
+{
+    if (!transient) {
+        return;
+    }
+
+    // a cpuset with a task can not be removed
+    cgroup::cpuset::ptr_t root = cgroup::cpuset::creat();
+    if (root && root->settask(::getpid())) {
+        transient->destroy();
+    }
+
+    transient.reset();
+}
+
+int parse_policy(const std::string &p)
+{
+    if (p == "bind")       return MPOL_BIND;
+    if (p == "interleave") return MPOL_INTERLEAVE;
+    if (p == "preferred")  return MPOL_PREFERRED;
+    if (p == "local")      return MPOL_LOCAL;
+
+    fatal("unknown memory policy %s\n", p.c_str());
+}
+
+bool set_affinity(const std::vector<int> &cpus)
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+
+    for (int c : cpus) {
+        if (c < CPU_SETSIZE) {
+            CPU_SET(c, &mask);
+        }
+    }
+
+    if (::sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+        warn("sched_setaffinity() %s\n", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool set_mempolicy(int mode, const std::vector<int> &nodes)
+{
+    std::vector<unsigned long> mask(1, 0);
+    const size_t bits = sizeof(unsigned long) * 8;
+
+    for (int n : nodes) {
+        if (static_cast<size_t>(n) / bits >= mask.size()) {
+            mask.resize(n / bits + 1, 0);
+        }
+        mask[n / bits] |= 1UL << (n % bits);
+    }
+
+    bool no_nodes = mode == MPOL_LOCAL || mode == MPOL_DEFAULT;
+
+    // maxnode is one more than the bits of @mask, see set_mempolicy(2)
+    if (::syscall(SYS_set_mempolicy, mode, no_nodes ? NULL : mask.data(),
+                  no_nodes ? 0 : mask.size() * bits + 1) != 0) {
+        warn("set_mempolicy() %s\n", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+} /* namespace */
+
+int main(int argc, char **argv)
+{
+    std::string cpunodes;
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+        switch (ch) {
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+
+        case 'N':
+            cpunodes = optarg;
+            break;
+
+        case 'C':
+            options.cpus = optarg;
+            break;
+
+        case 'm':
+            options.mems = optarg;
+            break;
+
+        case 'p':
+            options.policy = parse_policy(optarg);
+            break;
+
+        case 'n':
+            options.name = optarg;
+            break;
+
+        case 'e':
+            options.exec = true;
+            break;
+
+        case 'G':
+            options.cgroup = false;
+            break;
+
+        case 'v':
+            options.verbose = true;
+            break;
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    //
+    // the cpus & memory nodes
+    //
+    numa::nodelist::ptr_t nodes = numa::nodelist::creat();
+    if (!nodes->init()) {
+        fatal("no numa node found in %s\n", numa::numacfg.c_str());
+    }
+
+    if (!cpunodes.empty()) {
+        std::vector<int> nids = util::parse_list(cpunodes);
+        if (nids.empty()) {
+            fatal("invalid node list %s\n", cpunodes.c_str());
+        }
+
+        std::string cpus = nodes->cpulist(nids);
+        if (cpus.empty()) {
+            fatal("no cpu on node(s) %s\n", cpunodes.c_str());
+        }
+
+        options.cpus += (options.cpus.empty() ? "" : ",") + cpus;
+
+        if (options.mems.empty()) {
+            options.mems = cpunodes;
+        }
+    }
+
+    std::vector<int> cpus = util::parse_list(options.cpus);
+    std::vector<int> mems = util::parse_list(options.mems);
+
+    if (!options.cpus.empty() && cpus.empty()) {
+        fatal("invalid cpu list %s\n", options.cpus.c_str());
+    }
+
+    if (!options.mems.empty() && mems.empty()) {
+        fatal("invalid node list %s\n", options.mems.c_str());
+    }
+
+    for (int n : mems) {
+        if (!nodes->find(n)) {
+            fatal("node %d does not exist\n", n);
+        }
+    }
+
+    //
+    // bind, by a transient cpuset, or by the affinity & memory policy of this process
+    //
+    cgroup::cpuset::ptr_t cs;
+
+    if (options.cgroup) {
+        cgroup::cpuset::ptr_t root = cgroup::cpuset::creat();
+
+        if (!root) {
+            warn("the cpuset controller is not available, use sched_setaffinity & set_mempolicy instead\n");
+        } else if (::geteuid() != 0) {
+            warn("a cpuset cgroup requires root privilege, use sched_setaffinity & set_mempolicy instead\n");
+        } else {
+            if (options.name.empty()) {
+                options.name = "numarun." + std::to_string(::getpid());
+            }
+
+            cs = root->creat(options.name);
+            if (!cs) {
+                fatal("failed to create the cpuset %s\n", options.name.c_str());
+            }
+
+            // from here on every exit, fatal() or not, removes the cpuset
+            transient = cs;
+            atexit(release);
+
+            // a new v1 cpuset has no cpus & no mems, both are taken from the root if not given
+            if (!cs->setcpus(cpus.empty() ? root->getcpus() : options.cpus) ||
+                !cs->setmems(mems.empty() ? root->getmems() : options.mems)) {
+                fatal("failed to set the cpus/mems of the cpuset %s\n", cs->root().c_str());
+            }
+
+            // v2 has no release agent, an empty group is seen by 'populated 0' in cgroup.events
+            if (options.exec && !cs->unified()) {
+                std::string one("1");
+                util::write_file((cs->root() + "notify_on_release").c_str(), &one[0], one.size());
+            }
+
+            if (!cs->settask(::getpid())) {
+                fatal("failed to move the process into the cpuset %s\n", cs->root().c_str());
+            }
+        }
+    }
+
+    if (!cs) {
+        if (!cpus.empty() && !set_affinity(cpus)) {
+            fatal("failed to bind the cpus %s\n", options.cpus.c_str());
+        }
+
+        if (!mems.empty() && options.policy == -1) {
+            options.policy = MPOL_BIND;
+        }
+    }
+
+    // interleave & co. need nodes, without -m/-N all the nodes allowed
+    if (mems.empty() && (options.policy == MPOL_BIND || options.policy == MPOL_INTERLEAVE ||
+                         options.policy == MPOL_PREFERRED)) {
+        if (cs) {
+            mems = util::parse_list(cs->getmems());
+        } else {
+            for (const auto &np : *nodes) {
+                mems.push_back(np->nid());
+            }
+        }
+    }
+
+    // the policy is inherited by the command across fork & exec
+    if (options.policy != -1 && !set_mempolicy(options.policy, mems)) {
+        fatal("failed to set the memory policy\n");
+    }
+
+    if (options.verbose) {
+        info("- process pid     : %d\n", ::getpid());
+        info("- cgroup path     : %s\n", cs ? cs->root().c_str() : "-");
+        info("- cpus            : %s\n", cs ? cs->getcpus().c_str() : (options.cpus.empty() ? "-" : options.cpus.c_str()));
+        info("- mems            : %s\n", cs ? cs->getmems().c_str() : (options.mems.empty() ? "-" : options.mems.c_str()));
+        info("- command to exec : %s\n", argv[optind]);
+        fflush(stdout);
+    }
+
+    if (options.exec || !cs) {
+        ::execvp(argv[optind], argv + optind);
+        fatal("execvp() %s %s\n", argv[optind], strerror(errno));
+    }
+
+    //
+    // fork the command, wait for it & remove the cpuset
+    //
+    struct sigaction sig;
+
+    memset(&sig, 0, sizeof(sig));
+    sigemptyset(&sig.sa_mask);
+    sig.sa_handler = sig_forward;
+
+    sigset_t block, saved;
+    sigemptyset(&block);
+
+    for (int signo : forward_signals) {
+        sigaction(signo, &sig, NULL);
+        sigaddset(&block, signo);
+    }
+
+    // a signal between fork() & the store of @child would be lost, hold them until then
+    sigprocmask(SIG_BLOCK, &block, &saved);
+
+    pid_t pid = ::fork();
+    if (pid == -1) {
+        fatal("fork() %s\n", strerror(errno));
+    }
+
+    if (pid == 0) {
+        sig.sa_handler = SIG_DFL;
+        for (int signo : forward_signals) {
+            sigaction(signo, &sig, NULL);
+        }
+        sigprocmask(SIG_SETMASK, &saved, NULL);
+
+        ::execvp(argv[optind], argv + optind);
+        warn("execvp() %s %s\n", argv[optind], strerror(errno));
+        ::_exit(127);
+    }
+
+    child = pid;
+    sigprocmask(SIG_SETMASK, &saved, NULL);
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+        ;
+    }
+
+    release();
+
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+
+    return WEXITSTATUS(status);
+}
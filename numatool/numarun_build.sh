@@ -0,0 +1,14 @@
+#!/bin/bash
+
+set -u
+
+TARGET="numarun"
+
+if [ -f $TARGET ]; then
+    rm -vf $TARGET
+    echo ""
+fi
+
+SRC_FILE="numarun.cpp cgroup.cpp node.cpp utils.cpp"
+
+g++ -std=c++11 -g -O2 -Wall $SRC_FILE -o $TARGET
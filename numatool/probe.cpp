@@ -0,0 +1,230 @@
+#include "utils.hpp"
+#include "probe.hpp"
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace {
+
+// <numaif.h> without libnuma
+const int      mpol_bind      = 2;        /* MPOL_BIND */
+const unsigned mpol_mf_strict = 1U << 0;  /* MPOL_MF_STRICT */
+
+const size_t cache_line = 64;
+
+struct line_t {
+    line_t *next;
+    char    pad[cache_line - sizeof(line_t *)];
+};
+
+double now_ns()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* @bytes of anonymous memory, all pages on node @nid */
+void *alloc_on(size_t bytes, int nid)
+{
+    void *p = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        warn("mmap() %zu %s\n", bytes, strerror(errno));
+        return NULL;
+    }
+
+    const size_t bits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(nid / bits + 1, 0);
+    mask[nid / bits] |= 1UL << (nid % bits);
+
+    if (::syscall(SYS_mbind, p, bytes, mpol_bind, mask.data(), mask.size() * bits + 1, mpol_mf_strict) != 0) {
+        warn("mbind() node %d %s\n", nid, strerror(errno));
+        ::munmap(p, bytes);
+        return NULL;
+    }
+
+    // fault the pages in now, not in the timed loops
+    std::memset(p, 0, bytes);
+
+    return p;
+}
+
+} /* namespace */
+
+namespace numa {
+
+double probe::triad(void *mem) const
+{
+    size_t n = bw_bytes / sizeof(double);
+
+    double *a = static_cast<double *>(mem);
+    double *b = a + n;
+    double *c = b + n;
+
+    for (size_t k = 0; k < n; ++k) {
+        b[k] = 1.0;
+        c[k] = 2.0;
+    }
+
+    const double s = 3.0;
+    double best = 0;
+
+    for (int r = 0; r < rounds; ++r) {
+        double t = now_ns();
+
+        for (size_t k = 0; k < n; ++k) {
+            a[k] = b[k] + s * c[k];
+        }
+
+        t = now_ns() - t;
+
+        // STREAM counts 2 reads & 1 write per element
+        double mbps = 3.0 * n * sizeof(double) / t * 1e3;
+        if (mbps > best) {
+            best = mbps;
+        }
+    }
+
+    // keep the stores alive
+    volatile double sink = a[n / 2];
+    (void)sink;
+
+    return best;
+}
+
+double probe::chase(void *mem) const
+{
+    size_t n = lat_bytes / sizeof(line_t);
+    if (n < 2) {
+        return 0;
+    }
+
+    line_t *lines = static_cast<line_t *>(mem);
+
+    // a single random cycle through all the lines (Sattolo's shuffle)
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+
+    std::mt19937_64 rng(n);
+    for (size_t i = n - 1; i > 0; --i) {
+        std::uniform_int_distribution<size_t> pick(0, i - 1);
+        std::swap(order[i], order[pick(rng)]);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        lines[i].next = &lines[order[i]];
+    }
+
+    // one full cycle per round, at least 4M hops so the timer does not matter
+    size_t hops = std::max<size_t>(n, 1UL << 22);
+    double best = 0;
+
+    line_t *p = lines;
+
+    for (int r = 0; r < rounds; ++r) {
+        double t = now_ns();
+
+        for (size_t h = 0; h < hops; ++h) {
+            p = p->next;
+        }
+
+        t = (now_ns() - t) / hops;
+
+        if (best == 0 || t < best) {
+            best = t;
+        }
+    }
+
+    line_t *volatile sink = p;
+    (void)sink;
+
+    return best;
+}
+
+bool probe::measure(int cpu_node, int mem_node, result_t &res, bool bw, bool lat)
+{
+    res.cpu_node  = cpu_node;
+    res.mem_node  = mem_node;
+    res.bandwidth = 0;
+    res.latency   = 0;
+
+    node::ptr_t cn = nodes->find(cpu_node);
+    if (!cn || !nodes->find(mem_node)) {
+        warn("node %d or %d does not exist\n", cpu_node, mem_node);
+        return false;
+    }
+
+    std::vector<int> cpus = cn->cpus();
+    if (cpus.empty()) {
+        return false; /* memory only node */
+    }
+
+    cpu_set_t saved, mask;
+    CPU_ZERO(&mask);
+
+    for (int c : cpus) {
+        if (c < CPU_SETSIZE) {
+            CPU_SET(c, &mask);
+        }
+    }
+
+    if (::sched_getaffinity(0, sizeof(saved), &saved) != 0 || ::sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+        warn("sched_setaffinity() node %d %s\n", cpu_node, strerror(errno));
+        return false;
+    }
+
+    bool succ = true;
+
+    if (bw && succ) {
+        void *mem = alloc_on(3 * bw_bytes, mem_node);
+        if (mem) {
+            res.bandwidth = triad(mem);
+            ::munmap(mem, 3 * bw_bytes);
+        } else {
+            succ = false;
+        }
+    }
+
+    if (lat && succ) {
+        void *mem = alloc_on(lat_bytes, mem_node);
+        if (mem) {
+            res.latency = chase(mem);
+            ::munmap(mem, lat_bytes);
+        } else {
+            succ = false;
+        }
+    }
+
+    ::sched_setaffinity(0, sizeof(saved), &saved);
+
+    return succ;
+}
+
+std::vector<probe::result_t> probe::matrix(bool bw, bool lat)
+{
+    std::vector<result_t> res;
+
+    for (const auto &cn : *nodes) {
+        for (const auto &mn : *nodes) {
+            result_t r;
+            measure(cn->nid(), mn->nid(), r, bw, lat);
+            res.push_back(r);
+        }
+    }
+
+    return res;
+}
+
+} /* namespace numa */
@@ -0,0 +1,89 @@
+/**
+ * probe.hpp - interface for measuring the bandwidth & latency between numa nodes
+ *
+ */
+#ifndef __PROBE_HPP_
+#define __PROBE_HPP_
+
+#include "node.hpp"
+
+#include <memory>
+#include <cstdint>
+#include <vector>
+
+namespace numa {
+
+//
+// the SLIT distances are what the firmware claims, often a rough 10/20/... the probe measures
+// what a thread pinned on the cpus of node <i> gets from the memory of node <j>:
+//
+//   bandwidth  a STREAM triad, a[k] = b[k] + s * c[k], over three arrays bound to node <j>
+//   latency    a dependent pointer chase, one cache line per hop, in random order so that the
+//              hardware prefetchers can not help, over a buffer bound to node <j>
+//
+// the arrays are far larger than the LLC by default, so both are the figures of the DRAM.
+// the nodes without cpus are only probed as the memory side.
+//
+class probe {
+
+public:
+    using ptr_t = std::shared_ptr<probe>;
+
+    struct result_t {
+        int    cpu_node;
+        int    mem_node;
+        double bandwidth;   /* MB/s, the best of the rounds, 0 if not measured */
+        double latency;     /* ns per load, the best of the rounds, 0 if not measured */
+    };
+
+    static ptr_t creat(const nodelist::ptr_t &nodes) {
+        return ptr_t(new probe(nodes));
+    }
+
+    ~probe() { }
+
+private:
+    probe(const nodelist::ptr_t &nodes) : nodes(nodes) { }
+
+public:
+    /* the size of each of the 3 triad arrays & of the chase buffer, in bytes */
+    void set_size(size_t bw_size, size_t lat_size) {
+        bw_bytes  = bw_size;
+        lat_bytes = lat_size;
+    }
+
+    void set_rounds(int n) {
+        rounds = n > 0 ? n : 1;
+    }
+
+    /**
+     * measure - the bandwidth & latency from node @cpu_node to node @mem_node
+     *
+     * Description:
+     *     the calling thread is pinned on the cpus of @cpu_node during the measurement, its
+     *     affinity is restored afterwards
+     *
+     * Return:
+     *     true  - succ, @res is filled
+     *     false - @cpu_node has no cpu, or failed to bind / allocate the memory
+     */
+    bool measure(int cpu_node, int mem_node, result_t &res, bool bw = true, bool lat = true);
+
+    /* every pair of nodes, row-major in the order of the nodelist */
+    std::vector<result_t> matrix(bool bw = true, bool lat = true);
+
+private:
+    double triad(void *mem) const;
+    double chase(void *mem) const;
+
+private:
+    nodelist::ptr_t nodes;
+
+    size_t bw_bytes  = 256UL << 20;
+    size_t lat_bytes = 256UL << 20;
+    int    rounds    = 3;
+};
+
+} /* namespace numa */
+
+#endif /* __PROBE_HPP_ */
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <string>
+#include <fstream>
+#include <algorithm>
 #include <cstring>
 
 #include <sys/types.h>
@@ -69,10 +71,59 @@ ssize_t write_file(const char *filp, void *buf, size_t sz)
         char buferr[BUFERR] = { '\0' };
         strerror_r(errno, buferr, sizeof(buferr));
         warn("write(): %s %s\n", filp, buferr);
-        return -1;
     }
 
+    ::close(fd);
+
     return nr;
 }
 
+std::string read_line(const std::string &filp)
+{
+    std::fstream fp(filp, std::ios_base::in);
+    std::string line;
+
+    if (!fp.good() || !std::getline(fp, line)) {
+        return "";
+    }
+
+    return line;
+}
+
+std::vector<int> parse_list(const std::string &list)
+{
+    std::vector<int> ids;
+
+    for (const auto &item : str_split(list, ",")) {
+        if (item.empty() || item == "\n") {
+            continue;
+        }
+
+        int fr = 0, to = 0;
+
+        try {
+            size_t del = item.find('-');
+            fr = std::stoi(item);
+            to = del == std::string::npos ? fr : std::stoi(item.substr(del + 1));
+        } catch (const std::exception &e) {
+            warn("invalid list %s\n", list.c_str());
+            return std::vector<int>();
+        }
+
+        if (fr < 0 || to < fr) {
+            warn("invalid list %s\n", list.c_str());
+            return std::vector<int>();
+        }
+
+        for (int i = fr; i <= to; ++i) {
+            ids.push_back(i);
+        }
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    return ids;
+}
+
 } /* namespace util */
@@ -37,6 +37,12 @@ std::vector<std::string> str_split(const std::string &str, const std::string &de
 
 ssize_t write_file(const char *file, void *buf, size_t sz);
 
+/* the first line of @file, without the '\n', empty on error */
+std::string read_line(const std::string &file);
+
+/* the ids in the list @list (e.g. "0-3,8,10-11"), ascending, empty on a syntax error */
+std::vector<int> parse_list(const std::string &list);
+
 } /* namespace util */
 
 #endif /* __UTILS_HPP_ */
@@ -1,4 +1,6 @@
 #include "perfm_util.hpp"
+#include "perfm_option.hpp"
+#include "perfm_parser.hpp"
 
 #include <cstdio>
 #include <cstdlib>
@@ -8,16 +10,13 @@
 #include <locale.h>
 #include <libgen.h>
 
-#include <perfmon/perf_event.h>
-#include <perfmon/pfmlib_perf_event.h>
+#include <linux/perf_event.h>
 
 namespace {
 
 /* 
  * this definition must be consistent with the 'perf_type_id' defined in
  *     <linux/perf_event.h> 
- * or
- *     <perfmon/perf_event.h>
  */
 
 #define PERF_MAX PERF_TYPE_MAX
@@ -34,23 +33,15 @@ const char *ev_type[PERF_MAX] = {
 void ev2perf(const std::string &evn, FILE *fp = stdout)
 {
     struct perf_event_attr hw; 
-    memset(&hw, 0, sizeof(hw));
-
-    pfm_perf_encode_arg_t arg;
-    memset(&arg, 0, sizeof(arg));
-
-    arg.attr = &hw;
-    arg.size = sizeof(arg);
-
-    pfm_err_t ret = pfm_get_os_event_encoding(evn.c_str(), PFM_PLM3 | PFM_PLM0, PFM_OS_PERF_EVENT, &arg);
-    if (ret != PFM_SUCCESS) {
-        perfm_warn("%s %s\n", evn.c_str(), pfm_strerror(ret));
+    if (!perfm::perfm_parser.encode(evn, &hw)) {
         return;
     }
 
     fprintf(fp, "- %s -\n", evn.c_str());
     fprintf(fp, "  perf.type                    : %s\n"
-                "      .config                  : %zx\n"
+                "      .config                  : %llx\n"
+                "      .config1                 : %llx\n"
+                "      .config2                 : %llx\n"
                 "  perf.disabled                : %s\n"
                 "      .inherit                 : %s\n"
                 "      .pinned                  : %s\n"
@@ -65,8 +56,10 @@ void ev2perf(const std::string &evn, FILE *fp = stdout)
                 "      .exclude_callchain_user  : %s\n"
                 "      .use_clockid             : %s\n"
                 "",
-                ev_type[hw.type],
-                hw.config,
+                hw.type < PERF_MAX ? ev_type[hw.type] : "PERF_DYNAMIC_PMU",
+                static_cast<unsigned long long>(hw.config),
+                static_cast<unsigned long long>(hw.config1),
+                static_cast<unsigned long long>(hw.config2),
                 hw.disabled                 ? "true" : "false",
                 hw.inherit                  ? "true" : "false",
                 hw.pinned                   ? "true" : "false",
@@ -106,9 +99,16 @@ int main(int argc, char **argv)
 {
     setlocale(LC_ALL, "");
 
-    pfm_err_t ret = pfm_initialize();
-    if (ret != PFM_SUCCESS) {
-        perfm_fatal("pfm_initialize() failed, %s\n", pfm_strerror(ret));
+    perfm::perfm_options.select_event_files();
+
+    if (perfm::perfm_parser.load_builtin(perfm::cpu_identifier())) {
+        perfm::perfm_parser.pmu_detect();
+    } else if (perfm::perfm_options.event_core_filp.empty() && perfm::perfm_options.event_uncore_filp.empty()) {
+        perfm::perfm_parser.pmu_detect();
+    } else {
+        perfm::perfm_parser.load_event_db(perfm::perfm_options.event_db_filp,
+                                          perfm::perfm_options.event_core_filp,
+                                          perfm::perfm_options.event_uncore_filp);
     }
 
     std::string ev;
@@ -116,7 +116,5 @@ int main(int argc, char **argv)
         ev2perf(ev);
     }
 
-    pfm_terminate();
-
     return 0;
 }
@@ -9,6 +9,15 @@ if [ -f $TARGET ]; then
     echo ""
 fi
 
-SRC_FILE="perfm_util.cpp  perfm_pmu.cpp  perfm_option.cpp  perfm_event.cpp  ev2perf.cpp"
+# event names are encoded natively (perfm_parser), USE_LIBPFM=1 adds libpfm4 as the fallback encoder
+USE_LIBPFM=${USE_LIBPFM:-0}
 
-g++ -std=c++11 -g -Wall -lpfm $SRC_FILE -o $TARGET -lrt
+SRC_FILE="perfm_util.cpp  perfm_cpuset.cpp  perfm_option.cpp  perfm_event.cpp  perfm_evdb.cpp  perfm_parser.cpp  perfm_mapfile.cpp  perfm_evindex.cpp  perfm_builtin.cpp  perfm_syscall.cpp  ev2perf.cpp"
+LIBPFM=""
+
+if [ "$USE_LIBPFM" = "1" ]; then
+    SRC_FILE="$SRC_FILE perfm_pmu.cpp"
+    LIBPFM="-DPERFM_USE_LIBPFM -lpfm"
+fi
+
+g++ -std=c++11 -g -Wall $LIBPFM $SRC_FILE -o $TARGET -lrt
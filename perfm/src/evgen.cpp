@@ -0,0 +1,270 @@
+/**
+ * evgen.cpp - generate the compiled-in event tables, see perfm_builtin.hpp
+ *
+ * Usage:
+ *     evgen [-d <event dir>] [-o <output dir>] [Family-model ...]
+ *
+ *     for each microarchitecture in <event dir>/mapfile.csv (or only those matching the given
+ *     Family-models, e.g. GenuineIntel-6-4F), write <output dir>/perfm_builtin_<arch>.hpp, then
+ *     <output dir>/perfm_builtin_tables.hpp listing them all.
+ */
+#include "perfm_util.hpp"
+#include "perfm_parser.hpp"
+#include "perfm_mapfile.hpp"
+#include "perfm_builtin.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <getopt.h>
+#include <locale.h>
+
+namespace {
+
+struct arch_t {
+    std::string name;                 /* e.g. BroadwellX, the namespace of its table */
+    std::vector<std::string> cpuid;   /* Family-models using this arch */
+    std::string core;
+    std::string uncore;
+};
+
+/* C++ string literal of @s, '?' is escaped against trigraphs */
+std::string literal(const std::string &s)
+{
+    std::string r("\"");
+
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"':  r += "\\\""; break;
+        case '\\': r += "\\\\"; break;
+        case '?':  r += "\\?";  break;
+        case '\n': r += "\\n";  break;
+        case '\t': r += "\\t";  break;
+
+        default:
+            if (c < 0x20 || c >= 0x7f) {
+                char oct[8];
+                snprintf(oct, sizeof(oct), "\\%03o", c);
+                r += oct;
+            } else {
+                r += static_cast<char>(c);
+            }
+        }
+    }
+
+    return r + "\"";
+}
+
+/* BroadwellX_core_V10.json -> BroadwellX */
+std::string arch_name(const std::string &filp)
+{
+    std::string base = filp.substr(filp.rfind('/') + 1);
+    std::string name = base.substr(0, base.find_first_of("_."));
+
+    for (auto &c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            c = '_';
+        }
+    }
+
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        name = "arch_" + name;
+    }
+
+    return name;
+}
+
+bool emit_arch(const arch_t &arch, const std::string &outdir)
+{
+    perfm::parser::ptr_t p = perfm::parser::alloc();
+    if (!p) {
+        perfm_fatal("failed to alloc the parser object\n");
+    }
+
+    p->load_event(arch.core, arch.uncore);
+
+    std::vector<perfm::einfo::ptr_t> events = p->event_list();
+    std::sort(events.begin(), events.end(), [](const perfm::einfo::ptr_t &a, const perfm::einfo::ptr_t &b) {
+        return a->_r_name < b->_r_name;
+    });
+
+    const std::string filp = outdir + "/perfm_builtin_" + arch.name + ".hpp";
+
+    FILE *fp = fopen(filp.c_str(), "w");
+    if (!fp) {
+        perfm_warn("failed to open %s\n", filp.c_str());
+        return false;
+    }
+
+    std::string guard = "__PERFM_BUILTIN_" + arch.name + "_HPP__";
+    std::transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+
+    fprintf(fp, "/**\n * perfm_builtin_%s.hpp - generated by evgen, DO NOT EDIT\n *\n", arch.name.c_str());
+    for (const auto &src : { arch.core, arch.uncore }) {
+        if (!src.empty()) {
+            fprintf(fp, " *     %s\n", src.c_str());
+        }
+    }
+    fprintf(fp, " */\n#ifndef %s\n#define %s\n\n#include \"perfm_builtin.hpp\"\n\n", guard.c_str(), guard.c_str());
+    fprintf(fp, "namespace perfm {\n\nnamespace builtin {\n\nnamespace %s {\n\n", arch.name.c_str());
+
+    // events, sorted by name for find_event()
+    size_t nr_event = 0;
+
+    fprintf(fp, "constexpr event_t event[] = {\n");
+    for (const auto &ep : events) {
+        const perfm::einfo_intel *e = dynamic_cast<const perfm::einfo_intel *>(ep.get());
+        if (!e) {
+            continue;
+        }
+
+        int flags = (e->_e_inv    ? perfm::evdb::E_FLAG_INV    : 0) |
+                    (e->_e_any    ? perfm::evdb::E_FLAG_ANY    : 0) |
+                    (e->_e_edge   ? perfm::evdb::E_FLAG_EDGE   : 0) |
+                    (e->_e_pebs   ? perfm::evdb::E_FLAG_PEBS   : 0) |
+                    (e->_e_extsel ? perfm::evdb::E_FLAG_EXTSEL : 0);
+
+        fprintf(fp, "    { %s, %s, %s, %s, %d, %d, %d, %#llx, %#llx, %#llx, %llu, %llu, { %#llx, %#llx, %#llx, %#llx, %#llx } },\n",
+                literal(e->_r_name).c_str(), literal(e->_e_desc).c_str(), literal(e->_e_unit).c_str(),
+                literal(e->_e_filter).c_str(),
+                e->_e_type, e->_nr_msr, flags,
+                static_cast<unsigned long long>(e->_e_ecode),
+                static_cast<unsigned long long>(e->_e_umask),
+                static_cast<unsigned long long>(e->_e_msrv),
+                static_cast<unsigned long long>(e->_e_cmask),
+                static_cast<unsigned long long>(e->_e_period),
+                static_cast<unsigned long long>(e->_e_msri[0]), static_cast<unsigned long long>(e->_e_msri[1]),
+                static_cast<unsigned long long>(e->_e_msri[2]), static_cast<unsigned long long>(e->_e_msri[3]),
+                static_cast<unsigned long long>(e->_e_msri[4]));
+        ++nr_event;
+    }
+    fprintf(fp, "};\n\nconstexpr uint32_t nr_event = %lu;\n\n", nr_event);
+
+    fprintf(fp, "} /* namespace %s */\n\n} /* namespace builtin */\n\n} /* namespace perfm */\n\n#endif /* %s */\n",
+            arch.name.c_str(), guard.c_str());
+
+    fclose(fp);
+
+    fprintf(stderr, "%s: %lu events\n", filp.c_str(), nr_event);
+
+    return true;
+}
+
+bool emit_tables(const std::vector<arch_t> &archs, const std::string &outdir)
+{
+    const std::string filp = outdir + "/perfm_builtin_tables.hpp";
+
+    FILE *fp = fopen(filp.c_str(), "w");
+    if (!fp) {
+        perfm_warn("failed to open %s\n", filp.c_str());
+        return false;
+    }
+
+    fprintf(fp, "/**\n * perfm_builtin_tables.hpp - generated by evgen, DO NOT EDIT\n *\n */\n");
+    fprintf(fp, "#ifndef __PERFM_BUILTIN_TABLES_HPP__\n#define __PERFM_BUILTIN_TABLES_HPP__\n\n");
+
+    for (const auto &a : archs) {
+        fprintf(fp, "#include \"perfm_builtin_%s.hpp\"\n", a.name.c_str());
+    }
+
+    fprintf(fp, "\nnamespace perfm {\n\nnamespace builtin {\n\nconstexpr table_t tables[] = {\n");
+    for (const auto &a : archs) {
+        for (const auto &id : a.cpuid) {
+            fprintf(fp, "    { %s, \"%s\", %s::event, %s::nr_event },\n",
+                    literal(id).c_str(), a.name.c_str(), a.name.c_str(), a.name.c_str());
+        }
+    }
+    fprintf(fp, "};\n\n} /* namespace builtin */\n\n} /* namespace perfm */\n\n#endif /* __PERFM_BUILTIN_TABLES_HPP__ */\n");
+
+    fclose(fp);
+
+    return true;
+}
+
+void usage(const char *cmd)
+{
+    fprintf(stderr,
+            "Usage: %s [-d <event dir>] [-o <output dir>] [Family-model ...]\n"
+            "  -d <event dir>    event tree with a mapfile.csv, defaults to ./events\n"
+            "  -o <output dir>   where to write the headers, defaults to .\n"
+            "  Family-model      only these lines of the mapfile, e.g. GenuineIntel-6-4F\n", cmd);
+}
+
+} /* namespace */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    std::string evdir  = "events";
+    std::string outdir = ".";
+
+    int ch;
+    while ((ch = getopt(argc, argv, "d:o:h")) != -1) {
+        switch (ch) {
+        case 'd': evdir  = optarg; break;
+        case 'o': outdir = optarg; break;
+
+        default:
+            usage(argv[0]);
+            exit(ch == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+    std::vector<std::string> only(argv + optind, argv + argc);
+
+    perfm::mapfile::ptr_t map = perfm::mapfile::alloc();
+    if (!map || !map->load(evdir + "/mapfile.csv")) {
+        perfm_fatal("failed to load %s/mapfile.csv\n", evdir.c_str());
+    }
+
+    // group the lines by Family-model, then the Family-models by the files they use
+    std::vector<arch_t> archs;
+
+    for (const auto &e : map->entries()) {
+        if (!only.empty() && std::find(only.begin(), only.end(), e.cpuid) == only.end()) {
+            continue;
+        }
+
+        const perfm::mapfile::entry_t *core   = map->find(e.cpuid, "core");
+        const perfm::mapfile::entry_t *uncore = map->find(e.cpuid, "uncore");
+
+        if (!core && !uncore) {
+            continue;
+        }
+
+        std::string name = arch_name(core ? core->filp : uncore->filp);
+
+        auto it = std::find_if(archs.begin(), archs.end(), [&name](const arch_t &a) { return a.name == name; });
+        if (it == archs.end()) {
+            arch_t a;
+            a.name   = name;
+            a.core   = core   ? core->filp   : "";
+            a.uncore = uncore ? uncore->filp : "";
+
+            archs.push_back(a);
+            it = archs.end() - 1;
+        }
+
+        if (std::find(it->cpuid.begin(), it->cpuid.end(), e.cpuid) == it->cpuid.end()) {
+            it->cpuid.push_back(e.cpuid);
+        }
+    }
+
+    if (archs.empty()) {
+        perfm_fatal("no microarchitecture selected\n");
+    }
+
+    for (const auto &a : archs) {
+        if (!emit_arch(a, outdir)) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return emit_tables(archs, outdir) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
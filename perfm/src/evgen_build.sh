@@ -0,0 +1,15 @@
+#!/bin/bash
+
+set -u
+
+TARGET="evgen"
+
+if [ -f $TARGET ]; then
+    rm -vf $TARGET
+    echo ""
+fi
+
+# evgen turns events/mapfile.csv & the files it lists into the headers of perfm_builtin.hpp
+SRC_FILE="perfm_util.cpp  perfm_cpuset.cpp  perfm_option.cpp  perfm_event.cpp  perfm_evdb.cpp  perfm_parser.cpp  perfm_mapfile.cpp  perfm_evindex.cpp  perfm_builtin.cpp  perfm_syscall.cpp  evgen.cpp"
+
+g++ -std=c++11 -g -Wall $SRC_FILE -o $TARGET -lrt
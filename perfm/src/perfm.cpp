@@ -1,10 +1,11 @@
 #include "perfm_util.hpp"
-#include "perfm_pmu.hpp"
 #include "perfm_option.hpp"
 #include "perfm_monitor.hpp"
 #include "perfm_analyzer.hpp"
 #include "perfm_top.hpp"
 #include "perfm_topology.hpp"
+#include "perfm_capture.hpp"
+#include "perfm_parser.hpp"
 
 #include <cstdio>
 #include <cstdlib>
@@ -19,7 +20,10 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#ifdef PERFM_USE_LIBPFM
+#include "perfm_pmu.hpp"
 #include <perfmon/pfmlib_perf_event.h>
+#endif
 
 namespace perfm {
     
@@ -28,6 +32,24 @@ inline bool perf_event_available()
     return ::access("/proc/sys/kernel/perf_event_paranoid", F_OK) == 0;
 }
 
+/* event names are encoded by perfm_parser, libpfm4 is only used as a fallback (PERFM_USE_LIBPFM) */
+inline void load_event()
+{
+    if (perfm_parser.load_builtin(perfm::cpu_identifier())) {
+        perfm_parser.pmu_detect(); /* the event table is compiled in, see perfm_builtin.hpp */
+        return;
+    }
+
+    perfm_options.select_event_files();
+
+    if (perfm_options.event_core_filp.empty() && perfm_options.event_uncore_filp.empty()) {
+        perfm_parser.pmu_detect(); /* no event table, perf style events can still be encoded */
+        return;
+    }
+
+    perfm_parser.load_event_db(perfm_options.event_db_filp, perfm_options.event_core_filp, perfm_options.event_uncore_filp);
+}
+
 void run_monitor()
 {
     if (!perf_event_available()) {
@@ -39,9 +61,21 @@ void run_monitor()
         exit(EXIT_FAILURE);
     }
 
-    pfm_err_t ret = pfm_initialize();
-    if (ret != PFM_SUCCESS) {
-        perfm_fatal("pfm_initialize() failed, %s\n", pfm_strerror(ret));
+    load_event();
+
+    // the topology goes to the head of the capture (if it's a file) & to the standalone
+    // snapshot, so the samples can be analyzed anywhere
+    perfm::topology::ptr_t topology = perfm::topology::alloc();
+    if (!topology) {
+        perfm_fatal("failed to alloc the topology object\n");
+    }
+
+    topology->build();
+    topology->print(perfm_options.sys_topology_filp.c_str());
+    topology->save(perfm_options.sys_snapshot_filp.c_str());
+
+    if (perfm_options.fp_out && !perfm::capture::write(perfm_options.fp_out, *topology)) {
+        perfm_fatal("failed to write the capture header to %s\n", perfm_options.file_out.c_str());
     }
 
     perfm::monitor::ptr_t m = perfm::monitor::alloc();
@@ -53,16 +87,6 @@ void run_monitor()
     m->open();
     m->start();
     m->close();
-
-    pfm_terminate();
-
-    perfm::topology::ptr_t topology = perfm::topology::alloc();
-    if (!topology) {
-        perfm_fatal("failed to alloc the topology object\n");
-    }
-
-    topology->build();
-    topology->print(perfm_options.sys_topology_filp.c_str());
 }
 
 void run_sampler()
@@ -71,18 +95,15 @@ void run_sampler()
         perfm_fatal("perf_event NOT supported, exiting...\n");
     }
 
-    pfm_err_t ret = pfm_initialize();
-    if (ret != PFM_SUCCESS) {
-        perfm_fatal("pfm_initialize() failed, %s\n", pfm_strerror(ret));
-    }
+    load_event();
 
     perfm_fatal("TODO\n");
-
-    pfm_terminate();
 }
 
 void run_analyzer()
 {
+    perfm_options.select_event_files();
+
     perfm::analyzer::ptr_t analyzer = perfm::analyzer::alloc();
     if (!analyzer) {
         perfm_fatal("failed to alloc the analyzer object\n");
@@ -102,10 +123,7 @@ void run_topper()
         exit(EXIT_FAILURE);
     }
 
-    pfm_err_t ret = pfm_initialize();
-    if (ret != PFM_SUCCESS) {
-        perfm_fatal("pfm_initialize() failed, %s\n", pfm_strerror(ret));
-    }
+    load_event();
 
     perfm_options.rdfmt_evgroup = true;
     perfm_options.incl_children = false;
@@ -119,12 +137,18 @@ void run_topper()
     topper->open();
     topper->loop();
     topper->fini();
+}
 
-    pfm_terminate();
+void run_lister()
+{
+    load_event();
+
+    perfm_parser.list_event(perfm_options.list_query, perfm_options.list_max);
 }
 
 void run_general()
 {
+#ifdef PERFM_USE_LIBPFM
     pfm_err_t ret = pfm_initialize();
     if (ret != PFM_SUCCESS) {
         perfm_fatal("pfm_initialize() failed, %s\n", pfm_strerror(ret));
@@ -134,9 +158,14 @@ void run_general()
         perfm::pmu_list();
     }
 
-    /* TODO */
-
     pfm_terminate();
+#else
+    if (perfm_options.list_pmu) {
+        perfm_warn("listing PMUs requires libpfm4, rebuild with USE_LIBPFM=1\n");
+    }
+#endif
+
+    /* TODO */
 }
 
 } /* namespace perfm */
@@ -188,6 +217,10 @@ int main(int argc, char **argv)
         perfm::run_topper();
         break;
 
+    case PERFM_LIST:
+        perfm::run_lister();
+        break;
+
     default:
         perfm::run_general();
     }
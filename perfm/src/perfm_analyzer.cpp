@@ -4,16 +4,22 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include <stack>
 #include <string>
+#include <fstream>
 
 namespace perfm {
 
-const std::string analyzer::_thread_view_file = "__perfm_thread_view_summary.csv";
-const std::string analyzer::_core_view_file   = "__perfm_core_view_summary.csv";
-const std::string analyzer::_socket_view_file = "__perfm_socket_view_summary.csv";
-const std::string analyzer::_system_view_file = "__perfm_system_view_summary.csv";
+const std::string analyzer::_tsc_name = "TSC";
+
+const std::string analyzer::_thread_view_filp = "__perfm_thread_view_summary.csv";
+const std::string analyzer::_core_view_filp   = "__perfm_core_view_summary.csv";
+const std::string analyzer::_llc_view_filp    = "__perfm_llc_view_summary.csv";
+const std::string analyzer::_node_view_filp   = "__perfm_node_view_summary.csv";
+const std::string analyzer::_socket_view_filp = "__perfm_socket_view_summary.csv";
+const std::string analyzer::_system_view_filp = "__perfm_system_view_summary.csv";
 
 metric::ptr_t metric::alloc() 
 {
@@ -54,21 +60,24 @@ void metric::events_parse(const std::string &filp)
             continue;
         }
 
-        // uncore PMU event 
-        if (env.find("UNC_") != std::string::npos) {
-            _e_name.insert({env, PMU_UNCORE});
-            continue;
-        }
+        _e_name.insert({evn, evn_class(evn)});
+    }
+}
 
-        // offcore PMU event
-        if (env.find("OFFCORE_") != std::string::npos) {
-            _e_name.insert({evn, PMU_OFFCORE}); 
-            continue;
-        }
+int metric::evn_class(const std::string &evn)
+{
+    // uncore PMU event, & the socket level power rows of the monitor
+    if (evn.find("UNC_") != std::string::npos || evn.compare(0, 8, "FREERUN_") == 0) {
+        return PMU_UNCORE;
+    }
 
-        // core PMU event
-        _e_name.insert({evn, PMU_CORE});
+    // offcore PMU event
+    if (evn.find("OFFCORE_") != std::string::npos) {
+        return PMU_OFFCORE;
     }
+
+    // core PMU event
+    return PMU_CORE;
 }
 
 void metric::metric_parse(const std::string &filp)
@@ -111,7 +120,7 @@ bool metric::metric_parse(xml::xml_node<char> *m)
 
     std::string m_name(n->value(), n->value_size());        // metric name
     std::string m_expr;                                     // metric expr
-    std::map<std::string, _e_name_map_t::iterator> e_alias; // metric expr alias
+    std::map<std::string, std::string> e_alias;             // metric expr alias
 
     // metric expr (non-empty)
     for (xml::xml_node<char> *nd = m->first_node(); nd; nd = nd->next_sibling()) {
@@ -136,12 +145,8 @@ bool metric::metric_parse(xml::xml_node<char> *m)
 
             std::string alias(attr->value(), attr->value_size());
 
-            auto event = _e_name.find(nd_val);
-            if (event == _e_name.end()) {
-                perfm_warn("TODO\n");
-            }
-
-            e_alias.insert({alias, event});
+            // the events are known once the samples are collected, see evn2type()
+            e_alias.insert({alias, nd_val});
 
             continue;
         }
@@ -158,10 +163,11 @@ bool metric::metric_parse(xml::xml_node<char> *m)
             auto constant = _e_name.insert({nd_val, PMU_CONSTANT});
 
             if (!constant.second && constant.first->second != PMU_CONSTANT) {
-                perfm_warn("TODO\n");
+                perfm_warn("%s is both an event & a constant, metric %s\n", nd_val.c_str(), m_name.c_str());
+                continue;
             }
 
-            e_alias.insert({alias, constant});
+            e_alias.insert({alias, nd_val});
 
             continue;
         }
@@ -190,7 +196,7 @@ int metric::evn2type(const std::string &evn)
         return it->second;
     }
 
-    return PMU_UNKNOWN;
+    return _e_name.insert({evn, evn_class(evn)}).first->second;
 }
 
 analyzer::ptr_t analyzer::alloc() 
@@ -208,6 +214,18 @@ analyzer::ptr_t analyzer::alloc()
 
 void analyzer::analyze()
 {
+    //
+    // map the capture, the samples & (usually) the topology
+    //
+    this->_capture = capture::alloc();
+    if (!this->_capture) {
+        perfm_fatal("failed to alloc the capture object\n");
+    }
+
+    if (!this->_capture->open(perfm_options.pmu_value_filp)) {
+        perfm_fatal("failed to open %s\n", perfm_options.pmu_value_filp.c_str());
+    }
+
     // 
     // build cpu topology
     //
@@ -221,8 +239,13 @@ void analyzer::analyze()
         perfm_fatal("failed to alloc the metric object\n");
     }
 
-    this->_metric->events_parse(/* TODO */);
-    this->_metric->metric_parse(/* TODO */);
+    // the events are classified as the samples are collected, see metric::evn2type()
+    this->_metric->metric_parse(perfm_options.metric_xml_filp);
+
+    //
+    // bind the system.* constants to the capture's host
+    //
+    this->constants();
 
     //
     // gather the collected PMU events
@@ -235,56 +258,71 @@ void analyzer::analyze()
     this->compute();
 }
 
-void analyzer::topology(const std::string &filp)
+void analyzer::topology()
 {
-    for (size_t i = 0; i < NR_MAX_PROCESSOR; ++i) {
-        _cpu_topology[i] = std::make_tuple(-1, -1, -1);    
-    }
+    _cpu_topology.clear();
 
     _nr_thread = 0;
     _nr_core   = 0;
     _nr_socket = 0;
     _nr_system = 1;
 
-    _core_usable_list.reset();
+    _core_index.clear();
+    _thrd_usable_list = cpuset();
+    _skt_usable_list  = cpuset();
+    _llc_usable_list  = cpuset();
+    _node_usable_list = cpuset();
 
-    std::fstream fp;
+    // the topology embedded in the capture, or the standalone snapshot for a capture without it
+    capture::ptr_t snap = _capture;
 
-    if (filp.empty()) {
-        fp.open(perfm_options.sys_topology_filp, std::ios::in);
-    } else {
-        fp.open(filp, std::ios::in);
+    if (!snap->has_topology()) {
+        snap = capture::alloc();
+        if (!snap) {
+            perfm_fatal("failed to alloc the capture object\n");
+        }
+
+        if (!snap->open(perfm_options.sys_snapshot_filp) || !snap->has_topology()) {
+            perfm_fatal("no topology in %s, nor in %s\n", perfm_options.pmu_value_filp.c_str(), perfm_options.sys_snapshot_filp.c_str());
+        }
+
+        perfm_warn("%s has no topology, use %s of host %s\n", perfm_options.pmu_value_filp.c_str(),
+                perfm_options.sys_snapshot_filp.c_str(), snap->header().host);
     }
 
-    if (!fp.good()) {
-        perfm_fatal("failed to open %s\n", filp.empty() ? perfm_options.sys_topology_filp.c_str() : filp.c_str());
+    _tsc_freq = snap->tsc_freq();
+    if (!_tsc_freq) {
+        _tsc_freq = tsc_frequency();
+        perfm_warn("no TSC frequency in the header of host %s, use %.3f GHz of this host\n",
+                snap->header().host, _tsc_freq / 1e9);
     }
 
-    const std::string title = "[Processor] - [Core] - [Socket] - [Online]";
-    std::string line;
+    for (uint32_t i = 0; i < snap->nr_cpu(); ++i) {
+        const capture::cpu_t &c = snap->cpu()[i];
 
-    while (std::getline(fp, line)) {
-        if (line == title) {
-            break;
+        if (c.cpu < 0 || c.core < 0 || c.socket < 0) {
+            perfm_fatal("invalid topology of cpu %d, core %d socket %d\n", c.cpu, c.core, c.socket);
         }
-    }
 
-    if (!fp.good()) {
-        perfm_fatal("failed to read %s\n", filp.empty() ? perfm_options.sys_topology_filp.c_str() : filp.c_str());
-    }
+        if (static_cast<size_t>(c.cpu) >= _cpu_topology.size()) {
+            _cpu_topology.resize(c.cpu + 1, std::make_tuple(-1, -1, -1, -1, -1));
+        }
 
-    int cpu, core, socket, online;
-    while (fp >> cpu >> core >> socket >> online) {
-        _cpu_topology[cpu] = std::make_tuple(online, core, socket); 
+        _cpu_topology[c.cpu] = std::make_tuple(c.online, c.core, c.socket, c.llc, c.node); 
+        _thrd_usable_list.set(c.cpu);
         ++_nr_thread;
+
+        _llc_usable_list.set(c.llc);
+        _node_usable_list.set(c.node);
     }
 
-    for (unsigned int c = 0, n = 0; n < _nr_thread; ++c) {
-        if (_m_processor_stauts(c) == -1) {
-            continue;
-        }
-        ++n;
+    _nr_llc  = _llc_usable_list.count();
+    _nr_node = _node_usable_list.count();
 
+    // the cores are numbered after all of them are known, in the order of <socket, core>
+    std::map<std::pair<int, int>, unsigned int> core_index;
+
+    for (int c : _thrd_usable_list) {
         int coreid = _m_processor_coreid(c);
         int socket = _m_processor_socket(c);
 
@@ -293,27 +331,131 @@ void analyzer::topology(const std::string &filp)
             _skt_usable_list.set(socket);
         }
 
-        if (!_core_usable_list.test(core_script(socket, coreid))) {
-            ++_nr_core;
-            _core_usable_list.set(core_script(socket, coreid));
-        }
+        core_index.insert(std::make_pair(std::make_pair(socket, coreid), 0U));
     }
+
+    for (auto &ci : core_index) {
+        ci.second = _nr_core++;
+    }
+
+    _core_index.swap(core_index);
 }
 
-void analyzer::collect(const std::string &filp)
+void analyzer::constants()
 {
-    std::fstream fp;
+    _constant.clear();
 
-    if (filp.empty()) {
-        fp.open(perfm_options.pmu_value_filp, std::ios::in);
-    } else {
-        fp.open(filp.c_str(), std::ios::in);
+    for (const auto &e : _metric->_e_name) {
+        if (e.second == PMU_CONSTANT) {
+            _constant[e.first] = constant(e.first);
+        }
     }
+}
 
-    if (!fp.good()) {
-        perfm_fatal("failed to open %s\n", filp.empty() ? perfm_options.pmu_value_filp.c_str() : filp.c_str());
+double analyzer::constant(const std::string &expr) const
+{
+    // the n-th usable socket, & its <socket, core> => index entries
+    auto socket_id = [this] (unsigned int n) -> int {
+        for (int skt : _skt_usable_list) {
+            if (n-- == 0) {
+                return skt;
+            }
+        }
+        return -1;
+    };
+
+    auto atom = [&] (const std::string &name) -> double {
+        unsigned int s = 0, c = 0;
+        char tail[64] = { 0 };
+
+        if (name == "system.tsc_freq") {
+            return _tsc_freq;
+        }
+
+        if (name == "system.sockets.count" || name == "system.socket_count") {
+            return _nr_socket;
+        }
+
+        if (std::sscanf(name.c_str(), "system.sockets[%u].%63s", &s, tail) == 2) {
+            int skt = socket_id(s);
+            unsigned int n = 0;
+
+            if (skt < 0) {
+                perfm_warn("%s, the capture has %u socket(s), use 0\n", name.c_str(), _nr_socket);
+                return 0;
+            }
+
+            if (!strcmp(tail, "cores.count")) {
+                for (const auto &ci : _core_index) {
+                    n += ci.first.first == skt;
+                }
+                return n;
+            }
+
+            if (!strcmp(tail, "cpus.count")) {
+                for (int cpu : _thrd_usable_list) {
+                    n += _m_processor_socket(cpu) == skt;
+                }
+                return n;
+            }
+        }
+
+        // threads of the c-th core of the s-th socket
+        if (std::sscanf(name.c_str(), "system.sockets[%u][%u].%63s", &s, &c, tail) == 3 && !strcmp(tail, "size")) {
+            int skt = socket_id(s);
+            unsigned int n = 0;
+
+            if (skt < 0) {
+                perfm_warn("%s, the capture has %u socket(s), use 0\n", name.c_str(), _nr_socket);
+                return 0;
+            }
+
+            for (const auto &ci : _core_index) {
+                if (ci.first.first == skt && c-- == 0) {
+                    for (int cpu : _thrd_usable_list) {
+                        n += _m_processor_socket(cpu) == skt && _m_processor_coreid(cpu) == ci.first.second;
+                    }
+                    break;
+                }
+            }
+
+            return n;
+        }
+
+        char *end = nullptr;
+        double v = std::strtod(name.c_str(), &end);
+        if (end && *end == '\0' && end != name.c_str()) {
+            return v;
+        }
+
+        perfm_warn("unknown constant %s, use 0\n", name.c_str());
+        return 0;
+    };
+
+    double res = 0;
+    char op = '*';
+
+    for (size_t pos = 0; pos <= expr.size(); ) {
+        size_t del = expr.find_first_of("*/", pos);
+        if (del == std::string::npos) {
+            del = expr.size();
+        }
+
+        double v = atom(str_trim(expr.substr(pos, del - pos)));
+
+        res = pos == 0 ? v : op == '*' ? res * v : (v != 0 ? res / v : 0);
+
+        if (del < expr.size()) {
+            op = expr[del];
+        }
+        pos = del + 1;
     }
 
+    return res;
+}
+
+void analyzer::collect()
+{
     const std::string delimiter = " ";
     std::string line;
 
@@ -322,15 +464,39 @@ void analyzer::collect(const std::string &filp)
     // event_name, tsc_cycle, cpu0, cpu1, cpu2, ... (core PMU)
     // event_name, tsc_cycle, socket0, socket1, ... (uncore PMU)
     
-    while (std::getline(fp, line)) {
-        if (line.empty()) {
+    // the samples are parsed in place, line by line
+    const char *text = _capture->text();
+    const char *tail = text + _capture->text_size();
+
+    while (text < tail) {
+        const char *eol = static_cast<const char *>(memchr(text, '\n', tail - text));
+        if (!eol) {
+            eol = tail;
+        }
+
+        line.assign(text, eol);
+        text = eol + 1;
+
+        // comment lines, e.g. the cpu hotplug marks of the monitor
+        if (line.empty() || line[0] == '#') {
             continue;
         }
 
-        auto slice = str_split(line, delimiter);
+        auto slice = str_split(line, delimiter, 0, true);
+        if (slice.size() < 3) {
+            perfm_warn("invalid event sample %s\n", line.c_str());
+            continue;
+        }
 
         std::string nam_event = std::move(slice[0]);
-        uint64_t tsc_cycle    = slice[1];
+        uint64_t tsc_cycle    = 0;
+
+        try {
+            tsc_cycle = std::stoull(slice[1]);
+        } catch (const std::exception &) {
+            perfm_warn("invalid event sample %s\n", line.c_str());
+            continue;
+        }
 
         std::vector<double> pmu_value;
 
@@ -338,6 +504,13 @@ void analyzer::collect(const std::string &filp)
         
         for (size_t i = 2; is_valid && i < slice.size(); ++i) {
             uint64_t val = 0;    
+
+            // "-" for a selected cpu which was offline during the interval, no count
+            if (slice[i] == "-") {
+                pmu_value.push_back(val);
+                continue;
+            }
+
             try {
                 val = std::stoull(slice[i]);
             } catch (const std::invalid_argument &) {
@@ -350,11 +523,7 @@ void analyzer::collect(const std::string &filp)
                 break;
             }
 
-            /* FIXME */
-            if (val > tsc_cycle) {
-                is_valid = false;
-                break;
-            }
+            // no upper bound by tsc_cycle, e.g. INST_RETIRED.ANY exceeds it whenever IPC > 1
 
             // cpu0, cpu1, cpu2, ... (core PMU)
             // socket0, socket1, ... (uncore PMU)
@@ -367,6 +536,14 @@ void analyzer::collect(const std::string &filp)
         }
 
         insert(nam_event, pmu_value);
+        ++ev_count[nam_event];
+
+        // the TSC of the interval, for the metrics of a fraction of the wall clock (e.g. CPU utilization)
+        int type = _metric->evn2type(nam_event);
+        if (type == PMU_CORE || type == PMU_OFFCORE) {
+            insert(_tsc_name, std::vector<double>(pmu_value.size(), tsc_cycle));
+            ++ev_count[_tsc_name];
+        }
     }
 
     average(ev_count);   
@@ -386,30 +563,22 @@ void analyzer::insert(const std::string &evn, const std::vector<double> &val)
             if (it == this->_e_thread.end()) {
                 _e_thrd_elem_t *p = nullptr;
                 try {
-                    p = new _e_thrd_elem_t;
+                    p = new _e_thrd_elem_t(_cpu_topology.size(), 0);
                 } catch (const std::bad_alloc &) {
                     perfm_fatal("failed to alloc memory\n");
                 }
 
-                for (size_t c = 0, n = 0; n < val.size(); ++c) {
-                    if (_m_processor_status(c) == -1) {
-                        continue;
-                    }
-                    ++n;
-
-                    p[c] = val[n];
+                size_t n = 0;
+                for (int c : _thrd_usable_list) {
+                    (*p)[c] = val[n++];
                 }
 
                 this->_e_thread.insert({evn, std::shared_ptr<_e_thrd_elem_t>(p)});
 
             } else {
-                for (size_t c = 0, n = 0; n < val.size(); ++c) {
-                    if (_m_processor_status(c) == -1) {
-                        continue;
-                    }
-                    ++n;
-
-                    (*(it->second))[c] += val[n];
+                size_t n = 0;
+                for (int c : _thrd_usable_list) {
+                    (*(it->second))[c] += val[n++];
                 }
             }
         }
@@ -426,20 +595,22 @@ void analyzer::insert(const std::string &evn, const std::vector<double> &val)
             if (it == this->_e_socket.end()) {
                 _e_socket_elem_t *p = nullptr;
                 try {
-                    p = new _e_socket_elem_t;
+                    p = new _e_socket_elem_t(_skt_usable_list.size(), 0);
                 } catch (const std::bad_alloc &) {
                     perfm_fatal("failed to alloc memory\n");
                 }
 
-                for (size_t i = 0; i < val.size(); ++i) {
-                    p[i] = val[i];
+                size_t i = 0;
+                for (int skt : _skt_usable_list) {
+                    (*p)[skt] = val[i++];
                 }
 
                 this->_e_socket.insert({evn, std::shared_ptr<_e_socket_elem_t>(p)});
 
             } else {
-                for (size_t i = 0; i < val.size(); ++i) {
-                    (*(it->second))[i] += val[i];
+                size_t i = 0;
+                for (int skt : _skt_usable_list) {
+                    (*(it->second))[skt] += val[i++];
                 }
             }
         }
@@ -464,29 +635,19 @@ void analyzer::average(const std::unordered_map<std::string, size_t> &ev_count)
 {
     // core/offcore PMU events are related to each presented (logical) CPUs 
     for (auto it = _e_thread.begin(); it != _e_thread.end(); ++it) {
-        size_t cntr = ev_count[it->first];
-
-        for (unsigned int c = 0, n = 0; n < _nr_thread; ++c) {
-            if (_m_processor_status(c) == -1) {
-                continue;
-            }
-            ++n;
+        size_t cntr = ev_count.at(it->first);
 
+        for (int c : _thrd_usable_list) {
             (*(it->second))[c] /= cntr;
         }
     }
 
     // uncore PMU events are related to socket (not CPUs)
     for (auto it = _e_socket.begin(); it != _e_socket.end(); ++it) {
-        size_t cntr = ev_count[it->first];
-
-        for (unsigned int c = 0, n = 0; n < _nr_socket; ++c) {
-            if (_m_processor_status(c) == -1) {
-                continue;
-            }
-            ++n;
+        size_t cntr = ev_count.at(it->first);
 
-            (*(it->second))[c] /= cntr;
+        for (int skt : _skt_usable_list) {
+            (*(it->second))[skt] /= cntr;
         }
     }
 }
@@ -501,6 +662,14 @@ void analyzer::compute()
         core_compute();
     }
 
+    if (perfm_options.llc_view) {
+        llc_compute();
+    }
+
+    if (perfm_options.node_view) {
+        node_compute();
+    }
+
     if (perfm_options.socket_view) {
         socket_compute();
     }
@@ -512,8 +681,12 @@ void analyzer::compute()
 
 void analyzer::thrd_compute()
 {
+    _column_t column;
+    for (int c : _thrd_usable_list) {
+        column.push_back({"cpu" + std::to_string(c), c});
+    }
 
-    /* TODO */
+    metric_eval(_thread_view_filp, _e_thread, column);
 }
 
 void analyzer::core_compute()
@@ -521,29 +694,27 @@ void analyzer::core_compute()
     for (auto it = _e_thread.begin(); it != _e_thread.end(); ++it) {
         _e_core_elem_t *p = nullptr;
         try {
-            p = new _e_core_elem_t;
+            p = new _e_core_elem_t(_nr_core, 0);
         } catch (const std::bad_alloc &) {
             perfm_fatal("failed to alloc memory\n"); 
         }
 
-        for (unsigned int c = 0; c < NR_MAX_CORE; ++c) {
-            p[c] = 0;
-        }
-
-        for (unsigned int c = 0, n = 0; n < _nr_thread; ++c) {
-            if (_m_processor_status(c) == -1) {
-                continue;
-            }
-            ++n;
-
+        for (int c : _thrd_usable_list) {
             int socket = _m_processor_socket(c);
             int coreid = _m_processor_coreid(c);
 
-            p[core_script(socket, coreid)] += (*(it->second))[c];
+            (*p)[core_script(socket, coreid)] += (*(it->second))[c];
         }
+
+        _e_core.insert({it->first, std::shared_ptr<_e_core_elem_t>(p)});
+    }
+
+    _column_t column;
+    for (const auto &ci : _core_index) {
+        column.push_back({"socket" + std::to_string(ci.first.first) + ".core" + std::to_string(ci.first.second), ci.second});
     }
 
-    /* TODO */
+    metric_eval(_core_view_filp, _e_core, column);
 }
 
 void analyzer::socket_compute()
@@ -552,97 +723,180 @@ void analyzer::socket_compute()
     for (auto it = _e_thread.begin(); it != _e_thread.end(); ++it) {
         _e_socket_elem_t *p = nullptr;
         try {
-            p = new _e_socket_elem_t;
+            p = new _e_socket_elem_t(_skt_usable_list.size(), 0);
         } catch (const std::bad_alloc &) {
             perfm_fatal("failed to alloc memory\n"); 
         }
 
-        for (unsigned int s = 0; s < NR_MAX_SOCKET; ++s) {
-            p[s] = 0;
+        for (int c : _thrd_usable_list) {
+            (*p)[_m_processor_socket(c)] += (*(it->second))[c];
         }
 
-        for (unsigned int c = 0, n = 0; n < _nr_thread; ++c) {
-            if (_m_processor_status(c) == -1) {
-                continue;
+        _e_socket.insert({it->first, std::shared_ptr<_e_socket_elem_t>(p)});
+    }
+
+    _column_t column;
+    for (int skt : _skt_usable_list) {
+        column.push_back({"socket" + std::to_string(skt), skt});
+    }
+
+    metric_eval(_socket_view_filp, _e_socket, column);
+}
+
+void analyzer::llc_compute()
+{
+    // aggregate PMU data related to this LLC domain, processors without cache info are left out
+    for (auto it = _e_thread.begin(); it != _e_thread.end(); ++it) {
+        _e_llc_elem_t *p = nullptr;
+        try {
+            p = new _e_llc_elem_t(_llc_usable_list.size(), 0);
+        } catch (const std::bad_alloc &) {
+            perfm_fatal("failed to alloc memory\n"); 
+        }
+
+        for (int c : _thrd_usable_list) {
+            if (_m_processor_llc(c) >= 0) {
+                (*p)[_m_processor_llc(c)] += (*(it->second))[c];
             }
-            ++n;
-            
-            p[_m_processor_socket(c)] += (*(it->second))[c];
         }
 
-        _e_socket.insert({it->first, std::shared_ptr<_e_socket_elem_t>(p)});
+        _e_llc.insert({it->first, std::shared_ptr<_e_llc_elem_t>(p)});
     }
 
-    // parse the aggregated data
-    /* TODO */
+    _column_t column;
+    for (int id : _llc_usable_list) {
+        column.push_back({"llc" + std::to_string(id), id});
+    }
+
+    metric_eval(_llc_view_filp, _e_llc, column);
 }
 
-void analyzer::system_compute()
+void analyzer::node_compute()
 {
-    if (perfm_options.socket_view) {
-        for (auto it = _e_socket.begin(); it != _e_socket.end(); ++it) {
-            _e_system_elem_t *p = nullptr;
-            try {
-                p = new _e_system_elem_t { 0 };
-            } catch (const std::bad_alloc &) {
-                perfm_fatal("failed to alloc memory\n"); 
-            }
+    // aggregate PMU data related to this NUMA node
+    for (auto it = _e_thread.begin(); it != _e_thread.end(); ++it) {
+        _e_node_elem_t *p = nullptr;
+        try {
+            p = new _e_node_elem_t(_node_usable_list.size(), 0);
+        } catch (const std::bad_alloc &) {
+            perfm_fatal("failed to alloc memory\n"); 
+        }
 
-            for (unsigned int s = 0; s < _nr_socket; ++s) {
-                p[0] += (*(it->second))[s];
+        for (int c : _thrd_usable_list) {
+            if (_m_processor_node(c) >= 0) {
+                (*p)[_m_processor_node(c)] += (*(it->second))[c];
             }
+        }
+
+        _e_node.insert({it->first, std::shared_ptr<_e_node_elem_t>(p)});
+    }
+
+    _column_t column;
+    for (int id : _node_usable_list) {
+        column.push_back({"node" + std::to_string(id), id});
+    }
+
+    metric_eval(_node_view_filp, _e_node, column);
+}
+
+void analyzer::system_compute()
+{
+    // core PMU events summed over the processors, uncore PMU events over the sockets
+    for (auto it = _e_thread.begin(); it != _e_thread.end(); ++it) {
+        _e_system_elem_t *p = nullptr;
+        try {
+            p = new _e_system_elem_t(_nr_system, 0);
+        } catch (const std::bad_alloc &) {
+            perfm_fatal("failed to alloc memory\n"); 
+        }
 
-            _e_system.insert({it->first, std::shared_ptr<_e_system_elem_t>(p)});
+        for (int c : _thrd_usable_list) {
+            (*p)[0] += (*(it->second))[c];
         }
-    
-    } else {
-        for (auto it = _e_thread.begin(); it != _e_thread.end(); ++it) {
-            _e_system_elem_t *p = nullptr;
-            try {
-                p = new _e_system_elem_t { 0 };
-            } catch (const std::bad_alloc &) {
-                perfm_fatal("failed to alloc memory\n"); 
-            }
 
-            for (unsigned int c = 0, n = 0; n < _nr_thread; ++c) {
-                if (_m_processor_status(c) == -1) {
-                    continue;
-                }
-                ++n;
-                
-                p[0] += (*(it->second))[c];
-            }
+        _e_system.insert({it->first, std::shared_ptr<_e_system_elem_t>(p)});
+    }
 
-            _e_system.insert({it->first, std::shared_ptr<_e_system_elem_t>(p)});
+    for (auto it = _e_socket.begin(); it != _e_socket.end(); ++it) {
+        if (_e_system.count(it->first)) {
+            continue; /* a core event, aggregated by socket_compute() */
         }
+
+        _e_system_elem_t *p = nullptr;
+        try {
+            p = new _e_system_elem_t(_nr_system, 0);
+        } catch (const std::bad_alloc &) {
+            perfm_fatal("failed to alloc memory\n"); 
+        }
+
+        for (int s : _skt_usable_list) {
+            (*p)[0] += (*(it->second))[s];
+        }
+
+        _e_system.insert({it->first, std::shared_ptr<_e_system_elem_t>(p)});
     }
 
-    /* TODO */
+    metric_eval(_system_view_filp, _e_system, _column_t{ {"system", 0} });
 }
 
-void analyzer::metric_eval()
+void analyzer::metric_eval(const std::string &filp, const _e_view_t &data, const _column_t &column) const
 {
-    if (_metrics_list.empty()) {
+    if (_metric->_metrics_list.empty()) {
         perfm_warn("no metric for evaluate\n");
         return;
     }
 
-    for (auto iter = _metrics_list.begin(); iter != _metrics_list.end(); ++iter) {
-        metric_eval(*iter);
+    FILE *fp = ::fopen(filp.c_str(), "w");
+    if (!fp) {
+        perfm_fatal("failed to open %s, %s\n", filp.c_str(), strerror(errno));
     }
-}
 
-void analyzer::metric_eval(const _metric_nam_t &metric)
-{
-    auto iter = _formula_list.find(metric);
-    if (iter == _formula_list.end()) {
-        perfm_warn("invalid metric %s\n", metric.c_str());
-        return;
+    // metric, column0, column1, ...
+    fprintf(fp, "metric");
+    for (const auto &col : column) {
+        fprintf(fp, ",%s", col.first.c_str());
+    }
+    fprintf(fp, "\n");
+
+    size_t nr_metric = 0;
+
+    for (const auto &m : _metric->_metrics_list) {
+        const _expression_t &formula = _metric->_formula_list.at(m);
+
+        bool is_valid = true;
+        for (const auto &alias : formula.second) {
+            if (!_constant.count(alias.second) && !data.count(alias.second)) {
+                is_valid = false;
+                break;
+            }
+        }
+
+        if (!is_valid) {
+            continue;
+        }
+
+        std::vector<double> val(column.size(), 0);
+        for (size_t i = 0; is_valid && i < column.size(); ++i) {
+            is_valid = expr_eval(formula, data, column[i].second, val[i]);
+        }
+
+        if (!is_valid) {
+            perfm_warn("invalid formula %s of metric %s, skipped\n", formula.first.c_str(), m.c_str());
+            continue;
+        }
+
+        fprintf(fp, "%s", m.c_str());
+        for (double v : val) {
+            fprintf(fp, ",%.6f", v);
+        }
+        fprintf(fp, "\n");
+
+        ++nr_metric;
     }
 
-    double metric_val = expr_eval(iter->second);
+    ::fclose(fp);
 
-    /* TODO (how to use/show/display this value) */
+    printf("%zu metrics in %s\n", nr_metric, filp.c_str());
 }
 
 std::string analyzer::expr_in2postfix(const std::string &expr_infix) const
@@ -718,10 +972,6 @@ std::string analyzer::expr_in2postfix(const std::string &expr_infix) const
         return priority[a] < priority[b];
     };
 
-    auto more_priority = [&priority] (int a, int b) -> bool {
-        return priority[a] > priority[b];
-    };
-
     std::string expr_postfix;
     std::string elem;
     std::stack<char> stk;
@@ -768,10 +1018,10 @@ std::string analyzer::expr_in2postfix(const std::string &expr_infix) const
         stk.pop();
     }
 
-    return std::move(expr_postfix);
+    return expr_postfix;
 }
 
-double analyzer::expr_eval(const _expression_t &formula, size_t column) const
+bool analyzer::expr_eval(const _expression_t &formula, const _e_view_t &data, size_t column, double &val) const
 {
     const auto  exprn = expr_in2postfix(formula.first); // std::string
     const auto &alias = formula.second;                 // std::map
@@ -800,6 +1050,9 @@ double analyzer::expr_eval(const _expression_t &formula, size_t column) const
                 return OPERAND;
 
             case '*':  case '/':  case '%':  case '+':  case '-':
+                if (!res.empty()) {
+                    return OPERAND;
+                }
                 res = str[pos++];
                 return OPERATOR;
 
@@ -820,23 +1073,37 @@ double analyzer::expr_eval(const _expression_t &formula, size_t column) const
                 // fetch the real name (event name) for this alias
                 auto name = alias.find(elem);
                 if (name == alias.end()) {
-                    perfm_fatal("invalid operand %s\n", elem.c_str());
+                    // a number, e.g. the 100 of 100*a/b
+                    char *end = nullptr;
+                    double v = std::strtod(elem.c_str(), &end);
+                    if (end == elem.c_str() || *end != '\0') {
+                        return false;
+                    }
+
+                    stk.push(v);
+                    break;
+                }
+
+                // a system.* constant, the same for all the columns
+                auto cval = _constant.find(name->second);
+                if (cval != _constant.end()) {
+                    stk.push(cval->second);
+                    break;
                 }
 
                 // fetch data for the given event
-                auto data = _e_data.find(name->second->first);
-                if (data == _e_data.end()) {
-                    perfm_fatal("invalid event name %s\n", name->second->first.c_str());
+                auto d = data.find(name->second);
+                if (d == data.end()) {
+                    return false;
                 }
 
-                /* FIXME */
-                stk.push(data->second[column]);
+                stk.push((*d->second)[column]);
             }
             break;
 
         case OPERATOR: {
                 if (stk.size() < 2) {
-                    perfm_fatal("invalid formula expression %s\n", formula.first.c_str());
+                    return false;
                 }
 
                 double r = stk.top(); stk.pop(); // right operand
@@ -861,7 +1128,7 @@ double analyzer::expr_eval(const _expression_t &formula, size_t column) const
                     break;
 
                 default:
-                    perfm_fatal("invalid operator %s\n", elem.c_str());
+                    return false;
                 }
 
                 stk.push(v);
@@ -870,11 +1137,13 @@ double analyzer::expr_eval(const _expression_t &formula, size_t column) const
         }
     }
 
-    if (stk.empty()) {
-        perfm_fatal("invalid formula expression %s\n", formula.first.c_str());
+    if (stk.size() != 1) {
+        return false;
     }
 
-    return stk.top();
+    val = stk.top();
+
+    return true;
 }
 
 } /* namespace perfm */
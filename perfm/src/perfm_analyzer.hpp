@@ -7,6 +7,8 @@
 
 #include "perfm_util.hpp"
 #include "perfm_config.hpp"
+#include "perfm_cpuset.hpp"
+#include "perfm_capture.hpp"
 #include "perfm_option.hpp"
 #include "perfm_xml.hpp"
 
@@ -51,7 +53,7 @@ private:
      */
     using _e_name_map_t = std::unordered_map<std::string, int>;
     using _metric_nam_t = std::string;
-    using _expression_t = std::pair<std::string, std::map<std::string, _e_name_map_t::iterator>>;
+    using _expression_t = std::pair<std::string, std::map<std::string, std::string>>; /* formula, alias=>event/constant */
 
 public:
     static ptr_t alloc();
@@ -59,11 +61,21 @@ public:
     void metric_parse(const std::string &filp);
     void events_parse(const std::string &filp);
 
+    /*
+     * evn2type - the type of an event
+     *
+     * Description:
+     *     an event not in the list (e.g. one found in the samples only) is classified by its name,
+     *     UNC_* & the FREERUN_* power rows are socket level, OFFCORE_* offcore, the others core,
+     *     & added to the list
+     */
     int evn2type(const std::string &evn);
 
 private:
     bool metric_parse(xml::xml_node<char> *m);
 
+    static int evn_class(const std::string &evn);
+
 private:
     std::unordered_map<_metric_nam_t, _expression_t> _formula_list; /* metric = formula
                                                                      * e.g.
@@ -80,15 +92,37 @@ class analyzer {
 public:
     using ptr_t = std::shared_ptr<analyzer>;
 
+private:
+    using _metric_nam_t = metric::_metric_nam_t;
+    using _expression_t = metric::_expression_t;
+
+    /* name=>data list of one view, the elems are the columns of the view */
+    using _e_view_t = std::unordered_map<std::string, std::shared_ptr<std::vector<double>>>;
+
+    /* the columns of one view, <name, sub-script in the elem list>, e.g. <"cpu3", 3> */
+    using _column_t = std::vector<std::pair<std::string, size_t>>;
+
 public:
     static ptr_t alloc();
 
     void analyze(/* TODO */);
 
 private:
-    void topology(const std::string &filp = "");
+    void topology();
+    void constants();
 
-    void collect(const std::string &filp = "");
+    /*
+     * constant - the value of a system.* constant of the metrics
+     *
+     * @expr: e.g. "system.tsc_freq", "system.sockets[0].cpus.count/system.sockets[0].cores.count"
+     *
+     * Description:
+     *     the TSC frequency is the one recorded in the capture header, the others are counted in
+     *     the topology. '*' & '/' are evaluated from left to right, unknown names are 0
+     */
+    double constant(const std::string &expr) const;
+
+    void collect();
 
     void compute();
 
@@ -97,45 +131,72 @@ private:
 
     void thrd_compute();
     void core_compute();
+    void llc_compute();
+    void node_compute();
 
     void socket_compute();
     void system_compute();
 
-    void eval(/* TODO */);
-    void eval(/* TODO */const _metric_nam_t &metric);
+    /*
+     * metric_eval - evaluate the metrics for each column of a view, written to @filp as csv
+     *
+     * Description:
+     *     one row per metric: name, value of column 0, column 1, ... the metrics with an event
+     *     not in @data (not collected, or not in this view) are left out
+     */
+    void metric_eval(const std::string &filp, const _e_view_t &data, const _column_t &column) const;
 
     std::string expr_in2postfix(const std::string &infix) const;
 
-    double expr_eval(const _expression_t &expr, size_t column) const;
+    /*
+     * expr_eval - the value of a formula for one column of a view, in @val
+     *
+     * Return:
+     *     true  - evaluated
+     *     false - invalid formula (e.g. an unknown operand or operator)
+     */
+    bool expr_eval(const _expression_t &expr, const _e_view_t &data, size_t column, double &val) const;
 
 private:
     /* data format for one PMU event
      *
      * since event may be collected simultaneously on multiple processors, cores, sockets and so
-     * we use a std::array. for each of the processors/cores/sockets, there exists a elem in the array
+     * we use a std::vector sized by the topology. for each of the processors/cores/sockets, there
+     * exists a elem in the vector
      * 
      * event's PMU value are aggregated & averaged by multiple samples (so we use double, not uint64_t)
      */
-    using _e_thrd_elem_t   = std::array<double, NR_MAX_PROCESSOR>;
-    using _e_core_elem_t   = std::array<double, NR_MAX_CORE>;
-    using _e_socket_elem_t = std::array<double, NR_MAX_SOCKET>;
-    using _e_system_elem_t = std::array<double, 1U>;
+    using _e_thrd_elem_t   = std::vector<double>; /* _cpu_topology.size() elems */
+    using _e_core_elem_t   = std::vector<double>; /* _nr_core elems */
+    using _e_llc_elem_t    = std::vector<double>; /* _llc_usable_list.size() elems */
+    using _e_node_elem_t   = std::vector<double>; /* _node_usable_list.size() elems */
+    using _e_socket_elem_t = std::vector<double>; /* _skt_usable_list.size() elems */
+    using _e_system_elem_t = std::vector<double>; /* 1 elem */
 
     /* name=>data list
      *
      * key: event's name string
-     * val: event's pmu value (a smart pointer to std::array)
+     * val: event's pmu value (a smart pointer to the elem list)
      */
     using _e_thrd_t   = std::unordered_map<std::string, std::shared_ptr<_e_thrd_elem_t>>;
     using _e_core_t   = std::unordered_map<std::string, std::shared_ptr<_e_core_elem_t>>;
+    using _e_llc_t    = std::unordered_map<std::string, std::shared_ptr<_e_llc_elem_t>>;
+    using _e_node_t   = std::unordered_map<std::string, std::shared_ptr<_e_node_elem_t>>;
     using _e_socket_t = std::unordered_map<std::string, std::shared_ptr<_e_socket_elem_t>>;
     using _e_system_t = std::unordered_map<std::string, std::shared_ptr<_e_system_elem_t>>;
 
 private:
     metric::ptr_t  _metric;
+    capture::ptr_t _capture; /* the mapped capture, see perfm_capture.hpp */
+
+    uint64_t _tsc_freq = 0; /* Hz, of the host the capture was taken on */
+
+    std::unordered_map<std::string, double> _constant; /* constant name => value */
 
     unsigned int _nr_thread;
     unsigned int _nr_core;
+    unsigned int _nr_llc;
+    unsigned int _nr_node;
     unsigned int _nr_socket;
     unsigned int _nr_system = 1;
 
@@ -158,18 +219,32 @@ private:
     /* event data list, physical core level, only for core PMU events
      * 
      * key: event's name string
-     * val: an array, the sub-script is *maped* to socket's id + core's id
-     * 
-     * if N = NR_MAX_CORE_PER_SKT, then: 
-     *   [0, N - 1]:          cores for socket0 (include non-exist cores)
-     *   [N,  2 * N - 1]:     cores for socket1
-     *   [2 * N,  3 * N - 1]: cores for socket2
+     * val: an array, the sub-script is *maped* from <socket's id, core's id>
+     *
+     * the existing cores are numbered in the order of <socket, core>, so the array has no hole
+     * for the discontinuous core ids:
+     *   [0, N0 - 1]:         cores for socket0, N0 is the # of cores on socket0
+     *   [N0, N0 + N1 - 1]:   cores for socket1
      */
     _e_core_t _e_core;
 
-    std::bitset<NR_MAX_CORE> _core_usable_list;
-    #define core_script(socket, coreid)  ((socket) * NR_MAX_CORE_PER_SKT + (coreid))
-    #define core_usable(socket, coreid)  _core_usable_list.test(core_script(socket, coreid))
+    std::map<std::pair<int, int>, unsigned int> _core_index; /* <socket, coreid> => sub-script */
+    #define core_script(socket, coreid)  _core_index.at(std::make_pair((socket), (coreid)))
+    #define core_usable(socket, coreid)  (_core_index.count(std::make_pair((socket), (coreid))) != 0)
+
+    /* event data list, LLC domain & NUMA node level, only for core PMU events
+     *
+     * key: event's name string
+     * val: an array, the sub-script is the LLC id / node id of the topology file
+     *
+     * with sub-NUMA clustering (or several CCXs per socket), a socket has more than one LLC
+     * domain or node, & the contention within one of them is averaged away in the socket view
+     */
+    _e_llc_t  _e_llc;
+    _e_node_t _e_node;
+
+    cpuset _llc_usable_list;
+    cpuset _node_usable_list;
 
     /* event name list, socket level, for all events (core & uncore PMU events)
      *
@@ -178,7 +253,7 @@ private:
      */
     _e_socket_t _e_socket;
 
-    std::bitset<NR_MAX_SOCKET> _skt_usable_list;
+    cpuset _skt_usable_list;
 
     /* event name list, system level, for all events (core & uncore PMU events)
      *
@@ -187,23 +262,32 @@ private:
      */
     _e_system_t _e_system;
 
+    const static std::string _tsc_name; /* the TSC of each sample interval, as a core event */
+
     const static std::string _thread_view_filp;
     const static std::string _core_view_filp;
+    const static std::string _llc_view_filp;
+    const static std::string _node_view_filp;
     const static std::string _socket_view_filp;
     const static std::string _system_view_filp;
 
     /* subscript is (logical) processor's id
-     * array type is: <status, coreid, socket>
+     * array type is: <status, coreid, socket, llc, node>
      *
      * status - -1: not presented (not usable), 0: not online, 1: online
      * coreid - physical core id
      * socket - socket id (physical package id)
+     * llc    - last level cache domain id, -1 if unknown
+     * node   - NUMA node id
      */
-    std::array<std::tuple<int, int, int>, NR_MAX_PROCESSOR> _cpu_topology;
+    std::vector<std::tuple<int, int, int, int, int>> _cpu_topology; /* sized by the largest processor id */
+    cpuset _thrd_usable_list; /* the presented processors */
                                                                            
     #define _m_processor_status(c)  std::get<0>(this->_cpu_topology[(c)])
     #define _m_processor_coreid(c)  std::get<1>(this->_cpu_topology[(c)])
     #define _m_processor_socket(c)  std::get<2>(this->_cpu_topology[(c)])
+    #define _m_processor_llc(c)     std::get<3>(this->_cpu_topology[(c)])
+    #define _m_processor_node(c)    std::get<4>(this->_cpu_topology[(c)])
 
     #define _m_processor_online(c)  _m_processor_status(c) == 1
 };
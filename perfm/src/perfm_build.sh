@@ -9,6 +9,34 @@ if [ -f $TARGET ]; then
     echo ""
 fi
 
-SRC_FILE="perfm_util.cpp perfm_pmu.cpp perfm_option.cpp perfm_event.cpp perfm_group.cpp perfm_monitor.cpp perfm_analyzer.cpp perfm_top.cpp perfm_topology.cpp perfm.cpp"
+# event names are encoded natively (perfm_parser), USE_LIBPFM=1 adds libpfm4 as the fallback encoder
+USE_LIBPFM=${USE_LIBPFM:-0}
 
-g++ -std=c++11 -g -Wall -lpfm $SRC_FILE -o $TARGET -lrt -lncurses
+# BUILTIN=1 compiles the event tables of events/mapfile.csv into a static perfm, see perfm_builtin.hpp
+# BUILTIN_CPUID limits them to some Family-models, e.g. BUILTIN_CPUID="GenuineIntel-6-4F"
+BUILTIN=${BUILTIN:-0}
+BUILTIN_CPUID=${BUILTIN_CPUID:-}
+
+SRC_FILE="perfm_util.cpp perfm_cpuset.cpp perfm_option.cpp perfm_event.cpp perfm_group.cpp perfm_evdb.cpp perfm_parser.cpp perfm_monitor.cpp perfm_analyzer.cpp perfm_top.cpp perfm_hotness.cpp perfm_rapl.cpp perfm_uncore.cpp perfm_mapfile.cpp perfm_evindex.cpp perfm_builtin.cpp perfm_topology.cpp perfm_capture.cpp perfm_syscall.cpp perfm.cpp ../../msr/msr.cpp"
+LIBPFM=""
+STATIC=""
+NCURSES="-lncurses"
+
+if [ "$USE_LIBPFM" = "1" ]; then
+    SRC_FILE="$SRC_FILE perfm_pmu.cpp"
+    LIBPFM="-DPERFM_USE_LIBPFM -lpfm"
+fi
+
+if [ "$BUILTIN" = "1" ]; then
+    ./evgen_build.sh || exit 1
+
+    mkdir -p builtin
+    ./evgen -d events -o builtin $BUILTIN_CPUID || exit 1
+
+    STATIC="-DPERFM_BUILTIN -I. -Ibuiltin -static"
+
+    # a static ncurses also needs its own deps (e.g. -ltinfo -ldl on Debian)
+    NCURSES=$(pkg-config --static --libs ncurses 2>/dev/null || echo "-lncurses -ltinfo -ldl")
+fi
+
+g++ -std=c++11 -g -Wall $LIBPFM $STATIC $SRC_FILE -o $TARGET -lrt $NCURSES -pthread
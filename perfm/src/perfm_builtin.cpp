@@ -0,0 +1,60 @@
+#include "perfm_util.hpp"
+#include "perfm_mapfile.hpp"
+#include "perfm_builtin.hpp"
+
+#include <cstring>
+#include <string>
+
+#ifdef PERFM_BUILTIN
+#include "perfm_builtin_tables.hpp" /* generated by evgen */
+#endif
+
+namespace perfm {
+
+namespace builtin {
+
+const table_t *find_table(const std::string &cpuid)
+{
+#ifdef PERFM_BUILTIN
+    if (cpuid.empty()) {
+        return nullptr;
+    }
+
+    std::string model = cpuid.substr(0, cpuid.rfind('-'));
+
+    for (const auto &t : tables) {
+        if (mapfile::match(t.cpuid, cpuid) || mapfile::match(t.cpuid, model)) {
+            return &t;
+        }
+    }
+#endif
+
+    return nullptr;
+}
+
+const event_t *find_event(const table_t &t, const char *name)
+{
+    size_t lo = 0;
+    size_t hi = t.nr_event;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        int cmp = strcmp(t.event[mid].name, name);
+        if (cmp == 0) {
+            return &t.event[mid];
+        }
+
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return nullptr;
+}
+
+} /* namespace builtin */
+
+} /* namespace perfm */
@@ -0,0 +1,68 @@
+/**
+ * perfm_builtin.hpp - event tables compiled into perfm (see evgen.cpp)
+ *
+ */
+#ifndef __PERFM_BUILTIN_HPP__
+#define __PERFM_BUILTIN_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace perfm {
+
+namespace builtin {
+
+//
+// for a fixed deployment target, evgen turns the json event files of each microarchitecture
+// listed in events/mapfile.csv into a header of constexpr arrays:
+//
+//   perfm_builtin_<arch>.hpp    events sorted by name
+//   perfm_builtin_tables.hpp    one table_t per Family-model of the mapfile
+//
+// perfm built with -DPERFM_BUILTIN (perfm_build.sh BUILTIN=1) includes them, picks the table of the
+// current processor at startup and neither parses json nor reads the event database, see
+// parser::load_builtin(). a processor without a table falls back to the files, as usual.
+//
+
+struct event_t {
+    const char *name;
+    const char *desc;
+    const char *unit;
+    const char *filter;   /* box filter of an uncore event, "" if none */
+    uint8_t  type;        /* einfo::E_PMU_CORE or E_PMU_UNCORE */
+    uint8_t  nr_msr;
+    uint8_t  flags;       /* evdb::E_FLAG_* */
+    uint64_t ecode;
+    uint64_t umask;
+    uint64_t msrv;
+    uint64_t cmask;
+    uint64_t period;
+    uint64_t msri[5];
+};
+
+struct table_t {
+    const char *cpuid;    /* Family-model of the mapfile, a regular expression */
+    const char *arch;
+    const event_t  *event;
+    uint32_t nr_event;
+};
+
+/**
+ * find_table - the table of processor @cpuid (see cpu_identifier())
+ *
+ * Return:
+ *     nullptr if perfm is built without PERFM_BUILTIN, or no table matches
+ */
+const table_t *find_table(const std::string &cpuid);
+
+/**
+ * find_event - binary search the event named @name in @t
+ */
+const event_t *find_event(const table_t &t, const char *name);
+
+} /* namespace builtin */
+
+} /* namespace perfm */
+
+#endif /* __PERFM_BUILTIN_HPP__ */
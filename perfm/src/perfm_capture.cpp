@@ -0,0 +1,154 @@
+#include "perfm_util.hpp"
+#include "perfm_topology.hpp"
+#include "perfm_capture.hpp"
+
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char capture_magic[8] = { 'P', 'E', 'R', 'F', 'M', 'C', 'A', 'P' };
+
+inline uint64_t align8(uint64_t v)
+{
+    return (v + 7) & ~7ULL;
+}
+
+} /* namespace */
+
+namespace perfm {
+
+capture::ptr_t capture::alloc()
+{
+    capture *p = nullptr;
+
+    try {
+        p = new capture;
+    } catch (const std::bad_alloc &) {
+        p = nullptr;
+    }
+
+    return ptr_t(p);
+}
+
+bool capture::write(FILE *fp, const topology &topo)
+{
+    std::vector<cpu_t> cpus = topo.snapshot();
+
+    header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+
+    memcpy(hdr.magic, capture_magic, sizeof(capture_magic));
+    hdr.version = version;
+    hdr.cpu_sig = cpu_signature();
+    hdr.nr_cpu  = cpus.size();
+    hdr.tsc_freq = tsc_frequency();
+    hdr.off_cpu = align8(sizeof(header_t));
+    hdr.size    = align8(hdr.off_cpu + cpus.size() * sizeof(cpu_t));
+
+    if (::gethostname(hdr.host, sizeof(hdr.host) - 1) != 0) {
+        hdr.host[0] = '\0';
+    }
+
+    static const char zero[8] = { 0 };
+
+    size_t pad_hdr = hdr.off_cpu - sizeof(hdr);
+    size_t pad_cpu = hdr.size - hdr.off_cpu - cpus.size() * sizeof(cpu_t);
+
+    if (::fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        ::fwrite(zero, 1, pad_hdr, fp) != pad_hdr ||
+        ::fwrite(cpus.data(), sizeof(cpu_t), cpus.size(), fp) != cpus.size() ||
+        ::fwrite(zero, 1, pad_cpu, fp) != pad_cpu) {
+        perfm_warn("failed to write the capture header, %s\n", strerror(errno));
+        return false;
+    }
+
+    return ::fflush(fp) == 0;
+}
+
+bool capture::open(const std::string &filp)
+{
+    close();
+
+    int fd = ::open(filp.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1) {
+        ::close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true; /* an empty capture, no header & no text */
+    }
+
+    void *p = ::mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED) {
+        perfm_warn("failed to mmap %s, %s\n", filp.c_str(), strerror(errno));
+        return false;
+    }
+
+    _base = p;
+    _size = st.st_size;
+
+    const char *base = static_cast<const char *>(_base);
+
+    _text      = base;
+    _text_size = _size;
+
+    if (_size < sizeof(capture_magic) || memcmp(base, capture_magic, sizeof(capture_magic)) != 0) {
+        return true; /* all text */
+    }
+
+    const header_t *hdr = reinterpret_cast<const header_t *>(base);
+
+    // a v1 header is shorter, without tsc_freq
+    size_t sz_hdr = _size < offsetof(header_t, cpu_sig) ? sizeof(header_t) :
+                    hdr->version >= 2 ? sizeof(header_t) : offsetof(header_t, tsc_freq);
+
+    if (_size < sz_hdr || hdr->version < min_version || hdr->version > version || hdr->size > _size ||
+        hdr->off_cpu < sz_hdr || hdr->off_cpu > hdr->size ||
+        hdr->nr_cpu > (hdr->size - hdr->off_cpu) / sizeof(cpu_t)) {
+        perfm_warn("corrupted capture header in %s\n", filp.c_str());
+        close();
+        return false;
+    }
+
+    _hdr       = hdr;
+    _cpu       = reinterpret_cast<const cpu_t *>(base + hdr->off_cpu);
+    _text      = base + hdr->size;
+    _text_size = _size - hdr->size;
+
+    return true;
+}
+
+void capture::close()
+{
+    if (_base) {
+        ::munmap(_base, _size);
+    }
+
+    _base      = nullptr;
+    _size      = 0;
+    _hdr       = nullptr;
+    _cpu       = nullptr;
+    _text      = nullptr;
+    _text_size = 0;
+}
+
+} /* namespace perfm */
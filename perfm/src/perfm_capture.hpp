@@ -0,0 +1,138 @@
+/**
+ * perfm_capture.hpp - self-describing capture files: a binary header (topology, ...) before the samples
+ *
+ */
+#ifndef __PERFM_CAPTURE_HPP__
+#define __PERFM_CAPTURE_HPP__
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace perfm {
+
+//
+// the samples written by the monitor mean nothing without the topology of the machine they were
+// collected on (which column is which cpu, which cpus share a core, an LLC, a node ...). rather
+// than a separate topology file, which is easily lost or mixed up with the one of another host,
+// `perfm monitor -o <file>` writes a binary section at the head of the capture:
+//
+//   header_t
+//   cpu_t [nr_cpu]      the present processors, in ascending order of id
+//   text                the samples, as before
+//
+// every section is 8 bytes aligned, native endian. header_t.size is the size of the binary part,
+// i.e. where the text starts. the analyzer maps the capture once, takes the topology from the
+// header & parses the text in place.
+//
+// a capture without the header (written to stdout, or by an older perfm) is all text, the topology
+// is then read from the standalone snapshot (options::sys_snapshot_filp), a file with the same
+// layout & no text, written by every monitor run.
+//
+
+class topology;
+
+class capture {
+
+public:
+    using ptr_t = std::shared_ptr<capture>;
+
+    static constexpr uint32_t version     = 2;
+    static constexpr uint32_t min_version = 1; /* v1 has no tsc_freq */
+
+    struct header_t {
+        char     magic[8];        /* "PERFMCAP" */
+        uint32_t version;
+        uint32_t cpu_sig;         /* CPUID.1:EAX of the host */
+        uint64_t size;            /* size of the binary part, the text starts here */
+        uint32_t nr_cpu;
+        uint32_t reserved;
+        uint64_t off_cpu;
+        char     host[64];        /* hostname, NUL terminated */
+        uint64_t tsc_freq;        /* Hz, see tsc_frequency(), since v2 */
+    };
+
+    struct cpu_t {
+        int32_t cpu;
+        int32_t core;
+        int32_t socket;
+        int32_t llc;              /* -1 if unknown */
+        int32_t node;
+        int32_t online;
+    };
+
+public:
+    static ptr_t alloc();
+
+    ~capture() {
+        close();
+    }
+
+    /**
+     * write - write the binary header of topology @topo to @fp
+     *
+     * Return:
+     *     true  - succ
+     *     false - failed to write, @fp is left at an unspecified position
+     */
+    static bool write(FILE *fp, const topology &topo);
+
+    /**
+     * open - map the capture (or standalone snapshot) @filp
+     *
+     * Return:
+     *     true  - succ, with or without the binary header
+     *     false - failed to open/map it, or the header is corrupted
+     */
+    bool open(const std::string &filp);
+    void close();
+
+    /* whether the file has the binary header */
+    bool has_topology() const {
+        return _hdr != nullptr;
+    }
+
+    const header_t &header() const {
+        return *_hdr;
+    }
+
+    const cpu_t *cpu() const {
+        return _cpu;
+    }
+
+    uint32_t nr_cpu() const {
+        return _hdr ? _hdr->nr_cpu : 0;
+    }
+
+    /* the TSC frequency (Hz) of the host, 0 if unknown (no header, or an older one) */
+    uint64_t tsc_freq() const {
+        return _hdr && _hdr->version >= 2 ? _hdr->tsc_freq : 0;
+    }
+
+    /* the samples, not NUL terminated */
+    const char *text() const {
+        return _text;
+    }
+
+    size_t text_size() const {
+        return _text_size;
+    }
+
+private:
+    capture() = default;
+
+private:
+    void  *_base = nullptr;
+    size_t _size = 0;
+
+    const header_t *_hdr  = nullptr;
+    const cpu_t    *_cpu  = nullptr;
+    const char     *_text = nullptr;
+    size_t _text_size = 0;
+};
+
+} /* namespace perfm */
+
+#endif /* __PERFM_CAPTURE_HPP__ */
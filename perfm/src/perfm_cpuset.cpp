@@ -0,0 +1,194 @@
+#include "perfm_util.hpp"
+#include "perfm_cpuset.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace perfm {
+
+cpuset cpuset::parse(const std::string &list, size_t nbits)
+{
+    cpuset res(nbits);
+
+    for (const auto &s : str_split(str_trim(list), ",", 0, true)) {
+        long fr, to;
+
+        try {
+            size_t del = s.find("-");
+            fr = std::stol(s);
+            to = del == std::string::npos ? fr : std::stol(s.substr(del + 1));
+        } catch (const std::exception &) {
+            perfm_warn("invalid cpu list %s\n", list.c_str());
+            continue;
+        }
+
+        if (fr < 0 || to < fr) {
+            perfm_warn("invalid cpu list %s\n", list.c_str());
+            continue;
+        }
+
+        if (nbits && static_cast<size_t>(to) >= nbits) {
+            if (static_cast<size_t>(fr) >= nbits) {
+                perfm_warn("%s exceeds the largest id %zu, ignored\n", s.c_str(), nbits - 1);
+                continue;
+            }
+
+            perfm_warn("%s exceeds the largest id %zu, truncated\n", s.c_str(), nbits - 1);
+            to = nbits - 1;
+        }
+
+        if (static_cast<size_t>(to) >= res._nbits) {
+            res.resize(to + 1);
+        }
+
+        for (long c = fr; c <= to; ++c) {
+            res._bits[c / nr_bit_long] |= 1UL << (c % nr_bit_long);
+        }
+    }
+
+    return res;
+}
+
+std::string cpuset::str() const
+{
+    std::string res;
+
+    for (size_t fr = find_first(); fr < _nbits; ) {
+        size_t to = fr;
+        while (test(to + 1)) {
+            ++to;
+        }
+
+        if (!res.empty()) {
+            res += ",";
+        }
+
+        res += std::to_string(fr);
+        if (to != fr) {
+            res += "-" + std::to_string(to);
+        }
+
+        fr = find_next(to);
+    }
+
+    return res;
+}
+
+std::vector<int> cpuset::to_vector() const
+{
+    std::vector<int> res;
+
+    for (int c : *this) {
+        res.push_back(c);
+    }
+
+    return res;
+}
+
+void cpuset::resize(size_t nbits)
+{
+    _bits.resize((nbits + nr_bit_long - 1) / nr_bit_long, 0);
+    _nbits = nbits;
+
+    // the bits beyond @nbits in the last word must be 0 for count(), find_from() & operator==
+    if (nbits % nr_bit_long) {
+        _bits.back() &= (1UL << (nbits % nr_bit_long)) - 1;
+    }
+}
+
+void cpuset::reset()
+{
+    std::fill(_bits.begin(), _bits.end(), 0);
+}
+
+size_t cpuset::count() const
+{
+    size_t n = 0;
+
+    for (unsigned long w : _bits) {
+        n += __builtin_popcountl(w);
+    }
+
+    return n;
+}
+
+bool cpuset::none() const
+{
+    for (unsigned long w : _bits) {
+        if (w) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t cpuset::find_from(size_t pos) const
+{
+    if (pos >= _nbits) {
+        return _nbits;
+    }
+
+    size_t i = pos / nr_bit_long;
+    unsigned long w = _bits[i] & (~0UL << (pos % nr_bit_long));
+
+    while (!w) {
+        if (++i == _bits.size()) {
+            return _nbits;
+        }
+
+        w = _bits[i];
+    }
+
+    return i * nr_bit_long + __builtin_ctzl(w);
+}
+
+cpuset &cpuset::operator&=(const cpuset &s)
+{
+    for (size_t i = 0; i < _bits.size(); ++i) {
+        _bits[i] &= i < s._bits.size() ? s._bits[i] : 0;
+    }
+
+    return *this;
+}
+
+cpuset &cpuset::operator|=(const cpuset &s)
+{
+    if (s._nbits > _nbits) {
+        resize(s._nbits);
+    }
+
+    for (size_t i = 0; i < s._bits.size(); ++i) {
+        _bits[i] |= s._bits[i];
+    }
+
+    return *this;
+}
+
+cpuset &cpuset::operator-=(const cpuset &s)
+{
+    for (size_t i = 0; i < _bits.size() && i < s._bits.size(); ++i) {
+        _bits[i] &= ~s._bits[i];
+    }
+
+    return *this;
+}
+
+bool cpuset::operator==(const cpuset &s) const
+{
+    size_t n = std::max(_bits.size(), s._bits.size());
+
+    for (size_t i = 0; i < n; ++i) {
+        unsigned long a = i < _bits.size() ? _bits[i] : 0;
+        unsigned long b = i < s._bits.size() ? s._bits[i] : 0;
+
+        if (a != b) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} /* namespace perfm */
@@ -0,0 +1,190 @@
+/**
+ * perfm_cpuset.hpp - a set of processor (or socket, core, ...) ids
+ *
+ */
+#ifndef __PERFM_CPUSET_HPP__
+#define __PERFM_CPUSET_HPP__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <iterator>
+
+namespace perfm {
+
+//
+// a dynamic bitmap, bit X for id X, sized at runtime (e.g. by nr_cpu_ids()), with:
+//
+// - set-bit iteration by find_first()/find_next(), one ctz per set bit + one load per empty word,
+//   so walking the selected cpus costs O(# of selected) rather than O(largest id):
+//
+//     for (int c : cpus) { ... }
+//
+// - cpulist parsing & printing in the sysfs format, e.g. "0,18-35"
+// - set algebra (&, |, -), on sets of different sizes the missing bits are 0
+//
+// ids beyond size() are never set: test() returns false, clr() does nothing & set() grows the set.
+//
+class cpuset final {
+
+public:
+    class iterator {
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = int;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const int *;
+        using reference         = int;
+
+        iterator(const cpuset *s, size_t pos) : _s(s), _pos(pos) { }
+
+        int operator*() const {
+            return static_cast<int>(_pos);
+        }
+
+        iterator &operator++() {
+            _pos = _s->find_next(_pos);
+            return *this;
+        }
+
+        bool operator==(const iterator &it) const {
+            return _pos == it._pos;
+        }
+
+        bool operator!=(const iterator &it) const {
+            return _pos != it._pos;
+        }
+
+    private:
+        const cpuset *_s;
+        size_t _pos;
+    };
+
+public:
+    cpuset() = default;
+
+    explicit cpuset(size_t nbits) {
+        resize(nbits);
+    }
+
+    /**
+     * parse - the set of ids in the cpulist @list, e.g. "0,18-35"
+     *
+     * @nbits  the size of the returned set, 0 for just enough to hold the largest id
+     *
+     * Description:
+     *     invalid items & ids not less than a non-zero @nbits are ignored with a warning
+     */
+    static cpuset parse(const std::string &list, size_t nbits = 0);
+
+    /* the set in the cpulist format, with ranges collapsed, e.g. "0,18-35" */
+    std::string str() const;
+
+    /* the ids in ascending order */
+    std::vector<int> to_vector() const;
+
+    /* bits, not the # of set bits */
+    size_t size() const {
+        return _nbits;
+    }
+
+    /* keeps the bits below @nbits */
+    void resize(size_t nbits);
+
+    bool test(long pos) const {
+        if (pos < 0 || static_cast<size_t>(pos) >= _nbits) {
+            return false;
+        }
+
+        return !!(_bits[pos / nr_bit_long] & (1UL << (pos % nr_bit_long)));
+    }
+
+    void set(long pos) {
+        if (pos < 0) {
+            return;
+        }
+
+        if (static_cast<size_t>(pos) >= _nbits) {
+            resize(pos + 1);
+        }
+
+        _bits[pos / nr_bit_long] |= 1UL << (pos % nr_bit_long);
+    }
+
+    void clr(long pos) {
+        if (pos < 0 || static_cast<size_t>(pos) >= _nbits) {
+            return;
+        }
+
+        _bits[pos / nr_bit_long] &= ~(1UL << (pos % nr_bit_long));
+    }
+
+    /* clear all bits, the size is kept */
+    void reset();
+
+    /* # of set bits */
+    size_t count() const;
+
+    bool none() const;
+
+    /**
+     * find_first/find_next - the first set bit, or the first one after @pos
+     *
+     * Return:
+     *     the id, size() if there is none
+     */
+    size_t find_first() const {
+        return find_from(0);
+    }
+
+    size_t find_next(size_t pos) const {
+        return find_from(pos + 1);
+    }
+
+    iterator begin() const {
+        return iterator(this, find_first());
+    }
+
+    iterator end() const {
+        return iterator(this, _nbits);
+    }
+
+    cpuset &operator&=(const cpuset &s);
+    cpuset &operator|=(const cpuset &s);
+    cpuset &operator-=(const cpuset &s); /* and-not */
+
+    bool operator==(const cpuset &s) const;
+
+    bool operator!=(const cpuset &s) const {
+        return !(*this == s);
+    }
+
+private:
+    size_t find_from(size_t pos) const;
+
+private:
+    static constexpr size_t nr_bit_long = sizeof(unsigned long) << 3;
+
+    std::vector<unsigned long> _bits; /* bit X is bit (X % nr_bit_long) of _bits[X / nr_bit_long] */
+    size_t _nbits = 0;
+};
+
+inline cpuset operator&(cpuset a, const cpuset &b)
+{
+    return a &= b;
+}
+
+inline cpuset operator|(cpuset a, const cpuset &b)
+{
+    return a |= b;
+}
+
+inline cpuset operator-(cpuset a, const cpuset &b)
+{
+    return a -= b;
+}
+
+} /* namespace perfm */
+
+#endif /* __PERFM_CPUSET_HPP__ */
@@ -0,0 +1,488 @@
+#include "perfm_util.hpp"
+#include "perfm_evdb.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <new>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+namespace {
+
+const char evdb_magic[8] = { 'P', 'E', 'R', 'F', 'M', 'E', 'D', 'B' };
+
+constexpr uint64_t fnv_offset = 14695981039346656037ULL;
+constexpr uint64_t fnv_prime  = 1099511628211ULL;
+
+inline uint64_t fnv1a(const void *buf, size_t len, uint64_t h = fnv_offset)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(buf);
+
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= fnv_prime;
+    }
+
+    return h;
+}
+
+inline uint64_t fnv1a(const char *s, uint64_t h = fnv_offset)
+{
+    return fnv1a(s, strlen(s), h);
+}
+
+/* splitmix64's finalizer, spreads the displaced hash over all bits */
+inline uint64_t mix(uint64_t h, uint32_t d)
+{
+    h ^= (d + 1) * 0x9e3779b97f4a7c15ULL;
+    h  = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h  = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+
+    return h ^ (h >> 31);
+}
+
+inline size_t align8(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+} /* namespace */
+
+namespace perfm {
+
+evdb::ptr_t evdb::alloc()
+{
+    evdb *p = nullptr;
+
+    try {
+        p = new evdb;
+    } catch (const std::bad_alloc &) {
+        p = nullptr;
+    }
+
+    return ptr_t(p);
+}
+
+evdb::key_t evdb::make_key(const std::vector<std::string> &inputs)
+{
+    key_t key;
+
+    key.cpu_sig = cpu_signature();
+
+    uint64_t h = fnv_offset;
+
+    struct utsname uts;
+    if (::uname(&uts) == 0) {
+        h = fnv1a(uts.release, h);
+    }
+
+    // json files: path, size & mtime, re-hashing the contents would cost as much as parsing them
+    for (const auto &f : inputs) {
+        struct stat st;
+        memset(&st, 0, sizeof(st));
+
+        h = fnv1a(f.c_str(), h);
+
+        if (::stat(f.c_str(), &st) == 0) {
+            h = fnv1a(&st.st_size, sizeof(st.st_size), h);
+            h = fnv1a(&st.st_mtim, sizeof(st.st_mtim), h);
+        }
+    }
+
+    // PMUs: name & type
+    const std::string path("/sys/bus/event_source/devices/");
+
+    std::vector<std::string> pmus;
+
+    DIR *dirp = ::opendir(path.c_str());
+    if (dirp) {
+        struct dirent *dp = nullptr;
+        while ((dp = ::readdir(dirp)) != NULL) {
+            if (dp->d_name[0] != '.') {
+                pmus.push_back(dp->d_name);
+            }
+        }
+        ::closedir(dirp);
+    }
+
+    std::sort(pmus.begin(), pmus.end()); /* readdir(3) order is unspecified */
+
+    for (const auto &p : pmus) {
+        std::string type;
+
+        std::fstream fp(path + p + "/type", std::ios::in);
+        if (fp.good()) {
+            fp >> type;
+        }
+
+        h = fnv1a(p.c_str(), h);
+        h = fnv1a(type.c_str(), h);
+    }
+
+    key.fingerprint = h;
+
+    return key;
+}
+
+bool evdb::open(const std::string &filp, const key_t &key)
+{
+    close();
+
+    int fd = ::open(filp.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(header_t)) {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = ::mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED) {
+        perfm_warn("failed to mmap %s, %s\n", filp.c_str(), strerror(errno));
+        return false;
+    }
+
+    _base = p;
+    _size = st.st_size;
+
+    const char *base = static_cast<const char *>(_base);
+
+    _hdr    = reinterpret_cast<const header_t *>(base);
+    _pmu    = reinterpret_cast<const pmu_t *>(base + _hdr->off_pmu);
+    _format = reinterpret_cast<const format_t *>(base + _hdr->off_format);
+    _event  = reinterpret_cast<const event_t *>(base + _hdr->off_event);
+    _disp   = reinterpret_cast<const uint32_t *>(base + _hdr->off_disp);
+    _slot   = reinterpret_cast<const uint32_t *>(base + _hdr->off_slot);
+    _str    = base + _hdr->off_str;
+
+    if (!validate(key)) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void evdb::close()
+{
+    if (_base) {
+        ::munmap(_base, _size);
+    }
+
+    _base   = nullptr;
+    _size   = 0;
+    _hdr    = nullptr;
+    _pmu    = nullptr;
+    _format = nullptr;
+    _event  = nullptr;
+    _disp   = nullptr;
+    _slot   = nullptr;
+    _str    = nullptr;
+}
+
+bool evdb::validate(const key_t &key) const
+{
+    if (memcmp(_hdr->magic, evdb_magic, sizeof(evdb_magic)) != 0 || _hdr->version != version) {
+        return false;
+    }
+
+    if (_hdr->cpu_sig != key.cpu_sig || _hdr->fingerprint != key.fingerprint) {
+        return false; /* stale */
+    }
+
+    if (_hdr->size != _size) {
+        return false; /* truncated */
+    }
+
+    // every section must be 8 bytes aligned & inside the file, without overflowing the offsets
+    const struct {
+        uint64_t off;
+        uint64_t nr;
+        size_t   sz;
+    } sect[] = {
+        { _hdr->off_pmu,    _hdr->nr_pmu,    sizeof(pmu_t)    },
+        { _hdr->off_format, _hdr->nr_format, sizeof(format_t) },
+        { _hdr->off_event,  _hdr->nr_event,  sizeof(event_t)  },
+        { _hdr->off_disp,   _hdr->nr_bucket, sizeof(uint32_t) },
+        { _hdr->off_slot,   _hdr->nr_event,  sizeof(uint32_t) },
+        { _hdr->off_str,    0,               1                },
+    };
+
+    for (const auto &s : sect) {
+        if (s.off % 8 || s.off > _size || s.nr > (_size - s.off) / s.sz) {
+            return false;
+        }
+    }
+
+    if (_hdr->nr_event && !_hdr->nr_bucket) {
+        return false;
+    }
+
+    if (_size <= _hdr->off_str || static_cast<const char *>(_base)[_size - 1] != '\0') {
+        return false;
+    }
+
+    // the string table ends with a NUL, so any offset inside it is a terminated string
+    const uint64_t nr_str = _size - _hdr->off_str;
+
+    for (size_t i = 0; i < _hdr->nr_pmu; ++i) {
+        const pmu_t &p = _pmu[i];
+
+        if (p.name >= nr_str || p.format > _hdr->nr_format || p.nr_format > _hdr->nr_format - p.format) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < _hdr->nr_format; ++i) {
+        const format_t &f = _format[i];
+
+        if (f.name >= nr_str || f.config > 2 || f.lo > f.hi || f.hi > 63) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < _hdr->nr_event; ++i) {
+        const event_t &e = _event[i];
+
+        if (e.name >= nr_str || e.desc >= nr_str || e.unit >= nr_str || e.filter >= nr_str ||
+            e.nr_msr > sizeof(e.msri) / sizeof(e.msri[0])) {
+            return false;
+        }
+
+        if (_slot[i] >= _hdr->nr_event) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const evdb::event_t *evdb::find(const char *name) const
+{
+    if (!_hdr || !_hdr->nr_event || !name) {
+        return nullptr;
+    }
+
+    uint64_t h = fnv1a(name);
+    uint32_t d = _disp[h % _hdr->nr_bucket];
+    uint32_t s = _slot[mix(h, d) % _hdr->nr_event];
+
+    if (s >= _hdr->nr_event) {
+        return nullptr;
+    }
+
+    const event_t *e = &_event[s];
+
+    return strcmp(str(e->name), name) == 0 ? e : nullptr;
+}
+
+void evdb::builder::add_pmu(const std::string &name, int type)
+{
+    pmu_t p;
+
+    p.name      = intern(name);
+    p.type      = type;
+    p.format    = _format.size();
+    p.nr_format = 0;
+
+    _pmu.push_back(p);
+}
+
+void evdb::builder::add_format(const std::string &name, int config, int lo, int hi)
+{
+    if (_pmu.empty()) {
+        return;
+    }
+
+    format_t f;
+
+    f.name   = intern(name);
+    f.config = config;
+    f.lo     = lo;
+    f.hi     = hi;
+    f.pad    = 0;
+
+    _format.push_back(f);
+    ++_pmu.back().nr_format;
+}
+
+void evdb::builder::add_event(const event_t &e, const std::string &name, const std::string &desc, const std::string &unit,
+                              const std::string &filter)
+{
+    event_t r = e;
+
+    r.name = intern(name);
+    r.desc = intern(desc);
+    r.unit     = intern(unit);
+    r.filter   = intern(filter);
+    r.pad      = 0;
+    r.reserved = 0;
+
+    _event.push_back(r);
+}
+
+uint32_t evdb::builder::intern(const std::string &s)
+{
+    if (s.empty()) {
+        return 0;
+    }
+
+    uint32_t off = _str.size();
+
+    _str.append(s);
+    _str.push_back('\0');
+
+    return off;
+}
+
+bool evdb::builder::build_index(std::vector<uint32_t> &disp, std::vector<uint32_t> &slot) const
+{
+    const size_t n = _event.size();
+    const size_t b = disp.size();
+
+    if (!n) {
+        return true;
+    }
+
+    std::vector<uint64_t> hash(n);
+    std::vector<std::vector<uint32_t>> bucket(b);
+
+    for (size_t i = 0; i < n; ++i) {
+        hash[i] = fnv1a(_str.data() + _event[i].name);
+        bucket[hash[i] % b].push_back(i);
+    }
+
+    // place the largest buckets first, while most slots are still free
+    std::vector<uint32_t> order(b);
+    for (size_t i = 0; i < b; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&bucket](uint32_t x, uint32_t y) {
+        return bucket[x].size() > bucket[y].size();
+    });
+
+    const uint32_t empty = UINT32_MAX;
+    std::fill(slot.begin(), slot.end(), empty);
+
+    std::vector<size_t> taken;
+
+    for (auto bi : order) {
+        const auto &keys = bucket[bi];
+        if (keys.empty()) {
+            break;
+        }
+
+        uint32_t d = 0;
+        for (; d < (1U << 24); ++d) {
+            taken.clear();
+
+            bool ok = true;
+            for (auto k : keys) {
+                size_t s = mix(hash[k], d) % n;
+                if (slot[s] != empty || std::find(taken.begin(), taken.end(), s) != taken.end()) {
+                    ok = false;
+                    break;
+                }
+                taken.push_back(s);
+            }
+
+            if (ok) {
+                break;
+            }
+        }
+
+        if (d == (1U << 24)) {
+            return false; /* e.g. duplicate names */
+        }
+
+        disp[bi] = d;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            slot[taken[i]] = keys[i];
+        }
+    }
+
+    return true;
+}
+
+bool evdb::builder::write(const std::string &filp, const key_t &key)
+{
+    header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+
+    std::vector<uint32_t> disp(_event.size() / 4 + 1, 0); /* ~4 keys per bucket */
+    std::vector<uint32_t> slot(_event.size(), 0);
+
+    if (!build_index(disp, slot)) {
+        perfm_warn("failed to build the perfect hash for %s\n", filp.c_str());
+        return false;
+    }
+
+    memcpy(hdr.magic, evdb_magic, sizeof(evdb_magic));
+    hdr.version     = version;
+    hdr.cpu_sig     = key.cpu_sig;
+    hdr.fingerprint = key.fingerprint;
+    hdr.nr_pmu      = _pmu.size();
+    hdr.nr_format   = _format.size();
+    hdr.nr_event    = _event.size();
+    hdr.nr_bucket   = disp.size();
+
+    size_t off = align8(sizeof(hdr));
+    hdr.off_pmu    = off; off = align8(off + sizeof(pmu_t)    * _pmu.size());
+    hdr.off_format = off; off = align8(off + sizeof(format_t) * _format.size());
+    hdr.off_event  = off; off = align8(off + sizeof(event_t)  * _event.size());
+    hdr.off_disp   = off; off = align8(off + sizeof(uint32_t) * disp.size());
+    hdr.off_slot   = off; off = align8(off + sizeof(uint32_t) * slot.size());
+    hdr.off_str    = off; off = off + _str.size();
+    hdr.size       = off;
+
+    std::vector<char> buf;
+    try {
+        buf.assign(off, 0);
+    } catch (const std::bad_alloc &) {
+        perfm_warn("failed to alloc memory for %s\n", filp.c_str());
+        return false;
+    }
+
+    memcpy(&buf[0], &hdr, sizeof(hdr));
+    if (!_pmu.empty())    memcpy(&buf[hdr.off_pmu],    _pmu.data(),    sizeof(pmu_t)    * _pmu.size());
+    if (!_format.empty()) memcpy(&buf[hdr.off_format], _format.data(), sizeof(format_t) * _format.size());
+    if (!_event.empty())  memcpy(&buf[hdr.off_event],  _event.data(),  sizeof(event_t)  * _event.size());
+    if (!slot.empty())    memcpy(&buf[hdr.off_slot],   slot.data(),    sizeof(uint32_t) * slot.size());
+    memcpy(&buf[hdr.off_disp], disp.data(), sizeof(uint32_t) * disp.size());
+    memcpy(&buf[hdr.off_str],  _str.data(), _str.size());
+
+    // readers either see the old file or the complete new one
+    const std::string tmp = filp + ".tmp." + std::to_string(::getpid());
+
+    if (!save_file(tmp.c_str(), buf.data(), buf.size())) {
+        perfm_warn("failed to write %s\n", tmp.c_str());
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    if (::rename(tmp.c_str(), filp.c_str()) != 0) {
+        perfm_warn("failed to rename %s to %s\n", tmp.c_str(), filp.c_str());
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+} /* namespace perfm */
@@ -0,0 +1,223 @@
+/**
+ * perfm_evdb.hpp - precompiled event database (events, encodings & PMU formats in one mmap'able file)
+ *
+ */
+#ifndef __PERFM_EVDB_HPP__
+#define __PERFM_EVDB_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace perfm {
+
+//
+// parsing the json event tables & scanning /sys/bus/event_source/devices/*/format/ dominate the
+// startup of a short perfm run. evdb keeps the result of both in a binary file which is mmap'ed
+// read-only and queried in place, nothing is parsed or copied at startup.
+//
+// the file is only valid for the machine & inputs it was built from, so it's keyed by
+// - the CPU signature (CPUID.1:EAX, family/model/stepping)
+// - a fingerprint of the inputs: path/size/mtime of each json file, the name & type of each PMU
+//   in /sys/bus/event_source/devices/, and the kernel release
+// open() rejects a file whose key differs, the caller then rebuilds it.
+//
+// layout (native endian, every section 8 bytes aligned):
+//
+//   header_t
+//   pmu_t    [nr_pmu]      PMUs, each owns a contiguous range of format_t
+//   format_t [nr_format]   PMU formats (/sys/bus/event_source/devices/<pmu>/format/*)
+//   event_t  [nr_event]
+//   uint32_t [nr_bucket]   perfect hash: per bucket displacement
+//   uint32_t [nr_event]    perfect hash: slot -> index into event_t[]
+//   char     []            string table, NUL terminated strings, referenced by offset
+//
+// event lookup is a minimal perfect hash (hash & displace, CHD): the name's bucket gives a
+// displacement, which selects exactly one slot; the name stored in that slot is compared to reject
+// unknown names. one probe, no collisions.
+//
+
+class evdb {
+
+public:
+    using ptr_t = std::shared_ptr<evdb>;
+
+    static constexpr uint32_t version = 2; /* v2: event_t.filter */
+
+    struct key_t {
+        uint32_t cpu_sig     = 0; /* CPUID.1:EAX */
+        uint64_t fingerprint = 0; /* inputs, see above */
+    };
+
+    struct header_t {
+        char     magic[8];        /* "PERFMEDB" */
+        uint32_t version;
+        uint32_t cpu_sig;
+        uint64_t fingerprint;
+        uint64_t size;            /* size of the whole file */
+        uint32_t nr_pmu;
+        uint32_t nr_format;
+        uint32_t nr_event;
+        uint32_t nr_bucket;
+        uint64_t off_pmu;
+        uint64_t off_format;
+        uint64_t off_event;
+        uint64_t off_disp;
+        uint64_t off_slot;
+        uint64_t off_str;
+    };
+
+    struct pmu_t {
+        uint32_t name;            /* offset in the string table */
+        int32_t  type;            /* perf_event_attr.type */
+        uint32_t format;          /* first format_t of this PMU */
+        uint32_t nr_format;
+    };
+
+    struct format_t {
+        uint32_t name;
+        uint8_t  config;          /* 0: config, 1: config1, 2: config2 */
+        uint8_t  lo;              /* lowest bit (inclusive) */
+        uint8_t  hi;              /* highest bit (inclusive) */
+        uint8_t  pad;
+    };
+
+    enum {
+        E_FLAG_INV    = 1 << 0,
+        E_FLAG_ANY    = 1 << 1,
+        E_FLAG_EDGE   = 1 << 2,
+        E_FLAG_PEBS   = 1 << 3,
+        E_FLAG_EXTSEL = 1 << 4,
+    };
+
+    struct event_t {
+        uint32_t name;
+        uint32_t desc;
+        uint32_t unit;
+        uint8_t  type;            /* einfo::E_PMU_CORE or E_PMU_UNCORE */
+        uint8_t  nr_msr;
+        uint8_t  flags;           /* E_FLAG_* */
+        uint8_t  pad;
+        uint32_t filter;          /* box filter of an uncore event, see einfo_intel::_e_filter */
+        uint32_t reserved;
+        uint64_t ecode;
+        uint64_t umask;
+        uint64_t msrv;
+        uint64_t cmask;
+        uint64_t period;
+        uint64_t msri[5];
+    };
+
+public:
+    static ptr_t alloc();
+
+    /**
+     * make_key - compute the key of the current machine & inputs
+     *
+     * @inputs  the json event files the database is built from
+     */
+    static key_t make_key(const std::vector<std::string> &inputs);
+
+    ~evdb() {
+        close();
+    }
+
+    /**
+     * open - mmap @filp read-only & validate it against @key
+     *
+     * Return:
+     *     true  - ready to query
+     *     false - missing, corrupted, or built for other machine/inputs
+     */
+    bool open(const std::string &filp, const key_t &key);
+    void close();
+
+    bool is_open() const {
+        return _base != nullptr;
+    }
+
+    size_t nr_pmu() const {
+        return _hdr ? _hdr->nr_pmu : 0;
+    }
+
+    size_t nr_event() const {
+        return _hdr ? _hdr->nr_event : 0;
+    }
+
+    const pmu_t &pmu(size_t i) const {
+        return _pmu[i];
+    }
+
+    const format_t &format(const pmu_t &p, size_t i) const {
+        return _format[p.format + i];
+    }
+
+    const event_t &event(size_t i) const {
+        return _event[i];
+    }
+
+    /* the event named @name, nullptr if not found */
+    const event_t *find(const char *name) const;
+
+    const event_t *find(const std::string &name) const {
+        return find(name.c_str());
+    }
+
+    const char *str(uint32_t off) const {
+        return _str + off;
+    }
+
+public:
+    /*
+     * builder - collect PMUs, formats & events, then write them out as an evdb file
+     */
+    class builder {
+
+    public:
+        /* a new PMU, the following add_format() calls belong to it */
+        void add_pmu(const std::string &name, int type);
+        void add_format(const std::string &name, int config, int lo, int hi);
+
+        void add_event(const event_t &e, const std::string &name, const std::string &desc, const std::string &unit,
+                       const std::string &filter = "");
+
+        /**
+         * write - build the perfect hash & write the database to @filp (atomically, via rename(2))
+         */
+        bool write(const std::string &filp, const key_t &key);
+
+    private:
+        uint32_t intern(const std::string &s);
+
+        bool build_index(std::vector<uint32_t> &disp, std::vector<uint32_t> &slot) const;
+
+    private:
+        std::vector<pmu_t>    _pmu;
+        std::vector<format_t> _format;
+        std::vector<event_t>  _event;
+        std::string           _str = std::string(1, '\0'); /* offset 0 is the empty string */
+    };
+
+private:
+    evdb() = default;
+
+    /* the key, then every section, offset & index once, the queries trust the file afterwards */
+    bool validate(const key_t &key) const;
+
+private:
+    void  *_base = nullptr;
+    size_t _size = 0;
+
+    const header_t *_hdr    = nullptr;
+    const pmu_t    *_pmu    = nullptr;
+    const format_t *_format = nullptr;
+    const event_t  *_event  = nullptr;
+    const uint32_t *_disp   = nullptr;
+    const uint32_t *_slot   = nullptr;
+    const char     *_str    = nullptr;
+};
+
+} /* namespace perfm */
+
+#endif /* __PERFM_EVDB_HPP__ */
@@ -9,6 +9,7 @@
 #include <cstring>
 
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
 
@@ -63,10 +64,10 @@ bool descriptor::open(const struct perf_event_attr *hw, pid_t pid, int cpu, int
 
 bool descriptor::open()
 {
-    _fd = ::perf_event_open(&_hw, _pid, _cpu, _group_fd, _flags);
+    _fd = perf_event_open(&_hw, _pid, _cpu, _group_fd, _flags);
 
     if (_fd == -1) {
-        perfm_warn("perf_event_open() %s\n", strerror_r(errno, NULL, 0));
+        perfm_warn("perf_event_open() %s\n", strerror(errno));
     }
 
     return _fd != -1;
@@ -74,6 +75,8 @@ bool descriptor::open()
 
 bool descriptor::close()
 {
+    munmap();
+
     if (_fd == -1) {
         return true;
     }
@@ -88,26 +91,52 @@ bool descriptor::close()
     return !err;
 }
 
-struct perf_event_attr *descriptor::attr() const
+bool descriptor::mmap(size_t nr_pages)
 {
-    struct perf_event_attr *hw_copy = nullptr;
-    try {
-        hw_copy = new perf_event_attr;
-    } catch (const std::bad_alloc &) {
-        hw_copy = nullptr;
+    if (_fd == -1 || !nr_pages || (nr_pages & (nr_pages - 1))) {
+        return false;
     }
-    
-    if (hw_copy) {
-        memmove(hw_copy, &_hw, sizeof(struct perf_event_attr));
+
+    if (_page) {
+        return true;
     }
 
-    return hw_copy;
+    size_t sz = (nr_pages + 1) * ::sysconf(_SC_PAGESIZE);
+
+    void *p = ::mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (p == MAP_FAILED) {
+        perfm_warn("mmap() perf_event %d, %s\n", _fd, strerror(errno));
+        return false;
+    }
+
+    _page    = static_cast<struct perf_event_mmap_page *>(p);
+    _mmap_sz = sz;
+
+    return true;
 }
 
-void descripter::attr(const struct perf_event_attr *hw)
+bool descriptor::munmap()
+{
+    if (!_page) {
+        return true;
+    }
+
+    int err = ::munmap(_page, _mmap_sz);
+    if (!err) {
+        _page    = nullptr;
+        _mmap_sz = 0;
+    } else {
+        perfm_warn("failed to munmap perf_event %d\n", _fd);
+    }
+
+    return !err;
+}
+
+void descriptor::attr(const struct perf_event_attr *hw)
 {
     if (!hw) {
         perfm_warn("argument invalid, attr unchanged\n");
+        return;
     }
 
     memmove(&_hw, hw, sizeof(struct perf_event_attr));
@@ -126,27 +155,12 @@ event::ptr_t event::alloc()
     return ptr_t(e);
 }
 
-int event::open(const std::string &evn, pid_t pid, int cpu, int grp, unsigned long flg, unsigned long plm)
+int event::open(const std::string &evn, pid_t pid, int cpu, int grp, unsigned long flg)
 {
-    _plm = plm;
-    _nam = evn;
-
-    /* 
-     * FIXME:
-     *    remove libpfm4
-     */
-    pfm_perf_encode_arg_t arg;
-    memset(&arg, 0, sizeof(arg));
+    _raw_nam = evn;
 
     struct perf_event_attr hw;
-    memset(&hw, 0, sizeof(hw));
-
-    arg.attr = &hw;
-    arg.size = sizeof(arg);
-
-    pfm_err_t ret = pfm_get_os_event_encoding(this->name().c_str(), this->pl_mask(), PFM_OS_PERF_EVENT, &arg);
-    if (ret != PFM_SUCCESS) {
-        perfm_warn("%s %s\n", this->name().c_str(), pfm_strerror(ret));
+    if (!perfm_parser.encode(evn, &hw)) {
         return -1;
     }
 
@@ -170,7 +184,7 @@ int event::open(const std::string &evn, pid_t pid, int cpu, int grp, unsigned lo
 
     /* TODO (we need more setting) */
 
-    return open(hw, pid, cpu, grp, flg);
+    return open(&hw, pid, cpu, grp, flg) ? fd() : -1;
 }
 
 bool event::read()
@@ -185,7 +199,7 @@ bool event::read()
 
     ssize_t nr = ::read(fd(), _pmu_vals, 3 * sizeof(uint64_t));
     if (nr != 3 * sizeof(uint64_t)) {
-        perfm_warn("read pmu counters failed %s\n", strerror_r(errno, NULL, 0));
+        perfm_warn("read pmu counters failed %s\n", strerror(errno));
         err = true;
     }
 
@@ -279,7 +293,7 @@ void event::prcfg() const
            );
 
     // event's perf attr
-    struct perf_event_attr *hw = attr();
+    const struct perf_event_attr *hw = &attr();
 
     fprintf(fp, "  perf.type                    : %s\n"
                 "  perf.config                  : %zx\n"
@@ -317,8 +331,6 @@ void event::prcfg() const
                 hw->exclude_callchain_user   ? "true" : "false",
                 hw->use_clockid              ? "true" : "false"
             );
-
-    free(hw);
 }
 
 } /* namespace perfm */
@@ -85,6 +85,14 @@
 
 namespace perfm {
 
+/**
+ * perf_event_open - the perf_event_open(2) syscall, glibc has no wrapper (see perfm_syscall.cpp)
+ *
+ * Return:
+ *     the new fd, or -1 with errno set
+ */
+long perf_event_open(struct perf_event_attr *hw, pid_t pid, int cpu, int group_fd, unsigned long flags);
+
 /**
  * descriptor - the descriptor for a single perf_event
  *
@@ -103,7 +111,9 @@ public:
 public:
     static ptr_t alloc();
     
-    virtual ~descriptor() { }
+    virtual ~descriptor() {
+        munmap();
+    }
 
     bool open(const struct perf_event_attr *hw, pid_t pid, int cpu, int group_fd, unsigned long flags);
     bool open();
@@ -133,12 +143,11 @@ public:
      * attr - get the attribute struct for this perf_event instance
      *
      * Return:
-     *     return a pointer which point to the copy of @_hw
-     *
-     * Description:
-     *     the returned pointer should be freed by the caller
+     *     a reference to @_hw, valid as long as this descriptor
      */
-    struct perf_event_attr *attr() const;
+    const struct perf_event_attr &attr() const {
+        return _hw;
+    }
 
     void fd(int fd) {
         _fd = fd;
@@ -162,6 +171,30 @@ public:
 
     void attr(const struct perf_event_attr *hw);
 
+    /**
+     * mmap - map the ring buffer of this perf_event (sampling mode only)
+     *
+     * @nr_pages  # of data pages, must be a power of 2
+     *
+     * Return:
+     *     true  - succ
+     *     false - fail
+     *
+     * Description:
+     *     one extra page (the perf_event_mmap_page header) is mapped in front of the data pages,
+     *     the event must be opened before calling this func
+     */
+    bool mmap(size_t nr_pages);
+    bool munmap();
+
+    struct perf_event_mmap_page *page() const {
+        return _page;
+    }
+
+    size_t mmap_size() const {
+        return _mmap_sz;
+    }
+
     bool enable();
     bool disable();
     bool start();
@@ -200,11 +233,13 @@ private:
     struct perf_event_attr _hw;
 
     /*
-     * @_fd    file descriptor return by perf_event_open(2)
-     * @_page  TODO
+     * @_fd       file descriptor return by perf_event_open(2)
+     * @_page     the mmap'ed ring buffer (header page + 2^n data pages), only for sampling
+     * @_mmap_sz  size in bytes of @_page, including the header page
      */
     int _fd = -1;
     struct perf_event_mmap_page *_page = nullptr;
+    size_t _mmap_sz = 0;
 };
 
 /**
@@ -230,11 +265,9 @@ public:
     using descriptor::open;
 
     /** 
-     * FIXME: remove libpfm4
-     *
      * open - resolve the event string and then open the event for monitoring
      *
-     * @evn  event name string
+     * @evn  event name string, anything perfm_parser.encode() accepts
      *
      * @pid  process/thread to minitor, -1 for any process/thread
      * @cpu  processor to monitor, -1 for any processor
@@ -0,0 +1,287 @@
+#include "perfm_util.hpp"
+#include "perfm_evindex.hpp"
+
+#include <cctype>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <new>
+
+namespace {
+
+std::string to_lower(const std::string &s)
+{
+    std::string r(s);
+    for (auto &c : r) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return r;
+}
+
+inline uint32_t trigram(const char *p)
+{
+    return static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16 |
+           static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8  |
+           static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+/* add @doc to the posting list of each trigram of @text, docs are added in ascending order */
+template <typename Posting>
+void index_trigrams(Posting &post, const std::string &text, uint32_t doc)
+{
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        auto &list = post[trigram(text.data() + i)];
+        if (list.empty() || list.back() != doc) {
+            list.push_back(doc);
+        }
+    }
+}
+
+std::vector<uint32_t> intersect(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+{
+    std::vector<uint32_t> r;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(r));
+    return r;
+}
+
+std::vector<uint32_t> merge(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+{
+    std::vector<uint32_t> r;
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(r));
+    return r;
+}
+
+} /* namespace */
+
+namespace perfm {
+
+evindex::ptr_t evindex::alloc()
+{
+    evindex *x = nullptr;
+
+    try {
+        x = new evindex;
+    } catch (const std::bad_alloc &) {
+        x = nullptr;
+    }
+
+    return ptr_t(x);
+}
+
+uint32_t evindex::add(const std::string &name, const std::string &desc)
+{
+    _name.push_back(name);
+    _desc.push_back(desc);
+
+    return _name.size() - 1;
+}
+
+void evindex::build()
+{
+    const uint32_t nr_doc = _name.size();
+
+    _lname.resize(nr_doc);
+    _ldesc.resize(nr_doc);
+
+    _tri_name.clear();
+    _tri_desc.clear();
+
+    for (uint32_t d = 0; d < nr_doc; ++d) {
+        _lname[d] = to_lower(_name[d]);
+        _ldesc[d] = to_lower(_desc[d]);
+
+        index_trigrams(_tri_name, _lname[d], d);
+        index_trigrams(_tri_desc, _ldesc[d], d);
+    }
+
+    // the trie, names are inserted in sorted order so the child to follow, if any, is always the
+    // last one & the names under each node are contiguous in _sorted
+    _sorted.resize(nr_doc);
+    for (uint32_t d = 0; d < nr_doc; ++d) {
+        _sorted[d] = d;
+    }
+    std::sort(_sorted.begin(), _sorted.end(), [this](uint32_t a, uint32_t b) {
+        return _lname[a] < _lname[b];
+    });
+
+    _trie.assign(1, node_t());
+    _trie[0].hi = nr_doc;
+
+    std::vector<uint32_t> last(1, 0); /* last child of each node, during the build only */
+
+    for (uint32_t i = 0; i < nr_doc; ++i) {
+        uint32_t cur = 0;
+
+        for (char c : _lname[_sorted[i]]) {
+            uint32_t l = last[cur];
+
+            if (l && _trie[l].c == c) {
+                cur = l;
+            } else {
+                node_t n;
+                n.c  = c;
+                n.lo = i;
+
+                _trie.push_back(n);
+                last.push_back(0);
+
+                uint32_t id = _trie.size() - 1;
+                if (l) {
+                    _trie[l].sibling = id;
+                } else {
+                    _trie[cur].child = id;
+                }
+                last[cur] = id;
+
+                cur = id;
+            }
+
+            _trie[cur].hi = i + 1;
+        }
+    }
+}
+
+std::pair<uint32_t, uint32_t> evindex::prefix(const std::string &prefix) const
+{
+    if (_trie.empty()) {
+        return {0, 0};
+    }
+
+    uint32_t cur = 0;
+
+    for (char c : prefix) {
+        uint32_t n = _trie[cur].child;
+        while (n && _trie[n].c < c) {
+            n = _trie[n].sibling;
+        }
+
+        if (!n || _trie[n].c != c) {
+            return {0, 0};
+        }
+
+        cur = n;
+    }
+
+    return {_trie[cur].lo, _trie[cur].hi};
+}
+
+std::vector<uint32_t> evindex::substring(const std::string &word, bool in_desc) const
+{
+    std::vector<uint32_t> res;
+
+    if (word.size() < 3) {
+        if (in_desc) {
+            return res;
+        }
+
+        // too short for a trigram, name prefixes only
+        auto range = prefix(word);
+        res.assign(_sorted.begin() + range.first, _sorted.begin() + range.second);
+        std::sort(res.begin(), res.end());
+
+        return res;
+    }
+
+    const posting_t &post = in_desc ? _tri_desc : _tri_name;
+    const std::vector<std::string> &text = in_desc ? _ldesc : _lname;
+
+    std::vector<const std::vector<uint32_t> *> lists;
+    for (size_t i = 0; i + 3 <= word.size(); ++i) {
+        auto it = post.find(trigram(word.data() + i));
+        if (it == post.end()) {
+            return res;
+        }
+        lists.push_back(&it->second);
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+        return a->size() < b->size();
+    });
+
+    std::vector<uint32_t> cand = *lists[0];
+    for (size_t i = 1; i < lists.size() && !cand.empty(); ++i) {
+        cand = intersect(cand, *lists[i]);
+    }
+
+    // having all the trigrams does not mean having them in a row
+    for (uint32_t d : cand) {
+        if (text[d].find(word) != std::string::npos) {
+            res.push_back(d);
+        }
+    }
+
+    return res;
+}
+
+int evindex::score(uint32_t doc, const std::vector<std::string> &words) const
+{
+    const std::string &n = _lname[doc];
+    int s = 0;
+
+    for (const auto &w : words) {
+        size_t pos = n.find(w);
+
+        if (n == w) {
+            s += 1000;
+        } else if (pos == 0) {
+            s += 500;
+        } else if (pos != std::string::npos) {
+            s += 200 - static_cast<int>(std::min<size_t>(pos, 100));
+        } else {
+            s += 50; /* found in the description */
+        }
+    }
+
+    return s;
+}
+
+std::vector<evindex::match_t> evindex::search(const std::string &query, size_t limit) const
+{
+    std::vector<std::string> words = str_split(to_lower(query), " ", 0, true);
+
+    std::vector<match_t> res;
+
+    if (words.empty()) {
+        for (uint32_t d : _sorted) {
+            if (limit && res.size() == limit) {
+                break;
+            }
+            res.push_back({d, 0});
+        }
+        return res;
+    }
+
+    std::vector<uint32_t> cand;
+    for (size_t i = 0; i < words.size(); ++i) {
+        std::vector<uint32_t> hit = merge(substring(words[i], false), substring(words[i], true));
+
+        cand = i ? intersect(cand, hit) : std::move(hit);
+        if (cand.empty()) {
+            return res;
+        }
+    }
+
+    res.reserve(cand.size());
+    for (uint32_t d : cand) {
+        res.push_back({d, score(d, words)});
+    }
+
+    std::sort(res.begin(), res.end(), [this](const match_t &a, const match_t &b) {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        if (_name[a.doc].size() != _name[b.doc].size()) {
+            return _name[a.doc].size() < _name[b.doc].size();
+        }
+        return _lname[a.doc] < _lname[b.doc];
+    });
+
+    if (limit && res.size() > limit) {
+        res.resize(limit);
+    }
+
+    return res;
+}
+
+} /* namespace perfm */
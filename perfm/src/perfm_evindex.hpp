@@ -0,0 +1,115 @@
+/**
+ * perfm_evindex.hpp - in-memory search index over event names & descriptions
+ *
+ */
+#ifndef __PERFM_EVINDEX_HPP__
+#define __PERFM_EVINDEX_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+
+namespace perfm {
+
+//
+// `perfm list <query>` looks for events among the tables of all the loaded generations, tens of
+// thousands of names. a linear scan with a substring search of every name & description for every
+// query is what the index avoids:
+//
+// - prefix trie over the (lower case) names, built from the sorted names, so each node covers a
+//   contiguous range of them: a prefix query walks |query| nodes and returns the range as is
+// - trigram index over the names and, separately, the descriptions: trigram -> sorted doc ids.
+//   a substring query intersects the posting lists of its trigrams (shortest first) & verifies
+//   the few candidates left. words shorter than 3 chars have no trigram, they match name prefixes
+//   (the trie) only
+//
+// the query is split into words, a doc matches if every word is found in its name or description.
+// matches are ranked: exact name > name prefix > name substring (earlier is better) > description,
+// then shorter names first.
+//
+
+class evindex {
+
+public:
+    using ptr_t = std::shared_ptr<evindex>;
+
+    struct match_t {
+        uint32_t doc;   /* index given by add() */
+        int      score;
+    };
+
+public:
+    static ptr_t alloc();
+
+    /**
+     * add - add an event to the index
+     *
+     * Return:
+     *     the doc id of the event, ids are given in the order of add()
+     */
+    uint32_t add(const std::string &name, const std::string &desc);
+
+    /**
+     * build - build the trie & the trigram index, must be called after the last add()
+     */
+    void build();
+
+    /**
+     * search - the events matching @query, ranked
+     *
+     * @query  words separated by spaces, case insensitive
+     * @limit  max # of matches to return, 0 for all
+     */
+    std::vector<match_t> search(const std::string &query, size_t limit = 0) const;
+
+    size_t size() const {
+        return _name.size();
+    }
+
+    const std::string &name(uint32_t doc) const {
+        return _name[doc];
+    }
+
+    const std::string &desc(uint32_t doc) const {
+        return _desc[doc];
+    }
+
+private:
+    evindex() = default;
+
+    /* docs whose name starts with @prefix, as a range of _sorted */
+    std::pair<uint32_t, uint32_t> prefix(const std::string &prefix) const;
+
+    /* docs whose lower case @text contains @word, sorted by id */
+    std::vector<uint32_t> substring(const std::string &word, bool in_desc) const;
+
+    int score(uint32_t doc, const std::vector<std::string> &words) const;
+
+private:
+    struct node_t {
+        uint32_t child   = 0;  /* first child, 0 for none (the root is never a child) */
+        uint32_t sibling = 0;  /* next sibling, in ascending order of @c */
+        uint32_t lo      = 0;  /* names in [lo, hi) of _sorted go through this node */
+        uint32_t hi      = 0;
+        char     c       = 0;
+    };
+
+    using posting_t = std::unordered_map<uint32_t, std::vector<uint32_t>>;
+
+    std::vector<std::string> _name;
+    std::vector<std::string> _desc;
+    std::vector<std::string> _lname;  /* lower case name */
+    std::vector<std::string> _ldesc;  /* lower case description */
+
+    std::vector<uint32_t> _sorted;    /* doc ids, sorted by the lower case name */
+    std::vector<node_t>   _trie;      /* _trie[0] is the root */
+
+    posting_t _tri_name;
+    posting_t _tri_desc;
+};
+
+} /* namespace perfm */
+
+#endif /* __PERFM_EVINDEX_HPP__ */
@@ -30,86 +30,170 @@ group::ptr_t group::alloc()
 
 bool group::open(const std::string &list, pid_t pid, int cpu, unsigned long flags)
 {
-    const auto &argv = str_split(list, ",", options::sz_group_max()); 
+    const auto &argv = parser::split_events(list); 
     return open(argv, pid, cpu, flags);
 }
 
-bool group::open(const std::vector<std::string> &argv, pid_t pid, int cpu, unsigned long flags)
+group::tmpl_ptr_t group::encode(const std::vector<std::string> &argv)
 {
-    /*
-     * FIXME:
-     *    remove libpfm4
-     */
-    _pid   = pid;
-    _cpu   = cpu;
-    _flags = flags;
-    _grp   = 0; // just let the *first* event in this group to be the leader
-
-    for (decltype(argv.size()) i = 0; i < argv.size(); ++i) {
-        event::ptr_t e = event::alloc();
-        if (!ev) {
-            perfm_warn("failed to alloc event object\n");
-            continue;
-        }
+    std::shared_ptr<attr_template> tmpl;
 
-        pfm_perf_encode_arg_t arg;
-        memset(&arg, 0, sizeof(arg));
+    try {
+        tmpl = std::make_shared<attr_template>();
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
 
+    for (decltype(argv.size()) i = 0; i < argv.size(); ++i) {
         struct perf_event_attr hw;
-        memset(&hw, 0, sizeof(hw));
-
-        arg.attr = &hw;
-        arg.size = sizeof(arg);
-
-        pfm_err_t ret = pfm_get_os_event_encoding(argv[i].c_str(), PFM_PLM3 | PFM_PLM0, PFM_OS_PERF_EVENT, &arg);
-        if (ret != PFM_SUCCESS) {
+        if (!perfm_parser.encode(argv[i], &hw)) {
             if (perfm_options.skip_err) {
                 perfm_warn("invalid event (ignored), %s\n", argv[i].c_str());
                 continue;
             } else {
-                perfm_fatal("event encoding error, %s %s\n", argv[i].c_str(), pfm_strerror(ret));
+                perfm_fatal("event encoding error, %s\n", argv[i].c_str());
             }
         }
 
-        e->process(_pid);
-        e->cpu(_cpu);
-        e->flag(_flags);
-        e->raw_name(argv[i]);
-        e->attr(&hw);
+        bool is_leader = tmpl->attr.empty(); // just let the *first* event in this group to be the leader
 
-        _e_list.push_back(e);
+        hw.disabled = is_leader ? 1 : 0;     /* disabled = 1 for group leader, 0 for others */
+        if (perfm_options.rdfmt_timeing) {
+            hw.read_format |= RDFMT_TIMEING; /* include timing information for scaling */
+        }
+        if (perfm_options.rdfmt_evgroup && is_leader) {
+            hw.read_format |= RDFMT_EVGROUP; /* PERF_FORMAT_GROUP */
+        }
+        if (perfm_options.incl_children) {
+            hw.inherit = 1;
+        }
+
+        tmpl->name.push_back(argv[i]);
+        tmpl->attr.push_back(hw);
     }
 
-    for (size_t i = 0, n = size(); i < n; ++i) {
-        struct perf_event_attr *hw = _e_list[i]->attr();
-        if (!hw) {
-            perfm_fatal("failed to get event's attr\n");
+    if (tmpl->attr.empty()) {
+        return nullptr;
+    }
+
+    return tmpl;
+}
+
+std::vector<std::vector<std::string>> group::split(const std::vector<std::string> &argv)
+{
+    // the extra MSR values used by one group, offcore response events can use either of the two MSRs
+    struct msr_usage {
+        std::vector<uint64_t> offcore; /* at most 2 */
+        std::vector<uint64_t> ldlat;   /* at most 1 */
+        std::vector<uint64_t> frontend;/* at most 1 */
+    };
+
+    auto fit = [](std::vector<uint64_t> &used, uint64_t val, size_t max) -> bool {
+        for (auto v : used) {
+            if (v == val) {
+                return true;
+            }
         }
+        if (used.size() >= max) {
+            return false;
+        }
+        used.push_back(val);
+        return true;
+    };
 
-        hw->disabled = i == this->_grp ? 1 : 0;   /* disabled = 1 for group leader, 0 for others */
-        if (perfm_options.rdfmt_timeing) {
-            hw->read_format |= PEV_RDFMT_TIMEING; /* include timing information for scaling */
+    std::vector<std::vector<std::string>> res;
+    std::vector<msr_usage> usage;
+
+    for (const auto &evn : argv) {
+        struct perf_event_attr hw;
+        uint64_t val = 0;
+        uint32_t msr = !perfm_parser.is_uncore(evn) && perfm_parser.encode(evn, &hw) ? perfm_parser.extra_msr(hw, &val) : 0;
+
+        size_t g = 0;
+        for (; g < res.size(); ++g) {
+            if (res[g].size() >= static_cast<size_t>(options::sz_group_max())) {
+                continue;
+            }
+
+            bool ok = true;
+            switch (msr) {
+            case 0x1a6: case 0x1a7:
+                ok = fit(usage[g].offcore, val, 2);
+                break;
+            case 0x3f6:
+                ok = fit(usage[g].ldlat, val, 1);
+                break;
+            case 0x3f7:
+                ok = fit(usage[g].frontend, val, 1);
+                break;
+            }
+
+            if (ok) {
+                break;
+            }
         }
-        if (perfm_options.rdfmt_evgroup && i == this->_grp) {
-            hw->read_format |= PEV_RDFMT_EVGROUP; /* PERF_FORMAT_GROUP */
+
+        if (g == res.size()) {
+            res.push_back(std::vector<std::string>());
+            usage.push_back(msr_usage());
+
+            switch (msr) {
+            case 0x1a6: case 0x1a7: usage[g].offcore.push_back(val);  break;
+            case 0x3f6:             usage[g].ldlat.push_back(val);    break;
+            case 0x3f7:             usage[g].frontend.push_back(val); break;
+            }
         }
-        if (perfm_options.incl_children) {
-            hw->inherit = 1;
+
+        res[g].push_back(evn);
+    }
+
+    return res;
+}
+
+bool group::open(const std::vector<std::string> &argv, pid_t pid, int cpu, unsigned long flags)
+{
+    tmpl_ptr_t tmpl = encode(argv);
+    if (!tmpl) {
+        return false;
+    }
+
+    return open(tmpl, pid, cpu, flags);
+}
+
+bool group::open(const tmpl_ptr_t &tmpl, pid_t pid, int cpu, unsigned long flags)
+{
+    if (!tmpl) {
+        return false;
+    }
+
+    _tmpl  = tmpl;
+    _pid   = pid;
+    _cpu   = cpu;
+    _flags = flags;
+    _grp   = 0; // the first event in the template is the leader
+
+    bool succ = true;
+
+    for (size_t i = 0, n = tmpl->attr.size(); i < n; ++i) {
+        event::ptr_t e = event::alloc();
+        if (!e) {
+            perfm_warn("failed to alloc event object\n");
+            return false;
         }
 
-        _e_list[i]->leader(i == this->_grp ? -1 : leader()->fd());
-        _e_list[i]->attr(hw);
+        e->raw_name(tmpl->name[i]);
+
+        int group_fd = i == this->_grp ? -1 : leader()->fd();
 
-        _e_list[i]->open();
+        if (!e->open(&tmpl->attr[i], _pid, _cpu, group_fd, _flags)) {
+            perfm_warn("failed to open %s on cpu %d\n", tmpl->name[i].c_str(), _cpu);
+            succ = false;
+        }
 
-        free(hw);
+        _e_list.push_back(e);
     }
 
-    /*
-     * FIXME:
-     *    error handling
-     */
-    return true;
+    return succ;
 }
 
 bool group::close() {
@@ -186,7 +270,7 @@ void group::print() const
     // 2. column fields separated by DELIMITER
     // 3. event groups separated by an empty line
     for (decltype(_e_list.size()) i = 0; i < _e_list.size(); ++i) {
-        fprintf(fp, "%s" DELIMITER "%zu\n", _e_list[i]->name().c_str(), _e_list[i]->scale());
+        fprintf(fp, "%s" DELIMITER "%zu\n", _e_list[i]->raw_name().c_str(), _e_list[i]->scale());
     }
 
     fprintf(fp, "\n");
@@ -46,9 +46,49 @@ class group {
 public:
     using ptr_t = std::shared_ptr<group>;
 
+    /*
+     * attr_template - an event group encoded once, shared by every group opened from it
+     *
+     * @name  raw event names, as given by the user
+     * @attr  perf_event_attr of each event, ready to be opened: disabled, read_format & inherit are
+     *        already set for its position in the group, only pid/cpu/group_fd vary per instance
+     */
+    struct attr_template {
+        std::vector<std::string>            name;
+        std::vector<struct perf_event_attr> attr;
+    };
+
+    using tmpl_ptr_t = std::shared_ptr<const attr_template>;
+
 public:
     static ptr_t alloc();
 
+    /**
+     * encode - encode the event group @argv into an immutable template
+     *
+     * Return:
+     *     the template, or nullptr if no event could be encoded
+     *
+     * Description:
+     *     the template can be passed to open() for any number of (pid, cpu), e.g. once per CPU,
+     *     so each event string is resolved only once
+     */
+    static tmpl_ptr_t encode(const std::vector<std::string> &argv);
+
+    /**
+     * split - split the event group @argv into groups that can be scheduled
+     *
+     * Return:
+     *     the groups, in the order of @argv; just @argv itself if there is no conflict
+     *
+     * Description:
+     *     a core has only two offcore response MSRs, one load latency MSR and one frontend MSR
+     *     (see parser::extra_msr()). a group whose events need more distinct values than that
+     *     can never be scheduled, so such events are moved to the first group without conflict,
+     *     or to a new one. events sharing the same MSR value share the MSR.
+     */
+    static std::vector<std::vector<std::string>> split(const std::vector<std::string> &argv);
+
     virtual ~group() { }
 
 private:
@@ -83,6 +123,7 @@ public:
      */
     bool open(const std::string &list, pid_t pid, int cpu, unsigned long flags = 0UL);
     bool open(const std::vector<std::string> &argv, pid_t pid, int cpu, unsigned long flags = 0UL);
+    bool open(const tmpl_ptr_t &tmpl, pid_t pid, int cpu, unsigned long flags = 0UL);
 
     bool close();
 
@@ -148,6 +189,8 @@ private:
                                         * - events in the same group are measured simultaneously
                                         */
 
+    tmpl_ptr_t _tmpl;         /* the template this group was opened from */
+
     size_t _grp = 0;          /* group leader's subscipt in _e_list; for now it should always be 0 */
 
     int _cpu = -1;            /* which CPU to monitor, -1 for any CPU */
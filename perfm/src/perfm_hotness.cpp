@@ -0,0 +1,355 @@
+#include "perfm_util.hpp"
+#include "perfm_event.hpp"
+#include "perfm_hotness.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <new>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace {
+
+/*
+ * the body of the records we are interested in (sample_type = PERF_SAMPLE_TID, sample_id_all = 0)
+ */
+struct record_sample_t {
+    struct perf_event_header header;
+    uint32_t pid;
+    uint32_t tid;
+};
+
+struct record_comm_t {
+    struct perf_event_header header;
+    uint32_t pid;
+    uint32_t tid;
+    char comm[16];
+};
+
+/* PERF_RECORD_FORK & PERF_RECORD_EXIT */
+struct record_task_t {
+    struct perf_event_header header;
+    uint32_t pid;
+    uint32_t ppid;
+    uint32_t tid;
+    uint32_t ptid;
+    uint64_t time;
+};
+
+struct record_lost_t {
+    struct perf_event_header header;
+    uint64_t id;
+    uint64_t lost;
+};
+
+/* any of the records above, a record wrapping around the ring buffer is copied into one */
+union record_t {
+    record_sample_t sample;
+    record_comm_t   comm;
+    record_task_t   task;
+    record_lost_t   lost;
+};
+
+inline size_t slot_hash(uint32_t key, size_t mask)
+{
+    return (key * 2654435761U) & mask; /* Knuth's multiplicative hash */
+}
+
+} /* namespace */
+
+namespace perfm {
+
+hotness::ptr_t hotness::alloc()
+{
+    hotness *h = nullptr;
+
+    try {
+        h = new hotness;
+    } catch (const std::bad_alloc &) {
+        h = nullptr;
+    }
+
+    return ptr_t(h);
+}
+
+bool hotness::open(const std::vector<int> &cpus, uint64_t freq)
+{
+    struct perf_event_attr hw;
+    memset(&hw, 0, sizeof(hw));
+
+    hw.size          = sizeof(hw);
+    hw.type          = PERF_TYPE_HARDWARE;
+    hw.config        = PERF_COUNT_HW_CPU_CYCLES;
+    hw.freq          = 1;
+    hw.sample_freq   = freq ? freq : 1000;
+    hw.sample_type   = PERF_SAMPLE_TID;
+    hw.disabled      = 1;
+    hw.comm          = 1;  /* PERF_RECORD_COMM on exec(2), so we can track the process's name */
+    hw.task          = 1;  /* PERF_RECORD_EXIT, so the name of an exited process is dropped */
+    hw.wakeup_events = 0;  /* we poll the ring buffer each tick, never wakeup */
+
+    try {
+        _slots.assign(cpus.size() * _nr_slot, slot_t{0, 0});
+        _merged.assign(_nr_mslot, slot_t{0, 0});
+        _percpu.reserve(cpus.size());
+        _top_list.reserve(64);
+    } catch (const std::bad_alloc &e) {
+        perfm_fatal("failed to alloc memory, %s\n", e.what());
+    }
+
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        descriptor::ptr_t d = descriptor::alloc();
+        if (!d) {
+            perfm_warn("failed to alloc descriptor object\n");
+            continue;
+        }
+
+        if (!d->open(&hw, -1, cpus[i], -1, 0)) {
+            perfm_warn("failed to open cycles sampling on cpu %d, ignored\n", cpus[i]);
+            continue;
+        }
+
+        if (!d->mmap(_nr_page)) {
+            perfm_warn("failed to mmap ring buffer on cpu %d, ignored\n", cpus[i]);
+            d->close();
+            continue;
+        }
+
+        _percpu.push_back({cpus[i], d, &_slots[_percpu.size() * _nr_slot], 0});
+    }
+
+    return !_percpu.empty();
+}
+
+void hotness::close()
+{
+    for (auto &pc : _percpu) {
+        pc.evt->close();
+    }
+
+    _percpu.clear();
+}
+
+bool hotness::start()
+{
+    bool succ = true;
+
+    for (auto &pc : _percpu) {
+        succ = pc.evt->enable() && succ;
+    }
+
+    return succ;
+}
+
+bool hotness::stop()
+{
+    bool succ = true;
+
+    for (auto &pc : _percpu) {
+        succ = pc.evt->disable() && succ;
+    }
+
+    return succ;
+}
+
+void hotness::count(percpu_t &pc, uint32_t pid)
+{
+    const size_t mask = _nr_slot - 1;
+    const uint32_t key = pid + 1;
+
+    for (size_t i = slot_hash(key, mask), n = 0; n < _nr_slot; i = (i + 1) & mask, ++n) {
+        if (pc.tbl[i].key == key) {
+            ++pc.tbl[i].cnt;
+            return;
+        }
+
+        if (pc.tbl[i].key == 0) {
+            pc.tbl[i].key = key;
+            pc.tbl[i].cnt = 1;
+            return;
+        }
+    }
+
+    ++pc.nr_other; /* table full */
+}
+
+void hotness::drain(percpu_t &pc)
+{
+    struct perf_event_mmap_page *meta = pc.evt->page();
+    if (!meta) {
+        return;
+    }
+
+    const size_t page_sz = ::sysconf(_SC_PAGESIZE);
+    const size_t data_sz = pc.evt->mmap_size() - page_sz;
+    const char  *data    = reinterpret_cast<const char *>(meta) + page_sz;
+
+    // the kernel writes data_head, we write data_tail. an acquire after reading data_head
+    // pairs with the kernel's release, so record bodies are visible before we parse them
+    uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+
+    char buf[sizeof(record_t)];
+
+    while (tail < head) {
+        const size_t off = tail % data_sz;
+        const struct perf_event_header *hdr = reinterpret_cast<const struct perf_event_header *>(data + off);
+
+        // records may wrap around the end of the ring buffer, copy the bytes we need if so
+        size_t need = std::min<size_t>(hdr->size, sizeof(buf));
+        const char *rec = data + off;
+
+        if (off + need > data_sz) {
+            size_t part = data_sz - off;
+            memcpy(buf, data + off, part);
+            memcpy(buf + part, data, need - part);
+            rec = buf;
+            hdr = reinterpret_cast<const struct perf_event_header *>(buf);
+        }
+
+        if (!hdr->size) {
+            break; /* should never happen */
+        }
+
+        switch (hdr->type) {
+        case PERF_RECORD_SAMPLE:
+            count(pc, reinterpret_cast<const record_sample_t *>(rec)->pid);
+            break;
+
+        case PERF_RECORD_COMM: {
+                const record_comm_t *r = reinterpret_cast<const record_comm_t *>(rec);
+
+                // a thread's own name (prctl(PR_SET_NAME)) is not the process's
+                if (r->pid == r->tid) {
+                    _comm[r->pid] = comm_t{std::string(r->comm, strnlen(r->comm, sizeof(r->comm))), _nr_tick};
+                }
+            }
+            break;
+
+        case PERF_RECORD_EXIT: {
+                const record_task_t *r = reinterpret_cast<const record_task_t *>(rec);
+
+                if (r->pid == r->tid) {
+                    _comm.erase(r->pid);
+                }
+            }
+            break;
+
+        case PERF_RECORD_LOST:
+            _nr_lost += reinterpret_cast<const record_lost_t *>(rec)->lost;
+            break;
+
+        default:
+            ;
+        }
+
+        tail += hdr->size;
+    }
+
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+void hotness::merge(const percpu_t &pc)
+{
+    const size_t mask = _nr_mslot - 1;
+
+    for (size_t s = 0; s < _nr_slot; ++s) {
+        const slot_t &e = pc.tbl[s];
+        if (!e.key) {
+            continue;
+        }
+
+        size_t i = slot_hash(e.key, mask), n = 0;
+        for (; n < _nr_mslot; i = (i + 1) & mask, ++n) {
+            if (_merged[i].key == e.key || _merged[i].key == 0) {
+                break;
+            }
+        }
+
+        if (n == _nr_mslot) {
+            _merged_other += e.cnt;
+            continue;
+        }
+
+        _merged[i].key  = e.key;
+        _merged[i].cnt += e.cnt;
+    }
+
+    _merged_other += pc.nr_other;
+}
+
+const std::string &hotness::comm(pid_t pid)
+{
+    auto it = _comm.find(pid);
+    if (it != _comm.end()) {
+        it->second.tick = _nr_tick;
+        return it->second.name;
+    }
+
+    std::string nam;
+
+    if (pid == 0) {
+        nam = "[idle]";
+    } else {
+        std::fstream fp("/proc/" + std::to_string(pid) + "/comm", std::ios::in);
+        if (!fp.good() || !std::getline(fp, nam)) {
+            nam = "[exited]";
+        }
+    }
+
+    return _comm.insert({pid, comm_t{nam, _nr_tick}}).first->second.name;
+}
+
+uint64_t hotness::tick(size_t nr_top)
+{
+    ++_nr_tick;
+
+    // the processes which exited on a CPU we do not sample left no PERF_RECORD_EXIT
+    if (_nr_tick % _comm_ttl == 0) {
+        for (auto it = _comm.begin(); it != _comm.end(); ) {
+            if (it->second.tick + _comm_ttl < _nr_tick) {
+                it = _comm.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::fill(_merged.begin(), _merged.end(), slot_t{0, 0});
+    _merged_other = 0;
+
+    for (auto &pc : _percpu) {
+        drain(pc);
+        merge(pc);
+
+        std::fill(pc.tbl, pc.tbl + _nr_slot, slot_t{0, 0});
+        pc.nr_other = 0;
+    }
+
+    uint64_t total = _merged_other;
+
+    // keep the @nr_top hottest slots at the front of the merged table
+    auto first = _merged.begin();
+    auto last  = std::partition(_merged.begin(), _merged.end(), [](const slot_t &s) { return s.key != 0; });
+
+    for (auto it = first; it != last; ++it) {
+        total += it->cnt;
+    }
+
+    auto middle = first + std::min<size_t>(nr_top, last - first);
+    std::partial_sort(first, middle, last, [](const slot_t &a, const slot_t &b) { return a.cnt > b.cnt; });
+
+    _top_list.clear();
+    for (auto it = first; it != middle; ++it) {
+        pid_t pid = static_cast<pid_t>(it->key - 1);
+        _top_list.emplace_back(pid, it->cnt, comm(pid));
+    }
+
+    return total;
+}
+
+} /* namespace perfm */
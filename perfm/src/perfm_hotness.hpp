@@ -0,0 +1,139 @@
+/**
+ * perfm_hotness.hpp - per-process hotness (which process is burning the cycles), based on sampling
+ *
+ */
+#ifndef __PERFM_HOTNESS_HPP__
+#define __PERFM_HOTNESS_HPP__
+
+#include "perfm_event.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+#include <utility>
+#include <tuple>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+namespace perfm {
+
+/**
+ * hotness - sample `cycles` with PERF_SAMPLE_TID on each selected CPU & histogram them by process
+ *
+ * Description:
+ *     each CPU owns a sampling event (with a mmap'ed ring buffer) and a fixed-size, open addressing
+ *     <pid, samples> table. a CPU's ring buffer is only ever drained into this CPU's table, so the
+ *     tables have a single writer and need no lock. on each tick the per-CPU tables are merged,
+ *     the top-N processes are picked out, and all the tables are cleared for the next interval.
+ *
+ *     PERF_RECORD_COMM (attr.comm = 1) is used to track the process's name, only the records of
+ *     the main thread (pid == tid) rename it, a thread naming itself by prctl(PR_SET_NAME) does
+ *     not; if a process was started before us, it's name will be read from /proc/<pid>/comm at
+ *     the first time it is seen. PERF_RECORD_EXIT (attr.task = 1) drops the name of a process
+ *     that exited on a sampled CPU, and the names not sampled for _comm_ttl ticks are dropped as
+ *     well, so a reused pid is not shown with the name of the former process.
+ *
+ *     all memory is allocated in open(), nothing is allocated on the per-tick path (except the comm
+ *     cache, which only grows when a new process shows up).
+ */
+class hotness {
+
+public:
+    using ptr_t = std::shared_ptr<hotness>;
+
+    /* <pid, samples, comm> for one process within the last tick */
+    using entry_t = std::tuple<pid_t, uint64_t, std::string>;
+
+public:
+    static ptr_t alloc();
+
+    ~hotness() {
+        close();
+    }
+
+    /**
+     * open - open & mmap one `cycles` sampling event for each CPU in @cpus
+     *
+     * @cpus  logical processors to sample on
+     * @freq  sampling frequency (Hz) per CPU
+     *
+     * Return:
+     *     true  - at least one CPU was opened
+     *     false - failed on all the CPUs
+     */
+    bool open(const std::vector<int> &cpus, uint64_t freq = 1000);
+    void close();
+
+    bool start();
+    bool stop();
+
+    /**
+     * tick - drain all the ring buffers & rebuild the top-N process list
+     *
+     * @nr_top  how many processes to keep
+     *
+     * Return:
+     *     total # of samples seen during this tick (all CPUs)
+     */
+    uint64_t tick(size_t nr_top);
+
+    const std::vector<entry_t> &top_list() const {
+        return _top_list;
+    }
+
+    uint64_t nr_lost() const {
+        return _nr_lost;
+    }
+
+private:
+    hotness() = default;
+
+    struct slot_t {
+        uint32_t key; /* pid + 1, 0 for an empty slot */
+        uint32_t cnt; /* # of samples */
+    };
+
+    /* per-CPU sampling state, only touched by the thread which drains it */
+    struct percpu_t {
+        int cpu;
+        descriptor::ptr_t evt;
+        slot_t *tbl;          /* _nr_slot entries, open addressing with linear probing */
+        uint64_t nr_other;    /* samples which did not fit into @tbl */
+    };
+
+    void drain(percpu_t &pc);
+    void count(percpu_t &pc, uint32_t pid);
+    void merge(const percpu_t &pc);
+
+    const std::string &comm(pid_t pid);
+
+private:
+    static constexpr size_t _nr_page = 8;     /* data pages for each ring buffer (2^n) */
+    static constexpr size_t _nr_slot = 1024;  /* table size for each CPU (2^n) */
+    static constexpr size_t _nr_mslot = 8192; /* table size for the merged table (2^n) */
+
+    std::vector<percpu_t> _percpu;
+    std::vector<slot_t>   _slots;  /* backing store for all the per-CPU tables */
+    std::vector<slot_t>   _merged; /* merged table, rebuilt each tick */
+    uint64_t _merged_other = 0;
+
+    std::vector<entry_t> _top_list;
+    struct comm_t {
+        std::string name;
+        uint64_t    tick;  /* the last tick the process was sampled or renamed in */
+    };
+
+    static constexpr uint64_t _comm_ttl = 64; /* ticks */
+
+    std::unordered_map<pid_t, comm_t> _comm; /* pid => comm */
+    uint64_t _nr_tick = 0;
+
+    uint64_t _nr_lost = 0; /* # of PERF_RECORD_LOST'ed samples */
+};
+
+} /* namespace perfm */
+
+#endif /* __PERFM_HOTNESS_HPP__ */
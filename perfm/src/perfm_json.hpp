@@ -1,17 +1,386 @@
 /**
- * perfm_json.hpp - json parser interface (based on boost::property_tree)
+ * perfm_json.hpp - json parser interface (single pass, streaming, SAX style)
  *
  */
 #ifndef __PERFM_JSON_HPP__
 #define __PERFM_JSON_HPP__
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace perfm {
 
-namespace property_tree = boost::property_tree;
-namespace json          = property_tree::json_parser;
+namespace json {
+
+//
+// the json reader walks the input once and reports what it sees to a handler, no DOM is built.
+// the event description files (https://download.01.org/perfmon) are a flat array of flat objects
+// and the loader only keeps a handful of fields of each object, so a tree would be pure overhead.
+//
+// - a string (key or value) is passed as (ptr, len). if it contains no escape sequence, @ptr points
+//   into the input directly; otherwise it points to a scratch buffer holding the unescaped string.
+//   either way, it is only valid until the callback returns
+// - numbers, true, false & null are passed as value() with @str = false, verbatim
+//
+
+class handler {
+
+public:
+    virtual ~handler() { }
+
+    /* return false from any callback to stop the parsing */
+    virtual bool begin_object() { return true; }
+    virtual bool end_object()   { return true; }
+    virtual bool begin_array()  { return true; }
+    virtual bool end_array()    { return true; }
+
+    virtual bool key(const char *ptr, size_t len) = 0;
+    virtual bool value(const char *ptr, size_t len, bool str) = 0;
+};
+
+class reader {
+
+public:
+    /**
+     * parse - parse the json text [@buf, @buf + @len)
+     *
+     * Return:
+     *     true  - succ
+     *     false - syntax error, or stopped by @h, see error()
+     */
+    bool parse(const char *buf, size_t len, handler &h) {
+        _beg = _cur = buf;
+        _end = buf + len;
+        _err.clear();
+
+        skip_space();
+        if (!parse_value(h, 0)) {
+            return false;
+        }
+
+        skip_space();
+        if (_cur != _end) {
+            return fail("trailing characters");
+        }
+
+        return true;
+    }
+
+    /**
+     * parse_file - mmap @filp read-only & parse it
+     */
+    bool parse_file(const std::string &filp, handler &h) {
+        int fd = ::open(filp.c_str(), O_RDONLY);
+        if (fd == -1) {
+            _err = "failed to open " + filp;
+            return false;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) == -1 || st.st_size == 0) {
+            ::close(fd);
+            _err = "failed to stat (or empty) " + filp;
+            return false;
+        }
+
+        void *p = ::mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (p == MAP_FAILED) {
+            _err = "failed to mmap " + filp;
+            return false;
+        }
+
+        ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+        bool succ = parse(static_cast<const char *>(p), st.st_size, h);
+        if (!succ) {
+            _err = filp + ": " + _err;
+        }
+
+        ::munmap(p, st.st_size);
+
+        return succ;
+    }
+
+    const std::string &error() const {
+        return _err;
+    }
+
+private:
+    static constexpr int _max_depth = 64;
+
+    bool fail(const char *what) {
+        // report line:column of the current position
+        size_t line = 1, col = 1;
+        for (const char *p = _beg; p < _cur && p < _end; ++p) {
+            if (*p == '\n') {
+                ++line;
+                col = 1;
+            } else {
+                ++col;
+            }
+        }
+
+        _err = std::string(what) + " at line " + std::to_string(line) + ", column " + std::to_string(col);
+
+        return false;
+    }
+
+    void skip_space() {
+        while (_cur < _end && (*_cur == ' ' || *_cur == '\n' || *_cur == '\r' || *_cur == '\t')) {
+            ++_cur;
+        }
+    }
+
+    bool parse_value(handler &h, int depth) {
+        if (depth > _max_depth) {
+            return fail("nested too deep");
+        }
+
+        if (_cur == _end) {
+            return fail("unexpected end of input");
+        }
+
+        switch (*_cur) {
+        case '{':
+            return parse_object(h, depth + 1);
+
+        case '[':
+            return parse_array(h, depth + 1);
+
+        case '"': {
+                const char *ptr;
+                size_t len;
+                if (!parse_string(&ptr, &len)) {
+                    return false;
+                }
+                return h.value(ptr, len, true) || fail("stopped by handler");
+            }
+
+        default:
+            return parse_literal(h);
+        }
+    }
+
+    bool parse_object(handler &h, int depth) {
+        ++_cur; /* '{' */
+
+        if (!h.begin_object()) {
+            return fail("stopped by handler");
+        }
+
+        skip_space();
+        if (_cur < _end && *_cur == '}') {
+            ++_cur;
+            return h.end_object() || fail("stopped by handler");
+        }
+
+        while (true) {
+            skip_space();
+            if (_cur == _end || *_cur != '"') {
+                return fail("expect a string as the key");
+            }
+
+            const char *ptr;
+            size_t len;
+            if (!parse_string(&ptr, &len)) {
+                return false;
+            }
+
+            if (!h.key(ptr, len)) {
+                return fail("stopped by handler");
+            }
+
+            skip_space();
+            if (_cur == _end || *_cur != ':') {
+                return fail("expect ':'");
+            }
+            ++_cur;
+
+            skip_space();
+            if (!parse_value(h, depth)) {
+                return false;
+            }
+
+            skip_space();
+            if (_cur < _end && *_cur == ',') {
+                ++_cur;
+                continue;
+            }
+
+            if (_cur < _end && *_cur == '}') {
+                ++_cur;
+                return h.end_object() || fail("stopped by handler");
+            }
+
+            return fail("expect ',' or '}'");
+        }
+    }
+
+    bool parse_array(handler &h, int depth) {
+        ++_cur; /* '[' */
+
+        if (!h.begin_array()) {
+            return fail("stopped by handler");
+        }
+
+        skip_space();
+        if (_cur < _end && *_cur == ']') {
+            ++_cur;
+            return h.end_array() || fail("stopped by handler");
+        }
+
+        while (true) {
+            skip_space();
+            if (!parse_value(h, depth)) {
+                return false;
+            }
+
+            skip_space();
+            if (_cur < _end && *_cur == ',') {
+                ++_cur;
+                continue;
+            }
+
+            if (_cur < _end && *_cur == ']') {
+                ++_cur;
+                return h.end_array() || fail("stopped by handler");
+            }
+
+            return fail("expect ',' or ']'");
+        }
+    }
+
+    bool parse_literal(handler &h) {
+        const char *beg = _cur;
+
+        while (_cur < _end && *_cur != ',' && *_cur != '}' && *_cur != ']' &&
+               *_cur != ' ' && *_cur != '\n' && *_cur != '\r' && *_cur != '\t') {
+            ++_cur;
+        }
+
+        size_t len = _cur - beg;
+        if (!len) {
+            return fail("unexpected character");
+        }
+
+        bool valid = (len == 4 && !memcmp(beg, "true", 4))  ||
+                     (len == 5 && !memcmp(beg, "false", 5)) ||
+                     (len == 4 && !memcmp(beg, "null", 4))  ||
+                     (*beg == '-' || (*beg >= '0' && *beg <= '9'));
+        if (!valid) {
+            _cur = beg;
+            return fail("invalid literal");
+        }
+
+        return h.value(beg, len, false) || fail("stopped by handler");
+    }
+
+    bool parse_string(const char **ptr, size_t *len) {
+        const char *beg = ++_cur; /* skip '"' */
+
+        // fast path: no escape sequence, point into the input directly
+        while (_cur < _end && *_cur != '"' && *_cur != '\\') {
+            ++_cur;
+        }
+
+        if (_cur == _end) {
+            return fail("unterminated string");
+        }
+
+        if (*_cur == '"') {
+            *ptr = beg;
+            *len = _cur++ - beg;
+            return true;
+        }
+
+        // slow path: unescape into the scratch buffer
+        _str.assign(beg, _cur - beg);
+
+        while (_cur < _end && *_cur != '"') {
+            if (*_cur != '\\') {
+                _str.push_back(*_cur++);
+                continue;
+            }
+
+            if (++_cur == _end) {
+                break;
+            }
+
+            switch (*_cur++) {
+            case '"':  _str.push_back('"');  break;
+            case '\\': _str.push_back('\\'); break;
+            case '/':  _str.push_back('/');  break;
+            case 'b':  _str.push_back('\b'); break;
+            case 'f':  _str.push_back('\f'); break;
+            case 'n':  _str.push_back('\n'); break;
+            case 'r':  _str.push_back('\r'); break;
+            case 't':  _str.push_back('\t'); break;
+
+            case 'u': {
+                    if (_end - _cur < 4) {
+                        return fail("invalid \\u escape");
+                    }
+
+                    char hex[5] = { _cur[0], _cur[1], _cur[2], _cur[3], 0 };
+                    char *eptr = nullptr;
+                    unsigned long cp = std::strtoul(hex, &eptr, 16);
+                    if (eptr != hex + 4) {
+                        return fail("invalid \\u escape");
+                    }
+                    _cur += 4;
+
+                    // utf-8, surrogate pairs are not combined (never seen in the event files)
+                    if (cp < 0x80) {
+                        _str.push_back(static_cast<char>(cp));
+                    } else if (cp < 0x800) {
+                        _str.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+                        _str.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+                    } else {
+                        _str.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+                        _str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+                        _str.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+                    }
+                }
+                break;
+
+            default:
+                --_cur;
+                return fail("invalid escape sequence");
+            }
+        }
+
+        if (_cur == _end) {
+            return fail("unterminated string");
+        }
+
+        ++_cur; /* '"' */
+
+        *ptr = _str.data();
+        *len = _str.size();
+
+        return true;
+    }
+
+private:
+    const char *_beg = nullptr;
+    const char *_cur = nullptr;
+    const char *_end = nullptr;
+
+    std::string _str; /* scratch buffer for unescaped strings */
+    std::string _err;
+};
+
+} /* namespace json */
 
 } /* namespace perfm */
 
@@ -0,0 +1,126 @@
+#include "perfm_util.hpp"
+#include "perfm_mapfile.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <new>
+
+#include <regex.h>
+
+namespace perfm {
+
+mapfile::ptr_t mapfile::alloc()
+{
+    mapfile *m = nullptr;
+
+    try {
+        m = new mapfile;
+    } catch (const std::bad_alloc &) {
+        m = nullptr;
+    }
+
+    return ptr_t(m);
+}
+
+bool mapfile::load(const std::string &filp)
+{
+    _entry.clear();
+
+    std::fstream fp(filp, std::ios::in);
+    if (!fp.good()) {
+        perfm_warn("failed to open %s\n", filp.c_str());
+        return false;
+    }
+
+    std::string dir;
+    size_t slash = filp.rfind('/');
+    if (slash != std::string::npos) {
+        dir = filp.substr(0, slash + 1);
+    }
+
+    std::string line;
+    int nr_line = 0;
+
+    while (std::getline(fp, line)) {
+        ++nr_line;
+
+        line = str_trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        auto col = str_split(line, ",");
+        if (col.size() < 4) {
+            perfm_warn("%s:%d: expect at least 4 columns, ignored\n", filp.c_str(), nr_line);
+            continue;
+        }
+
+        if (col[0] == "Family-model") {
+            continue; /* the header */
+        }
+
+        entry_t e;
+        e.cpuid   = str_trim(col[0]);
+        e.version = str_trim(col[1]);
+        e.filp    = str_trim(col[2]);
+        e.type    = str_trim(col[3]);
+
+        if (e.cpuid.empty() || e.filp.empty() || e.type.empty()) {
+            perfm_warn("%s:%d: empty column, ignored\n", filp.c_str(), nr_line);
+            continue;
+        }
+
+        size_t beg = e.filp.find_first_not_of('/');
+        e.filp = dir + e.filp.substr(beg == std::string::npos ? e.filp.size() : beg);
+
+        _entry.push_back(std::move(e));
+    }
+
+    return !_entry.empty();
+}
+
+const mapfile::entry_t *mapfile::find(const std::string &cpuid, const std::string &type) const
+{
+    if (cpuid.empty()) {
+        return nullptr;
+    }
+
+    // e.g. GenuineIntel-6-4F-1 -> GenuineIntel-6-4F, most of the lines do not care about the stepping
+    std::string model = cpuid.substr(0, cpuid.rfind('-'));
+
+    for (const auto &e : _entry) {
+        if (e.type != type) {
+            continue;
+        }
+
+        if (match(e.cpuid, cpuid) || match(e.cpuid, model)) {
+            return &e;
+        }
+    }
+
+    return nullptr;
+}
+
+bool mapfile::match(const std::string &regex, const std::string &cpuid)
+{
+    regex_t re;
+
+    if (::regcomp(&re, regex.c_str(), REG_EXTENDED) != 0) {
+        perfm_warn("invalid Family-model %s in mapfile, ignored\n", regex.c_str());
+        return false;
+    }
+
+    regmatch_t m;
+    bool succ = ::regexec(&re, cpuid.c_str(), 1, &m, 0) == 0 &&
+                m.rm_so == 0 && static_cast<size_t>(m.rm_eo) == cpuid.size();
+
+    ::regfree(&re);
+
+    return succ;
+}
+
+} /* namespace perfm */
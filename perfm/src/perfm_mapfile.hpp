@@ -0,0 +1,80 @@
+/**
+ * perfm_mapfile.hpp - select the event & metric files of the current processor (mapfile.csv)
+ *
+ */
+#ifndef __PERFM_MAPFILE_HPP__
+#define __PERFM_MAPFILE_HPP__
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace perfm {
+
+//
+// the event tree keeps the files of all the supported generations, and a mapfile.csv at its root
+// tells which files belong to which processor, in the format of https://download.01.org/perfmon:
+//
+//   Family-model,Version,Filename,EventType
+//   GenuineIntel-6-4F,V10,/intel/BroadwellX_core_V10.json,core
+//   GenuineIntel-6-55-[01234],V1.28,/intel/skylakex_core_v1.28.json,core
+//
+// - Family-model is an (extended) regular expression, matched against the whole processor id
+//   <vendor>-<family>-<model>-<stepping> (see cpu_identifier()), or the id without the stepping
+// - Filename is relative to the directory of mapfile.csv, a leading '/' is ignored
+// - EventType: core, uncore, offcore (the offcore response matrix, not used by perfm) & metric,
+//   an extension of perfm for the analyzer's metric file
+// - the extra columns of the newer mapfiles (Core Type, ...) are ignored
+//
+// the first matching line of each EventType wins.
+//
+
+class mapfile {
+
+public:
+    using ptr_t = std::shared_ptr<mapfile>;
+
+    struct entry_t {
+        std::string cpuid;  /* Family-model, a regular expression */
+        std::string version;
+        std::string filp;   /* full path */
+        std::string type;   /* EventType */
+    };
+
+public:
+    static ptr_t alloc();
+
+    /**
+     * load - read the mapfile @filp
+     *
+     * Return:
+     *     true  - succ
+     *     false - failed to open it, or it has no valid line
+     */
+    bool load(const std::string &filp);
+
+    /**
+     * find - the file of @type for processor @cpuid
+     *
+     * Return:
+     *     the first matching entry, nullptr if none
+     */
+    const entry_t *find(const std::string &cpuid, const std::string &type) const;
+
+    const std::vector<entry_t> &entries() const {
+        return _entry;
+    }
+
+    /* whether the Family-model @regex matches the whole @cpuid */
+    static bool match(const std::string &regex, const std::string &cpuid);
+
+private:
+    mapfile() = default;
+
+private:
+    std::vector<entry_t> _entry;
+};
+
+} /* namespace perfm */
+
+#endif /* __PERFM_MAPFILE_HPP__ */
@@ -2,7 +2,9 @@
 #include "perfm_option.hpp"
 #include "perfm_event.hpp"
 #include "perfm_group.hpp"
+#include "perfm_rapl.hpp"
 #include "perfm_monitor.hpp"
+#include "perfm_parser.hpp"
 
 #include <cstdio>
 #include <cstdlib>
@@ -13,11 +15,11 @@
 #include <random>
 
 #include <sys/types.h>
+#include <fcntl.h>
 #include <time.h>
 #include <unistd.h>
 #include <signal.h>
 
-#include <perfmon/pfmlib_perf_event.h>
 
 namespace {
 
@@ -35,6 +37,28 @@ void sig_handler(int signo)
     }
 }
 
+/* the online cpus, @nbits wide, from a single read of the sysfs cpulist */
+perfm::cpuset online_cpus(size_t nbits)
+{
+    char buf[4096];
+
+    int fd = ::open("/sys/devices/system/cpu/online", O_RDONLY);
+    if (fd == -1) {
+        return perfm::cpuset();
+    }
+
+    ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+    ::close(fd);
+
+    if (n <= 0) {
+        return perfm::cpuset();
+    }
+
+    buf[n] = '\0';
+
+    return perfm::cpuset::parse(buf, nbits);
+}
+
 } /* namespace */
 
 namespace perfm {
@@ -65,7 +89,29 @@ monitor::~monitor()
 
 void monitor::init()
 {
-    /* for now, do nothing */
+    // split the groups which need more offcore/load latency/frontend MSRs than a core has
+    std::vector<std::string> egroups;
+
+    for (const auto &eg : perfm_options.egroups) {
+        auto sub = group::split(parser::split_events(eg));
+        if (sub.size() > 1) {
+            perfm_warn("event group %s split into %zu groups (extra MSR conflict)\n", eg.c_str(), sub.size());
+        }
+
+        for (const auto &g : sub) {
+            std::string list;
+            for (const auto &e : g) {
+                list += (list.empty() ? "" : ",") + e;
+            }
+            egroups.push_back(list);
+        }
+    }
+
+    if (egroups.size() > static_cast<size_t>(options::nr_group_max())) {
+        perfm_fatal("too many event groups after splitting, %zu > %d\n", egroups.size(), options::nr_group_max());
+    }
+
+    perfm_options.egroups = egroups;
 }
 
 void monitor::open()
@@ -74,18 +120,21 @@ void monitor::open()
     // FIXME:
     //   how to handle uncore PMU event ?
     //
-    this->_nr_usable_cpu = num_cpu_usable();
     this->_nr_select_cpu = 0;
 
-    memset(this->_cpu_list, 0, sizeof(this->_cpu_list));
+    // alloc memory for each cpu, processor's id may be discontinuous (e.g. hot removed cpus),
+    // so the per-cpu tables are indexed by id & sized by the largest possible id
+    this->_cpu_list   = cpuset(nr_cpu_ids());
+    this->_cpu_usable = cpuset(nr_cpu_ids());
+
+    for (unsigned int c = 0; c < _cpu_usable.size(); ++c) {
+        if (cpu_exist(c)) {
+            _cpu_usable.set(c);
+        }
+    }
 
-    // alloc memory for each cpu
-    //
-    // FIXME:
-    //   for now, we assume the processor's id is always less than _nr_usable_cpu
-    //   processor's id can be obtained from /proc/cpuinfo or /sys/devices/system/cpu
     try {
-        this->_cpu_data = new _pmu_dat_t[this->_nr_usable_cpu]; 
+        this->_cpu_data = new _pmu_dat_t[this->_cpu_list.size()]; 
         this->_ev_group = new _e_group_t[perfm_options.nr_group()];
     } catch (const std::bad_alloc &e) {
         perfm_fatal("failed to alloc memory, %s\n", e.what());
@@ -106,43 +155,108 @@ void monitor::open()
         perfm_fatal("perfm monitor requires root privilege to run\n");
     }
 
-    // open event groups for each selected CPUs
+    // open event groups for each selected CPUs, each group is encoded only once.
+    // the uncore events of a group are opened on each socket, & scheduled with the core events
+    _unc_data.resize(perfm_options.nr_group());
+
     for (size_t g = 0; g < perfm_options.nr_group(); ++g) {
-        _ev_group[g] = str_split(perfm_options.egroups[g], ",");
+        std::vector<std::string> unc_events;
 
-        for (unsigned int c = 0, n = 0; n < _nr_select_cpu && c < NR_MAX_PROCESSOR; ++c) {
-            if (!is_set(c)) {
-                continue;
+        for (const auto &e : parser::split_events(perfm_options.egroups[g])) {
+            if (perfm_parser.is_uncore(e)) {
+                unc_events.push_back(e);
+            } else {
+                _ev_group[g].push_back(e);
             }
-            ++n;
+        }
 
-            group::ptr_t group = group::alloc();
-            if (!group) {
-                perfm_fatal("failed to alloc group object\n");
+        if (!unc_events.empty()) {
+            _unc_data[g] = uncore::alloc();
+            if (!_unc_data[g]) {
+                perfm_fatal("failed to alloc uncore object\n");
             }
 
-            // FIXME: 
-            //   the pid & cpu argument
-            group->open(_ev_group[g], perfm_options.pid, c);
+            if (!_unc_data[g]->open(unc_events)) {
+                _unc_data[g].reset();
+            }
+        }
+
+        group::tmpl_ptr_t tmpl;
+        if (!_ev_group[g].empty()) {
+            tmpl = group::encode(_ev_group[g]);
+            if (!tmpl) {
+                perfm_fatal("failed to encode event group %s\n", perfm_options.egroups[g].c_str());
+            }
+        }
+
+        _tmpl.push_back(tmpl); /* kept to reopen the group on a cpu back online */
+    }
+
+    for (int c : _cpu_list) {
+        open_cpu(c);
+    }
+
+    // package/DRAM energy, sampled around each event group
+    if (perfm_options.power) {
+        _rapl = rapl::alloc();
+        if (!_rapl) {
+            perfm_fatal("failed to alloc rapl object\n");
+        }
 
-            _cpu_data[c].push_back(group);
+        if (!_rapl->open()) {
+            perfm_warn("RAPL is not available, --power ignored\n");
+            _rapl.reset();
         }
     }
 }
 
-void monitor::close()
+void monitor::open_cpu(int c)
 {
-    for (unsigned int c = 0, n = 0; n < _nr_select_cpu && c < NR_MAX_PROCESSOR; ++c) {
-        if (!is_set(c)) {
+    for (const auto &tmpl : _tmpl) {
+        if (!tmpl) {
+            _cpu_data[c].push_back(group::ptr_t()); /* uncore only group */
             continue;
         }
 
-        ++n;
+        group::ptr_t group = group::alloc();
+        if (!group) {
+            perfm_fatal("failed to alloc group object\n");
+        }
+
+        // FIXME: 
+        //   the pid & cpu argument
+        group->open(tmpl, perfm_options.pid, c);
+
+        _cpu_data[c].push_back(group);
+    }
+}
 
-        for (size_t g = 0; g < _cpu_data[c].size(); ++g) {
+void monitor::close_cpu(int c)
+{
+    for (size_t g = 0; g < _cpu_data[c].size(); ++g) {
+        if (_cpu_data[c][g]) {
             _cpu_data[c][g]->close();
         }
     }
+
+    _cpu_data[c].clear();
+}
+
+void monitor::close()
+{
+    for (int c : _cpu_list) {
+        close_cpu(c);
+    }
+
+    for (auto &u : _unc_data) {
+        if (u) {
+            u->close();
+        }
+    }
+
+    if (_rapl) {
+        _rapl->close();
+    }
 }
 
 void monitor::start() 
@@ -154,7 +268,7 @@ void monitor::start()
     sig.sa_handler = sig_handler;
 
     if (sigaction(SIGINT, &sig, NULL) != 0) {
-        perfm_warn("failed to install handler for SIGINT, %s\n", strerror_r(errno, NULL, 0));
+        perfm_warn("failed to install handler for SIGINT, %s\n", strerror(errno));
     }
 
     loop();
@@ -192,16 +306,23 @@ void monitor::rr(double second)
     uint64_t tsc_curr;
 
     for (size_t g = 0; g < nr_group; ++g) {
+        hotplug();
+
         tsc_curr = read_tsc();
 
+        if (_rapl) {
+            _rapl->read(); /* baseline */
+        }
+
         // start
-        for (unsigned int c = 0, n = 0; n < _nr_select_cpu && c < NR_MAX_PROCESSOR; ++c) {
-            if (!is_set(c)) {
-                continue;
-            }
-            ++n;
+        if (_unc_data[g]) {
+            _unc_data[g]->start();
+        }
 
-            _cpu_data[c][g]->start();
+        for (int c : _cpu_list) {
+            if (_cpu_data[c][g]) {
+                _cpu_data[c][g]->start();
+            }
         }
 
         nanosecond_sleep(second);
@@ -210,137 +331,216 @@ void monitor::rr(double second)
         tsc_curr = read_tsc();
 
         // stop
-        for (unsigned int c = 0, n = 0; n < _nr_select_cpu && c < NR_MAX_PROCESSOR; ++c) {
-            if (!is_set(c)) {
-                continue;
-            } 
-            ++n;
-            
-            _cpu_data[c][g]->stop();
+        for (int c : _cpu_list) {
+            if (_cpu_data[c][g]) {
+                _cpu_data[c][g]->stop();
+            }
+        }
+
+        if (_unc_data[g]) {
+            _unc_data[g]->stop();
+        }
+
+        // a cpu gone offline during the interval has nothing to read, the ones back online
+        // are reopened before the next group, so that their first interval is a full one
+        hotplug(false);
+
+        if (_rapl) {
+            _rapl->read();
         }
 
         // read
-        for (unsigned int c = 0, n = 0; n < _nr_select_cpu && c < NR_MAX_PROCESSOR; ++c) {
-            if (!is_set(c)) {
-                continue;
-            } 
-            ++n;
-            
-            _cpu_data[c][g]->read();
+        for (int c : _cpu_list) {
+            if (_cpu_data[c][g]) {
+                _cpu_data[c][g]->read();
+            }
+        }
+
+        if (!_ev_group[g].empty()) {
+            print(g, tsc_curr - tsc_prev);
+        }
+
+        if (_unc_data[g]) {
+            _unc_data[g]->read();
+            print_uncore(g, tsc_curr - tsc_prev);
+        }
+
+        if (_rapl) {
+            print_power(tsc_curr - tsc_prev);
         }
     }
 }
 
+void monitor::hotplug(bool reopen)
+{
+    cpuset online = online_cpus(_cpu_want.size());
+    if (online.none()) {
+        return; /* sysfs unreadable, keep the current set */
+    }
+
+    cpuset back = reopen ? (_cpu_want & online) - _cpu_list : cpuset();
+    cpuset gone = _cpu_list - online;
+
+    if (back.none() && gone.none()) {
+        return;
+    }
+
+    FILE *fp = perfm_options.fp_out ? perfm_options.fp_out : stdout;
+
+    // the groups of a cpu gone offline are not readable anymore, the kernel has already
+    // removed the events from the pmu, so the counts of the last interval are dropped
+    for (int c : gone) {
+        close_cpu(c);
+        _cpu_list.clr(c);
+
+        fprintf(fp, "# hotplug: cpu %d offline\n", c);
+        perfm_warn("cpu %d went offline, its columns are \"-\" until it is back\n", c);
+    }
+
+    for (int c : back) {
+        open_cpu(c);
+        _cpu_list.set(c);
+
+        fprintf(fp, "# hotplug: cpu %d online\n", c);
+        perfm_warn("cpu %d came back online, event groups reopened\n", c);
+    }
+
+    _nr_select_cpu = _cpu_list.count();
+}
+
 void monitor::print(size_t g, uint64_t tsc_cycles) const
 {
-    // 
-    // FIXME:
-    //   how to handle uncore PMU event ?
-    //
     #define delimiter " "
-    #define is_first(x) (x) == 0
 
     FILE *fp = perfm_options.fp_out ? perfm_options.fp_out : stdout;
 
+    // core events only, the uncore & power rows are printed by print_uncore() & print_power()
+    //
     // event_name, tsc_cycles, cpu0, cpu1, cpu2, cpu3, ...
     // event_name, tsc_cycles, cpu0, cpu1, cpu2, cpu3, ...
-    //
-    // event_name, tsc_cycles, sockek0, socket1, ...
-    // event_name, tsc_cycles, sockek0, socket1, ...
 
+    // a column per present cpu, in the order of id, as the analyzer walks the topology
     for (size_t e = 0, n = _ev_group[g].size(); e < n; ++e) {
-        /* FIXME */
-        
-        if (thread_level_event()) {
-            for (unsigned int c = 0; c < _nr_usable_cpu; ++c) {
-                if (is_first(c)) {
-                    fprintf(fp, "%s" delimiter "%zu", _ev_group[g][e].c_str(), tsc_cycles);
-                }
+        fprintf(fp, "%s" delimiter "%zu", _ev_group[g][e].c_str(), tsc_cycles);
 
-                if (is_set(c)) {
-                    event::ptr_t event = _cpu_data[c][g]->fetch_event(e);
-                    if (event->name() != _ev_group[g][e]) {
-                        perfm_fatal("event group must be consistent between all selected cpus\n");
-                    }
-                    fprintf(fp, delimiter "%lu", event->delta());
-                } else {
-                    fprintf(fp, delimiter "0");
+        for (int c : _cpu_usable) {
+            if (_cpu_list.test(c) && _cpu_data[c][g]) {
+                event::ptr_t event = _cpu_data[c][g]->fetch_event(e);
+                if (event->raw_name() != _ev_group[g][e]) {
+                    perfm_fatal("event group must be consistent between all selected cpus\n");
                 }
+                fprintf(fp, delimiter "%lu", event->delta());
+            } else if (_cpu_want.test(c)) {
+                fprintf(fp, delimiter "-"); /* selected, but offline */
+            } else {
+                fprintf(fp, delimiter "0");
             }
-        } else if (socket_level_event()) {
-            /* TODO */        
         }
         fprintf(fp, "\n");
     }
     fprintf(fp, "\n");
+
+    #undef delimiter
 }
 
-void monitor::parse_cpu_list(const std::string &list)
+void monitor::print_power(uint64_t tsc_cycles) const
 {
-    // if @list empty, select all online CPUs
-    if (list.empty()) {
-        for (unsigned int c = 0, n = 0; n < _nr_usable_cpu && c < NR_MAX_PROCESSOR; ++c) {
-            if (!cpu_exist(c)) {
-                continue;
-            }
+    #define delimiter " "
 
-            ++n;
+    FILE *fp = perfm_options.fp_out ? perfm_options.fp_out : stdout;
 
-            if (cpu_online(c)) {
-                ++_nr_select_cpu;
-                do_set(c);
-            }
+    // socket level rows, in the hardware energy status units, so the metric formulas
+    // written for FREERUN_*_ENERGY_STATUS (e.g. a * 61 / 1000000 for package Joules) apply as is
+    //
+    // event_name, tsc_cycles, socket0, socket1, ...
+    const char *name[rapl::RAPL_DOMAIN_MAX] = {
+        "FREERUN_PKG_ENERGY_STATUS",
+        "FREERUN_DRAM_ENERGY_STATUS",
+    };
+
+    for (int d = 0; d < rapl::RAPL_DOMAIN_MAX; ++d) {
+        if (!_rapl->available(d)) {
+            continue;
         }
 
-    // parse @list and eliminate the non-exist & off-line CPUs
-    } else {
-        std::vector<std::string> slice = str_split(list, ",");
+        fprintf(fp, "%s" delimiter "%zu", name[d], tsc_cycles);
+        for (size_t s = 0; s < _rapl->nr_socket(); ++s) {
+            fprintf(fp, delimiter "%lu", _rapl->raw(s, d));
+        }
+        fprintf(fp, "\n");
+    }
+    fprintf(fp, "\n");
 
-        for (size_t i = 0; i < slice.size(); ++i) {
-            if (slice[i].empty()) {
-                continue;
-            }
+    #undef delimiter
+}
 
-            size_t pos = slice[i].find("-");
+void monitor::print_uncore(size_t g, uint64_t tsc_cycles) const
+{
+    #define delimiter " "
 
-            if (pos == std::string::npos) {
-                int c;
-                try {
-                    c = std::stoi(slice[i]);
-                } catch (const std::exception &e) {
-                    perfm_warn("%s %s\n", e.what(), slice[i].c_str());
-                    continue;
-                }
+    FILE *fp = perfm_options.fp_out ? perfm_options.fp_out : stdout;
 
-                if (!cpu_exist(c) || !cpu_online(c)) {
-                    perfm_warn("cpu %d does not exist/online, ignored\n", c);
-                    continue;
-                }
+    // socket level rows, summed over the boxes of each socket as emon does
+    //
+    // event_name, tsc_cycles, socket0, socket1, ...
+    //
+    // with --per-box, followed by one row for each box
+    //
+    // event_name@box, tsc_cycles, socket0, socket1, ...
+    const uncore::ptr_t &u = _unc_data[g];
 
-                ++_nr_select_cpu;
-                do_set(c);
-            } else {
-                int from, to;
-                try {
-                    from = std::stoi(slice[i]);
-                    to   = std::stoi(slice[i].substr(pos + 1));
-                } catch (const std::exception &e) {
-                    perfm_warn("%s %s\n", e.what(), slice[i].c_str());
-                    continue;
-                }
+    for (size_t e = 0; e < u->nr_event(); ++e) {
+        fprintf(fp, "%s" delimiter "%zu", u->name(e).c_str(), tsc_cycles);
+        for (size_t s = 0; s < u->nr_socket(); ++s) {
+            fprintf(fp, delimiter "%lu", u->value(e, s));
+        }
+        fprintf(fp, "\n");
 
-                for (int c = from; c <= to; ++c) {
-                    if (!cpu_exist(c) || !cpu_online(c)) {
-                        perfm_warn("cpu %d does not exist/online, ignored\n", c);
-                        continue;
-                    }
+        if (!perfm_options.per_box) {
+            continue;
+        }
 
-                    ++_nr_select_cpu;
-                    do_set(c);
-                }
+        for (size_t b = 0; b < u->nr_box(e); ++b) {
+            fprintf(fp, "%s@%s" delimiter "%zu", u->name(e).c_str(), u->box_name(e, b).c_str(), tsc_cycles);
+            for (size_t s = 0; s < u->nr_socket(); ++s) {
+                fprintf(fp, delimiter "%lu", u->box_value(e, s, b));
             }
+            fprintf(fp, "\n");
         }
     }
+    fprintf(fp, "\n");
+
+    #undef delimiter
+}
+
+void monitor::parse_cpu_list(const std::string &list)
+{
+    // if @list empty, select all present CPUs
+    if (list.empty()) {
+        _cpu_want = _cpu_usable;
+
+    // parse @list and eliminate the non-exist CPUs
+    } else {
+        _cpu_want = cpuset::parse(list, _cpu_list.size());
+
+        for (int c : _cpu_want) {
+            if (!cpu_exist(c)) {
+                perfm_warn("cpu %d does not exist, ignored\n", c);
+                _cpu_want.clr(c);
+            }
+        }
+    }
+
+    // the offline ones are kept in _cpu_want, & monitored once they are back online
+    for (int c : _cpu_want) {
+        if (cpu_online(c)) {
+            _cpu_list.set(c);
+        } else if (!list.empty()) {
+            perfm_warn("cpu %d is offline, monitored once it is online\n", c);
+        }
+    }
+
+    _nr_select_cpu = _cpu_list.count();
 }
 
 } /* namespace perfm */
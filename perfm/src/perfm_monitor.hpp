@@ -10,59 +10,13 @@
 #include <cstring>
 
 #include "perfm_config.hpp"
+#include "perfm_cpuset.hpp"
 #include "perfm_group.hpp"
+#include "perfm_rapl.hpp"
+#include "perfm_uncore.hpp"
 
 namespace perfm {
 
-template<std::size_t N> class bitmap final {
-
-public:
-    bool is_set(long bit) const
-    {
-        if (bit < 0 || static_cast<size_t>(bit) >= N) {
-            return false;
-        }
-
-        return !!(_bits_array[bit / _NR_BIT_LONG] & lshift(bit));
-    }
-
-    void do_set(long bit)
-    {
-        if (bit < 0 || static_cast<size_t>(bit) >= N) {
-            return;
-        }
-
-        _bits_array[bit / _NR_BIT_LONG] |= lshift(bit);
-    }
-
-    void do_clr(long bit)
-    {
-        if (bit < 0 || static_cast<size_t>(bit) >= N) {
-            return;
-        }
-
-        _bits_array[bit / _NR_BIT_LONG] &= ~lshift(bit);
-    }
-
-public:
-    bitmap() { }
-    ~bitmap() { }
-
-    bitmap(const bitmap &) = delete;
-    bitmap(bitmap &&) = delete;
-
-private:
-    static unsigned long lshift(unsigned long v) {
-        return 1UL << (_NR_BIT_LONG - 1 - (v % _NR_BIT_LONG));
-    }
-
-private:
-    unsigned long _bits_array[(N / _NR_BIT_LONG) + 1] = { 0 };
-
-private:
-    static constexpr std::size_t _NR_BIT_LONG = sizeof(unsigned long) << 3; 
-};
-
 class monitor {
 
 public:
@@ -81,9 +35,7 @@ public:
     void stop();
 
 private:
-    monitor() {
-        memset(_cpu_list, 0, sizeof(_cpu_list));
-    }
+    monitor() = default;
 
     /*
      * rr - Round-robin scheduling
@@ -98,15 +50,25 @@ private:
 
     void parse_cpu_list(const std::string &list);
 
-    static unsigned long lshift(unsigned long v) {
-        return 1UL << (NR_BIT_PER_LONG - 1 - (v % NR_BIT_PER_LONG));
-    }
+    /*
+     * hotplug - follow the cpus going offline/online during the run
+     *
+     * @reopen: whether to reopen the groups on the cpus back online
+     *
+     * Description:
+     *     compares the online cpus against _cpu_list around each group's interval, the groups on
+     *     a cpu gone offline are closed, a selected cpu back online gets all its groups reopened.
+     *     both are marked in the output by a comment line, & the columns of the inactive cpus are
+     *     printed as "-" until they are back, so the gaps are not mistaken for zero counts.
+     */
+    void hotplug(bool reopen = true);
 
-    bool is_set(int pos) const;
-    void do_set(int pos);
-    void do_clr(int pos);
+    void open_cpu(int c);
+    void close_cpu(int c);
 
     void print(size_t group, uint64_t tsc_cycles) const;
+    void print_power(uint64_t tsc_cycles) const;
+    void print_uncore(size_t group, uint64_t tsc_cycles) const;
 
 private:
     /* a set of "event group" associated to a processor or a socket
@@ -125,42 +87,21 @@ private:
      */
     using _e_group_t = std::vector<std::string>;
 
-    unsigned long _cpu_list[NR_MAX_PROCESSOR / NR_BIT_PER_LONG];
+    cpuset _cpu_usable; /* present cpus, a column each in the core rows, sized by nr_cpu_ids() */
+    cpuset _cpu_want;   /* selected cpus, online or not, sized by nr_cpu_ids() */
+    cpuset _cpu_list;   /* the online subset of _cpu_want, the groups of which are opened */
 
-    _pmu_dat_t *_cpu_data = nullptr;
-    _pmu_dat_t *_skt_data = nullptr;
-    _e_group_t *_ev_group = nullptr;
+    _pmu_dat_t *_cpu_data = nullptr; /* nr_cpu_ids() elems, subscript is the processor's id */
+    _e_group_t *_ev_group = nullptr; /* the core events of each group */
 
-    size_t _nr_select_cpu = 0; /* # of selected cpus */
-    size_t _nr_usable_cpu = 0; /* # of presented cpus */
-};
-
-inline bool monitor::is_set(int pos) const
-{
-    if (pos < 0 || static_cast<size_t>(pos) >= NR_MAX_PROCESSOR) {
-        return false;
-    }
-
-    return !!(_cpu_list[pos / NR_BIT_PER_LONG] & lshift(pos));
-}
+    std::vector<group::tmpl_ptr_t> _tmpl; /* the encoded core events of each group, null if none */
 
-inline void monitor::do_set(int pos)
-{
-    if (pos < 0 || static_cast<size_t>(pos) >= NR_MAX_PROCESSOR) {
-        return;
-    }
+    std::vector<uncore::ptr_t> _unc_data; /* the uncore events of each group, null if none */
 
-    _cpu_list[pos / NR_BIT_PER_LONG] |= lshift(pos);
-}
+    rapl::ptr_t _rapl; /* package/DRAM energy of each socket, if --power */
 
-inline void monitor::do_clr(int pos)
-{
-    if (pos < 0 || static_cast<size_t>(pos) >= NR_MAX_PROCESSOR) {
-        return;
-    }
-
-    _cpu_list[pos / NR_BIT_PER_LONG] &= ~lshift(pos);
-}
+    size_t _nr_select_cpu = 0; /* # of selected cpus */
+};
 
 } /* namespace perfm */
 
@@ -12,6 +12,8 @@
 
 #include "perfm_util.hpp"
 #include "perfm_option.hpp"
+#include "perfm_parser.hpp"
+#include "perfm_mapfile.hpp"
 
 namespace perfm {
 
@@ -22,6 +24,7 @@ const char *perfm_switch_str[PERFM_MAX] = {
     "sample",
     "analyze",
     "top",
+    "list",
 };
 
 void usage(const char *cmd)
@@ -38,6 +41,7 @@ void usage(const char *cmd)
             "  -v, --verbose                     run perfm in verbose mode\n"
             "  -V, --version                     display version information\n"
             " --list-pmu                         list online PMUs\n"
+            " --event-dir <dir>                  event tree with a mapfile.csv, defaults to ./events\n"
             "\n"
            );
 
@@ -47,6 +51,7 @@ void usage(const char *cmd)
             "  sample                            perfm will run in sampling mode\n"
             "  analyze                           analyze the collected data\n"
             "  top                               PMU-based CPU utilization tool\n"
+            "  list                              search the events by name & description\n"
             "\n"
            );
 
@@ -56,13 +61,17 @@ void usage(const char *cmd)
             "  -t, --time <interval>             time (s) that an event set is monitored, defaults to 0.1s\n"
             "  -e, --event <event1,event2;...>   event list to be monitor\n"
             "                                    events separated by ',' within the same group\n"
-            "                                    event groups separated by ';'\n"
+            "                                    event groups separated by ';', or enclosed in '{}'\n"
+            "                                    perf syntax is accepted, e.g. {cycles,instructions}:u\n"
             "  -i, --input <input file path>     event config file for perfm, will override -e & --event\n"
             "  -o, --output <output file path>   output file\n"
             "  -c, --cpu, --processor <CPUs>     CPUs to monitor, if not provided, select all (online) CPUs\n"
             "  -p, --pid <pid>                   PID to monitor, if not provided, any process/thread\n"
             "  -m, --plm <plm string>            privilege level mask\n"
             "  --incl-children                   TODO\n"
+            "  --power                           also output the package/DRAM energy (RAPL) of each socket\n"
+            "  --per-box                         also output uncore events of each box (e.g. uncore_cbox_3),\n"
+            "                                    not only the sum of all the boxes of a socket\n"
             "\n"
            );
 
@@ -70,6 +79,8 @@ void usage(const char *cmd)
             "Commandline Options for: analyze\n"
             "  -i, --input <input file path>     input file for perfm.\n"
             "  -o, --output <output file path>   output file.\n"
+            "  -V, --view <view list>            views to compute, separated by ',', defaults to system:\n"
+            "                                    thread, core, llc (last level cache domain), node (NUMA node), socket, system\n"
             "\n"
            );
 
@@ -79,6 +90,19 @@ void usage(const char *cmd)
             "  -d, --delay <delay>               specifies the delay between screen updates, granularity: 0.01s\n"
             "  -c, --cpu-list <cpu-list>         CPUs to monitor, in the form: 1,2,3-4,5,8-16\n"
             "  -b, --batch-mode                  top in batch mode, useful for sending output from top to other programs or to a file\n"
+            "  -P, --proc <nr>                   also show the <nr> hottest processes, by sampling cycles on each CPU\n"
+            "  --sample-freq <freq>              sampling frequency (Hz) used by -P, defaults to 1000\n"
+            "  -H, --history <N>                 # of intervals kept for each CPU/socket row, defaults to 60\n"
+            "  --history-file <file path>        where to dump the history (key 'w', or on exit in batch mode)\n"
+            "  -W, --power                       also show the package/DRAM power (W) of each socket (RAPL)\n"
+            "\n"
+           );
+
+    fprintf(stderr,
+            "Commandline Options for: list [query...]\n"
+            "  -n, --max <nr>                    show at most <nr> events, the best matches first\n"
+            "  query                             words to search for in the event names & descriptions,\n"
+            "                                    e.g. 'perfm list l2 miss', list all the events if not provided\n"
             "\n"
            );
 
@@ -108,8 +132,8 @@ bool options::parse_event_file()
         } 
 
         if (event == ";") {
-            if (!group.empty()) {
-                this->egroups.push_back(group);
+            for (const auto &g : parser::split_groups(group)) {
+                this->egroups.push_back(g);
             }
             group.clear();
         } else {
@@ -137,8 +161,9 @@ void options::parse_general(int argc, char **argv)
         {"help",     no_argument, NULL, 'h'},
         {"version",  no_argument, NULL, 'V'},
         {"verbose",  no_argument, NULL, 'v'},
-        {"list-pmu", no_argument, NULL,  1 },
-        { NULL,      no_argument, NULL,  0 },
+        {"list-pmu",  no_argument,       NULL,  1 },
+        {"event-dir", required_argument, NULL,  2 },
+        { NULL,       no_argument,       NULL,  0 },
     };
 
     char ch;
@@ -161,6 +186,10 @@ void options::parse_general(int argc, char **argv)
             this->list_pmu = true;
             break;
 
+        case  2:
+            this->event_dir = optarg;
+            break;
+
         default:
             this->error = true;
             return;
@@ -188,6 +217,8 @@ void options::parse_monitor(int argc, char **argv)
         {"plm",           required_argument, NULL, 'm'},
         {"pid",           required_argument, NULL, 'p'},
         {"incl-children", no_argument,       NULL,  1 },
+        {"power",         no_argument,       NULL,  2 },
+        {"per-box",       no_argument,       NULL,  3 },
         { NULL,           no_argument,       NULL,  0 },
     };
 
@@ -211,14 +242,25 @@ void options::parse_monitor(int argc, char **argv)
             break;
 
         case 'e':
-            this->egroups = str_split(optarg, ";", options::nr_group_max());
+            // ';' separates groups, perf's braces are accepted as well: "{a,b},{c,d}" is 2 groups
+            this->egroups.clear();
+            for (const auto &grp : str_split(optarg, ";")) {
+                for (const auto &g : parser::split_groups(grp)) {
+                    this->egroups.push_back(g);
+                }
+            }
+
+            if (this->egroups.size() > static_cast<size_t>(options::nr_group_max())) {
+                perfm_warn("too many event groups, only the first %d are used\n", options::nr_group_max());
+                this->egroups.resize(options::nr_group_max());
+            }
             break;
 
         case 'i':
             this->file_in = std::move(std::string(optarg));
             this->fp_in   = ::fopen(optarg, "r");
             if (!this->fp_in) {
-                perfm_fatal("failed to open file %s, %s\n", optarg, strerror_r(errno, NULL, 0));
+                perfm_fatal("failed to open file %s, %s\n", optarg, strerror(errno));
             }
             break;
 
@@ -226,7 +268,7 @@ void options::parse_monitor(int argc, char **argv)
             this->file_out = std::move(std::string(optarg));
             this->fp_out   = ::fopen(optarg, "w");
             if (!this->fp_out) {
-                perfm_fatal("failed to open file %s, %s\n", optarg, strerror_r(errno, NULL, 0));
+                perfm_fatal("failed to open file %s, %s\n", optarg, strerror(errno));
             }
             break;
 
@@ -250,6 +292,14 @@ void options::parse_monitor(int argc, char **argv)
             this->incl_children = true;
             break;
 
+        case 2:
+            this->power = true;
+            break;
+
+        case 3:
+            this->per_box = true;
+            break;
+
         default:
             this->error = true;
             return;
@@ -278,12 +328,64 @@ void options::parse_sample(int argc, char **argv)
 
 void options::parse_analyze(int argc, char **argv)
 {
-    if (argc <= 0 || !argv) {
+    if (argc < 0 || (argc > 0 && !argv)) {
         this->error = true;
         return;
     }
 
-    perfm_fatal("TODO\n");
+    const char *opts = "i:o:V:";
+
+    const struct option longopts[] = {
+        {"input",  required_argument, NULL, 'i'},
+        {"output", required_argument, NULL, 'o'},
+        {"view",   required_argument, NULL, 'V'},
+        { NULL,    no_argument,       NULL,  0 },
+    };
+
+    char ch;
+    while ((ch = getopt_long(argc, argv, opts, longopts, NULL)) != -1) {
+        switch(ch) {
+        case 'i':
+            this->pmu_value_filp = std::move(std::string(optarg));
+            break;
+
+        case 'o':
+            this->file_out = std::move(std::string(optarg));
+            this->fp_out   = ::fopen(optarg, "w");
+            if (!this->fp_out) {
+                perfm_fatal("failed to open file %s, %s\n", optarg, strerror(errno));
+            }
+            break;
+
+        case 'V':
+            for (const auto &v : str_split(optarg, ",", 0, true)) {
+                if (v == "thread") {
+                    this->thread_view = true;
+                } else if (v == "core") {
+                    this->core_view = true;
+                } else if (v == "llc") {
+                    this->llc_view = true;
+                } else if (v == "node") {
+                    this->node_view = true;
+                } else if (v == "socket") {
+                    this->socket_view = true;
+                } else if (v == "system") {
+                    this->system_view = true;
+                } else {
+                    perfm_fatal("unknown view %s\n", v.c_str());
+                }
+            }
+            break;
+
+        default:
+            this->error = true;
+            return;
+        }
+    }
+
+    if (!this->thread_view && !this->core_view && !this->llc_view && !this->node_view && !this->socket_view) {
+        this->system_view = true;
+    }
 }
 
 void options::parse_top(int argc, char **argv)
@@ -297,7 +399,7 @@ void options::parse_top(int argc, char **argv)
         return;
     }
 
-    const char *opts= "d:n:c:b";
+    const char *opts= "d:n:c:bP:H:W";
 
     const struct option longopts[] = {
         {"delay",       required_argument, NULL, 'd'},
@@ -305,6 +407,11 @@ void options::parse_top(int argc, char **argv)
         {"cpu",         required_argument, NULL, 'c'},
         {"processor",   required_argument, NULL, 'c'},
         {"batch-mode",  no_argument,       NULL, 'b'},
+        {"proc",        required_argument, NULL, 'P'},
+        {"sample-freq", required_argument, NULL,  1 },
+        {"history",     required_argument, NULL, 'H'},
+        {"history-file",required_argument, NULL,  2 },
+        {"power",       no_argument,       NULL, 'W'},
         { NULL,         no_argument,       NULL,  0 },
     };
 
@@ -335,6 +442,39 @@ void options::parse_top(int argc, char **argv)
             this->batch_mode = true;
             break;
 
+        case 'P':
+            try {
+                this->nr_proc = std::stoul(optarg);
+            } catch (const std::exception &e) {
+                perfm_fatal("%s %s\n", e.what(), optarg);
+            }
+            this->proc_view = this->nr_proc > 0;
+            break;
+
+        case 1:
+            try {
+                this->sample_freq = std::stoull(optarg);
+            } catch (const std::exception &e) {
+                perfm_fatal("%s %s\n", e.what(), optarg);
+            }
+            break;
+
+        case 'H':
+            try {
+                this->nr_hist = std::stoul(optarg);
+            } catch (const std::exception &e) {
+                perfm_fatal("%s %s\n", e.what(), optarg);
+            }
+            break;
+
+        case 2:
+            this->hist_filp = std::move(std::string(optarg));
+            break;
+
+        case 'W':
+            this->power = true;
+            break;
+
         default:
             this->error = true;
             return;
@@ -346,6 +486,47 @@ void options::parse_top(int argc, char **argv)
     }
 }
 
+void options::parse_list(int argc, char **argv)
+{
+    //
+    // options for perfm.list is optional
+    //
+
+    if (argc < 0 || (argc > 0 && !argv)) {
+        this->error = true;
+        return;
+    }
+
+    const char *opts= "n:";
+
+    const struct option longopts[] = {
+        {"max",         required_argument, NULL, 'n'},
+        { NULL,         no_argument,       NULL,  0 },
+    };
+
+    char ch;
+    while ((ch = getopt_long(argc, argv, opts, longopts, NULL)) != -1) {
+        switch(ch) {
+        case 'n':
+            try {
+                this->list_max = std::stoul(optarg);
+            } catch (const std::exception &e) {
+                perfm_fatal("%s %s\n", e.what(), optarg);
+            }
+            break;
+
+        default:
+            this->error = true;
+            return;
+        }
+    }
+
+    // the rest are the words to search for
+    for (int i = optind; i < argc; ++i) {
+        this->list_query += this->list_query.empty() ? argv[i] : std::string(" ") + argv[i];
+    }
+}
+
 void options::parse(int argc, char **argv) 
 {
     int  perfm_switch_id = 0;  /* whether the "command switch option" was provided by the user,
@@ -369,7 +550,9 @@ void options::parse(int argc, char **argv)
         return;
     }
 
-    // step 3. parse command-line options
+    // step 3. parse command-line options, getopt restarts from the command (0 reinitializes glibc's getopt)
+    optind = 0;
+
     switch (this->perfm_switch) {
     case PERFM_MONITOR:
         parse_monitor(argc - perfm_switch_id, argv + perfm_switch_id);
@@ -387,6 +570,10 @@ void options::parse(int argc, char **argv)
         parse_top(argc - perfm_switch_id, argv + perfm_switch_id);
         break;
 
+    case PERFM_LIST:
+        parse_list(argc - perfm_switch_id, argv + perfm_switch_id);
+        break;
+
     case PERFM_MAX:
         break;
 
@@ -395,6 +582,49 @@ void options::parse(int argc, char **argv)
     }
 }
 
+void options::select_event_files()
+{
+    const std::string cpuid = cpu_identifier();
+
+    if (this->event_db_filp.empty()) {
+        this->event_db_filp = "__perfm_event_db." + (cpuid.empty() ? std::string("unknown") : cpuid) + ".bin";
+    }
+
+    bool need_event  = this->event_core_filp.empty() && this->event_uncore_filp.empty();
+    bool need_metric = this->metric_xml_filp.empty();
+
+    if (!need_event && !need_metric) {
+        return;
+    }
+
+    const std::string filp = this->event_dir + "/mapfile.csv";
+
+    mapfile::ptr_t map = mapfile::alloc();
+    if (map && map->load(filp)) {
+        const mapfile::entry_t *core   = map->find(cpuid, "core");
+        const mapfile::entry_t *uncore = map->find(cpuid, "uncore");
+        const mapfile::entry_t *metric = map->find(cpuid, "metric");
+
+        if (need_event) {
+            this->event_core_filp   = core   ? core->filp   : "";
+            this->event_uncore_filp = uncore ? uncore->filp : "";
+        }
+
+        if (need_metric && metric) {
+            this->metric_xml_filp = metric->filp;
+        }
+    }
+
+    if (need_event && this->event_core_filp.empty() && this->event_uncore_filp.empty()) {
+        perfm_warn("no event file for processor %s in %s, only perf style events are available\n",
+                   cpuid.c_str(), filp.c_str());
+    }
+
+    if (this->metric_xml_filp.empty()) {
+        this->metric_xml_filp = "perfm_metric.xml";
+    }
+}
+
 void options::print() const
 {
     FILE *fp = stdout;
@@ -413,11 +643,13 @@ void options::print() const
             fprintf(fp, "- output result file                    : %s\n",      this->fp_out ? this->file_out.c_str() : "stdout");
             fprintf(fp, "- privilege level mask                  : %s\n",      this->plm.c_str());
             fprintf(fp, "- # of event groups to monitor          : %lu\n",     this->nr_group());
+            fprintf(fp, "- package/DRAM energy (RAPL)            : %s\n",      this->power ? "yes" : "no");
+            fprintf(fp, "- uncore events of each box             : %s\n",      this->per_box ? "yes" : "no");
             fprintf(fp, "-------------------------------------------------------\n");
 
             int i = 0;
             for (const auto &grp : egroups) {
-                auto ev_list = str_split(grp, ",", options::sz_group_max()); 
+                auto ev_list = parser::split_events(grp); 
                 
                 fprintf(fp, "- Event Group #%d (%lu events)\n", i++, ev_list.size());
                 for (const auto &ev : ev_list) {
@@ -441,6 +673,16 @@ void options::print() const
             break;
         }
 
+        case PERFM_ANALYZE: {
+            fprintf(fp, "-------------------------------------------------------\n");
+            fprintf(fp, "- perfm will run in mode: %-24s    -\n", perfm_switch_str[rmod]);
+            fprintf(fp, "-------------------------------------------------------\n");
+            fprintf(fp, "- capture to analyze                    : %s\n",      this->pmu_value_filp.c_str());
+            fprintf(fp, "- metric file                           : %s\n",      this->metric_xml_filp.empty() ? "auto" : this->metric_xml_filp.c_str());
+            fprintf(fp, "-------------------------------------------------------\n");
+            break;
+        }
+
         case PERFM_TOP: {
             fprintf(fp, "-------------------------------------------------------\n");
             fprintf(fp, "- perfm will run in mode: %-24s    -\n", perfm_switch_str[rmod]);
@@ -448,6 +690,9 @@ void options::print() const
             break;                
         }
 
+        case PERFM_LIST:
+            break;
+
         case PERFM_MAX:
             break;
         
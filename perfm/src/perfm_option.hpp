@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 #include <sys/types.h>
 
@@ -15,6 +16,7 @@ typedef enum {
     PERFM_SAMPLE,
     PERFM_ANALYZE,
     PERFM_TOP,
+    PERFM_LIST,
     PERFM_MAX
 } perfm_switch_t;
 
@@ -44,6 +46,15 @@ public:
     void parse(int argc, char **argv);
     void print() const;
 
+    /**
+     * select_event_files - pick the event & metric files of this processor from <event_dir>/mapfile.csv
+     *
+     * Description:
+     *     files given explicitly are kept. if no event file matches, only the perf style
+     *     events (e.g. cycles, cpu/event=0x3c/) can be encoded
+     */
+    void select_event_files();
+
     size_t nr_group() const {
         return this->egroups.size();
     }
@@ -64,6 +75,7 @@ private:
     void parse_sample(int argc, char **argv);
     void parse_analyze(int argc, char **argv);
     void parse_top(int argc, char **argv);
+    void parse_list(int argc, char **argv);
 
 public:
     //
@@ -98,6 +110,18 @@ public:
 
     std::string cpu_list;        /* if empty, select all CPUs */
 
+    bool power = false;          /* also read the package/DRAM energy counters (RAPL) of each socket */
+
+    /* event tables used to encode the event names & their precompiled database, see perfm_evdb.hpp
+     *
+     * if empty, they are selected by the processor id from <event_dir>/mapfile.csv,
+     * see perfm_mapfile.hpp, and the database is named after the processor id
+     */
+    std::string event_dir         = "events";
+    std::string event_core_filp;
+    std::string event_uncore_filp;
+    std::string event_db_filp;
+
     std::string file_in;
     std::string file_out;
 
@@ -112,8 +136,9 @@ public:
 
     double interval = 1;         /* time (s) that an event group is monitored */
     int loops = 1;               /* the number of times each event group is monitored */
-    pid_t pid;                   /* process/thread id to be monitored */
+    pid_t pid = -1;              /* process/thread id to be monitored, -1 for all */
     std::string plm = "ukh";     /* privilege level mask */
+    bool per_box = false;        /* output uncore events of each box besides the per socket sum */
 
     //
     // options for perfm.sample
@@ -122,11 +147,13 @@ public:
     //
     // options for perfm.analyze
     // 
-    std::string metric_xml_filp = "perfm_metric.xml";
+    std::string metric_xml_filp; /* if empty, selected from the mapfile, or perfm_metric.xml */
     std::string pmu_value_filp  = "perfm.txt";
 
     bool thread_view;
     bool core_view;
+    bool llc_view;               /* per last level cache domain */
+    bool node_view;              /* per NUMA node */
     bool socket_view;
     bool system_view;
 
@@ -136,6 +163,17 @@ public:
     double delay = 1.0;          /* default to 1 second */
     int iter = -1;               /* -1 for inf iters */
     bool batch_mode = false;     /* default to interactive mode */
+    bool proc_view  = false;     /* show the per-process hotness (sampling based) */
+    uint64_t sample_freq = 1000; /* sampling frequency (Hz) for the per-process hotness */
+    size_t nr_proc  = 10;        /* # of the hottest processes to show */
+    size_t nr_hist  = 60;        /* # of intervals kept in the history of each CPU/socket row */
+    std::string hist_filp = "__perfm_top_history.txt"; /* where to dump the history ('w' key or batch mode exit) */
+
+    //
+    // options for perfm.list
+    //
+    std::string list_query;      /* words to search for, empty to list all the events */
+    size_t list_max = 0;         /* max # of events to show, 0 for all */
 
     std::vector<std::string> egroups; /* event group list 
                                        * - events separated by "," within the same group
@@ -145,7 +183,8 @@ public:
                                        * - elems in egroups are in the form: "event1,event2,..."
                                        */
 
-    const std::string sys_topology_filp = "__perfm_sys_topology_file.txt";
+    const std::string sys_topology_filp = "__perfm_sys_topology_file.txt"; /* human readable */
+    const std::string sys_snapshot_filp = "__perfm_sys_topology.bin";      /* see perfm_capture.hpp */
 };
 
 extern options perfm_options; /* the global configure options for perfm */
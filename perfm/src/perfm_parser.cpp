@@ -2,6 +2,7 @@
 #include "perfm_json.hpp"
 #include "perfm_parser.hpp"
 #include "perfm_util.hpp"
+#include "perfm_evindex.hpp"
 
 #ifndef NOT_USE_GLOB
 #include <glob.h>
@@ -15,6 +16,9 @@
 #include <cstring>
 #include <fstream>
 #include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <cctype>
 
 // 
 // #include <> /* only search the std include path */ 
@@ -22,6 +26,10 @@
 // 
 #include "linux/perf_event.h"
 
+#ifdef PERFM_USE_LIBPFM
+#include <perfmon/pfmlib_perf_event.h>
+#endif
+
 namespace {
 
 /* 
@@ -40,6 +48,267 @@ const char *pmu_type_list[EVENT_SOURCE_MAX + 1] = {
     "pmu_unknown"
 };
 
+/* 
+ * fill einfo_intel objects from intel's event description file, which is an array of flat objects:
+ * [ { "EventCode": "0x3C", "UMask": "0x00", "EventName": "CPU_CLK_UNHALTED.THREAD_P", ... }, ... ]
+ */
+class intel_event_loader : public perfm::json::handler {
+
+public:
+    using table_t = std::unordered_map<std::string, perfm::einfo::ptr_t>;
+
+    intel_event_loader(table_t &table, int type, const std::string &filp) : _table(table), _type(type), _filp(filp) { }
+
+    bool begin_object() override {
+        if (++_depth != 2) {
+            return true;
+        }
+
+        _e = perfm::einfo_intel::alloc();
+        if (!_e) {
+            perfm_fatal("failed to alloc einfo object\n");
+        }
+        _e->_e_type = _type;
+        _field = F_NONE;
+        _valid = true;
+
+        return true;
+    }
+
+    bool end_object() override {
+        if (_depth-- != 2) {
+            return true;
+        }
+
+        if (_e->_r_name.empty()) {
+            perfm_warn("%s: event without EventName, ignored\n", _filp.c_str());
+        } else if (!_valid) {
+            perfm_warn("%s: invalid field in event %s, ignored\n", _filp.c_str(), _e->_r_name.c_str());
+        } else if (!_table.insert({_e->_r_name, _e}).second) {
+            perfm_warn("duplicate raw event %s\n", _e->_r_name.c_str());
+        }
+
+        _e.reset();
+
+        return true;
+    }
+
+    bool begin_array() override {
+        ++_depth;
+        return true;
+    }
+
+    bool end_array() override {
+        --_depth;
+        return true;
+    }
+
+    bool key(const char *ptr, size_t len) override {
+        _field = F_NONE;
+
+        if (_depth != 2) {
+            return true;
+        }
+
+        for (const auto &f : _fields) {
+            if (f.len == len && !memcmp(f.name, ptr, len)) {
+                _field = f.id;
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    bool value(const char *ptr, size_t len, bool) override {
+        if (_depth != 2 || _field == F_NONE) {
+            return true;
+        }
+
+        perfm::einfo_intel &e = *_e;
+
+        switch (_field) {
+        case F_NAME:
+            e._r_name.assign(ptr, len);
+            break;
+
+        case F_DESC:
+            e._e_desc.assign(ptr, len);
+            break;
+
+        case F_UNIT:
+            e._e_unit.assign(ptr, len);
+            break;
+
+        case F_CODE: /* e.g. "0xB7, 0xBB" for OFFCORE_RESPONSE, the first one is used */
+            _valid = parse_list(ptr, len, &e._e_ecode, 1) && _valid;
+            break;
+
+        case F_UMASK:
+            _valid = parse_list(ptr, len, &e._e_umask, 1) && _valid;
+            break;
+
+        case F_CMASK:
+            _valid = parse_list(ptr, len, &e._e_cmask, 1) && _valid;
+            break;
+
+        case F_PERIOD:
+            _valid = parse_list(ptr, len, &e._e_period, 1) && _valid;
+            break;
+
+        case F_MSRV:
+            _valid = parse_list(ptr, len, &e._e_msrv, 1) && _valid;
+            break;
+
+        case F_MSRI: {
+                int n = parse_list(ptr, len, e._e_msri, sizeof(e._e_msri) / sizeof(e._e_msri[0]));
+                e._nr_msr = n;
+                _valid = n > 0 && _valid;
+            }
+            break;
+
+        case F_INV:
+            e._e_inv = is_true(ptr, len);
+            break;
+
+        case F_ANY:
+            e._e_any = is_true(ptr, len);
+            break;
+
+        case F_EDGE:
+            e._e_edge = is_true(ptr, len);
+            break;
+
+        case F_PEBS:
+            e._e_pebs = is_true(ptr, len);
+            break;
+
+        case F_EXTSEL:
+            e._e_extsel = is_true(ptr, len);
+            break;
+
+        case F_FILTER: /* "null" or "na" if none */
+            if (is_true(ptr, len) && !(len == 2 && !memcmp(ptr, "na", 2))) {
+                e._e_filter.assign(ptr, len);
+            }
+            break;
+
+        default:
+            ;
+        }
+
+        return true;
+    }
+
+private:
+    /*
+     * parse a list of numbers such as "0x1a6,0x1a7" into @val (at most @max elems)
+     *
+     * return # of numbers parsed, 0 if the first one is not a number
+     */
+    static int parse_list(const char *ptr, size_t len, uint64_t *val, int max) {
+        char buf[64];
+        int n = 0;
+
+        for (size_t i = 0; i < len && n < max; ) {
+            while (i < len && (ptr[i] == ' ' || ptr[i] == ',')) {
+                ++i;
+            }
+
+            size_t j = i;
+            while (j < len && ptr[j] != ',' && ptr[j] != ' ') {
+                ++j;
+            }
+
+            if (j == i) {
+                break;
+            }
+
+            if (j - i >= sizeof(buf)) {
+                return n;
+            }
+
+            memcpy(buf, ptr + i, j - i);
+            buf[j - i] = '\0';
+
+            char *eptr = nullptr;
+            uint64_t v = std::strtoull(buf, &eptr, 0);
+            if (*eptr != '\0') {
+                return n;
+            }
+
+            val[n++] = v;
+            i = j;
+        }
+
+        return n;
+    }
+
+    /* "0"/"false"/"null"/"" are false, everything else is true */
+    static bool is_true(const char *ptr, size_t len) {
+        return !(len == 0 ||
+                 (len == 1 && ptr[0] == '0') ||
+                 (len == 4 && !memcmp(ptr, "null", 4)) ||
+                 (len == 5 && !memcmp(ptr, "false", 5)));
+    }
+
+private:
+    enum field_t {
+        F_NONE = 0,
+        F_NAME,   // EventName
+        F_DESC,   // BriefDescription
+        F_UNIT,   // Unit
+        F_CODE,   // EventCode
+        F_UMASK,  // UMask
+        F_CMASK,  // CounterMask
+        F_PERIOD, // SampleAfterValue
+        F_MSRI,   // MSRIndex
+        F_MSRV,   // MSRValue
+        F_INV,    // Invert
+        F_ANY,    // AnyThread
+        F_EDGE,   // EdgeDetect
+        F_PEBS,   // PEBS
+        F_EXTSEL, // ExtSel
+        F_FILTER  // Filter
+    };
+
+    struct field_name_t {
+        const char *name;
+        size_t len;
+        field_t id;
+    };
+
+    #define FIELD(n, id) { n, sizeof(n) - 1, id }
+    const field_name_t _fields[15] = {
+        FIELD("EventName",        F_NAME),
+        FIELD("BriefDescription", F_DESC),
+        FIELD("Unit",             F_UNIT),
+        FIELD("EventCode",        F_CODE),
+        FIELD("UMask",            F_UMASK),
+        FIELD("CounterMask",      F_CMASK),
+        FIELD("SampleAfterValue", F_PERIOD),
+        FIELD("MSRIndex",         F_MSRI),
+        FIELD("MSRValue",         F_MSRV),
+        FIELD("Invert",           F_INV),
+        FIELD("AnyThread",        F_ANY),
+        FIELD("EdgeDetect",       F_EDGE),
+        FIELD("PEBS",             F_PEBS),
+        FIELD("ExtSel",           F_EXTSEL),
+        FIELD("Filter",           F_FILTER),
+    };
+    #undef FIELD
+
+private:
+    table_t &_table;
+    const int _type;
+    const std::string &_filp;
+
+    perfm::einfo_intel::ptr_t _e;
+    field_t _field = F_NONE;
+    bool _valid = true;
+    int _depth  = 0;
+};
+
 } /* namespace */
 
 namespace perfm {
@@ -112,6 +381,7 @@ void einfo_intel::print(FILE *fp) const
         fprintf(fp, "UMask            : 0x%zx\n", _e_umask);
         fprintf(fp, "MSRValue         : 0x%zx\n", _e_msrv);
         fprintf(fp, "ExtSel           : %s\n",    _e_extsel ? "true" : "false");
+        fprintf(fp, "Filter           : %s\n",    _e_filter.empty() ? "-" : _e_filter.c_str());
         break;
 
     default:
@@ -145,6 +415,21 @@ parser::ptr_t parser::alloc()
     return ptr_t(p);
 }
 
+parser perfm_parser;
+
+parser::~parser()
+{
+    for (auto &it : _p2a_cache) {
+        free(it.second);
+    }
+
+#ifdef PERFM_USE_LIBPFM
+    if (_pfm_initialized) {
+        pfm_terminate();
+    }
+#endif
+}
+
 long parser::pmu_detect(const std::string &pmu)
 {
     if (!_pmu_source_detected) {
@@ -423,6 +708,101 @@ void parser::print_evn_info(FILE *fp) const
         e.second->print(fp);
         fprintf(fp, "\n");
     }
+
+    if (_evdb) {
+        for (size_t i = 0; i < _evdb->nr_event(); ++i) {
+            const evdb::event_t &e = _evdb->event(i);
+            if (_e_info_raw.find(_evdb->str(e.name)) != _e_info_raw.end()) {
+                continue; /* printed above */
+            }
+
+            materialize(e)->print(fp);
+            fprintf(fp, "\n");
+        }
+    }
+
+    if (_builtin) {
+        for (uint32_t i = 0; i < _builtin->nr_event; ++i) {
+            const builtin::event_t &e = _builtin->event[i];
+            if (_e_info_raw.find(e.name) != _e_info_raw.end()) {
+                continue;
+            }
+
+            materialize(e)->print(fp);
+            fprintf(fp, "\n");
+        }
+    }
+}
+
+void parser::list_event(const std::string &query, size_t limit, FILE *fp)
+{
+    if (!fp) {
+        return;
+    }
+
+    evindex::ptr_t index = evindex::alloc();
+    if (!index) {
+        perfm_fatal("failed to alloc the event index\n");
+    }
+
+    for (const auto &e : _symbolic_events) {
+        index->add(e.first, "perf symbolic event");
+    }
+    uint32_t nr_symbolic = index->size();
+
+    for (const auto &e : _e_info_raw) {
+        index->add(e.first, e.second->_e_desc);
+    }
+
+    if (_evdb) {
+        for (size_t i = 0; i < _evdb->nr_event(); ++i) {
+            const evdb::event_t &e = _evdb->event(i);
+            if (_e_info_raw.find(_evdb->str(e.name)) == _e_info_raw.end()) {
+                index->add(_evdb->str(e.name), _evdb->str(e.desc));
+            }
+        }
+    }
+
+    if (_builtin) {
+        for (uint32_t i = 0; i < _builtin->nr_event; ++i) {
+            const builtin::event_t &e = _builtin->event[i];
+            if (_e_info_raw.find(e.name) == _e_info_raw.end()) {
+                index->add(e.name, e.desc);
+            }
+        }
+    }
+
+    index->build();
+
+    auto res = index->search(query, limit);
+
+    for (const auto &m : res) {
+        const std::string &name = index->name(m.doc);
+
+        std::string enc;
+        std::vector<std::string> boxes;
+
+        if (m.doc < nr_symbolic) {
+            auto it = _symbolic_events.find(name);
+            char buf[64];
+            snprintf(buf, sizeof(buf), "type=%u,config=%#llx", it->second.first, static_cast<unsigned long long>(it->second.second));
+            enc = buf;
+        } else if (is_uncore(name)) {
+            if (expand_uncore(name, boxes, false) && !boxes.empty()) {
+                enc = boxes[0] + (boxes.size() > 1 ? " (x" + std::to_string(boxes.size()) + " boxes)" : "");
+            }
+        } else if (!parse_raw_event(name, enc)) {
+            enc.clear();
+        }
+
+        fprintf(fp, "%-48s %s\n", name.c_str(), enc.empty() ? "-" : enc.c_str());
+
+        if (!index->desc(m.doc).empty()) {
+            fprintf(fp, "    %s\n", index->desc(m.doc).c_str());
+        }
+    }
+
+    fprintf(fp, "\n%lu of %lu events shown\n", res.size(), index->size());
 }
 
 bool parser::parse_event(const std::string &raw, struct perf_event_attr *hw)
@@ -441,20 +821,21 @@ bool parser::parse_event(const std::string &raw, struct perf_event_attr *hw)
 
 bool parser::parse_perf_event(const std::string &e, struct perf_event_attr *hw)
 {
-    // linux/tools/perf/Documentation/{perf-record.txt, perf-stat.txt}
+    // linux/tools/perf/Documentation/{perf-list.txt, perf-record.txt, perf-stat.txt}
     //
-    // 1. a symbolic event name (use 'perf list' to list all events)
+    // 1. a symbolic event name, e.g. cycles, cache-misses, L1-dcache-load-misses, task-clock
     //
     // 2. a raw PMU event (eventsel+umask) in the form of rNNN where NNN is hexadecimal event descriptor. 
     //
     // 3. a symbolically formed PMU event like 'pmu/param1=0x3,param2/' where param1', 'param2', etc are
-    //    defined as formats for the PMU in sys/bus/event_source/devices/<pmu>/format/*
+    //    defined as formats for the PMU in sys/bus/event_source/devices/<pmu>/format/*, or an event
+    //    alias in sys/bus/event_source/devices/<pmu>/events/* (e.g. cpu/mem-loads/)
     //
-    // 4. a symbolically formed event like 'pmu/config=M,config1=N,config3=K/' where M, N, K are 
+    // 4. a symbolically formed event like 'pmu/config=M,config1=N,config2=K/' where M, N, K are 
     //    numbers (in decimal, hex, octal format)
-    // 
-    // FIXME:
-    //     for now, we only focus on 2 & 3
+    //
+    // 3 & 4 may be mixed, and may carry a label 'name=xxx' (see event_label()) & 'period=N'.
+    // each form may be followed by modifiers, e.g. cycles:u, r01c2:k, cpu/event=0x3c/uk, see parse_modifier()
 
     if (e.empty() || !hw) {
         return false;
@@ -473,39 +854,47 @@ bool parser::parse_perf_event(const std::string &e, struct perf_event_attr *hw)
     hw->size = sizeof(struct perf_event_attr);
     hw->type = PERF_TYPE_RAW; /* defaults to PERF_TYPE_RAW */
 
-    int modifier_pos = 0;
+    auto beg = e.find("/");
+    if (beg == std::string::npos) {
+        // name[:modifier], where name is symbolic or rNNN
+        auto colon = e.find(":");
+        std::string name = e.substr(0, colon);
+        std::string modifier = colon == std::string::npos ? "" : e.substr(colon + 1);
 
-    // 
-    // std::string const s("Emplary");
-    // assert(s.size() == std::strlen(s.c_str()));
-    // assert(std::equal(s.begin(), s.end(), s.c_str()));
-    // assert(std::equal(s.c_str(), s.c_str() + s.size(), s.begin()));
-    // assert(0 == *(s.c_str() + s.size()));
-    //
-    if (std::sscanf(e.c_str(), "r%zx%n", &hw->config, &modifier_pos) == 1) {
-        if (modifier_pos > e.size()) {
-            perfm_warn("this should not happen\n");
-            return false;
-        }
+        unsigned long long raw = 0;
+        int end = 0;
 
-        if (modifier_pos == e.size()) {
-            return true;
+        if (parse_generic_event(hw, name) || parse_cache_event(hw, name)) {
+            /* done */
+        } else if (std::sscanf(name.c_str(), "r%llx%n", &raw, &end) == 1 && static_cast<size_t>(end) == name.size()) {
+            hw->config = raw;
+        } else {
+            perfm_warn("invalid descriptor %s\n", e.c_str());
+            return false;
         }
 
-        if (e[modifier_pos] == ':') {
-            return parse_modifier(hw, e.substr(modifier_pos + 1));
+        if (!parse_modifier(hw, modifier)) {
+            return false;
         }
 
     } else {
-        // FIXME:
-        //    how to handle modifier ?
-        auto slice = str_split(e, "/", 2);
-        if (slice.size() != 2) {
+        // pmu/term1,term2,.../[:]modifiers
+        auto end = e.rfind("/");
+        if (beg == end) {
             perfm_warn("invalid descriptor %s\n", e.c_str());
             return false;
         }
 
-        if (!parse_encoding(hw, slice[0], slice[1])) {
+        if (!parse_encoding(hw, e.substr(0, beg), e.substr(beg + 1, end - beg - 1))) {
+            return false;
+        }
+
+        std::string modifier = e.substr(end + 1);
+        if (!modifier.empty() && modifier[0] == ':') {
+            modifier.erase(0, 1);
+        }
+
+        if (!parse_modifier(hw, modifier)) {
             return false;
         }
     }
@@ -521,19 +910,188 @@ bool parser::parse_perf_event(const std::string &e, struct perf_event_attr *hw)
     return true;
 }
 
+bool parser::is_perf_event(const std::string &e) const
+{
+    if (e.find("/") != std::string::npos) {
+        return true;
+    }
+
+    std::string name = e.substr(0, e.find(":"));
+
+    if (_symbolic_events.count(name)) {
+        return true;
+    }
+
+    struct perf_event_attr hw;
+    if (parse_cache_event(&hw, name)) {
+        return true;
+    }
+
+    unsigned long long raw = 0;
+    int end = 0;
+
+    return std::sscanf(name.c_str(), "r%llx%n", &raw, &end) == 1 && static_cast<size_t>(end) == name.size();
+}
+
+std::vector<std::string> parser::split_events(const std::string &list)
+{
+    // split at the commas which are not inside 'pmu/.../' or '{...}'
+    std::vector<std::string> res;
+    std::string cur;
+
+    bool in_pmu = false;
+    int  brace  = 0;
+
+    for (char c : list) {
+        if (c == '/') {
+            in_pmu = !in_pmu;
+        } else if (c == '{') {
+            ++brace;
+        } else if (c == '}') {
+            --brace;
+        } else if (c == ',' && !in_pmu && brace <= 0) {
+            cur = str_trim(cur);
+            if (!cur.empty()) {
+                res.push_back(cur);
+            }
+            cur.clear();
+            continue;
+        }
+
+        cur.push_back(c);
+    }
+
+    cur = str_trim(cur);
+    if (!cur.empty()) {
+        res.push_back(cur);
+    }
+
+    return res;
+}
+
+std::vector<std::string> parser::split_groups(const std::string &list)
+{
+    // "a,{b,c}:u,d" --> "a", "b:u,c:u" & "d"
+    std::vector<std::string> res;
+    std::string loose;
+
+    for (const auto &item : split_events(list)) {
+        if (item[0] != '{') {
+            loose += (loose.empty() ? "" : ",") + item;
+            continue;
+        }
+
+        // the events before a group are a group of their own, in the order given
+        if (!loose.empty()) {
+            res.push_back(loose);
+            loose.clear();
+        }
+
+        auto rb = item.find("}");
+        if (rb == std::string::npos || item.find("{", 1) < rb) {
+            perfm_warn("unbalanced or nested braces in %s, ignored\n", item.c_str());
+            continue;
+        }
+
+        // only modifiers may follow the '}', e.g. {a,b}:u or {a,b}:ppp
+        std::string modifier = item.substr(rb + 1);
+        if (!modifier.empty() && modifier[0] == ':') {
+            modifier.erase(0, 1);
+        }
+
+        if (modifier.find_first_not_of("ukhpPGHIUK:") != std::string::npos) {
+            perfm_warn("invalid modifier after the group %s, ignored\n", item.c_str());
+            continue;
+        }
+
+        std::string grp;
+        for (const auto &ev : split_events(item.substr(1, rb - 1))) {
+            grp += (grp.empty() ? "" : ",") + ev;
+            if (!modifier.empty()) {
+                grp += (ev.back() == '/' ? "" : ":") + modifier;
+            }
+        }
+
+        if (!grp.empty()) {
+            res.push_back(grp);
+        }
+    }
+
+    if (!loose.empty()) {
+        res.push_back(loose);
+    }
+
+    return res;
+}
+
+std::string parser::event_label(const std::string &e)
+{
+    auto beg = e.find("/");
+    auto end = e.rfind("/");
+    if (beg == std::string::npos || beg == end) {
+        return e;
+    }
+
+    for (const auto &term : str_split(e.substr(beg + 1, end - beg - 1), ",")) {
+        if (!term.compare(0, 5, "name=")) {
+            return term.substr(5);
+        }
+    }
+
+    return e;
+}
+
 bool parser::parse_raw_event(const std::string &r, std::string &p)
 {
     if (r.empty()) {
         return false;
     }
 
-    auto it = _e_info_raw.find(r);
-    if (it != _e_info_raw.end()) {
-        if (it->second->_e_perf.empty()) {
-            /* TODO */ 
+    einfo::ptr_t e = find_event(r);
+    if (e) {
+        if (e->_e_perf.empty()) {
+            const einfo_intel *ei = dynamic_cast<const einfo_intel *>(e.get());
+            if (!ei || ei->_e_type != einfo::E_PMU_CORE) {
+                return false; /* uncore events are not encoded natively yet */
+            }
+
+            // e.g. cpu/event=0xa3,umask=0x14,cmask=20/
+            std::string enc;
+
+            auto fixed = _fixed_cntr_events.find(ei->_r_name);
+            if (fixed != _fixed_cntr_events.end()) {
+                enc = fixed->second;
+            } else {
+                char buf[128];
+                snprintf(buf, sizeof(buf), "event=0x%lx,umask=0x%lx", ei->_e_ecode, ei->_e_umask);
+                enc = buf;
+
+                if (ei->_e_cmask) {
+                    enc += ",cmask=" + std::to_string(ei->_e_cmask);
+                }
+                if (ei->_e_inv) {
+                    enc += ",inv";
+                }
+                if (ei->_e_any) {
+                    enc += ",any";
+                }
+                if (ei->_e_edge) {
+                    enc += ",edge";
+                }
+
+                // e.g. offcore_rsp=0x3fbfc08fff for OFFCORE_RESPONSE.*, ldlat=0x4 for the load latency events
+                auto msr = _msr_fields_mapping.find(ei->_e_msri[0]);
+                if (msr != _msr_fields_mapping.end()) {
+                    snprintf(buf, sizeof(buf), ",%s=0x%lx", msr->second.c_str(), ei->_e_msrv);
+                    enc += buf;
+                }
+            }
+
+            e->_e_pmu  = "cpu";
+            e->_e_perf = e->_e_pmu + "/" + enc + "/";
         }
 
-        p = it->second->_e_perf;    
+        p = e->_e_perf;    
     } else {
         perfm_warn("unknown raw event %s\n", r.c_str());
         return false;
@@ -543,10 +1101,17 @@ bool parser::parse_raw_event(const std::string &r, std::string &p)
 }
 
 bool parser::parse_modifier(struct perf_event_attr *hw, const std::string &modifier) const
-{   // 
-    // FIXME: 
-    //     for now, we only support 'K', 'U', 'H', 'P', all the other will be ingored
+{
+    // linux/tools/perf/Documentation/perf-list.txt, EVENT MODIFIERS
+    //
+    //   u - user-space counting            k - kernel counting
+    //   h - hypervisor counting            I - non idle counting
+    //   G - guest counting (in KVM guests) H - host counting (not in KVM guests)
+    //   p - precise level, repeated for a higher level (pp, ppp)
+    //   P - the maximum precise level, 2 here (perf probes it)
     //
+    // if any of u/k/h is given, the privilege levels not given are excluded.
+    // 'U' & 'K' (libpfm4's style) are the same as 'u' & 'k', ':' is ignored so "u:k" equals "uk"
     if (modifier.empty()) {
         return true;
     } 
@@ -555,22 +1120,45 @@ bool parser::parse_modifier(struct perf_event_attr *hw, const std::string &modif
         return false;
     }
 
+    bool user = false, kernel = false, hv = false, plm = false;
+
     for (size_t i = 0; i < modifier.size(); ++i) {
         switch (modifier[i]) {
-        case 'K': case 'k': // kernel, don't count user
-            hw->exclude_user = 1;
+        case 'u': case 'U':
+            user = plm = true;
+            break;
+
+        case 'k': case 'K':
+            kernel = plm = true;
             break;
 
-        case 'U': case 'u': // user, don't count kernel
-            hw->exclude_kernel = 1;
+        case 'h':
+            hv = plm = true;
             break;
 
-        case 'H': case 'h': // hypervisor, don't count in guest
+        case 'H': // host only, don't count in guest
             hw->exclude_guest = 1;
             break;
 
-        case 'P': case 'p': // skid constraint
-            hw->precise_ip++;
+        case 'G': // guest only
+            hw->exclude_host = 1;
+            break;
+
+        case 'I':
+            hw->exclude_idle = 1;
+            break;
+
+        case 'p': // skid constraint
+            if (hw->precise_ip < 3) {
+                hw->precise_ip++;
+            }
+            break;
+
+        case 'P':
+            hw->precise_ip = 2;
+            break;
+
+        case ':':
             break;
 
         default:
@@ -578,6 +1166,12 @@ bool parser::parse_modifier(struct perf_event_attr *hw, const std::string &modif
         }
     }
 
+    if (plm) {
+        hw->exclude_user   = !user;
+        hw->exclude_kernel = !kernel;
+        hw->exclude_hv     = !hv;
+    }
+
     return true;
 }
 
@@ -641,12 +1235,17 @@ bool parser::parse_encoding(struct perf_event_attr *hw, const std::string &pmu,
     }
 
     std::string term;
-    uint64_t value, *config;
+    uint64_t value;
+    __u64 *config = nullptr;
     int l, r;
 
     auto slice = str_split(evn, ",");
 
     for (size_t i = 0; i < slice.size(); ++i) {
+        if (!slice[i].compare(0, 5, "name=")) {
+            continue; /* a label, see event_label() */
+        }
+
         auto equal = slice[i].find("=");
         if (equal != std::string::npos) {
             term = slice[i].substr(0, equal); 
@@ -658,14 +1257,41 @@ bool parser::parse_encoding(struct perf_event_attr *hw, const std::string &pmu,
                 value = std::stoull(slice[i].substr(equal + 1), nullptr, 0); 
             } catch (const std::exception &) {
                 perfm_warn("invalid descriptor %s(%s)\n", evn.c_str(), slice[i].c_str()); 
+                return false;
             }
         } else {
             term  = slice[i];
             value = 1;    
         }
 
+        // the raw config fields & the sample period
+        if (term == "config") {
+            hw->config = value;
+            continue;
+        } else if (term == "config1") {
+            hw->config1 = value;
+            continue;
+        } else if (term == "config2") {
+            hw->config2 = value;
+            continue;
+        } else if (term == "period") {
+            hw->sample_period = value;
+            continue;
+        }
+
         auto it = pmu_format->second.find(term);
         if (it == pmu_format->second.end()) {
+            // an event alias, e.g. /sys/bus/event_source/devices/cpu/events/mem-loads: event=0xcd,umask=0x1,ldlat=3
+            std::string alias;
+            std::fstream fp("/sys/bus/event_source/devices/" + pmu + "/events/" + term, std::ios::in);
+            if (equal == std::string::npos && fp.good() && std::getline(fp, alias) && !alias.empty() &&
+                alias.find("/") == std::string::npos) {
+                if (!parse_encoding(hw, pmu, str_trim(alias))) {
+                    return false;
+                }
+                continue;
+            }
+
             perfm_warn("invalid format field %s\n", term.c_str());
             return false;
         }
@@ -687,12 +1313,365 @@ bool parser::parse_encoding(struct perf_event_attr *hw, const std::string &pmu,
             break;
         }
 
-        *config |= (LSB(value, r - l + 1) << l);
+        if (!config) {
+            return false;
+        }
+
+        *config |= r - l + 1 >= 64 ? value : (LSB(value, r - l + 1) << l);
     }
 
     return true;
 }
 
+bool parser::parse_generic_event(struct perf_event_attr *hw, const std::string &e) const
+{
+    auto it = _generic_events.find(e);
+    if (it == _generic_events.end()) {
+        it = _symbolic_events.find(e);
+        if (it == _symbolic_events.end()) {
+            return false;
+        }
+    }
+
+    memset(hw, 0, sizeof(struct perf_event_attr));
+
+    hw->size   = sizeof(struct perf_event_attr);
+    hw->type   = it->second.first;
+    hw->config = it->second.second;
+
+    return true;
+}
+
+bool parser::parse_cache_event(struct perf_event_attr *hw, const std::string &e) const
+{
+    // <cache>-<ops> for accesses, <cache>-<op>-misses for misses, e.g. L1-dcache-loads, LLC-prefetches,
+    // LLC-load-misses, as perf list names them
+    static const std::pair<const char *, int> cache[] = {
+        {"L1-dcache", PERF_COUNT_HW_CACHE_L1D},
+        {"L1-icache", PERF_COUNT_HW_CACHE_L1I},
+        {"LLC",       PERF_COUNT_HW_CACHE_LL},
+        {"dTLB",      PERF_COUNT_HW_CACHE_DTLB},
+        {"iTLB",      PERF_COUNT_HW_CACHE_ITLB},
+        {"branch",    PERF_COUNT_HW_CACHE_BPU},
+        {"node",      PERF_COUNT_HW_CACHE_NODE},
+    };
+
+    static const struct {
+        const char *name;
+        const char *plural;
+        int op;
+    } op[] = {
+        {"load",     "loads",      PERF_COUNT_HW_CACHE_OP_READ},
+        {"store",    "stores",     PERF_COUNT_HW_CACHE_OP_WRITE},
+        {"prefetch", "prefetches", PERF_COUNT_HW_CACHE_OP_PREFETCH},
+    };
+
+    for (const auto &c : cache) {
+        for (const auto &o : op) {
+            std::string prefix = std::string(c.first) + "-";
+
+            int result = -1;
+            if (e == prefix + o.plural) {
+                result = PERF_COUNT_HW_CACHE_RESULT_ACCESS;
+            } else if (e == prefix + o.name + "-misses") {
+                result = PERF_COUNT_HW_CACHE_RESULT_MISS;
+            } else {
+                continue;
+            }
+
+            memset(hw, 0, sizeof(struct perf_event_attr));
+
+            hw->size   = sizeof(struct perf_event_attr);
+            hw->type   = PERF_TYPE_HW_CACHE;
+            hw->config = c.second | (o.op << 8) | (result << 16);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool parser::encode(const std::string &evn, struct perf_event_attr *hw)
+{
+    if (evn.empty() || !hw) {
+        return false;
+    }
+
+    auto it = _encode_cache.find(evn);
+    if (it != _encode_cache.end()) {
+        memmove(hw, &it->second, sizeof(struct perf_event_attr));
+        return true;
+    }
+
+    if (!encode_native(evn, hw) && !encode_libpfm(evn, hw)) {
+#ifndef PERFM_USE_LIBPFM
+        perfm_warn("unknown event %s (not in the event table, libpfm4 not built in)\n", evn.c_str());
+#endif
+        return false;
+    }
+
+    _encode_cache.insert({evn, *hw});
+
+    return true;
+}
+
+bool parser::encode_native(const std::string &evn, struct perf_event_attr *hw)
+{
+    // perf style: pmu/.../, rNNN or a symbolic name such as cycles
+    if (is_perf_event(evn)) {
+        return parse_perf_event(evn, hw);
+    }
+
+    // name[:modifier[:modifier...]]
+    auto slice = str_split(evn, ":");
+    size_t next = 1; /* the first modifier */
+
+    if (parse_generic_event(hw, slice[0])) {
+        /* done */
+    } else {
+        // json event name, INST_RETIRED.ANY_P or libpfm4's form INST_RETIRED:ANY_P
+        std::string name = slice[0];
+        std::string perf;
+
+        if (!find_event(name)) {
+            if (slice.size() < 2 || !find_event(slice[0] + "." + slice[1])) {
+                return false;
+            }
+            name = slice[0] + "." + slice[1];
+            next = 2;
+        }
+
+        if (!parse_raw_event(name, perf)) {
+            return false;
+        }
+
+        // extra terms (e.g. c=2, i) are folded into the encoding, the modifiers (e.g. u, ppp, ukhpPG)
+        // are applied after by parse_modifier()
+        std::string terms;
+        std::string plm;
+
+        for (size_t i = next; i < slice.size(); ++i) {
+            std::string m = str_trim(slice[i]);
+            std::string k = m.substr(0, m.find("="));
+            std::string v = m.find("=") == std::string::npos ? "" : m.substr(m.find("=") + 1);
+
+            if (k == "u" || k == "k" || k == "h") {
+                if (v.empty() || v != "0") {
+                    plm += k;
+                }
+            } else if (!m.empty() && v.empty() && m.find_first_not_of("ukhpPGHIUK") == std::string::npos) {
+                plm += m;
+            } else if (k == "c" || k == "cmask") {
+                terms += ",cmask=" + v;
+            } else if (k == "i" || k == "inv") {
+                terms += v == "0" ? "" : ",inv";
+            } else if (k == "e" || k == "edge") {
+                terms += v == "0" ? "" : ",edge";
+            } else if (k == "t" || k == "any") {
+                terms += v == "0" ? "" : ",any";
+            } else if (!m.empty()) {
+                terms += "," + m; /* a PMU format term, e.g. ldlat=3 */
+            }
+        }
+
+        if (!terms.empty()) {
+            perf.insert(perf.size() - 1, terms); /* before the trailing '/' */
+        }
+
+        if (!parse_perf_event(perf, hw)) {
+            return false;
+        }
+
+        return parse_modifier(hw, plm);
+    }
+
+    std::string plm;
+    for (size_t i = next; i < slice.size(); ++i) {
+        plm += str_trim(slice[i]);
+    }
+
+    return parse_modifier(hw, plm);
+}
+
+uint32_t parser::extra_msr(const struct perf_event_attr &hw, uint64_t *val) const
+{
+    auto it = _event_source_list.find("cpu");
+    if (hw.type != PERF_TYPE_RAW && (it == _event_source_list.end() || hw.type != static_cast<uint32_t>(it->second))) {
+        return 0;
+    }
+
+    uint32_t msr = 0;
+
+    switch (hw.config & 0xff) {
+    case 0xb7: msr = 0x1a6; break; /* OFFCORE_RESPONSE_0 */
+    case 0xbb: msr = 0x1a7; break; /* OFFCORE_RESPONSE_1 */
+    case 0xcd: msr = 0x3f6; break; /* MEM_TRANS_RETIRED.LOAD_LATENCY */
+    case 0xc6: msr = 0x3f7; break; /* FRONTEND_RETIRED */
+    default:
+        return 0;
+    }
+
+    if (!hw.config1) {
+        return 0; /* e.g. 0xc6 is not FRONTEND_RETIRED on older cores */
+    }
+
+    if (val) {
+        *val = hw.config1;
+    }
+
+    return msr;
+}
+
+bool parser::is_uncore(const std::string &evn)
+{
+    auto slice = str_split(evn, ":");
+
+    einfo::ptr_t e = find_event(slice[0]);
+    if (!e && slice.size() > 1) {
+        e = find_event(slice[0] + "." + slice[1]);
+    }
+
+    return e && e->_e_type == einfo::E_PMU_UNCORE;
+}
+
+bool parser::expand_uncore(const std::string &evn, std::vector<std::string> &res, bool verbose)
+{
+    res.clear();
+
+    // name[:modifier[:modifier...]], the name may be in libpfm4's form UNC_M_CAS_COUNT:RD
+    auto slice = str_split(evn, ":");
+    size_t next = 1;
+
+    einfo::ptr_t e = find_event(slice[0]);
+    if (!e && slice.size() > 1) {
+        e = find_event(slice[0] + "." + slice[1]);
+        next = 2;
+    }
+
+    const einfo_intel *ei = dynamic_cast<const einfo_intel *>(e.get());
+    if (!ei || ei->_e_type != einfo::E_PMU_UNCORE) {
+        return false;
+    }
+
+    auto unit = _uncore_units.find(ei->_e_unit);
+    if (unit == _uncore_units.end()) {
+        perfm_warn("unknown uncore unit %s of %s\n", ei->_e_unit.c_str(), evn.c_str());
+        return false;
+    }
+
+    // uncore_cbox_0 ... uncore_cbox_N, or a single uncore_pcu
+    const std::string &prefix = unit->second;
+    std::vector<std::pair<int, std::string>> boxes;
+
+    for (const auto &it : _event_source_list) {
+        const std::string &pmu = it.first;
+
+        if (pmu == prefix) {
+            boxes.push_back({-1, pmu});
+        } else if (pmu.size() > prefix.size() + 1 && !pmu.compare(0, prefix.size() + 1, prefix + "_") &&
+                   std::isdigit(static_cast<unsigned char>(pmu[prefix.size() + 1]))) {
+            boxes.push_back({std::atoi(pmu.c_str() + prefix.size() + 1), pmu});
+        }
+    }
+
+    if (boxes.empty()) {
+        perfm_warn("no %s* PMU found for %s\n", prefix.c_str(), evn.c_str());
+        return false;
+    }
+
+    std::sort(boxes.begin(), boxes.end());
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "event=0x%lx,umask=0x%lx", ei->_e_ecode, ei->_e_umask);
+
+    std::string enc = buf;
+
+    if (ei->_e_cmask) {
+        enc += ",thresh=" + std::to_string(ei->_e_cmask);
+    }
+    if (ei->_e_inv) {
+        enc += ",inv";
+    }
+    if (ei->_e_edge) {
+        enc += ",edge";
+    }
+
+    bool has_filter = false;
+
+    for (size_t i = next; i < slice.size(); ++i) {
+        std::string m = str_trim(slice[i]);
+        std::string k = m.substr(0, m.find("="));
+        std::string v = m.find("=") == std::string::npos ? "" : m.substr(m.find("=") + 1);
+
+        if (k == "c" || k == "cmask") {
+            enc += ",thresh=" + v;
+        } else if (k == "i" || k == "inv") {
+            enc += v == "0" ? "" : ",inv";
+        } else if (k == "e" || k == "edge") {
+            enc += v == "0" ? "" : ",edge";
+        } else if (!m.empty()) {
+            enc += "," + m; /* a box PMU format term, e.g. filter_state=0x1f */
+            has_filter = has_filter || !k.compare(0, 7, "filter_");
+        }
+    }
+
+    // the box filter the event needs, unless the user gave one
+    std::string filter = ei->_e_filter;
+    filter.erase(std::remove(filter.begin(), filter.end(), ' '), filter.end());
+
+    if (!filter.empty() && !has_filter) {
+        if (!filter.compare(0, 7, "filter_")) {
+            enc += "," + filter;
+        } else if (verbose) {
+            perfm_warn("%s needs the box filter %s, which may count nothing without it, "
+                       "pass it as a modifier, e.g. %s:filter_state=0x1f\n",
+                       evn.c_str(), filter.c_str(), evn.c_str());
+        }
+    }
+
+    for (const auto &b : boxes) {
+        res.push_back(b.second + "/" + enc + "/");
+    }
+
+    return true;
+}
+
+bool parser::encode_libpfm(const std::string &evn, struct perf_event_attr *hw)
+{
+#ifdef PERFM_USE_LIBPFM
+    if (!_pfm_initialized) {
+        pfm_err_t ret = pfm_initialize();
+        if (ret != PFM_SUCCESS) {
+            perfm_warn("pfm_initialize() failed, %s\n", pfm_strerror(ret));
+            return false;
+        }
+        _pfm_initialized = true;
+    }
+
+    pfm_perf_encode_arg_t arg;
+    memset(&arg, 0, sizeof(arg));
+    memset(hw, 0, sizeof(struct perf_event_attr));
+
+    arg.attr = hw;
+    arg.size = sizeof(arg);
+
+    pfm_err_t ret = pfm_get_os_event_encoding(evn.c_str(), PFM_PLM3 | PFM_PLM0, PFM_OS_PERF_EVENT, &arg);
+    if (ret != PFM_SUCCESS) {
+        perfm_warn("%s %s\n", evn.c_str(), pfm_strerror(ret));
+        return false;
+    }
+
+    hw->size = sizeof(struct perf_event_attr);
+
+    return true;
+#else
+    (void)evn;
+    (void)hw;
+    return false;
+#endif
+}
+
 void parser::load_event(const std::string &filp_thread, const std::string &filp_socket, bool append)
 {
     if (filp_thread.empty() && filp_socket.empty() && !append) {
@@ -713,203 +1692,290 @@ void parser::load_event(const std::string &filp_thread, const std::string &filp_
 }
 
 void parser::load_thread_level_event(const std::string &json_filp)
+{
+    load_intel_event(json_filp, einfo::E_PMU_CORE);
+}
+
+void parser::load_socket_level_event(const std::string &json_filp)
+{
+    load_intel_event(json_filp, einfo::E_PMU_UNCORE);
+}
+
+void parser::load_intel_event(const std::string &json_filp, int type)
 {
     if (json_filp.empty()) {
         perfm_fatal("please specify a json file which describes the pmu events\n");
     }
 
-    // Define the root of the property tree
-    property_tree::ptree ptree;
+    intel_event_loader loader(_e_info_raw, type, json_filp);
+    json::reader reader;
 
-    // Read JSON from a the given file and translate it to a property tree.
-    // - Clears existing contents of property tree. In case of error the property tree unmodified.
-    // - Items of JSON arrays are translated into ptree keys with empty names.
-    //   Members of objects are translated into named keys.
-    // - JSON data can be a string, a numeric value, or one of literals "null", "true" and "false".
-    //   During parse, any of the above is copied verbatim into ptree data string.
-    try {
-        json::read_json(json_filp, ptree);
-    } catch (const json::json_parser_error &e) {
-        perfm_fatal("%s\n", e.what());
-    } catch (const std::exception &e) {
-        perfm_fatal("%s\n", e.what());
+    if (!reader.parse_file(json_filp, loader)) {
+        perfm_fatal("%s\n", reader.error().c_str());
+    }
+}
+
+bool parser::load_event_db(const std::string &filp_db, const std::string &filp_thread, const std::string &filp_socket)
+{
+    std::vector<std::string> inputs;
+    if (!filp_thread.empty()) {
+        inputs.push_back(filp_thread);
+    }
+    if (!filp_socket.empty()) {
+        inputs.push_back(filp_socket);
     }
 
-    std::string _e_name; // EventName
-    std::string _e_desc; // BriefDescription
+    evdb::key_t key = evdb::make_key(inputs);
 
-    std::string _e_code; // EventCode
-    std::string _e_umsk; // UMask
-    std::string _e_cmsk; // CounterMask
-    std::string _e_prid; // SampleAfterValue
+    _builtin = nullptr;
 
-    std::string _e_inv;  // Invert
-    std::string _e_any;  // AnyThread
-    std::string _e_edge; // EdgeDetect  
-    std::string _e_pebs; // Precise Event Based Sampling
+    _evdb = evdb::alloc();
+    if (_evdb && _evdb->open(filp_db, key)) {
+        _event_source_list.clear();
+        _event_format_list.clear();
+        _e_info_raw.clear();
 
-    std::string _e_msri; // MSRIndex
-    std::string _e_msrv; // MSRValue
+        for (size_t i = 0; i < _evdb->nr_pmu(); ++i) {
+            const evdb::pmu_t &pmu = _evdb->pmu(i);
 
-    const std::string zero("0");
+            _event_source_list.insert({_evdb->str(pmu.name), pmu.type});
 
-    // FIXME (MsrIndex, MsrValue)
-    
-    for (property_tree::ptree::iterator it = ptree.begin(); it != ptree.end(); ++it) {
-        try { 
-            _e_name = it->second.get<std::string>("EventName");
-            _e_desc = it->second.get<std::string>("BriefDescription");
-
-            _e_code = it->second.get<std::string>("EventCode");  
-            _e_umsk = it->second.get<std::string>("UMask");
-            _e_cmsk = it->second.get<std::string>("CounterMask");
-            _e_prid = it->second.get<std::string>("SampleAfterValue");
-
-            _e_msri = it->second.get<std::string>("MSRIndex");
-            _e_msrv = it->second.get<std::string>("MSRValue");
-
-            _e_inv  = it->second.get<std::string>("Invert");
-            _e_any  = it->second.get<std::string>("AnyThread");
-            _e_edge = it->second.get<std::string>("EdgeDetect");
-            _e_pebs = it->second.get<std::string>("PEBS");
-        } catch (const property_tree::ptree_bad_path &e) {
-            perfm_fatal("%s\n", e.what());
-        } catch (const std::exception &e) {
-            perfm_fatal("%s\n", e.what());
-        }
-
-        einfo_intel::ptr_t e = einfo_intel::alloc();
-        if (!e) {
-            perfm_fatal("failed to alloc einfo object\n");
-        }
+            if (!pmu.nr_format) {
+                continue; /* generic PMUs do not have the format directory */
+            }
 
-        e->_r_name = _e_name;
-        e->_e_desc = _e_desc;
-        
-        try {
-            e->_e_ecode  = std::stoull(_e_code, nullptr, 0); 
-            e->_e_umask  = std::stoull(_e_umsk, nullptr, 0);
-            e->_e_cmask  = std::stoull(_e_cmsk, nullptr, 0);
-            e->_e_period = std::stoull(_e_prid, nullptr, 0);
-            e->_e_msrv   = std::stoull(_e_msrv, nullptr, 0);
-
-            e->_nr_msr = 0;
-            auto slice = str_split(_e_msri, ",");
-            for (size_t i = 0; i < slice.size() && i < 5U; ++i) {
-                e->_e_msri[e->_nr_msr++] = std::stoull(slice[i], nullptr, 0);
+            _event_format_t format;
+            for (size_t f = 0; f < pmu.nr_format; ++f) {
+                const evdb::format_t &fmt = _evdb->format(pmu, f);
+                format.insert({_evdb->str(fmt.name), std::make_tuple(static_cast<int>(fmt.config),
+                                                                     static_cast<int>(fmt.lo),
+                                                                     static_cast<int>(fmt.hi))});
             }
-        } catch (const std::invalid_argument &) {
-            perfm_fatal("\n"); 
-        } catch (const std::out_of_range &) {
-            perfm_fatal("\n"); 
+            _event_format_list.insert({_evdb->str(pmu.name), std::move(format)});
+        }
+
+        _pmu_source_detected = true;
+        _event_table_loaded  = true;
+
+        return true;
+    }
+
+    _evdb.reset();
+
+    // the slow way, then save the result for the next run
+    pmu_detect();
+    load_event(filp_thread, filp_socket);
+
+    _event_table_loaded = true;
+
+    if (!save_event_db(filp_db, key)) {
+        perfm_warn("failed to save the event database %s, ignored\n", filp_db.c_str());
+        return false;
+    }
+
+    // switch to the database just saved, so only the events actually used stay materialized
+    _evdb = evdb::alloc();
+    if (_evdb && _evdb->open(filp_db, key)) {
+        _e_info_raw.clear();
+    } else {
+        _evdb.reset();
+    }
+
+    return false;
+}
+
+bool parser::save_event_db(const std::string &filp, const evdb::key_t &key) const
+{
+    evdb::builder db;
+
+    for (const auto &pmu : _event_source_list) {
+        db.add_pmu(pmu.first, pmu.second);
+
+        auto fmt = _event_format_list.find(pmu.first);
+        if (fmt == _event_format_list.end()) {
+            continue;
+        }
+
+        for (const auto &f : fmt->second) {
+            db.add_format(f.first, std::get<0>(f.second), std::get<1>(f.second), std::get<2>(f.second));
+        }
+    }
+
+    for (const auto &it : _e_info_raw) {
+        const einfo_intel *e = dynamic_cast<const einfo_intel *>(it.second.get());
+        if (!e) {
+            continue;
         }
 
-        e->_e_inv  = _e_inv  != zero;
-        e->_e_any  = _e_any  != zero;
-        e->_e_edge = _e_edge != zero; 
-        e->_e_pebs = _e_pebs != zero;
+        evdb::event_t r;
+        memset(&r, 0, sizeof(r));
 
-        e->_e_type = einfo::E_PMU_CORE;
+        r.type   = e->_e_type;
+        r.nr_msr = e->_nr_msr;
+        r.ecode  = e->_e_ecode;
+        r.umask  = e->_e_umask;
+        r.msrv   = e->_e_msrv;
+        r.cmask  = e->_e_cmask;
+        r.period = e->_e_period;
 
-        auto err = _e_info_raw.insert({_e_name, e});
-        if (!err.second) {
-            perfm_warn("duplicate raw event %s\n", _e_name.c_str());
+        for (int i = 0; i < e->_nr_msr; ++i) {
+            r.msri[i] = e->_e_msri[i];
         }
+
+        r.flags = (e->_e_inv    ? evdb::E_FLAG_INV    : 0) |
+                  (e->_e_any    ? evdb::E_FLAG_ANY    : 0) |
+                  (e->_e_edge   ? evdb::E_FLAG_EDGE   : 0) |
+                  (e->_e_pebs   ? evdb::E_FLAG_PEBS   : 0) |
+                  (e->_e_extsel ? evdb::E_FLAG_EXTSEL : 0);
+
+        db.add_event(r, e->_r_name, e->_e_desc, e->_e_unit, e->_e_filter);
     }
+
+    return db.write(filp, key);
 }
 
-void parser::load_socket_level_event(const std::string &json_filp)
+einfo_intel::ptr_t parser::materialize(const evdb::event_t &r) const
 {
-    if (json_filp.empty()) {
-        perfm_fatal("please specify a json file which describes the pmu events\n");
+    einfo_intel::ptr_t e = einfo_intel::alloc();
+    if (!e) {
+        perfm_fatal("failed to alloc einfo object\n");
     }
 
-    // Define the root of the property tree
-    property_tree::ptree ptree;
+    e->_r_name   = _evdb->str(r.name);
+    e->_e_desc   = _evdb->str(r.desc);
+    e->_e_unit   = _evdb->str(r.unit);
+    e->_e_filter = _evdb->str(r.filter);
+    e->_e_type   = r.type;
+    e->_e_ecode  = r.ecode;
+    e->_e_umask  = r.umask;
+    e->_e_msrv   = r.msrv;
+    e->_e_cmask  = r.cmask;
+    e->_e_period = r.period;
+
+    e->_nr_msr = r.nr_msr;
+    for (int i = 0; i < r.nr_msr && i < 5; ++i) {
+        e->_e_msri[i] = r.msri[i];
+    }
 
-    // Read JSON from a the given file and translate it to a property tree.
-    // - Clears existing contents of property tree. In case of error the property tree unmodified.
-    // - Items of JSON arrays are translated into ptree keys with empty names.
-    //   Members of objects are translated into named keys.
-    // - JSON data can be a string, a numeric value, or one of literals "null", "true" and "false".
-    //   During parse, any of the above is copied verbatim into ptree data string.
-    try {
-        json::read_json(json_filp, ptree);
-    } catch (const json::json_parser_error &e) {
-        perfm_fatal("%s\n", e.what());
-    } catch (const std::exception &e) {
-        perfm_fatal("%s\n", e.what());
+    e->_e_inv    = r.flags & evdb::E_FLAG_INV;
+    e->_e_any    = r.flags & evdb::E_FLAG_ANY;
+    e->_e_edge   = r.flags & evdb::E_FLAG_EDGE;
+    e->_e_pebs   = r.flags & evdb::E_FLAG_PEBS;
+    e->_e_extsel = r.flags & evdb::E_FLAG_EXTSEL;
+
+    return e;
+}
+
+einfo_intel::ptr_t parser::materialize(const builtin::event_t &r) const
+{
+    einfo_intel::ptr_t e = einfo_intel::alloc();
+    if (!e) {
+        perfm_fatal("failed to alloc einfo object\n");
     }
 
-    std::string _e_name; // EventName
-    std::string _e_desc; // BriefDescription
-    std::string _e_unit; // Unit
+    e->_r_name   = r.name;
+    e->_e_desc   = r.desc;
+    e->_e_unit   = r.unit;
+    e->_e_filter = r.filter;
+    e->_e_type   = r.type;
+    e->_e_ecode  = r.ecode;
+    e->_e_umask  = r.umask;
+    e->_e_msrv   = r.msrv;
+    e->_e_cmask  = r.cmask;
+    e->_e_period = r.period;
+
+    e->_nr_msr = r.nr_msr;
+    for (int i = 0; i < r.nr_msr && i < 5; ++i) {
+        e->_e_msri[i] = r.msri[i];
+    }
 
-    std::string _e_code; // EventCode
-    std::string _e_umsk; // UMask
-    
-    std::string _e_esel; // ExtSel
-    
-    std::string _e_msrv; // MSRValue
+    e->_e_inv    = r.flags & evdb::E_FLAG_INV;
+    e->_e_any    = r.flags & evdb::E_FLAG_ANY;
+    e->_e_edge   = r.flags & evdb::E_FLAG_EDGE;
+    e->_e_pebs   = r.flags & evdb::E_FLAG_PEBS;
+    e->_e_extsel = r.flags & evdb::E_FLAG_EXTSEL;
 
-    const std::string zero("0");
-    
-    for (property_tree::ptree::iterator it = ptree.begin(); it != ptree.end(); ++it) {
-        try { 
-            _e_name = it->second.get<std::string>("EventName");
-            _e_desc = it->second.get<std::string>("BriefDescription");
-            _e_unit = it->second.get<std::string>("Unit");
+    return e;
+}
 
-            _e_code = it->second.get<std::string>("EventCode");  
-            _e_umsk = it->second.get<std::string>("UMask");
+bool parser::load_builtin(const std::string &cpuid)
+{
+    _builtin = builtin::find_table(cpuid);
+    if (!_builtin) {
+        return false;
+    }
 
-            _e_msrv = it->second.get<std::string>("MSRValue");
-            _e_esel = it->second.get<std::string>("ExtSel");
-        } catch (const property_tree::ptree_bad_path &e) {
-            perfm_fatal("%s\n", e.what());
-        } catch (const std::exception &e) {
-            perfm_fatal("%s\n", e.what());
-        }
+    _evdb.reset();
+    _e_info_raw.clear();
 
-        einfo_intel::ptr_t e = einfo_intel::alloc();
-        if (!e) {
-            perfm_fatal("failed to alloc einfo object\n");
-        }
+    _event_table_loaded = true;
 
-        e->_r_name = _e_name;
-        e->_e_desc = _e_desc;
-        
-        try {
-            e->_e_ecode = std::stoull(_e_code, nullptr, 0); 
-            e->_e_umask = std::stoull(_e_umsk, nullptr, 0);
-            e->_e_msrv  = std::stoull(_e_msrv, nullptr, 0);
-        } catch (const std::invalid_argument &) {
-            perfm_fatal("\n"); 
-        } catch (const std::out_of_range &) {
-            perfm_fatal("\n"); 
+    return true;
+}
+
+std::vector<einfo::ptr_t> parser::event_list()
+{
+    std::vector<einfo::ptr_t> res;
+
+    if (_evdb) {
+        for (size_t i = 0; i < _evdb->nr_event(); ++i) {
+            res.push_back(find_event(_evdb->str(_evdb->event(i).name)));
+        }
+    } else if (_builtin) {
+        for (uint32_t i = 0; i < _builtin->nr_event; ++i) {
+            res.push_back(find_event(_builtin->event[i].name));
+        }
+    } else {
+        for (const auto &e : _e_info_raw) {
+            res.push_back(e.second);
         }
+    }
+
+    return res;
+}
 
-        e->_e_unit   = _e_unit;
-        e->_e_extsel = _e_esel != zero;
+einfo::ptr_t parser::find_event(const std::string &name)
+{
+    auto it = _e_info_raw.find(name);
+    if (it != _e_info_raw.end()) {
+        return it->second;
+    }
 
-        e->_e_type = einfo::E_PMU_UNCORE;
+    einfo::ptr_t e;
 
-        auto err = _e_info_raw.insert({_e_name, e});
-        if (!err.second) {
-            perfm_warn("duplicate raw event %s\n", _e_name.c_str());
+    if (_evdb) {
+        const evdb::event_t *r = _evdb->find(name);
+        if (r) {
+            e = materialize(*r);
         }
+    } else if (_builtin) {
+        const builtin::event_t *r = builtin::find_event(*_builtin, name.c_str());
+        if (r) {
+            e = materialize(*r);
+        }
+    }
+
+    if (!e) {
+        return nullptr;
     }
+
+    // cache it, so _e_perf etc. filled in later are kept
+    _e_info_raw.insert({name, e});
+
+    return e;
 }
 
 } /* namespace perfm */
 
+#ifdef PERFM_PARSER_MAIN
+
 int main(int argc, char **argv)
 {
     perfm::parser::ptr_t parser = perfm::parser::alloc();
 
-    parser->pmu_detect();
-
-    parser->load_event("events/intel/BroadwellX_core_V10.json", "events/intel/BroadwellX_uncore_V10.json");
+    parser->load_event_db("__perfm_event_db.bin", "events/intel/BroadwellX_core_V10.json", "events/intel/BroadwellX_uncore_V10.json");
 
     parser->print();
 }
+
+#endif /* PERFM_PARSER_MAIN */
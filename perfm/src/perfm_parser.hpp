@@ -54,11 +54,18 @@
 #include <unordered_map>
 #include <memory>
 #include <tuple>
+#include <string>
+#include <utility>
+#include <cstdio>
+#include <cstdint>
 
 #include <dirent.h>
 
 #include "linux/perf_event.h"
 
+#include "perfm_evdb.hpp"
+#include "perfm_builtin.hpp"
+
 namespace perfm {
 
 //
@@ -141,22 +148,22 @@ public:
      * 
      * these fields should be valid for any type events
      */
-    uint64_t _e_ecode; // EventCode
-    uint64_t _e_umask; // UMask
-    uint64_t _e_msrv;  // MSRValue
+    uint64_t _e_ecode = 0; // EventCode
+    uint64_t _e_umask = 0; // UMask
+    uint64_t _e_msrv  = 0; // MSRValue
 
     /* Fields only for core pmu event
      *
      * these fields will be valid only when @_e_type == E_PMU_CORE
      */
-    uint64_t _e_msri[5]; // MSRIndex
-    uint64_t _e_cmask;   // CounterMask
-    bool _e_inv;         // Invert
-    bool _e_any;         // AnyThread
-    bool _e_edge;        // EdgeDetect
-    bool _e_pebs;        // Precise Event Based Sampling, a profiling technology in Intel CPUs 
-                         // that uses microcode to do (mostly) _precise_ event samples.
-    uint64_t _e_period;  // SampleAfterValue
+    uint64_t _e_msri[5] = { 0 }; // MSRIndex
+    uint64_t _e_cmask   = 0;     // CounterMask
+    bool _e_inv  = false;        // Invert
+    bool _e_any  = false;        // AnyThread
+    bool _e_edge = false;        // EdgeDetect
+    bool _e_pebs = false;        // Precise Event Based Sampling, a profiling technology in Intel CPUs 
+                                 // that uses microcode to do (mostly) _precise_ event samples.
+    uint64_t _e_period  = 0;     // SampleAfterValue
 
     int _nr_msr = 0; 
 
@@ -164,8 +171,10 @@ public:
      *
      * these fields will be valid only when @_e_type == E_PMU_UNCORE
      */
-    std::string _e_unit; // Unit
-    bool _e_extsel;      // ExtSel
+    std::string _e_unit;  // Unit
+    bool _e_extsel = false; // ExtSel
+    std::string _e_filter;  // Filter, the box filter the event needs, e.g. "CBoFilter0[23:17]"
+                            // (01.org) or "filter_state=0x1" (perf), empty if none
 };
 
 class einfo_loongson : public einfo {
@@ -193,6 +202,8 @@ public:
 public:
     static ptr_t alloc();
 
+    ~parser();
+
 public:
     /**
      * pmu_detect - detect all available PMUs provided by linux's perf_event subsystem
@@ -227,15 +238,60 @@ public:
      */
     void load_event(const std::string &filp_thread, const std::string &filp_socket, bool append = false);
 
+    /**
+     * load_event_db - load PMUs, PMU formats & events from a precompiled event database
+     *
+     * @filp_db:     the database file, see perfm_evdb.hpp
+     * @filp_thread: json file for thread level event (core pmu)
+     * @filp_socket: json file for socket level event (uncore pmu)
+     *
+     * Description:
+     *     if @filp_db matches this machine & the json files, it's mmap'ed and queried in place,
+     *     pmu_detect() & load_event() are not needed. otherwise they are done the slow way and
+     *     @filp_db is (re)generated for the next run.
+     *
+     *     either way the events end up in the database, an einfo object is only created when an
+     *     event is looked up by find_event()
+     *
+     * Return:
+     *     true:  loaded from @filp_db
+     *     false: loaded the slow way
+     */
+    bool load_event_db(const std::string &filp_db, const std::string &filp_thread, const std::string &filp_socket);
+
+    /**
+     * load_builtin - use the event table compiled into perfm for processor @cpuid, see perfm_builtin.hpp
+     *
+     * Return:
+     *     true:  a builtin table is used, load_event_db() & load_event() are not needed,
+     *            pmu_detect() still is
+     *     false: perfm is built without PERFM_BUILTIN, or there is no table for @cpuid
+     */
+    bool load_builtin(const std::string &cpuid);
+
+    /**
+     * event_list - all the events of the loaded tables (einfo objects are created for all of them)
+     */
+    std::vector<einfo::ptr_t> event_list();
+
+    /**
+     * find_event - find the description of raw event @name
+     *
+     * Return:
+     *     nullptr if not found
+     */
+    einfo::ptr_t find_event(const std::string &name);
+
     /**
      * parse_perf_event - resolve perf style event descriptions to attr
      * 
-     * @e:  perf style event description (e.g. cpu/event=1/)
+     * @e:  perf style event description (e.g. cycles:u, r01c2, cpu/event=0x3c,name=cyc/k, cpu/config=0x3c/)
      * @hw: perf_event_attr to fill in
      *
      * Description:
      *     Resolve perf style event descriptor to `perf_event_attr`. The `perf_event_attr` structure
      *     will be cleared firstly. User must initialize other fields of `perf_event_attr` _after_ this call
+     *     See the implementation for the accepted forms, modifiers are handled by parse_modifier()
      *
      * Return:
      *     true:  succ
@@ -243,6 +299,32 @@ public:
      */
     bool parse_perf_event(const std::string &e, struct perf_event_attr *hw);
 
+    /* whether @e is in one of the forms parse_perf_event() accepts */
+    bool is_perf_event(const std::string &e) const;
+
+    /**
+     * split_events - split an event list at the top level commas
+     *
+     * Description:
+     *     commas inside 'pmu/.../' & '{...}' do not split, e.g.
+     *     "cycles,cpu/event=0x3c,umask=0/,{a,b}" --> "cycles", "cpu/event=0x3c,umask=0/", "{a,b}"
+     */
+    static std::vector<std::string> split_events(const std::string &list);
+
+    /**
+     * split_groups - expand perf's group braces in an event list
+     *
+     * Return:
+     *     one event list for each {...}, modifiers after '}' applied to each member, and one list
+     *     for each run of events outside braces, all in the order given, e.g.
+     *     "branches,{cycles,instructions}:u,faults" --> "branches", "cycles:u,instructions:u", "faults"
+     *     a group followed by anything but modifiers (e.g. "{a,b}:u{c,d}") is rejected
+     */
+    static std::vector<std::string> split_groups(const std::string &list);
+
+    /* the label of @e given by the 'name=' term, e.g. cpu/event=0x3c,name=cyc/ --> cyc, otherwise @e itself */
+    static std::string event_label(const std::string &e);
+
     /**
      * parse_raw_event - turn raw event descriptor to perf style descriptor
      *
@@ -261,8 +343,85 @@ public:
 
     bool parse_event(const std::string &raw, struct perf_event_attr *hw);
 
+    /**
+     * encode - resolve any event string perfm accepts to `perf_event_attr`
+     *
+     * @evn: event string, one of
+     *       - a perf style descriptor:  cpu/event=0x3c,umask=0x0/, r01c2
+     *       - a generic perf event:     PERF_COUNT_HW_CPU_CYCLES[:u|:k]
+     *       - a raw (json) event:       INST_RETIRED.ANY_P, or libpfm4's form INST_RETIRED:ANY_P
+     *                                   followed by modifiers, e.g. :u :k :c=2 :i :e :t
+     * @hw:  perf_event_attr to fill in, cleared firstly
+     *
+     * Description:
+     *     the result of each @evn is cached, so an event opened on N cpus is encoded only once.
+     *     if perfm is built with PERFM_USE_LIBPFM, events which can not be encoded natively
+     *     (e.g. not in the json files) fall back to libpfm4, which is initialized at the first use.
+     *
+     * Return:
+     *     true:  succ
+     *     false: failed
+     */
+    bool encode(const std::string &evn, struct perf_event_attr *hw);
+
+    /**
+     * extra_msr - the extra MSR an encoded core event programs besides its counter
+     *
+     * @hw:  an encoded event
+     * @val: the value written to that MSR (res), may be nullptr
+     *
+     * Description:
+     *     offcore response events (0xb7/0xbb) use MSR_OFFCORE_RSP_0/1 (0x1a6/0x1a7), load latency
+     *     (0xcd) uses MSR_PEBS_LD_LAT (0x3f6) and the frontend events (0xc6) use MSR_PEBS_FRONTEND
+     *     (0x3f7). each core has only one of them, so events with different values conflict.
+     *     the kernel moves an offcore event to the other offcore MSR if the first one is busy.
+     *
+     * Return:
+     *     the MSR's index, or 0 if @hw does not use any
+     */
+    uint32_t extra_msr(const struct perf_event_attr &hw, uint64_t *val = nullptr) const;
+
+    /**
+     * expand_uncore - expand a logical uncore event to each box of its unit
+     *
+     * @evn: uncore event, e.g. UNC_C_LLC_LOOKUP.ANY or UNC_M_CAS_COUNT:RD, followed by optional
+     *       modifiers :c= :i :e, other modifiers are passed to the box PMU as is, e.g. :filter_state=0x1f
+     * @res: perf style descriptor of each box (res), e.g. uncore_cbox_0/event=0x34,umask=0x11/
+     * @verbose: warn about a required box filter which is not given
+     *
+     * Description:
+     *     the box PMUs are those detected by pmu_detect() whose name is the unit's prefix
+     *     (uncore_cbox, uncore_imc, ...) followed by an optional _<box id>, sorted by box id
+     *
+     *     some events count nothing without a box filter (the json "Filter", e.g. a state filter
+     *     for UNC_C_LLC_LOOKUP.*). one given in perf's form (filter_state=0x1) is applied unless
+     *     the user passed a filter_* modifier; one only naming the register field (01.org's
+     *     CBoFilter0[23:17]) has no value to apply, so the user is warned to pass it.
+     *
+     * Return:
+     *     true  - @evn is an uncore event & at least one box is found
+     *     false - otherwise
+     */
+    bool expand_uncore(const std::string &evn, std::vector<std::string> &res, bool verbose = true);
+
+    /* whether @evn names an uncore (socket level) event */
+    bool is_uncore(const std::string &evn);
+
     void print() const;
 
+    /**
+     * list_event - print the events matching @query, ranked, with their perf style encodings
+     *
+     * @query  words separated by spaces, matched against the names & descriptions, see perfm_evindex.hpp
+     * @limit  max # of events to print, 0 for all
+     * @fp     file stream to write to
+     *
+     * Description:
+     *     the perf symbolic events & the events of the loaded tables are searched, an uncore event
+     *     is shown with the encoding of its first box
+     */
+    void list_event(const std::string &query, size_t limit = 0, FILE *fp = stdout);
+
     std::string pmu_name(int type) const;
 
 private:
@@ -294,6 +453,11 @@ private:
     void detect_encode_format(const std::string &pmu);
 
     bool parse_modifier(struct perf_event_attr *, const std::string &m) const;
+    bool parse_generic_event(struct perf_event_attr *, const std::string &e) const;
+    bool parse_cache_event(struct perf_event_attr *, const std::string &e) const;
+
+    bool encode_native(const std::string &evn, struct perf_event_attr *hw);
+    bool encode_libpfm(const std::string &evn, struct perf_event_attr *hw);
     bool parse_pmu_type(struct perf_event_attr *, const std::string &p) const;
     bool parse_encoding(struct perf_event_attr *, const std::string &p, const std::string &e) const;
 
@@ -303,7 +467,8 @@ private:
      * @filp  json file to load from
      *
      * Description:
-     *     TODO
+     *     the file is streamed in one pass, each event object fills an einfo_intel directly.
+     *     only EventName is required, the other fields default to 0/false if missing
      */
     void load_thread_level_event(const std::string &filp);
 
@@ -313,10 +478,17 @@ private:
      * @filp  json file to load from
      *
      * Description:
-     *     TODO
+     *     same as load_thread_level_event()
      */
     void load_socket_level_event(const std::string &filp);
 
+    void load_intel_event(const std::string &filp, int type);
+
+    bool save_event_db(const std::string &filp, const evdb::key_t &key) const;
+
+    einfo_intel::ptr_t materialize(const evdb::event_t &e) const;
+    einfo_intel::ptr_t materialize(const builtin::event_t &e) const;
+
 private:
     /* event sources provided by linux's perf_event subsystem 
      *
@@ -365,6 +537,10 @@ private:
 private:
     std::unordered_map<std::string, einfo::ptr_t> _e_info_raw;
 
+    evdb::ptr_t _evdb; /* if loaded from the event database, events not in @_e_info_raw are looked up here */
+
+    const builtin::table_t *_builtin = nullptr; /* same as @_evdb, for the compiled-in table */
+
 private:
     /* perf style descriptor to `perf_event_attr` cache
      *
@@ -375,11 +551,79 @@ private:
      */
     std::unordered_map<std::string, struct perf_event_attr *> _p2a_cache;
 
+    /* event string to `perf_event_attr` cache, see encode() */
+    std::unordered_map<std::string, struct perf_event_attr> _encode_cache;
+
+    bool _pfm_initialized = false; /* libpfm4, only initialized when it's needed */
+
     // basedon intel's jevent lib, cache.c
     const std::unordered_map<std::string, std::string> _fixed_cntr_events = {
         {"INST_RETIRED.ANY",             "event=0xc0"}, 
         {"CPU_CLK_UNHALTED.THREAD",      "event=0x3c"}, 
         {"CPU_CLK_UNHALTED.THREAD_ANY",  "event=0x3c,any=1"}, 
+        {"CPU_CLK_UNHALTED.REF_TSC",     "event=0x00,umask=0x03"}, 
+    };
+
+    /* generic events (PERF_TYPE_HARDWARE & PERF_TYPE_SOFTWARE), named as libpfm4's perf PMU does
+     *
+     * key: event name
+     * val: <perf_event_attr.type, perf_event_attr.config>
+     */
+    const std::unordered_map<std::string, std::pair<uint32_t, uint64_t>> _generic_events = {
+        {"PERF_COUNT_HW_CPU_CYCLES",              {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}},
+        {"PERF_COUNT_HW_INSTRUCTIONS",            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}},
+        {"PERF_COUNT_HW_CACHE_REFERENCES",        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES}},
+        {"PERF_COUNT_HW_CACHE_MISSES",            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}},
+        {"PERF_COUNT_HW_BRANCH_INSTRUCTIONS",     {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS}},
+        {"PERF_COUNT_HW_BRANCH_MISSES",           {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}},
+        {"PERF_COUNT_HW_BUS_CYCLES",              {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES}},
+        {"PERF_COUNT_HW_STALLED_CYCLES_FRONTEND", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND}},
+        {"PERF_COUNT_HW_STALLED_CYCLES_BACKEND",  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND}},
+        {"PERF_COUNT_HW_REF_CPU_CYCLES",          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES}},
+
+        {"PERF_COUNT_SW_CPU_CLOCK",               {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK}},
+        {"PERF_COUNT_SW_TASK_CLOCK",              {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}},
+        {"PERF_COUNT_SW_PAGE_FAULTS",             {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}},
+        {"PERF_COUNT_SW_CONTEXT_SWITCHES",        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}},
+        {"PERF_COUNT_SW_CPU_MIGRATIONS",          {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}},
+        {"PERF_COUNT_SW_PAGE_FAULTS_MIN",         {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN}},
+        {"PERF_COUNT_SW_PAGE_FAULTS_MAJ",         {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ}},
+        {"PERF_COUNT_SW_ALIGNMENT_FAULTS",        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_ALIGNMENT_FAULTS}},
+        {"PERF_COUNT_SW_EMULATION_FAULTS",        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_EMULATION_FAULTS}},
+    };
+
+    /* generic events named as perf does (perf list), the generic hardware cache events are
+     * handled by parse_cache_event()
+     */
+    const std::unordered_map<std::string, std::pair<uint32_t, uint64_t>> _symbolic_events = {
+        {"cycles",                  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}},
+        {"cpu-cycles",              {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}},
+        {"instructions",            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}},
+        {"cache-references",        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES}},
+        {"cache-misses",            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}},
+        {"branches",                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS}},
+        {"branch-instructions",     {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS}},
+        {"branch-misses",           {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}},
+        {"bus-cycles",              {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES}},
+        {"stalled-cycles-frontend", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND}},
+        {"idle-cycles-frontend",    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND}},
+        {"stalled-cycles-backend",  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND}},
+        {"idle-cycles-backend",     {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND}},
+        {"ref-cycles",              {PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES}},
+
+        {"cpu-clock",               {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK}},
+        {"task-clock",              {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}},
+        {"page-faults",             {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}},
+        {"faults",                  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}},
+        {"context-switches",        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}},
+        {"cs",                      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}},
+        {"cpu-migrations",          {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}},
+        {"migrations",              {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}},
+        {"minor-faults",            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN}},
+        {"major-faults",            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ}},
+        {"alignment-faults",        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_ALIGNMENT_FAULTS}},
+        {"emulation-faults",        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_EMULATION_FAULTS}},
+        {"dummy",                   {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_DUMMY}},
     };
 
     /* attribute field mapping between intel's event description file to perf's format 
@@ -399,8 +643,40 @@ private:
         {"AnyThread",         "any"},  
         {"EdgeDetect",        "edge"},  
     };
+
+    /* box PMUs of each uncore unit
+     *
+     * key: Unit in intel's uncore event description file
+     * val: prefix of the box PMUs in /sys/bus/event_source/devices/ (e.g. uncore_cbox_0 ... uncore_cbox_21)
+     */
+    const std::unordered_map<std::string, std::string> _uncore_units = {
+        {"CBO",    "uncore_cbox"},
+        {"SBO",    "uncore_sbox"},
+        {"HA",     "uncore_ha"},
+        {"iMC",    "uncore_imc"},
+        {"IRP",    "uncore_irp"},
+        {"PCU",    "uncore_pcu"},
+        {"QPI LL", "uncore_qpi"},
+        {"R2PCIe", "uncore_r2pcie"},
+        {"R3QPI",  "uncore_r3qpi"},
+        {"UBOX",   "uncore_ubox"},
+    };
+
+    /* the perf format term used to program the extra MSR of an event
+     *
+     * key: MSRIndex in intel's event description file
+     * val: the term in /sys/bus/event_source/devices/cpu/format (all in config1)
+     */
+    const std::unordered_map<uint64_t, std::string> _msr_fields_mapping = {
+        {0x1a6, "offcore_rsp"}, // MSR_OFFCORE_RSP_0
+        {0x1a7, "offcore_rsp"}, // MSR_OFFCORE_RSP_1
+        {0x3f6, "ldlat"},       // MSR_PEBS_LD_LAT
+        {0x3f7, "frontend"},    // MSR_PEBS_FRONTEND
+    };
 };
 
+extern parser perfm_parser; /* the global event parser/encoder for perfm */
+
 } /* namespace perfm */
 
 #endif /* __PERFM_PARSER_HPP__ */
@@ -0,0 +1,385 @@
+#include "perfm_util.hpp"
+#include "perfm_event.hpp"
+#include "perfm_rapl.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <map>
+#include <new>
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <time.h>
+#include <cpuid.h>
+
+namespace {
+
+const std::string power_pmu_dir("/sys/bus/event_source/devices/power/");
+
+const char *power_pmu_event[perfm::rapl::RAPL_DOMAIN_MAX] = {
+    "energy-pkg",
+    "energy-ram",
+};
+
+const uint32_t energy_status_msr[perfm::rapl::RAPL_DOMAIN_MAX] = {
+    perfm::MSR_PKG_ENERGY_STATUS,
+    perfm::MSR_DRAM_ENERGY_STATUS,
+};
+
+double monotonic_seconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * server parts whose DRAM domain uses the fixed 15.3uJ unit, see perfm_rapl.hpp. the models of
+ * rapl_defaults_hsw_server & rapl_defaults_spr_server in linux drivers/powercap/intel_rapl_common.c
+ */
+bool dram_fixed_unit()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+
+    unsigned int family = (eax >> 8) & 0xf;
+    unsigned int model  = ((eax >> 4) & 0xf) | (((eax >> 16) & 0xf) << 4);
+
+    if (family != 6) {
+        return false;
+    }
+
+    switch (model) {
+    case 0x3f: /* Haswell-EP */
+    case 0x4f: /* Broadwell-EP */
+    case 0x56: /* Broadwell-DE */
+    case 0x55: /* Skylake-SP */
+    case 0x57: /* Knights Landing */
+    case 0x85: /* Knights Mill */
+    case 0x6a: /* Icelake-SP */
+    case 0x6c: /* Icelake-D */
+    case 0x8f: /* Sapphire Rapids */
+    case 0xcf: /* Emerald Rapids */
+    case 0xad: /* Granite Rapids-X */
+    case 0xae: /* Granite Rapids-D */
+    case 0xaf: /* Sierra Forest */
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+} /* namespace */
+
+namespace perfm {
+
+rapl::ptr_t rapl::alloc()
+{
+    rapl *p = nullptr;
+
+    try {
+        p = new rapl;
+    } catch (const std::bad_alloc &) {
+        p = nullptr;
+    }
+
+    return ptr_t(p);
+}
+
+bool rapl::open()
+{
+    close();
+
+    detect_unit();
+
+    if (open_perf()) {
+        _via_perf = true;
+    } else if (open_msr()) {
+        _via_perf = false;
+    } else {
+        perfm_warn("RAPL is not available (neither the power PMU nor /dev/cpu/*/msr)\n");
+        return false;
+    }
+
+    _primed = false;
+
+    return _available[RAPL_PKG];
+}
+
+void rapl::close()
+{
+    for (auto &s : _socket) {
+        for (int d = 0; d < RAPL_DOMAIN_MAX; ++d) {
+            if (s.evt[d]) {
+                s.evt[d]->close();
+            }
+        }
+    }
+
+    _socket.clear();
+    _msr.close();
+
+    _available[RAPL_PKG]  = false;
+    _available[RAPL_DRAM] = false;
+}
+
+void rapl::detect_unit()
+{
+    _unit[RAPL_PKG]  = 1.0 / (1 << 14);
+    _unit[RAPL_DRAM] = 1.0 / (1 << 16);
+
+    uint64_t val = 0;
+    if (msr::rdmsr(0, MSR_RAPL_POWER_UNIT, &val) == msr::MSR_OK) {
+        _unit[RAPL_PKG]  = 1.0 / (1UL << ((val >> 8) & 0x1f));
+        _unit[RAPL_DRAM] = dram_fixed_unit() ? 1.0 / (1 << 16) : _unit[RAPL_PKG];
+    }
+}
+
+bool rapl::open_perf()
+{
+    int type = -1;
+    {
+        std::fstream fp(power_pmu_dir + "type", std::ios::in);
+        if (!fp.good() || !(fp >> type)) {
+            return false;
+        }
+    }
+
+    std::string mask;
+    {
+        std::fstream fp(power_pmu_dir + "cpumask", std::ios::in);
+        if (!fp.good() || !std::getline(fp, mask)) {
+            return false;
+        }
+    }
+
+    for (int c : parse_cpu_list(mask)) {
+        socket_t s;
+
+        s.id  = cpu_package_id(c);
+        s.cpu = c;
+
+        for (int d = 0; d < RAPL_DOMAIN_MAX; ++d) {
+            s.prev[d]  = 0;
+            s.delta[d] = 0;
+        }
+
+        _socket.push_back(s);
+    }
+
+    if (_socket.empty()) {
+        return false;
+    }
+
+    for (int d = 0; d < RAPL_DOMAIN_MAX; ++d) {
+        const std::string evn = power_pmu_dir + "events/" + power_pmu_event[d];
+
+        std::string enc;
+        double scale = 0;
+        {
+            std::fstream fp(evn, std::ios::in);
+            std::fstream fs(evn + ".scale", std::ios::in);
+
+            if (!fp.good() || !std::getline(fp, enc) || !fs.good() || !(fs >> scale)) {
+                continue; /* e.g. no energy-ram on client parts */
+            }
+        }
+
+        unsigned long long config = 0;
+        if (std::sscanf(enc.c_str(), "event=%llx", &config) != 1) {
+            perfm_warn("invalid encoding %s for %s\n", enc.c_str(), power_pmu_event[d]);
+            continue;
+        }
+
+        struct perf_event_attr hw;
+        memset(&hw, 0, sizeof(hw));
+
+        hw.size   = sizeof(hw);
+        hw.type   = type;
+        hw.config = config;
+
+        bool succ = true;
+
+        for (auto &s : _socket) {
+            s.evt[d] = descriptor::alloc();
+            if (!s.evt[d] || !s.evt[d]->open(&hw, -1, s.cpu, -1, 0)) {
+                succ = false;
+                break;
+            }
+        }
+
+        if (!succ) {
+            for (auto &s : _socket) {
+                if (s.evt[d]) {
+                    s.evt[d]->close();
+                    s.evt[d].reset();
+                }
+            }
+            continue;
+        }
+
+        _scale[d]     = scale;
+        _available[d] = true;
+    }
+
+    if (!_available[RAPL_PKG]) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool rapl::open_msr()
+{
+    // the first online cpu of each socket
+    std::string online;
+    {
+        std::fstream fp("/sys/devices/system/cpu/online", std::ios::in);
+        if (!fp.good() || !std::getline(fp, online)) {
+            return false;
+        }
+    }
+
+    std::map<int, int> skt2cpu;
+    for (int c : parse_cpu_list(online)) {
+        int skt = cpu_package_id(c);
+        if (skt >= 0 && skt2cpu.find(skt) == skt2cpu.end()) {
+            skt2cpu.insert({skt, c});
+        }
+    }
+
+    for (const auto &it : skt2cpu) {
+        socket_t s;
+
+        s.id  = it.first;
+        s.cpu = it.second;
+
+        for (int d = 0; d < RAPL_DOMAIN_MAX; ++d) {
+            s.prev[d]  = 0;
+            s.delta[d] = 0;
+        }
+
+        _socket.push_back(s);
+    }
+
+    if (_socket.empty()) {
+        return false;
+    }
+
+    for (int d = 0; d < RAPL_DOMAIN_MAX; ++d) {
+        uint64_t val = 0;
+        bool succ = true;
+
+        for (const auto &s : _socket) {
+            if (_msr.read(s.cpu, energy_status_msr[d], &val) != msr::MSR_OK) {
+                succ = false;
+                break;
+            }
+        }
+
+        _scale[d]     = _unit[d];
+        _available[d] = succ;
+    }
+
+    if (!_available[RAPL_PKG]) {
+        _socket.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void rapl::read()
+{
+    double now = monotonic_seconds();
+
+    _tdiff = now - _tprev;
+    _tprev = now;
+
+    // via MSR, the energy status of all the sockets in one batch
+    std::vector<int> cpus;
+    std::vector<uint32_t> regs;
+    std::vector<uint64_t> vals;
+    std::vector<int> errs;
+
+    size_t col[RAPL_DOMAIN_MAX] = { 0, 0 }; /* of each domain in @regs */
+
+    if (!_via_perf) {
+        for (const auto &s : _socket) {
+            cpus.push_back(s.cpu);
+        }
+
+        for (int d = 0; d < RAPL_DOMAIN_MAX; ++d) {
+            if (_available[d]) {
+                col[d] = regs.size();
+                regs.push_back(energy_status_msr[d]);
+            }
+        }
+
+        _msr.read(cpus, regs, vals, &errs);
+    }
+
+    for (size_t i = 0; i < _socket.size(); ++i) {
+        socket_t &s = _socket[i];
+
+        for (int d = 0; d < RAPL_DOMAIN_MAX; ++d) {
+            if (!_available[d]) {
+                continue;
+            }
+
+            uint64_t val  = 0;
+            uint64_t diff = 0;
+
+            if (_via_perf) {
+                if (::read(s.evt[d]->fd(), &val, sizeof(val)) != sizeof(val)) {
+                    perfm_warn("failed to read %s on cpu %d\n", power_pmu_event[d], s.cpu);
+                    continue;
+                }
+                diff = val - s.prev[d];
+            } else {
+                if (errs[i] != msr::MSR_OK) {
+                    perfm_warn("failed to read MSR 0x%x on cpu %d\n", energy_status_msr[d], s.cpu);
+                    continue;
+                }
+                val  = vals[i * regs.size() + col[d]];
+                val &= 0xffffffffUL;                   /* bits 31:0 */
+                diff = (val - s.prev[d]) & 0xffffffffUL; /* handle the 32 bit wraparound */
+            }
+
+            s.delta[d] = _primed ? diff * _scale[d] : 0;
+            s.prev[d]  = val;
+        }
+    }
+
+    _primed = true;
+}
+
+double rapl::joules(size_t s, int domain) const
+{
+    if (s >= _socket.size() || !available(domain)) {
+        return 0;
+    }
+
+    return _socket[s].delta[domain];
+}
+
+double rapl::watts(size_t s, int domain) const
+{
+    if (_tdiff <= 0) {
+        return 0;
+    }
+
+    return joules(s, domain) / _tdiff;
+}
+
+} /* namespace perfm */
@@ -0,0 +1,141 @@
+/**
+ * perfm_rapl.hpp - package & DRAM energy/power per socket (Intel RAPL)
+ *
+ */
+#ifndef __PERFM_RAPL_HPP__
+#define __PERFM_RAPL_HPP__
+
+#include "perfm_event.hpp"
+
+#include "../../msr/msr.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+
+namespace perfm {
+
+// RAPL (Running Average Power Limit) energy counters, one set per socket
+//
+// - through the `power` perf PMU (/sys/bus/event_source/devices/power/), since linux 3.14
+//   events/energy-pkg, events/energy-ram  : encoding, e.g. "event=0x02"
+//   events/energy-*.scale                 : Joules per count, e.g. 2.3283064365386962890625e-10
+//   cpumask                               : one designated cpu for each socket
+//   the kernel accumulates the (32 bit) hardware counters into 64 bit, so no wraparound here
+//
+// - through MSRs (/dev/cpu/<cpu>/msr), if the above is not available
+//   MSR_RAPL_POWER_UNIT   (0x606) : bits 12:8 Energy Status Units, energy unit = 1 / 2^ESU Joules
+//   MSR_PKG_ENERGY_STATUS (0x611) : bits 31:0 total package energy consumed, wraps around
+//   MSR_DRAM_ENERGY_STATUS(0x619) : bits 31:0 total DRAM energy consumed, wraps around
+//   on the Xeon servers since Haswell-EP (HSX, BDX, SKX/CLX/CPX, ICX, SPR, EMR, GNR, SRF) & Xeon Phi
+//   the DRAM domain uses a fixed unit of 15.3uJ (2^-16 J) instead of the ESU in MSR_RAPL_POWER_UNIT
+
+constexpr uint32_t MSR_RAPL_POWER_UNIT    = 0x606;
+constexpr uint32_t MSR_PKG_ENERGY_STATUS  = 0x611;
+constexpr uint32_t MSR_DRAM_ENERGY_STATUS = 0x619;
+
+class rapl {
+
+public:
+    using ptr_t = std::shared_ptr<rapl>;
+
+    enum {
+        RAPL_PKG = 0,
+        RAPL_DRAM,
+        RAPL_DOMAIN_MAX
+    };
+
+public:
+    static ptr_t alloc();
+
+    ~rapl() {
+        close();
+    }
+
+    /**
+     * open - find one cpu for each socket & open the energy counters on it
+     *
+     * Return:
+     *     true  - at least the package domain is available (perf PMU or MSR)
+     *     false - RAPL is not available on this system
+     */
+    bool open();
+    void close();
+
+    /**
+     * read - sample all the energy counters & compute the energy consumed since the previous read()
+     *
+     * Description:
+     *     the first read() after open() only sets the baseline
+     */
+    void read();
+
+    size_t nr_socket() const {
+        return _socket.size();
+    }
+
+    /* physical package id of the @s-th socket */
+    int socket_id(size_t s) const {
+        return s < _socket.size() ? _socket[s].id : -1;
+    }
+
+    bool available(int domain) const {
+        return domain >= 0 && domain < RAPL_DOMAIN_MAX && _available[domain];
+    }
+
+    /* energy (J) consumed by @domain on the @s-th socket during the last read() interval */
+    double joules(size_t s, int domain) const;
+
+    /* average power (W) of @domain on the @s-th socket during the last read() interval */
+    double watts(size_t s, int domain) const;
+
+    /* the hardware energy status unit (J) of @domain, as used by MSR_*_ENERGY_STATUS */
+    double unit(int domain) const {
+        return _unit[domain];
+    }
+
+    /* energy of the last interval in hardware energy status units, as emon's FREERUN_*_ENERGY_STATUS */
+    uint64_t raw(size_t s, int domain) const {
+        return static_cast<uint64_t>(joules(s, domain) / _unit[domain] + 0.5);
+    }
+
+    bool via_perf() const {
+        return _via_perf;
+    }
+
+private:
+    rapl() = default;
+
+    bool open_perf();
+    bool open_msr();
+
+    void detect_unit();
+
+private:
+    struct socket_t {
+        int id;                          /* physical package id */
+        int cpu;                         /* the designated cpu */
+        descriptor::ptr_t evt[RAPL_DOMAIN_MAX]; /* perf_event, null if not opened (or via MSR) */
+        uint64_t prev[RAPL_DOMAIN_MAX];  /* previous raw counter value */
+        double   delta[RAPL_DOMAIN_MAX]; /* energy (J) consumed during the last interval */
+    };
+
+    std::vector<socket_t> _socket;
+
+    msr::handle _msr; /* the fds of the designated cpus stay open, if via MSR */
+
+    bool _via_perf = false;
+    bool _available[RAPL_DOMAIN_MAX] = { false, false };
+
+    double _scale[RAPL_DOMAIN_MAX] = { 0, 0 };            /* Joules per raw count we read */
+    double _unit[RAPL_DOMAIN_MAX]  = { 1.0 / (1 << 14), 1.0 / (1 << 16) }; /* hardware energy status unit */
+
+    double _tprev = 0; /* CLOCK_MONOTONIC_RAW (s) of the previous read() */
+    double _tdiff = 0; /* length (s) of the last interval */
+    bool _primed  = false;
+};
+
+} /* namespace perfm */
+
+#endif /* __PERFM_RAPL_HPP__ */
@@ -1,14 +1,20 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 
-#include "linux/perf_event.h"
+#include "perfm_event.hpp"
 
-__attribute__((weak)) long perf_event_open(struct perf_event_attr *hw_event, pid_t pid, 
-                                           int cpu, int group_fd, unsigned long flags)
+namespace perfm {
+
+// in namespace perfm, so it neither clashes with libpfm4's inline one in <perfmon/perf_event.h>
+// nor depends on it being included
+long perf_event_open(struct perf_event_attr *hw_event, pid_t pid, 
+                     int cpu, int group_fd, unsigned long flags)
 {
     return syscall(__NR_perf_event_open, hw_event, pid, cpu, group_fd, flags);
 }
 
+} /* namespace perfm */
+
 //
 // https://gcc.gnu.org/onlinedocs/gcc/Function-Attributes.html
 //
@@ -1,5 +1,6 @@
 #include "perfm_util.hpp"
 #include "perfm_option.hpp"
+#include "perfm_parser.hpp"
 #include "perfm_event.hpp"
 #include "perfm_group.hpp"
 #include "perfm_top.hpp"
@@ -11,10 +12,12 @@
 
 #include <vector>
 #include <string>
+#include <fstream>
 #include <memory>
 #include <utility>
 #include <new>
 #include <random>
+#include <algorithm>
 
 #include <unistd.h>
 #include <signal.h>
@@ -41,6 +44,8 @@ void sighandler(int signo)
 
 namespace perfm {
 
+constexpr size_t top::_spark_width; /* odr-used by std::min() */
+
 // The rdtsc instruction is used to move the 64-bit TSC counter into the registers EDX:EAX.
 // Below is a piece of code that will return the 64-bit wide counter value.
 // Note that this should work on both i386 and x86_64 architectures.
@@ -54,6 +59,63 @@ namespace perfm {
 //     return ((unsigned long long)eax) | (((unsigned long long)edx) << 32);
 // }
 
+double history::min() const
+{
+    double v = _size ? at(0) : 0;
+
+    for (size_t i = 1; i < _size; ++i) {
+        v = std::min(v, at(i));
+    }
+
+    return v;
+}
+
+double history::max() const
+{
+    double v = _size ? at(0) : 0;
+
+    for (size_t i = 1; i < _size; ++i) {
+        v = std::max(v, at(i));
+    }
+
+    return v;
+}
+
+double history::avg() const
+{
+    double v = 0;
+
+    for (size_t i = 0; i < _size; ++i) {
+        v += at(i);
+    }
+
+    return _size ? v / _size : 0;
+}
+
+const char *history::spark(char *buf, size_t len, double lo, double hi) const
+{
+    // plain ascii, so it renders with both ncurses & ncursesw in any locale
+    static const char level[] = " _.-:=+*#@";
+    static const size_t nr_level = sizeof(level) - 1;
+
+    size_t nr = std::min(len, _size);
+    size_t i  = 0;
+
+    for (; i < len - nr; ++i) {
+        buf[i] = ' ';
+    }
+
+    for (size_t k = _size - nr; k < _size; ++k, ++i) {
+        double v = hi > lo ? (at(k) - lo) / (hi - lo) : 0;
+        v = v < 0 ? 0 : (v > 1 ? 1 : v);
+        buf[i] = level[static_cast<size_t>(v * (nr_level - 1) + 0.5)];
+    }
+
+    buf[len] = '\0';
+
+    return buf;
+}
+
 top::ptr_t top::alloc()
 {
     top *topper = nullptr;
@@ -95,7 +157,9 @@ void top::init()
         this->_term_col = ws.ws_col > this->_term_col ? ws.ws_col : this->_term_col;
 
         initscr();
-        nocbreak();
+        cbreak();
+        noecho();
+        nodelay(stdscr, TRUE); /* getch() never blocks, keys are polled once per tick */
         resize_term(this->_term_row, this->_term_col);
     }
 }
@@ -112,10 +176,10 @@ void top::fini()
 
 void top::open()
 {
-    _nr_total_cpu  = num_cpus_total();
+    _nr_total_cpu  = nr_cpu_ids();
     _nr_select_cpu = 0;
 
-    memset(_cpu_list, 0, sizeof(_cpu_list));
+    _cpu_list = cpuset(_nr_total_cpu);
 
     try {
         this->_cpu_data = new cpu_data_t[_nr_total_cpu];
@@ -126,24 +190,62 @@ void top::open()
     // parse cpu list, if empty, select all available cpus
     if (perfm_options.cpu_list.empty()) {
         for (unsigned int cpu = 0; cpu < _nr_total_cpu; ++cpu) {
-            do_set(cpu);
-            ++_nr_select_cpu;
+            if (!cpu_exist(cpu)) {
+                continue;
+            }
+
+            _cpu_list.set(cpu);
         }
     } else {
         parse_cpu_list(perfm_options.cpu_list);
     }
 
+    _nr_select_cpu = _cpu_list.count();
+
+    // socket of each selected cpu & the (preallocated) history for each cpu/socket row
+    _cpu_hist.resize(_nr_total_cpu);
+    _cpu_skt.assign(_nr_total_cpu, -1);
+
+    int nr_skt = 0;
+    for (int c : _cpu_list) {
+        int skt = 0;
+        std::fstream fp("/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/physical_package_id", std::ios::in);
+        if (!fp.good() || !(fp >> skt) || skt < 0) {
+            skt = 0;
+        }
+
+        _cpu_skt[c] = skt;
+        _cpu_hist[c].resize(perfm_options.nr_hist);
+
+        nr_skt = std::max(nr_skt, skt + 1);
+    }
+
+    _skt_hist.resize(nr_skt);
+    _skt_busy.assign(nr_skt, 0);
+    _skt_ncpu.assign(nr_skt, 0);
+
+    for (unsigned int c = 0; c < _nr_total_cpu; ++c) {
+        if (_cpu_skt[c] >= 0) {
+            ++_skt_ncpu[_cpu_skt[c]];
+        }
+    }
+
+    for (int s = 0; s < nr_skt; ++s) {
+        if (_skt_ncpu[s]) {
+            _skt_hist[s].resize(perfm_options.nr_hist);
+        }
+    }
+
     // get the frequency for each online cpu
     auto freq_list = cpu_frequency();
 
-    // open event for each selected cpu
-    for (unsigned int c = 0, n = 0; n < _nr_select_cpu && c < _nr_total_cpu; ++c) {
-        if (!is_set(c)) {
-            continue;
-        } 
-
-        ++n;
+    // encode the events once, then open them for each selected cpu
+    group::tmpl_ptr_t tmpl = group::encode(parser::split_events(_ev_list));
+    if (!tmpl) {
+        perfm_fatal("failed to encode %s\n", _ev_list.c_str());
+    }
 
+    for (int c : _cpu_list) {
         int freq = 0;
 
         auto it = freq_list.find(c);
@@ -160,72 +262,56 @@ void top::open()
             continue;
         }
 
-        g->open(_ev_list, -1, c);
+        g->open(tmpl, -1, c);
 
         _cpu_data[c] = std::make_tuple(c, freq, g); 
     } 
-}
 
-void top::close()
-{
-    for (unsigned int c = 0, n = 0; c < _nr_total_cpu && n < _nr_select_cpu; ++c) {
-        if (!is_set(c)) {
-            continue;
+    // sample cycles on each selected cpu for the per-process view
+    if (perfm_options.proc_view) {
+        std::vector<int> cpus = _cpu_list.to_vector();
+
+        _hotness = hotness::alloc();
+        if (!_hotness || !_hotness->open(cpus, perfm_options.sample_freq)) {
+            perfm_warn("failed to open the per-process sampling, ignored\n");
+            _hotness.reset();
         }
-        
-        ++n;
-        cpu_pmu(c)->close();
     }
-}
-
-void top::parse_cpu_list(const std::string &list)
-{
-    std::vector<std::string> slice = str_split(list, ",");
 
-    for (size_t i = 0; i < slice.size(); ++i) {
-        if (slice[i].empty()) {
-            continue;
+    if (perfm_options.power) {
+        _rapl = rapl::alloc();
+        if (!_rapl || !_rapl->open()) {
+            perfm_warn("RAPL is not available, ignored\n");
+            _rapl.reset();
         }
+    }
+}
 
-        size_t del_pos = slice[i].find("-");
-
-        if (del_pos == std::string::npos) {
-            int cpu;
-            try {
-                cpu = std::stoi(slice[i]);
-            } catch (const std::exception &e) {
-                perfm_warn("%s %s\n", e.what(), slice[i].c_str());
-                continue;
-            }
+void top::close()
+{
+    for (int c : _cpu_list) {
+cpu_pmu(c)->close();
+    }
 
-            ++_nr_select_cpu;
-            do_set(cpu);
-        } else {
-            int from, to;
-            try {
-                from = std::stoi(slice[i]);
-                to   = std::stoi(slice[i].substr(del_pos + 1));
-            } catch (const std::exception &e) {
-                perfm_warn("%s %s\n", e.what(), slice[i].c_str());
-                continue;
-            }
+    if (_hotness) {
+        _hotness->close();
+    }
 
-            for (int cpu = from; cpu <= to; ++cpu) {
-                ++_nr_select_cpu;
-                do_set(cpu);
-            }
-        }
+    if (_rapl) {
+        _rapl->close();
     }
 }
 
-void top::print(double seconds) const
+void top::parse_cpu_list(const std::string &list)
 {
-    for (size_t c = 0, n = 0; n < _nr_select_cpu && c < _nr_total_cpu; ++c) {
-        if (!is_set(c)) {
-            continue;
-        }
-        ++n;
-    
+    _cpu_list = cpuset::parse(list, _nr_total_cpu);
+}
+
+void top::print(double seconds)
+{
+    std::fill(_skt_busy.begin(), _skt_busy.end(), 0);
+
+    for (int c : _cpu_list) {
         uint64_t delta_cycle = seconds * cpu_mhz(c) * 1000000;
 
         cpu_pmu(c)->read();
@@ -241,19 +327,159 @@ void top::print(double seconds) const
 
         double idle = usr + sys > 100 ? 0 : 100 - usr - sys;
 
-        print(cpu_num(c), cpu_mhz(c) / 1000.0, usr, sys, idle);
+        _cpu_hist[c].push(100 - idle);
+        _skt_busy[_cpu_skt[c]] += 100 - idle;
+
+        print(cpu_num(c), cpu_mhz(c) / 1000.0, usr, sys, idle, _cpu_hist[c]);
+    }
+
+    for (size_t s = 0; s < _skt_hist.size(); ++s) {
+        if (_skt_ncpu[s]) {
+            _skt_hist[s].push(_skt_busy[s] / _skt_ncpu[s]);
+        }
     }
+
+    print_skt();
 }
 
-void top::print(int cpu, double freq, double usr, double sys, double idle) const
+void top::print(int cpu, double freq, double usr, double sys, double idle, const history &h) const
 {
     FILE *fp = stderr;
 
+    char spark[_spark_width + 1];
+    h.spark(spark, std::min(_spark_width, h.capacity()), 0, 100);
+
     if (perfm_options.batch_mode) {
-        fprintf(fp, "Cpu%-2d : %.1fGHz,  usr: %5.1f%%,  sys: %5.1f%%,  idle: %5.1f%%\n", cpu, freq, usr, sys, idle); 
+        fprintf(fp, "Cpu%-2d : %.1fGHz,  usr: %5.1f%%,  sys: %5.1f%%,  idle: %5.1f%%  [%s] %5.1f/%5.1f/%5.1f\n",
+                cpu, freq, usr, sys, idle, spark, h.min(), h.avg(), h.max());
     } else {
-        printw(     "Cpu%-2d : %.1fGHz,  usr: %5.1f%%,  sys: %5.1f%%,  idle: %5.1f%%\n", cpu, freq, usr, sys, idle); 
+        printw(     "Cpu%-2d : %.1fGHz,  usr: %5.1f%%,  sys: %5.1f%%,  idle: %5.1f%%  [%s] %5.1f/%5.1f/%5.1f\n",
+                cpu, freq, usr, sys, idle, spark, h.min(), h.avg(), h.max());
+    }
+}
+
+void top::print_skt() const
+{
+    FILE *fp = stderr;
+
+    char spark[_spark_width + 1];
+
+    for (size_t s = 0; s < _skt_hist.size(); ++s) {
+        if (!_skt_ncpu[s]) {
+            continue;
+        }
+
+        const history &h = _skt_hist[s];
+        h.spark(spark, std::min(_spark_width, h.capacity()), 0, 100);
+
+        if (perfm_options.batch_mode) {
+            fprintf(fp, "Skt%-2zu : %3d cpus,  busy: %5.1f%%  [%s] %5.1f/%5.1f/%5.1f (min/avg/max)\n",
+                    s, _skt_ncpu[s], h.size() ? h.at(h.size() - 1) : 0.0, spark, h.min(), h.avg(), h.max());
+        } else {
+            printw(     "Skt%-2zu : %3d cpus,  busy: %5.1f%%  [%s] %5.1f/%5.1f/%5.1f (min/avg/max)\n",
+                    s, _skt_ncpu[s], h.size() ? h.at(h.size() - 1) : 0.0, spark, h.min(), h.avg(), h.max());
+        }
+    }
+}
+
+bool top::dump(const std::string &filp) const
+{
+    FILE *fp = ::fopen(filp.c_str(), "w");
+    if (!fp) {
+        perfm_warn("failed to open %s\n", filp.c_str());
+        return false;
+    }
+
+    // interval, then one row a line (oldest sample first)
+    fprintf(fp, "# interval %.2f(s), busy%% of the last %zu intervals\n", perfm_options.delay, perfm_options.nr_hist);
+
+    for (size_t c = 0; c < _cpu_hist.size(); ++c) {
+        if (_cpu_skt[c] < 0) {
+            continue;
+        }
+
+        fprintf(fp, "cpu%zu", c);
+        for (size_t i = 0; i < _cpu_hist[c].size(); ++i) {
+            fprintf(fp, " %.1f", _cpu_hist[c].at(i));
+        }
+        fprintf(fp, "\n");
+    }
+
+    for (size_t s = 0; s < _skt_hist.size(); ++s) {
+        if (!_skt_ncpu[s]) {
+            continue;
+        }
+
+        fprintf(fp, "socket%zu", s);
+        for (size_t i = 0; i < _skt_hist[s].size(); ++i) {
+            fprintf(fp, " %.1f", _skt_hist[s].at(i));
+        }
+        fprintf(fp, "\n");
     }
+
+    ::fclose(fp);
+
+    return true;
+}
+
+void top::print_proc()
+{
+    if (!_hotness) {
+        return;
+    }
+
+    uint64_t total = _hotness->tick(perfm_options.nr_proc);
+
+    #define pr(fmt, ...) do {                      \
+        if (perfm_options.batch_mode) {            \
+            fprintf(stderr, fmt, ##__VA_ARGS__);   \
+        } else {                                   \
+            printw(fmt, ##__VA_ARGS__);            \
+        }                                          \
+    } while (0)
+
+    pr("\n");
+    pr("%7s  %-16s  %10s  %6s\n", "PID", "COMMAND", "SAMPLES", "CYCLE%");
+
+    for (const auto &e : _hotness->top_list()) {
+        pr("%7d  %-16s  %10lu  %5.1f%%\n",
+           std::get<0>(e), std::get<2>(e).c_str(), std::get<1>(e), total ? 100.0 * std::get<1>(e) / total : 0.0);
+    }
+
+    if (_hotness->nr_lost()) {
+        pr("(%lu samples lost so far)\n", _hotness->nr_lost());
+    }
+
+    #undef pr
+}
+
+void top::print_power()
+{
+    if (!_rapl) {
+        return;
+    }
+
+    _rapl->read();
+
+    #define pr(fmt, ...) do {                      \
+        if (perfm_options.batch_mode) {            \
+            fprintf(stderr, fmt, ##__VA_ARGS__);   \
+        } else {                                   \
+            printw(fmt, ##__VA_ARGS__);            \
+        }                                          \
+    } while (0)
+
+    pr("\n");
+    for (size_t s = 0; s < _rapl->nr_socket(); ++s) {
+        if (_rapl->available(rapl::RAPL_DRAM)) {
+            pr("Skt%-2d : pkg: %7.2fW,  dram: %7.2fW\n",
+               _rapl->socket_id(s), _rapl->watts(s, rapl::RAPL_PKG), _rapl->watts(s, rapl::RAPL_DRAM));
+        } else {
+            pr("Skt%-2d : pkg: %7.2fW\n", _rapl->socket_id(s), _rapl->watts(s, rapl::RAPL_PKG));
+        }
+    }
+
+    #undef pr
 }
 
 void top::loop()
@@ -261,23 +487,24 @@ void top::loop()
     int iter = perfm_options.iter <= 0 ? INT_MAX : perfm_options.iter;
 
     // start counting ...
-    for (size_t c = 0, n = 0; n < _nr_select_cpu && c < _nr_total_cpu; ++c) {
-        if (is_set(c)) {
-            cpu_pmu(c)->start();
-            ++n;
-        }
+    for (int c : _cpu_list) {
+        cpu_pmu(c)->start();
     }
 
     // skip the first few ...
-    for (size_t c = 0, n = 0; n < _nr_select_cpu && c < _nr_total_cpu; ++c) {
-        if (!is_set(c)) {
-            continue;
-        }
-        ++n;
-    
+    for (int c : _cpu_list) {
         cpu_pmu(c)->read();
     }
 
+    if (_hotness) {
+        _hotness->start();
+        _hotness->tick(perfm_options.nr_proc);
+    }
+
+    if (_rapl) {
+        _rapl->read(); /* baseline */
+    }
+
     // 1. std::random_device is a uniformly-distributed __integer random number generator__ 
     //    that produces non-deterministic random numbers.
     // 2. std::random_device may be implemented in terms of an implementation-defined pseudo-random
@@ -295,11 +522,39 @@ void top::loop()
         if (!perfm_options.batch_mode) {
             move(0, 0);
             print(seconds);
+            print_power();
+            print_proc();
+
+            // 'w': dump the history, 'q': quit
+            switch (getch()) {
+            case 'w':
+                printw(dump(perfm_options.hist_filp) ? "history saved to %s\n" : "failed to save history to %s\n",
+                       perfm_options.hist_filp.c_str());
+                break;
+
+            case 'q':
+                should_quit = 1;
+                break;
+
+            default:
+                ;
+            }
+
             refresh();
         } else {
             print(seconds);
+            print_power();
+            print_proc();
         }
     }
+
+    if (perfm_options.batch_mode) {
+        dump(perfm_options.hist_filp);
+    }
+
+    if (_hotness) {
+        _hotness->stop();
+    }
 }
 
 } /* namespace perfm */
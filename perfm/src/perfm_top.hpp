@@ -7,6 +7,9 @@
 #endif
 
 #include "perfm_group.hpp"
+#include "perfm_hotness.hpp"
+#include "perfm_rapl.hpp"
+#include "perfm_cpuset.hpp"
 
 #include <vector>
 #include <string>
@@ -60,15 +63,76 @@
 
 namespace perfm {
 
+/**
+ * history - a bounded ring buffer of the last N samples (e.g. per-interval utilization) for a top row
+ *
+ * Description:
+ *     the buffer is allocated once by resize(), push() overwrites the oldest sample when full,
+ *     so nothing is allocated per tick
+ */
+class history final {
+
+public:
+    history() = default;
+
+    void resize(size_t cap) {
+        _val.assign(cap, 0.0);
+        _head = 0;
+        _size = 0;
+    }
+
+    void push(double v) {
+        if (_val.empty()) {
+            return;
+        }
+
+        _val[_head] = v;
+        _head = (_head + 1) % _val.size();
+        _size = _size < _val.size() ? _size + 1 : _size;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    size_t capacity() const {
+        return _val.size();
+    }
+
+    /* the @i-th oldest sample, 0 <= @i < size() */
+    double at(size_t i) const {
+        return _val[(_head + _val.size() - _size + i) % _val.size()];
+    }
+
+    double min() const;
+    double max() const;
+    double avg() const;
+
+    /**
+     * spark - render the last (at most) @len samples as a sparkline into @buf
+     *
+     * @buf  output buffer, at least @len + 1 bytes
+     * @len  width (in chars) of the sparkline
+     * @lo   value mapped to the lowest level
+     * @hi   value mapped to the highest level
+     *
+     * Return:
+     *     @buf, padded with ' ' on the left if there are fewer than @len samples
+     */
+    const char *spark(char *buf, size_t len, double lo, double hi) const;
+
+private:
+    std::vector<double> _val;
+    size_t _head = 0; /* where the next sample goes */
+    size_t _size = 0; /* # of valid samples */
+};
+
 class top {
 
 public:
     using ptr_t = std::shared_ptr<top>;
 
 public:
-    static constexpr size_t nr_max_cpus = 512;
-    static constexpr size_t nr_bit_long = sizeof(unsigned long) << 3;
-
     static ptr_t alloc();
 
     virtual ~top() {
@@ -87,40 +151,21 @@ public:
     void loop();
 
 private:
-    top () {
-        memset(_cpu_list, 0, sizeof(_cpu_list));
-    }
-
-    unsigned long lshift(unsigned long val) const {
-        return 1UL << (nr_bit_long - 1 - (val % nr_bit_long));
-    }
-
-    bool is_set(int cpu) const {
-        if (cpu < 0 || static_cast<size_t>(cpu) >= nr_max_cpus) {
-            return false;
-        }
-
-        return !!(_cpu_list[cpu / nr_bit_long] & lshift(cpu));
-    }
-
-    void do_set(int cpu) {
-        if (cpu < 0 || static_cast<size_t>(cpu) >= nr_max_cpus) {
-            return;
-        }
-
-        _cpu_list[cpu / nr_bit_long] |= lshift(cpu);
-    }
-
-    void do_clr(int cpu) {
-        if (cpu < 0 || static_cast<size_t>(cpu) >= nr_max_cpus) {
-            return;
-        }
-
-        _cpu_list[cpu / nr_bit_long] &= ~lshift(cpu);
-    }
-
-    void print(double) const;
-    void print(int, double, double, double, double) const;
+    top () = default;
+
+    void print(double);
+    void print(int, double, double, double, double, const history &) const;
+    void print_skt() const;
+    void print_proc();
+    void print_power();
+
+    /**
+     * dump - write the history of each CPU/socket row to @filp
+     *
+     * Description:
+     *     one row a line: row's name, followed by the samples (oldest first) separated by ' '
+     */
+    bool dump(const std::string &filp) const;
 
     //
     // @cpulist must with the form: 1,2-4,6,8,9-10
@@ -133,7 +178,7 @@ private:
     #define K_CYCLE_EID 1  // subscript for event(sys cycle) in cpu's event group
     #define N_EVENT_MAX 2
 
-    unsigned long _cpu_list[nr_max_cpus / nr_bit_long];
+    cpuset _cpu_list; /* selected cpus, sized by nr_cpu_ids() */
 
     using cpu_data_t = std::tuple<int, int, group::ptr_t>;
 
@@ -145,6 +190,17 @@ private:
     #define cpu_mhz(cpu) std::get<1>(_cpu_data[(cpu)]) // processor's frequency in MHz (from /proc/cpuinfo)
     #define cpu_pmu(cpu) std::get<2>(_cpu_data[(cpu)]) // processor's PMU event (pointer to the ev-group binded to it)
 
+    hotness::ptr_t _hotness; /* per-process hotness, only if perfm_options.proc_view */
+    rapl::ptr_t    _rapl;    /* package/DRAM power of each socket, only if perfm_options.power */
+
+    std::vector<history> _cpu_hist; /* subscript is processor's id, busy% (usr + sys) of the last N intervals */
+    std::vector<history> _skt_hist; /* subscript is socket's id, average busy% of the selected cpus on it */
+    std::vector<int>     _cpu_skt;  /* subscript is processor's id, val is the socket it belongs to (-1 if unselected) */
+    std::vector<double>  _skt_busy; /* per-tick scratch: sum of busy% on each socket */
+    std::vector<int>     _skt_ncpu; /* # of selected cpus on each socket */
+
+    static constexpr size_t _spark_width = 30; /* max width of a sparkline */
+
     struct termios _termios;
     int _term_row = 25;
     int _term_col = 80;
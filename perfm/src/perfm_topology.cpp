@@ -40,17 +40,16 @@ void topology::build()
     _nr_socket      = 0;
     _nr_onln_socket = 0;
 
-    _cpu_usable_list.reset();
-    _cpu_online_list.reset();
-    _socket_usable_list.reset();
-    _socket_online_list.reset();
+    _cpu_usable_list    = cpuset();
+    _cpu_online_list    = cpuset();
+    _socket_usable_list = cpuset();
+    _socket_online_list = cpuset();
 
-    for (unsigned int s = 0; s < NR_MAX_SOCKET; ++s) {
-        for (unsigned int c = 0; c < NR_MAX_CORE_PER_SKT; ++c) {
-            _m_core_usable(s, c) = false;
-            _m_core_thread(s, c) = 0;
-        }
-    }
+    _topology.clear();
+    _cpu.clear();
+
+    _llc.clear();
+    _node.clear();
 
     build_cpu_usable_list();
 
@@ -64,6 +63,10 @@ void topology::build()
 
     build_cpu_topology();
 
+    build_cpu_cache();
+
+    build_numa_node();
+
     processor_offline();
 }
 
@@ -79,28 +82,13 @@ void topology::build_cpu_usable_list()
             perfm_fatal("error on opening/reading %s\n", filp.c_str());
         }
 
-        auto slice = str_split(line, ",");
-        for (size_t i = 0; i < slice.size(); ++i) {
-            size_t del = slice[i].find("-");
-
-            if (del != std::string::npos) {
-                int fr = std::stoi(slice[i]);
-                int to = std::stoi(slice[i].substr(del + 1));
-                _nr_cpu += to - fr + 1;
-                for (int c = fr; c <= to; ++c) {
-                    _cpu_usable_list.set(c);
-                }
-            } else {
-                int c = std::stoi(slice[i]);
-                _cpu_usable_list.set(c);
-                ++_nr_cpu;
-            }
-        }
+        _cpu_usable_list = cpuset::parse(line);
+        _nr_cpu = _cpu_usable_list.count();
 
     } else {
         DIR *dirp = ::opendir(cpu_directory.c_str()); 
         if (!dirp) {
-            perfm_fatal("failed to open %s %s\n", cpu_directory.c_str(), strerror_r(errno, NULL, 0));
+            perfm_fatal("failed to open %s %s\n", cpu_directory.c_str(), strerror(errno));
         }
 
         struct dirent *dp = NULL;
@@ -115,7 +103,7 @@ void topology::build_cpu_usable_list()
         }
 
         if (errno) {
-            perfm_fatal("failed (may be partial successful) to read %s %s\n", cpu_directory.c_str(), strerror_r(errno, NULL, 0));
+            perfm_fatal("failed (may be partial successful) to read %s %s\n", cpu_directory.c_str(), strerror(errno));
         }
 
         ::closedir(dirp);
@@ -134,33 +122,11 @@ void topology::build_cpu_online_list()
             perfm_fatal("error on opening/reading %s\n", filp.c_str());
         }
 
-        std::vector<std::string> slice = str_split(line, ",");
-
-        for (size_t i = 0; i < slice.size(); ++i) {
-            size_t del = slice[i].find("-");
+        _cpu_online_list = cpuset::parse(line);
+        _nr_onln_cpu = _cpu_online_list.count();
 
-            if (del != std::string::npos) {
-                int fr = std::stoi(slice[i]);
-                int to = std::stoi(slice[i].substr(del + 1));
-                _nr_onln_cpu += to - fr + 1;
-                for (int c = fr; c <= to; ++c) {
-                    _cpu_online_list.set(c);
-                }
-            } else {
-                int c = std::stoi(slice[i]);
-                ++_nr_onln_cpu;
-                _cpu_online_list.set(c);
-            }
-        }
-    
     } else {
-        for (unsigned int c = 0, n = 0; n < _nr_cpu; ++c) {
-            if (!_m_cpu_usable(c)) {
-                continue;
-            }
-
-            ++n;
-
+        for (int c : _cpu_usable_list) {
             if (c == 0) {
                 ++_nr_onln_cpu;
                 _cpu_online_list.set(c);
@@ -193,13 +159,7 @@ void topology::build_cpu_topology()
     int socket;
 
     // build the '<socket, core> => processors' map
-    for (unsigned int c = 0, n = 0; n < _nr_cpu; ++c) {
-        if (!_m_cpu_usable(c)) {
-            continue;
-        } 
-
-        ++n;
-
+    for (int c : _cpu_usable_list) {
         // core_id
         {
             filp = cpu_directory + "cpu" + std::to_string(c) + filp_core;
@@ -227,54 +187,159 @@ void topology::build_cpu_topology()
         }
 
         // do some recording
+        if (socket < 0 || core_id < 0) {
+            perfm_fatal("invalid topology of cpu %d, core %d socket %d\n", c, core_id, socket);
+        }
+
         if (!_m_skt_usable(socket)) {
             ++_nr_socket;
             _socket_usable_list.set(socket);
+            _topology.resize(std::max(_topology.size(), static_cast<size_t>(socket) + 1));
         }
 
         if (!_m_core_usable(socket, core_id)) {
-            _m_core_usable(socket, core_id) = true;
             ++_nr_core;
         }
 
-        _m_list_thread(socket, core_id)[_m_core_thread(socket, core_id)++] = c;
+        _m_list_thread(socket, core_id).push_back(c);
     }
 
+    _cpu.assign(_cpu_usable_list.size(), std::make_tuple(-1, -1, -1, 0));
+
     // build the 'processor => <core, socket>' map
-    for (unsigned int s = 0, n = 0; n < _nr_socket && s < NR_MAX_SOCKET; ++s) {
-        if (!_m_skt_usable(s)) {
-            continue;
+    for (size_t s = 0; s < _topology.size(); ++s) {
+        for (const auto &core : _topology[s]) {
+            for (int p : core.second) {
+                _m_cpu_coreid(p) = core.first;
+                _m_cpu_socket(p) = static_cast<int>(s);
+            }
         }
+    }
 
-        ++n;
+    std::set<std::pair<int, int>> flag;
+    for (int c : _cpu_online_list) {
+        if (!_m_skt_online(_m_cpu_socket(c))) {
+            _socket_online_list.set(_m_cpu_socket(c));
+            ++_nr_onln_socket;
+        }
+
+        if (flag.find(std::make_pair(_m_cpu_coreid(c), _m_cpu_socket(c))) == flag.end()) {
+            ++_nr_onln_core;
+            flag.insert(std::make_pair(_m_cpu_coreid(c), _m_cpu_socket(c)));
+        }
+    }
+}
+
+void topology::build_cpu_cache()
+{
+    // cache instances are identified by <level, type, shared_cpu_list>, the LLC of a processor is
+    // its highest level data/unified cache. LLC ids are given in the order of the first processor
+    std::map<std::tuple<int, std::string, std::string>, int> llc_id;
+
+    for (int c : _cpu_usable_list) {
+        const std::string dir = cpu_directory + "cpu" + std::to_string(c) + "/cache/";
 
-        for (unsigned int c = 0; c < NR_MAX_CORE_PER_SKT; ++c) {
-            if (!_m_core_usable(s, c)) {
+        _cache_t llc { 0, "", 0, cpuset() };
+
+        for (int i = 0; ; ++i) {
+            const std::string idx = dir + "index" + std::to_string(i) + "/";
+            if (!file_exist(idx.c_str())) {
+                break;
+            }
+
+            _cache_t ca { 0, "", 0, cpuset() };
+            std::string size;
+            std::string list;
+
+            std::fstream fp_level(idx + "level", std::ios::in);
+            std::fstream fp_type(idx + "type", std::ios::in);
+            std::fstream fp_size(idx + "size", std::ios::in);
+            std::fstream fp_list(idx + "shared_cpu_list", std::ios::in);
+
+            if (!(fp_level >> ca.level) || !(fp_type >> ca.type) || !std::getline(fp_list, list)) {
+                perfm_warn("error on reading %s, ignored\n", idx.c_str());
                 continue;
             }
 
-            for (int p = 0; p < _m_core_thread(s, c); ++p) {
-                _cpu[_m_list_thread(s, c)[p]] = std::make_pair(c, s);
+            if (fp_size >> size) {
+                try {
+                    ca.size = std::stoul(size);
+                } catch (const std::exception &) {
+                    ca.size = 0;
+                }
+
+                switch (size.back()) {
+                case 'K': ca.size <<= 10; break;
+                case 'M': ca.size <<= 20; break;
+                case 'G': ca.size <<= 30; break;
+                }
+            }
+
+            ca.cpus = cpuset::parse(list);
+
+            if (ca.type != "Instruction" && ca.level > llc.level) {
+                llc = std::move(ca);
             }
         }
+
+        if (llc.level == 0) {
+            continue; /* no cache info, e.g. some VMs & non-x86 platforms */
+        }
+
+        auto key = std::make_tuple(llc.level, llc.type, llc.cpus.str());
+
+        auto it = llc_id.find(key);
+        if (it == llc_id.end()) {
+            it = llc_id.insert({key, static_cast<int>(_llc.size())}).first;
+            _llc.push_back(std::move(llc));
+        }
+
+        _m_cpu_llc(c) = it->second;
     }
+}
 
-    std::set<std::pair<int, int>> flag;
-    for (unsigned int c = 0, n = 0; n < _nr_onln_cpu; ++c) {
-        if (!_m_cpu_online(c)) {
+void topology::build_numa_node()
+{
+    const std::string node_directory = "/sys/devices/system/node/";
+
+    DIR *dirp = ::opendir(node_directory.c_str());
+    if (!dirp) {
+        // kernel without NUMA support, the whole system is node 0
+        _node.push_back(_cpu_usable_list);
+        return;
+    }
+
+    struct dirent *dp = NULL;
+
+    while ((dp = ::readdir(dirp)) != NULL) {
+        if (std::strncmp(dp->d_name, "node", 4) != 0 || !std::isdigit(static_cast<unsigned char>(dp->d_name[4]))) {
             continue;
         }
 
-        ++n;
+        int n = std::atoi(dp->d_name + 4);
 
-        if (!_m_skt_online(_m_processor_socket(c))) {
-            _socket_online_list.set(_m_processor_socket(c));
-            ++_nr_onln_socket;
+        std::fstream fp(node_directory + dp->d_name + "/cpulist", std::ios::in);
+        std::string list;
+
+        if (!fp.good() || !std::getline(fp, list)) {
+            perfm_warn("error on reading %s%s/cpulist, ignored\n", node_directory.c_str(), dp->d_name);
+            continue;
         }
 
-        if (flag.find(std::make_pair(_m_processor_coreid(c), _m_processor_socket(c))) == flag.end()) {
-            ++_nr_onln_core;
-            flag.insert(std::make_pair(_m_processor_coreid(c), _m_processor_socket(c)));
+        if (static_cast<size_t>(n) >= _node.size()) {
+            _node.resize(n + 1);
+        }
+
+        _node[n] = cpuset::parse(list);
+    }
+
+    ::closedir(dirp);
+
+    for (size_t n = 0; n < _node.size(); ++n) {
+        for (int c : _node[n]) {
+            if (_m_cpu_usable(c)) {
+                _m_cpu_node(c) = static_cast<int>(n);
+            }
         }
     }
 }
@@ -283,13 +348,7 @@ void topology::processor_online() const
 {   //
     // put all presented/usable processor online
     //
-    for (unsigned int c = 0, n = 0; n < _nr_cpu; ++c) {
-        if (!_m_cpu_usable(c)) {
-            continue; 
-        }
-
-        ++n;
-
+    for (int c : _cpu_usable_list) {
         if (!_m_cpu_online(c)) {
             processor_hotplug(c, +1);
         }
@@ -300,13 +359,7 @@ void topology::processor_offline() const
 {   //
     // offline processors not in the _cpu_online_list
     //
-    for (unsigned int c = 0, n = 0; n < _nr_cpu; ++c) {
-        if (!_m_cpu_usable(c)) {
-            continue;
-        }
-
-        ++n;
-
+    for (int c : _cpu_usable_list) {
         if (!_m_cpu_online(c)) {
             processor_hotplug(c, -1);
         }
@@ -337,6 +390,39 @@ void topology::processor_hotplug(int cpu, int action) const
     }
 }
 
+std::vector<capture::cpu_t> topology::snapshot() const
+{
+    std::vector<capture::cpu_t> res;
+
+    for (int c : _cpu_usable_list) {
+        capture::cpu_t cpu;
+
+        cpu.cpu    = c;
+        cpu.core   = _m_cpu_coreid(c);
+        cpu.socket = _m_cpu_socket(c);
+        cpu.llc    = _m_cpu_llc(c);
+        cpu.node   = _m_cpu_node(c);
+        cpu.online = _m_cpu_online(c) ? 1 : 0;
+
+        res.push_back(cpu);
+    }
+
+    return res;
+}
+
+bool topology::save(const char *filp) const
+{
+    FILE *fp = ::fopen(filp, "w");
+    if (!fp) {
+        perfm_warn("failed to open %s, %s\n", filp, strerror(errno));
+        return false;
+    }
+
+    bool succ = capture::write(fp, *this);
+
+    return ::fclose(fp) == 0 && succ;
+}
+
 void topology::print(const char *filp)
 {
     FILE *fp = stdout;
@@ -355,6 +441,8 @@ void topology::print(const char *filp)
     fprintf(fp, "- Number of logical cores (online/total)    : %zu/%zu\n", _nr_onln_cpu, _nr_cpu);
     fprintf(fp, "- Physical cores per socket                 : %zu\n", _nr_core / _nr_socket);
     fprintf(fp, "- Threads (logical cores) per physical core : %zu\n", _nr_cpu / _nr_core); 
+    fprintf(fp, "- Number of LLC domains                     : %zu\n", _llc.size());
+    fprintf(fp, "- Number of NUMA nodes                      : %zu\n", _node.size());
     fprintf(fp, "------------------------------------------------------\n");
     fprintf(fp, "\n");
 
@@ -373,14 +461,15 @@ void topology::print(const char *filp)
         return 4;
     };
 
-    int column_width[_nr_cpu];
+    std::vector<int> column_width;
 
     for (unsigned int c = 0, n = 0; n < _nr_cpu; ++c) {
         if (!_m_cpu_usable(c)) {
             continue;
         }
+        ++n;
 
-        column_width[n++] = compute_width(c, _m_processor_coreid(c), _m_processor_socket(c));
+        column_width.push_back(compute_width(c, _m_cpu_coreid(c), _m_cpu_socket(c)));
     }
 
     fprintf(fp, "Processor usable: %2zu - ", _nr_cpu);
@@ -448,7 +537,7 @@ void topology::print(const char *filp)
         }
         ++n;
 
-        switch (column_width[n]) {
+        switch (column_width[n - 1]) {
         case 2:
             fprintf(fp, "%2d", c);
             break;
@@ -470,15 +559,15 @@ void topology::print(const char *filp)
         }
         ++n;
 
-        switch (column_width[n]) {
+        switch (column_width[n - 1]) {
         case 2:
-            fprintf(fp, "%2d", _m_processor_coreid(c));
+            fprintf(fp, "%2d", _m_cpu_coreid(c));
             break;
         case 3:
-            fprintf(fp, "%3d", _m_processor_coreid(c));
+            fprintf(fp, "%3d", _m_cpu_coreid(c));
             break;
         case 4:
-            fprintf(fp, "%4d", _m_processor_coreid(c));
+            fprintf(fp, "%4d", _m_cpu_coreid(c));
             break;
         }
     }
@@ -492,32 +581,41 @@ void topology::print(const char *filp)
         }
         ++n;
 
-        switch (column_width[n]) {
+        switch (column_width[n - 1]) {
         case 2:
-            fprintf(fp, "%2d", _m_processor_socket(c));
+            fprintf(fp, "%2d", _m_cpu_socket(c));
             break;
         case 3:
-            fprintf(fp, "%3d", _m_processor_socket(c));
+            fprintf(fp, "%3d", _m_cpu_socket(c));
             break;
         case 4:
-            fprintf(fp, "%4d", _m_processor_socket(c));
+            fprintf(fp, "%4d", _m_cpu_socket(c));
             break;
         }
     }
     fprintf(fp, "\n");
     fprintf(fp, "\n");
 
-    fprintf(fp, "------------------------------------------\n");
-    fprintf(fp, "[Processor] - [Core] - [Socket] - [Online]\n");
-    for (unsigned int c = 0, n = 0; n < _nr_cpu; ++c) {
-        if (!_m_cpu_usable(c)) {
-            continue;
-        }
-        ++n;
+    // cache & NUMA domains
+    fprintf(fp, "[LLC] - [Level] - [Type] - [Size] - [Processors]\n");
+    for (size_t i = 0; i < _llc.size(); ++i) {
+        fprintf(fp, "%5zu     %5d   %-8s %6zuK   %s\n", i, _llc[i].level, _llc[i].type.c_str(), _llc[i].size >> 10, _llc[i].cpus.str().c_str());
+    }
+    fprintf(fp, "\n");
+
+    fprintf(fp, "[Node] - [Processors]\n");
+    for (size_t i = 0; i < _node.size(); ++i) {
+        fprintf(fp, "%6zu   %s\n", i, _node[i].str().c_str());
+    }
+    fprintf(fp, "\n");
 
-        fprintf(fp, "%7d       %4d     %5d       %4d\n", c, _m_processor_coreid(c), _m_processor_socket(c), _m_cpu_online(c) ? 1 : 0);
+    fprintf(fp, "------------------------------------------------------------\n");
+    fprintf(fp, "[Processor] - [Core] - [Socket] - [Online] - [LLC] - [Node]\n");
+    for (int c : _cpu_usable_list) {
+        fprintf(fp, "%7d       %4d     %5d       %4d      %3d      %4d\n", c, _m_cpu_coreid(c), _m_cpu_socket(c), _m_cpu_online(c) ? 1 : 0,
+                _m_cpu_llc(c), _m_cpu_node(c));
     }
-    fprintf(fp, "------------------------------------------\n");
+    fprintf(fp, "------------------------------------------------------------\n");
 
     fp != stdout ? ::fclose(fp) : 0;
 }
@@ -7,11 +7,17 @@
 #define __PERFM_TOPOLOGY_HPP__
 
 #include "perfm_config.hpp"
+#include "perfm_cpuset.hpp"
+#include "perfm_capture.hpp"
 
 #include <cstdio>
 #include <cstdlib>
 #include <memory>
-#include <bitset>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <tuple>
 
 namespace perfm {
 
@@ -35,9 +41,11 @@ namespace perfm {
 // 2. index2 - L2 unified
 // 3. index3 - L3 unified
 //
-// 4. shared_cpu_list - threads/processors which share a physical core (list format)
-// 5. shared_cpu_map  - threads/processors which share a physical core (bitmap format)
-// 6. type & size     - cache's type & size
+// 4. shared_cpu_list - threads/processors which share this cache (list format), e.g. all the
+//                      threads of a socket (or of a CCX, a sub-NUMA cluster ...) for the LLC
+// 5. shared_cpu_map  - same as above (bitmap format)
+// 6. type & size     - cache's type (Data, Instruction, Unified) & size (e.g. 32K)
+// 7. level           - 1, 2, 3 ...
 //
 // in cpuX/topology
 // 1. core_id              - physical core (uniq within socket, not uniq in the whole system; core id maybe discontinuous)
@@ -47,6 +55,10 @@ namespace perfm {
 // 5. core_siblings_list   - cpus/processors on this socket (processor, not physical core)
 // 6. core_siblings        - same as above
 //
+// in the directory "/sys/devices/system/node/" (absent if the kernel has no NUMA support)
+// 1. nodeX/cpulist - processors on NUMA node X, a socket may have several nodes with sub-NUMA
+//                    clustering, e.g. SNC-2 splits a socket's cores & memory controllers into 2
+//
 // nearly all the above entities will be affected when doing processor hotplug
 
 class topology {
@@ -59,10 +71,20 @@ public:
     void build();
     void print(const char *filp = NULL);
 
+    /* the present processors, in the format of the capture header (see perfm_capture.hpp) */
+    std::vector<capture::cpu_t> snapshot() const;
+
+    /**
+     * save - write the standalone snapshot (a capture header without samples) to @filp
+     */
+    bool save(const char *filp) const;
+
 private:
     void build_cpu_usable_list();
     void build_cpu_online_list();
     void build_cpu_topology();
+    void build_cpu_cache();
+    void build_numa_node();
 
     void processor_online() const;
     void processor_offline() const;
@@ -79,28 +101,45 @@ private:
     size_t _nr_onln_core;   /* number of online cores */
     size_t _nr_onln_socket; /* number of online sockets */
 
-    std::bitset<NR_MAX_PROCESSOR> _cpu_usable_list;
-    std::bitset<NR_MAX_PROCESSOR> _cpu_online_list;
+    /* a cache instance, shared by the processors in @cpus */
+    struct _cache_t {
+        int    level;
+        std::string type;
+        size_t size;        /* in bytes */
+        cpuset cpus;
+    };
+
+    std::vector<_cache_t> _llc;   /* the last level cache domains, subscript is the LLC id */
+    std::vector<cpuset>   _node;  /* processors on each NUMA node, subscript is the node id */
+
+    cpuset _cpu_usable_list;
+    cpuset _cpu_online_list;
     #define _m_cpu_usable(cpu)  _cpu_usable_list.test((cpu))  /* is (logical) @cpu usable ? */
     #define _m_cpu_online(cpu)  _cpu_online_list.test((cpu))  /* is (logical) @cpu online ? */
 
-    std::bitset<NR_MAX_SOCKET> _socket_usable_list;
-    std::bitset<NR_MAX_SOCKET> _socket_online_list;
+    cpuset _socket_usable_list;
+    cpuset _socket_online_list;
     #define _m_skt_usable(skt)  _socket_usable_list.test((skt))  /* is socket (physical package) usable ? */
     #define _m_skt_online(skt)  _socket_online_list.test((skt))  /* is socket (physical package) online ? */
 
-    using _core2thrds_map_t = std::array<int, NR_MAX_SMT_PER_CORE>;  
-
-    std::tuple<bool, int, _core2thrds_map_t> _topology[NR_MAX_SOCKET][NR_MAX_CORE_PER_SKT];           
-    #define _m_core_usable(skt, core)  std::get<0>(_topology[(skt)][(core)]) /* physical core exist? core's id may be discontinuous */
-    #define _m_core_thread(skt, core)  std::get<1>(_topology[(skt)][(core)]) /* how many logical threads share this core */
-    #define _m_list_thread(skt, core)  std::get<2>(_topology[(skt)][(core)]) /* logical processor/cpu list on this physical core */
-
-    std::array<std::pair<int, int>, NR_MAX_PROCESSOR> _cpu; /* subscript is (logical) processor's id
-                                                             * array type is: <core, socket>
-                                                             */
-    #define _m_processor_coreid(c)  _cpu[(c)].first
-    #define _m_processor_socket(c)  _cpu[(c)].second
+    /* core's id => logical processors on this physical core, core's id may be discontinuous */
+    using _core2thrds_map_t = std::map<int, std::vector<int>>;
+
+    std::vector<_core2thrds_map_t> _topology; /* subscript is the socket's id */
+    #define _m_core_usable(skt, core)  (_topology[(skt)].count((core)) != 0)  /* physical core exist? */
+    #define _m_core_thread(skt, core)  _topology[(skt)].at((core)).size()      /* how many logical threads share this core */
+    #define _m_list_thread(skt, core)  _topology[(skt)][(core)]                 /* logical processor/cpu list on this physical core */
+
+    std::vector<std::tuple<int, int, int, int>> _cpu; /* subscript is (logical) processor's id
+                                                       * elem type is: <core, socket, llc, node>
+                                                       *
+                                                       * not _m_processor_*, the analyzer defines those
+                                                       * on its own tuple & both are included by perfm.cpp
+                                                       */
+    #define _m_cpu_coreid(c)  std::get<0>(_cpu[(c)])
+    #define _m_cpu_socket(c)  std::get<1>(_cpu[(c)])
+    #define _m_cpu_llc(c)     std::get<2>(_cpu[(c)])  /* -1 if cpuX/cache is absent */
+    #define _m_cpu_node(c)    std::get<3>(_cpu[(c)])
 };
 
 } /* namespace perfm */
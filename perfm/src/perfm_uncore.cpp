@@ -0,0 +1,270 @@
+#include "perfm_util.hpp"
+#include "perfm_event.hpp"
+#include "perfm_parser.hpp"
+#include "perfm_uncore.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <new>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace {
+
+const std::string pmu_dir("/sys/bus/event_source/devices/");
+
+/* the cpus (one per socket) uncore events of @pmu must be opened on */
+std::vector<int> box_cpumask(const std::string &pmu)
+{
+    std::string mask;
+
+    std::fstream fp(pmu_dir + pmu + "/cpumask", std::ios::in);
+    if (!fp.good() || !std::getline(fp, mask)) {
+        return std::vector<int>();
+    }
+
+    return perfm::parse_cpu_list(mask);
+}
+
+/* raw * time_enabled / time_running, 0 if the event has never been on a counter */
+uint64_t box_scale(const uint64_t (&val)[3])
+{
+    if (val[2] == 0) {
+        return 0;
+    }
+
+    if (val[1] == val[2]) {
+        return val[0];
+    }
+
+    return static_cast<uint64_t>(1.0 * val[0] * val[1] / val[2]);
+}
+
+} /* namespace */
+
+namespace perfm {
+
+uncore::ptr_t uncore::alloc()
+{
+    uncore *u = nullptr;
+
+    try {
+        u = new uncore;
+    } catch (const std::bad_alloc &) {
+        u = nullptr;
+    }
+
+    return ptr_t(u);
+}
+
+int uncore::socket_index(int pkg)
+{
+    for (size_t s = 0; s < _socket.size(); ++s) {
+        if (_socket[s] == pkg) {
+            return s;
+        }
+    }
+
+    return -1;
+}
+
+bool uncore::open(const std::vector<std::string> &evts)
+{
+    close();
+
+    // 1. expand each event to its boxes, and find the sockets from the boxes' cpumask
+    struct expand_t {
+        std::string name;
+        std::vector<std::string> desc;   /* perf style descriptor of each box */
+        std::vector<std::vector<int>> cpus;
+    };
+
+    std::vector<expand_t> expand;
+
+    for (const auto &evn : evts) {
+        expand_t x;
+        x.name = evn;
+
+        if (!perfm_parser.expand_uncore(evn, x.desc)) {
+            perfm_warn("failed to expand uncore event %s, ignored\n", evn.c_str());
+            continue;
+        }
+
+        for (const auto &d : x.desc) {
+            x.cpus.push_back(box_cpumask(d.substr(0, d.find("/"))));
+
+            for (int c : x.cpus.back()) {
+                int pkg = cpu_package_id(c);
+                if (pkg >= 0 && socket_index(pkg) == -1) {
+                    _socket.push_back(pkg);
+                }
+            }
+        }
+
+        expand.push_back(std::move(x));
+    }
+
+    std::sort(_socket.begin(), _socket.end());
+
+    // 2. open each box event on the designated cpu of each socket
+    for (const auto &x : expand) {
+        event_t ev;
+        ev.name = x.name;
+
+        for (size_t b = 0; b < x.desc.size(); ++b) {
+            struct perf_event_attr hw;
+            if (!perfm_parser.encode(x.desc[b], &hw)) {
+                perfm_warn("failed to encode %s of %s\n", x.desc[b].c_str(), x.name.c_str());
+                continue;
+            }
+
+            hw.disabled    = 1; /* started by start() */
+            hw.read_format = RDFMT_TIMEING;
+
+            box_t box;
+            box.pmu = x.desc[b].substr(0, x.desc[b].find("/"));
+            box.evt.resize(_socket.size());
+            box.prev.assign(_socket.size(), 0);
+            box.delta.assign(_socket.size(), 0);
+
+            bool opened = false;
+
+            for (int c : x.cpus[b]) {
+                int s = socket_index(cpu_package_id(c));
+                if (s == -1) {
+                    continue;
+                }
+
+                descriptor::ptr_t d = descriptor::alloc();
+                if (!d || !d->open(&hw, -1, c, -1, 0)) {
+                    perfm_warn("failed to open %s on cpu %d\n", x.desc[b].c_str(), c);
+                    continue;
+                }
+
+                box.evt[s] = d;
+                opened = true;
+            }
+
+            if (opened) {
+                ev.box.push_back(std::move(box));
+            }
+        }
+
+        if (ev.box.empty()) {
+            perfm_warn("uncore event %s is not available, ignored\n", x.name.c_str());
+            continue;
+        }
+
+        _event.push_back(std::move(ev));
+    }
+
+    return !_event.empty();
+}
+
+void uncore::close()
+{
+    for (auto &ev : _event) {
+        for (auto &box : ev.box) {
+            for (auto &d : box.evt) {
+                if (d) {
+                    d->close();
+                }
+            }
+        }
+    }
+
+    _event.clear();
+    _socket.clear();
+}
+
+bool uncore::start()
+{
+    bool succ = true;
+
+    // counting from 0, so the first read() gives the count since start()
+    for (auto &ev : _event) {
+        for (auto &box : ev.box) {
+            for (size_t s = 0; s < box.evt.size(); ++s) {
+                if (box.evt[s] && (!box.evt[s]->reset() || !box.evt[s]->enable())) {
+                    succ = false;
+                }
+                box.prev[s] = 0;
+            }
+        }
+    }
+
+    return succ;
+}
+
+bool uncore::stop()
+{
+    bool succ = true;
+
+    for (auto &ev : _event) {
+        for (auto &box : ev.box) {
+            for (auto &d : box.evt) {
+                if (d && !d->disable()) {
+                    succ = false;
+                }
+            }
+        }
+    }
+
+    return succ;
+}
+
+void uncore::read()
+{
+    for (auto &ev : _event) {
+        for (auto &box : ev.box) {
+            for (size_t s = 0; s < box.evt.size(); ++s) {
+                if (!box.evt[s]) {
+                    continue;
+                }
+
+                uint64_t val[3] = { 0 }; /* raw count, time_enabled, time_running */
+                if (::read(box.evt[s]->fd(), val, sizeof(val)) != sizeof(val)) {
+                    perfm_warn("failed to read %s of %s on socket %d\n", box.pmu.c_str(), ev.name.c_str(), _socket[s]);
+                    continue;
+                }
+
+                uint64_t cur = box_scale(val);
+
+                // the scaled value is an estimate & may step back a little between two reads
+                box.delta[s] = cur > box.prev[s] ? cur - box.prev[s] : 0;
+                box.prev[s]  = cur;
+            }
+        }
+    }
+}
+
+uint64_t uncore::value(size_t e, size_t s) const
+{
+    if (e >= _event.size() || s >= _socket.size()) {
+        return 0;
+    }
+
+    uint64_t sum = 0;
+    for (const auto &box : _event[e].box) {
+        sum += box.delta[s];
+    }
+
+    return sum;
+}
+
+uint64_t uncore::box_value(size_t e, size_t s, size_t b) const
+{
+    if (e >= _event.size() || s >= _socket.size() || b >= _event[e].box.size()) {
+        return 0;
+    }
+
+    return _event[e].box[b].delta[s];
+}
+
+} /* namespace perfm */
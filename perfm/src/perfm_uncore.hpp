@@ -0,0 +1,118 @@
+/**
+ * perfm_uncore.hpp - uncore (socket level) events, fanned out to every box of a socket
+ *
+ */
+#ifndef __PERFM_UNCORE_HPP__
+#define __PERFM_UNCORE_HPP__
+
+#include "perfm_event.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+
+namespace perfm {
+
+// an uncore unit has several boxes on each socket, each box is a PMU of its own:
+//   UNC_C_* (CBO) -> uncore_cbox_0 ... uncore_cbox_N, one per LLC slice
+//   UNC_M_* (iMC) -> uncore_imc_0 ... uncore_imc_N, one per memory channel
+//
+// - a logical event is expanded to all the boxes of its unit (see parser::expand_uncore())
+// - each box event is opened on the designated cpu of each socket, listed in
+//   /sys/bus/event_source/devices/<box>/cpumask, pid is always -1
+// - the value of a socket is the sum over its boxes, as emon reports uncore events;
+//   the value of each box is also kept
+// - a box has few counters (2 ~ 4), the kernel multiplexes the box events beyond that, so
+//   each one is read with its time_enabled & time_running & scaled as the core events are
+//
+// events of different boxes are different PMUs and can not be grouped, each box event is
+// opened on its own & they are all started/stopped together.
+
+class uncore {
+
+public:
+    using ptr_t = std::shared_ptr<uncore>;
+
+public:
+    static ptr_t alloc();
+
+    ~uncore() {
+        close();
+    }
+
+    /**
+     * open - expand each uncore event in @evts to its boxes & open them on each socket
+     *
+     * Return:
+     *     true  - at least one event is opened
+     *     false - none of them
+     */
+    bool open(const std::vector<std::string> &evts);
+    void close();
+
+    bool start();
+    bool stop();
+
+    /**
+     * read - read all the box events & compute the counts since the previous read()
+     */
+    void read();
+
+    size_t nr_event() const {
+        return _event.size();
+    }
+
+    const std::string &name(size_t e) const {
+        return _event[e].name;
+    }
+
+    size_t nr_socket() const {
+        return _socket.size();
+    }
+
+    /* physical package id of the @s-th socket */
+    int socket_id(size_t s) const {
+        return s < _socket.size() ? _socket[s] : -1;
+    }
+
+    size_t nr_box(size_t e) const {
+        return e < _event.size() ? _event[e].box.size() : 0;
+    }
+
+    /* PMU name of the @b-th box of event @e, e.g. uncore_cbox_3 */
+    const std::string &box_name(size_t e, size_t b) const {
+        return _event[e].box[b].pmu;
+    }
+
+    /* count of event @e on the @s-th socket during the last read() interval, summed over boxes */
+    uint64_t value(size_t e, size_t s) const;
+
+    /* count of event @e on box @b of the @s-th socket during the last read() interval */
+    uint64_t box_value(size_t e, size_t s, size_t b) const;
+
+private:
+    uncore() = default;
+
+    int socket_index(int pkg);
+
+private:
+    struct box_t {
+        std::string pmu;                     /* box PMU, e.g. uncore_imc_2 */
+        std::vector<descriptor::ptr_t> evt;  /* one per socket, null if the box is missing on it */
+        std::vector<uint64_t> prev;          /* previous scaled counter value */
+        std::vector<uint64_t> delta;         /* count during the last interval */
+    };
+
+    struct event_t {
+        std::string name;                    /* the logical event, as given by the user */
+        std::vector<box_t> box;
+    };
+
+    std::vector<event_t> _event;
+    std::vector<int>     _socket;            /* physical package id of each socket */
+};
+
+} /* namespace perfm */
+
+#endif /* __PERFM_UNCORE_HPP__ */
@@ -4,6 +4,7 @@
  */
 
 #include "perfm_util.hpp"
+#include "perfm_cpuset.hpp"
 
 #include <cstdio>
 #include <cstdlib>
@@ -16,6 +17,7 @@
 #include <fstream>
 #include <functional>
 #include <map>
+#include <algorithm>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -25,6 +27,10 @@
 #include <error.h>
 #include <dirent.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
 namespace perfm {
 
 void nanosecond_sleep(double seconds, bool sleep_with_abs_time)
@@ -204,7 +210,7 @@ bool save_file(const char *filp, void *buf, size_t sz)
 
     int fd = ::open(filp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH); 
     if (fd == -1) {
-        perfm_warn("failed to open %s, %s\n", filp, strerror_r(errno, NULL, 0));
+        perfm_warn("failed to open %s, %s\n", filp, strerror(errno));
         return false;
     }
 
@@ -218,12 +224,14 @@ bool save_file(const char *filp, void *buf, size_t sz)
         }
 
         if (errno != EINTR) {
-            perfm_warn("failed to write %s, %s\n", filp, strerror_r(errno, NULL, 0));
+            perfm_warn("failed to write %s, %s\n", filp, strerror(errno));
             ::close(fd);
             return false;
         }
     }
 
+    ::close(fd);
+
     return true;
 }
 
@@ -235,13 +243,13 @@ void *read_file(const char *filp, size_t *sz)
 
     int fd = ::open(filp, O_RDONLY);
     if (fd == -1) {
-        perfm_warn("failed to open %s, %s\n", filp, strerror_r(errno, NULL, 0));
+        perfm_warn("failed to open %s, %s\n", filp, strerror(errno));
         return NULL;
     }
 
     struct stat sb;
     if (fstat(fd, &sb) != 0) {
-        perfm_warn("failed to stat %s, %s\n", filp, strerror_r(errno, NULL, 0));
+        perfm_warn("failed to stat %s, %s\n", filp, strerror(errno));
         close(fd);
         return NULL;
     }
@@ -267,7 +275,7 @@ void *read_file(const char *filp, size_t *sz)
         }
 
         if (errno != EINTR) {
-            perfm_warn("failed to read %s, %s\n", filp, strerror_r(errno, NULL, 0));
+            perfm_warn("failed to read %s, %s\n", filp, strerror(errno));
             close(fd);
             free(res);
             return NULL;
@@ -307,6 +315,41 @@ size_t num_cpu_usable()
     return nr_dirent;
 }
 
+size_t nr_cpu_ids()
+{
+    std::fstream fp("/sys/devices/system/cpu/possible", std::ios::in);
+    std::string line;
+
+    int max_id = -1;
+
+    if (fp.good() && std::getline(fp, line)) {
+        for (int c : parse_cpu_list(line)) {
+            max_id = std::max(max_id, c);
+        }
+    }
+
+    if (max_id >= 0) {
+        return max_id + 1;
+    }
+
+    struct dirent **namelist; 
+
+    int nr_dirent = ::scandir("/sys/devices/system/cpu/", &namelist, is_cpu, NULL);
+    if (nr_dirent < 0) {
+        perfm_warn("failed to get the # of processors on this system\n");
+        return 0;
+    }
+
+    for (int i = 0; i < nr_dirent; ++i) {
+        max_id = std::max(max_id, std::atoi(namelist[i]->d_name + 3));
+        free(namelist[i]);
+    }
+
+    free(namelist);
+
+    return max_id + 1;
+}
+
 std::map<int, int> cpu_frequency()
 {
     std::map<int, int> freq_list;
@@ -376,4 +419,138 @@ std::map<int, int> cpu_frequency()
     return std::move(freq_list);
 }
 
+std::vector<int> parse_cpu_list(const std::string &list)
+{
+    return cpuset::parse(list).to_vector();
+}
+
+int cpu_package_id(int cpu)
+{
+    int skt = -1;
+
+    std::fstream fp("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/physical_package_id", std::ios::in);
+    if (!fp.good() || !(fp >> skt)) {
+        return -1;
+    }
+
+    return skt;
+}
+
+uint32_t cpu_signature()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return eax;
+    }
+#endif
+
+    return 0;
+}
+
+namespace {
+
+uint64_t tsc_frequency_cpuid()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    // EAX/EBX: the ratio of TSC to the crystal clock, ECX: the crystal clock in Hz, 0 if not enumerated
+    if (__get_cpuid_max(0, NULL) < 0x15 || !__get_cpuid(0x15, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+
+    if (eax && ebx && ecx) {
+        return static_cast<uint64_t>(ecx) * ebx / eax;
+    }
+#endif
+
+    return 0;
+}
+
+uint64_t tsc_frequency_calibrate()
+{
+    auto nsec = [] () -> uint64_t {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    };
+
+    // the best of a few rounds, a round preempted between the clock & the TSC reads is off
+    double best = 0;
+    double err  = 1e18;
+
+    for (int r = 0; r < 3; ++r) {
+        uint64_t n0 = nsec();
+        uint64_t t0 = read_tsc();
+        uint64_t n1 = nsec();
+
+        nanosecond_sleep(0.02);
+
+        uint64_t n2 = nsec();
+        uint64_t t1 = read_tsc();
+        uint64_t n3 = nsec();
+
+        double elapsed = ((n2 + n3) - (n0 + n1)) / 2.0;
+        double jitter  = (n1 - n0) + (n3 - n2);
+
+        if (elapsed > 0 && jitter < err) {
+            err  = jitter;
+            best = (t1 - t0) * 1e9 / elapsed;
+        }
+    }
+
+    return static_cast<uint64_t>(best + 0.5);
+}
+
+} /* namespace */
+
+uint64_t tsc_frequency()
+{
+    static const uint64_t freq = [] {
+        uint64_t f = tsc_frequency_cpuid();
+        return f ? f : tsc_frequency_calibrate();
+    }();
+
+    return freq;
+}
+
+std::string cpu_identifier()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+        return "";
+    }
+
+    char vendor[13];
+    memcpy(vendor + 0, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+    vendor[12] = '\0';
+
+    uint32_t sig = cpu_signature();
+
+    unsigned int family   = (sig >> 8) & 0xf;
+    unsigned int model    = (sig >> 4) & 0xf;
+    unsigned int stepping = sig & 0xf;
+
+    if (family == 0xf) {
+        family += (sig >> 20) & 0xff;
+    }
+    if (family == 0x6 || family >= 0xf) {
+        model |= ((sig >> 16) & 0xf) << 4;
+    }
+
+    char id[64];
+    snprintf(id, sizeof(id), "%s-%u-%X-%X", vendor, family, model, stepping);
+
+    return id;
+#else
+    return "";
+#endif
+}
+
 } /* namespace perfm */
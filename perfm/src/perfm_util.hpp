@@ -201,6 +201,19 @@ void *read_file(const char *filp, size_t *sz = NULL);
  */
 size_t num_cpu_usable();
 
+/**
+ * nr_cpu_ids - upper bound (exclusive) of the processor ids on this system
+ *
+ * Return:
+ *     the largest possible processor id + 1
+ *
+ * Description:
+ *     from /sys/devices/system/cpu/possible, which also covers the processors that may be
+ *     hot added later, so a per-cpu table indexed by processor id never needs to grow.
+ *     falls back to the largest "cpuX" in /sys/devices/system/cpu/ + 1
+ */
+size_t nr_cpu_ids();
+
 /**
  * cpu_frequency - get frequency for all online processors
  *
@@ -215,6 +228,52 @@ size_t num_cpu_usable();
  */
 std::map<int, int> cpu_frequency();
 
+/**
+ * parse_cpu_list - expand a cpu list in the sysfs format, e.g. "0,18-35"
+ *
+ * Return:
+ *     the cpus in @list, in ascending order; invalid items are ignored with a warning
+ *
+ * Description:
+ *     see cpuset::parse() for a set of cpus rather than a list
+ */
+std::vector<int> parse_cpu_list(const std::string &list);
+
+/**
+ * cpu_package_id - physical package (socket) id of cpu @cpu
+ *
+ * Return:
+ *     the id from /sys/devices/system/cpu/cpu<cpu>/topology/physical_package_id, -1 on error
+ */
+int cpu_package_id(int cpu);
+
+/**
+ * cpu_signature - CPUID.1:EAX (family/model/stepping) of the current processor
+ *
+ * Return:
+ *     0 if CPUID is not available (non-x86)
+ */
+uint32_t cpu_signature();
+
+/**
+ * cpu_identifier - the processor id used to look up the event files, e.g. "GenuineIntel-6-4F-1"
+ *
+ * Description:
+ *     <vendor>-<family>-<model>-<stepping>, in the format of linux perf's x86 cpuid string,
+ *     so the Family-model column of the 01.org mapfile.csv can be matched against it.
+ *     empty if CPUID is not available
+ */
+std::string cpu_identifier();
+
+/**
+ * tsc_frequency - the rate (Hz) of the TSC read by read_tsc()
+ *
+ * Description:
+ *     CPUID.15H (TSC/crystal ratio x crystal clock) if it enumerates the crystal clock, otherwise
+ *     measured once against CLOCK_MONOTONIC_RAW (~20ms) & cached. 0 if neither works
+ */
+uint64_t tsc_frequency();
+
 /**
  * read_tsc - read the TSC counter
  *